@@ -0,0 +1,137 @@
+#include <random>
+#include <vector>
+#include <backstage/bvh.h>
+#include <backstage/scene.h>
+#include "bench_common.h"
+
+using namespace stage::backstage;
+
+/* A triangulated `n` x `n` height field with some noise, the typical case of a single large mesh */
+void
+add_terrain(Object& object, uint32_t n) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> height(0.f, 0.5f);
+    std::vector<stage_vec3f> positions;
+    positions.reserve(size_t(n + 1) * (n + 1));
+    for (uint32_t y = 0; y <= n; y++) {
+        for (uint32_t x = 0; x <= n; x++) {
+            positions.push_back(stage_vec3f(float(x), float(y), height(rng)));
+        }
+    }
+    std::vector<uint32_t> indices;
+    indices.reserve(size_t(n) * n * 6);
+    for (uint32_t y = 0; y < n; y++) {
+        for (uint32_t x = 0; x < n; x++) {
+            uint32_t i = y * (n + 1) + x;
+            indices.insert(indices.end(), { i, i + 1, i + n + 1, i + 1, i + n + 2, i + n + 1 });
+        }
+    }
+    std::vector<uint32_t> material_ids(positions.size(), 0);
+    object.geometries.push_back(Geometry(object, positions, {}, {}, material_ids, indices));
+}
+
+/* Small randomly placed and oriented triangles, the worst case for spatial coherence */
+void
+add_soup(Object& object, uint32_t num_triangles) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> position(0.f, 100.f);
+    std::uniform_real_distribution<float> offset(-1.f, 1.f);
+    std::vector<stage_vec3f> positions;
+    std::vector<uint32_t> indices;
+    positions.reserve(3 * size_t(num_triangles));
+    indices.reserve(3 * size_t(num_triangles));
+    for (uint32_t i = 0; i < num_triangles; i++) {
+        stage_vec3f center(position(rng), position(rng), position(rng));
+        for (uint32_t k = 0; k < 3; k++) {
+            indices.push_back(uint32_t(positions.size()));
+            positions.push_back(center + stage_vec3f(offset(rng), offset(rng), offset(rng)));
+        }
+    }
+    std::vector<uint32_t> material_ids(positions.size(), 0);
+    object.geometries.push_back(Geometry(object, positions, {}, {}, material_ids, indices));
+}
+
+size_t
+count_triangles(const std::vector<Object>& objects) {
+    size_t count = 0;
+    for (auto& object : objects) {
+        for (auto& geometry : object.geometries) {
+            count += geometry.numIndices() / 3;
+        }
+    }
+    return count;
+}
+
+void
+run(const std::string& name, const std::vector<Object>& objects, const std::vector<ObjectInstance>& instances) {
+    size_t num_triangles = count_triangles(objects);
+    std::printf("--- %s (%zu objects, %zu instances, %zu triangles) ---\n", name.c_str(), objects.size(), instances.size(), num_triangles);
+
+    for (uint32_t num_bins : { 8u, 16u, 32u }) {
+        BVHBuildOptions options;
+        options.num_bins = num_bins;
+        SceneBVH bvh;
+        double ms = bench([&]() { bvh = buildSceneBVH(objects, instances, options); });
+
+        // Average the object costs by triangle count so that large meshes dominate like they do when rendering
+        double object_cost = 0.;
+        for (size_t i = 0; i < objects.size(); i++) {
+            object_cost += double(bvh.objects[i].sahCost()) * bvh.objects[i].primitives.size();
+        }
+        object_cost /= num_triangles > 0 ? double(num_triangles) : 1.;
+
+        report("SAH BVH, " + std::to_string(num_bins) + " bins", ms, double(num_triangles), "tris");
+        std::printf("%-40s %10.3f BLAS %10.3f TLAS\n", "  SAH cost", object_cost, bvh.instances.sahCost());
+    }
+}
+
+ObjectInstance
+make_instance(float x, float y, uint32_t object_id) {
+    ObjectInstance instance;
+    instance.instance_to_world = stage_mat4f(stage_vec4f(1.f, 0.f, 0.f, 0.f), stage_vec4f(0.f, 1.f, 0.f, 0.f), stage_vec4f(0.f, 0.f, 1.f, 0.f), stage_vec4f(x, y, 0.f, 1.f));
+    instance.object_id = object_id;
+    return instance;
+}
+
+/* Usage: bench_bvh [scene ...], every scene given on the command line is benchmarked after the synthetic ones */
+int main(int argc, char** argv) {
+    for (uint32_t n : { 256u, 1024u }) {
+        std::vector<Object> objects;
+        objects.emplace_back(VertexLayout_Interleaved_V, 4);
+        add_terrain(objects[0], n);
+        run("Terrain " + std::to_string(n) + "x" + std::to_string(n), objects, { make_instance(0.f, 0.f, 0) });
+    }
+
+    {
+        std::vector<Object> objects;
+        objects.emplace_back(VertexLayout_Interleaved_V, 4);
+        add_soup(objects[0], 1u << 20);
+        run("Triangle soup", objects, { make_instance(0.f, 0.f, 0) });
+    }
+
+    {
+        // Many objects with a few thousand instances exercise both levels
+        std::vector<Object> objects;
+        for (uint32_t i = 0; i < 16; i++) {
+            objects.emplace_back(VertexLayout_Interleaved_V, 4);
+            add_terrain(objects.back(), 64 + 16 * i);
+        }
+        std::vector<ObjectInstance> instances;
+        for (uint32_t y = 0; y < 64; y++) {
+            for (uint32_t x = 0; x < 64; x++) {
+                instances.push_back(make_instance(300.f * x, 300.f * y, (x + y) % 16));
+            }
+        }
+        run("Instanced", objects, instances);
+    }
+
+    for (int i = 1; i < argc; i++) {
+        std::unique_ptr<Scene> scene = createScene(argv[i], Config());
+        if (!scene) {
+            std::printf("Failed to load %s\n", argv[i]);
+            continue;
+        }
+        run(argv[i], scene->getObjects(), scene->getInstances());
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+/* Runs `fn` `repetitions` times and returns the fastest run in milliseconds */
+inline double
+bench(const std::function<void()>& fn, int repetitions = 5) {
+    double best = 1e30;
+    for (int i = 0; i < repetitions; i++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        fn();
+        auto end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        best = ms < best ? ms : best;
+    }
+    return best;
+}
+
+inline void
+report(const std::string& name, double ms, double items, const std::string& unit) {
+    std::printf("%-40s %10.3f ms %12.2f M%s/s\n", name.c_str(), ms, items / (ms * 1e3), unit.c_str());
+}
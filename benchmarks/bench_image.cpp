@@ -0,0 +1,72 @@
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+#include <backstage/image.h>
+#include "bench_common.h"
+
+using namespace stage::backstage;
+
+template<typename T>
+Image
+make_image(int32_t width, int32_t height, T max_value) {
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> value(0.f, float(max_value));
+    auto pixels = std::make_shared<std::vector<T>>(size_t(width) * height * 4);
+    for (auto& p : *pixels) {
+        p = T(value(rng));
+    }
+    return Image((uint8_t*)pixels->data(), width, height, 4, std::is_same<T, float>::value, pixels);
+}
+
+template<typename T>
+void
+run(const char* format, int32_t width, int32_t height, T max_value) {
+    Image image = make_image<T>(width, height, max_value);
+    Image other = make_image<T>(width, height, max_value);
+    double pixels = double(width) * height;
+    std::printf("--- %s %dx%d ---\n", format, width, height);
+
+    // The first call makes a private copy of the wrapped pixels, which is not part of the measurement
+    image.scale(stage_vec3f(1.f));
+
+    // Scaling back and forth keeps HDR values in range across repetitions
+    double ms = bench([&]() {
+        image.scale(stage_vec3f(2.f, 1.5f, 0.5f));
+        image.scale(stage_vec3f(0.5f, 1.f / 1.5f, 2.f));
+    });
+    report("scale color", ms / 2, pixels, "px");
+
+    ms = bench([&]() { image.scale(other); });
+    report("scale image", ms, pixels, "px");
+
+    ms = bench([&]() { image.mix(stage_vec3f(0.2f, 0.4f, 0.6f), stage_vec3f(0.25f)); });
+    report("mix color", ms, pixels, "px");
+
+    ms = bench([&]() { image.mix(other, stage_vec3f(0.5f)); });
+    report("mix image", ms, pixels, "px");
+
+    // Every run generates the chain from the same pixels through a new reference
+    auto source = std::make_shared<Image>(std::move(other));
+    for (MipFilter filter : { MipFilter_Box, MipFilter_Kaiser }) {
+        ms = bench([&]() { Image(source).generateMips(filter); });
+        report(filter == MipFilter_Box ? "generateMips box" : "generateMips kaiser", ms, pixels, "px");
+    }
+
+    // Noise is the worst case for the endpoint fit, real textures compress faster
+    std::vector<std::pair<TextureFormat, const char*>> formats = { { TextureFormat_BC1, "compress BC1" }, { TextureFormat_BC4, "compress BC4" }, { TextureFormat_BC7, "compress BC7" } };
+    if (std::is_same<T, float>::value)
+        formats = { { TextureFormat_BC6H, "compress BC6H" } };
+    for (auto [format, name] : formats) {
+        ms = bench([&]() { Image(source).compress(format); }, 1);
+        report(name, ms, pixels, "px");
+    }
+}
+
+int main() {
+    for (auto [width, height] : { std::make_pair(3840, 2160), std::make_pair(7680, 4320) }) {
+        run<uint8_t>("RGBA8", width, height, 255);
+        run<float>("RGBA32F", width, height, 4.f);
+    }
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include <random>
+#include <vector>
+#include <backstage/kernels.h>
+#include "bench_common.h"
+
+using namespace stage::backstage;
+
+void
+run(size_t num_vertices) {
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> value(-100.f, 100.f);
+    std::vector<stage_vec3f> positions(num_vertices);
+    for (auto& p : positions) {
+        p = stage_vec3f(value(rng), value(rng), value(rng));
+    }
+    std::vector<uint32_t> material_ids(num_vertices, 0);
+
+    stage_mat4f m(stage_vec4f(0.f, 1.f, 0.f, 0.f), stage_vec4f(-2.f, 0.f, 0.f, 0.f), stage_vec4f(0.f, 0.f, 0.5f, 0.f), stage_vec4f(1.f, 2.f, 3.f, 1.f));
+    stage_mat4f inverse(stage_vec4f(0.f, -0.5f, 0.f, 0.f), stage_vec4f(1.f, 0.f, 0.f, 0.f), stage_vec4f(0.f, 0.f, 2.f, 0.f), stage_vec4f(-2.f, 0.5f, -6.f, 1.f));
+
+    // Tightly packed positions and positions interleaved with normals and material IDs
+    for (VertexLayout layout : { VertexLayout_Block_V, VertexLayout_Interleaved_VN }) {
+        Object object(layout, 4);
+        Geometry g(object, positions, layout == VertexLayout_Block_V ? std::vector<stage_vec3f>() : positions, {}, material_ids, {});
+        std::printf("--- %s, %zu vertices, stride %zu ---\n", layout == VertexLayout_Block_V ? "Block_V" : "Interleaved_VN", num_vertices, g.positions.stride());
+
+        for (int level = SIMDLevel_Scalar; level <= supportedSIMDLevel(); level++) {
+            setSIMDLevel(SIMDLevel(level));
+            std::string name = simdLevelName(SIMDLevel(level));
+
+            // Transforming back and forth keeps the data in range across repetitions
+            double ms = bench([&]() {
+                transformPositions(g.positions, m);
+                transformPositions(g.positions, inverse);
+            });
+            report("transformPositions " + name, ms / 2, double(num_vertices), "vec");
+
+            ms = bench([&]() { computeBounds(g.positions); });
+            report("computeBounds " + name, ms, double(num_vertices), "vec");
+
+            ms = bench([&]() { normalizeVectors(g.positions); });
+            report("normalizeVectors " + name, ms, double(num_vertices), "vec");
+
+            ms = bench([&]() { transformNormals(g.positions, m); });
+            report("transformNormals " + name, ms, double(num_vertices), "vec");
+        }
+    }
+}
+
+/* A cache resident batch shows the compute throughput, a large one the memory bound case */
+int main() {
+    for (size_t num_vertices : { size_t(1) << 14, size_t(1) << 22 }) {
+        run(num_vertices);
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <map>
+#include <tuple>
+#include <vector>
+#include <backstage/weld.h>
+#include "bench_common.h"
+
+using namespace stage::backstage;
+
+/* Corner indices of a triangulated grid, the way a loader would walk them face by face */
+std::vector<uint32_t>
+make_grid_corners(uint32_t n) {
+    std::vector<uint32_t> corners;
+    corners.reserve(size_t(n) * n * 6);
+    for (uint32_t y = 0; y < n; y++) {
+        for (uint32_t x = 0; x < n; x++) {
+            uint32_t v00 = y * (n + 1) + x;
+            uint32_t v10 = v00 + 1;
+            uint32_t v01 = v00 + n + 1;
+            uint32_t v11 = v01 + 1;
+            corners.insert(corners.end(), { v00, v10, v11, v00, v11, v01 });
+        }
+    }
+    return corners;
+}
+
+int main() {
+    for (uint32_t n : { 64u, 512u, 1024u }) {
+        std::vector<uint32_t> corners = make_grid_corners(n);
+        std::vector<uint32_t> indices(corners.size());
+        std::printf("--- Grid %ux%u (%zu corners) ---\n", n, n, corners.size());
+
+        double ms = bench([&]() {
+            std::map<std::tuple<uint32_t, uint32_t, uint32_t>, uint32_t> index_map;
+            uint32_t count = 0;
+            for (size_t i = 0; i < corners.size(); i++) {
+                auto key = std::make_tuple(corners[i], corners[i], corners[i]);
+                auto it = index_map.find(key);
+                if (it != index_map.end()) {
+                    indices[i] = it->second;
+                } else {
+                    index_map[key] = count;
+                    indices[i] = count++;
+                }
+            }
+        });
+        report("std::map<tuple> (OBJ)", ms, corners.size(), "corners");
+
+        ms = bench([&]() {
+            VertexWelder<stage_vec3i> welder(corners.size() / 4);
+            for (size_t i = 0; i < corners.size(); i++)
+                indices[i] = welder.weld(stage_vec3i(corners[i], corners[i], corners[i]));
+        });
+        report("VertexWelder<stage_vec3i> (OBJ)", ms, corners.size(), "corners");
+
+        ms = bench([&]() {
+            std::map<uint32_t, uint32_t> index_map;
+            uint32_t count = 0;
+            for (size_t i = 0; i < corners.size(); i++) {
+                auto it = index_map.find(corners[i]);
+                if (it != index_map.end()) {
+                    indices[i] = it->second;
+                } else {
+                    index_map[corners[i]] = count;
+                    indices[i] = count++;
+                }
+            }
+        });
+        report("std::map<uint32_t> (FBX)", ms, corners.size(), "corners");
+
+        ms = bench([&]() {
+            VertexWelder<uint32_t> welder(corners.size() / 4);
+            for (size_t i = 0; i < corners.size(); i++)
+                indices[i] = welder.weld(corners[i]);
+        });
+        report("VertexWelder<uint32_t> (FBX)", ms, corners.size(), "corners");
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include "allocator.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+#include <cstring>
+
+namespace stage {
+namespace backstage {
+
+namespace {
+
+/* 
+ * Uses std::malloc for alignments it already guarantees, so memory allocated by stbi and tinyexr can be released here as well.
+ * Larger alignments use the platform's aligned allocation, which cannot grow in place.
+ */
+struct MallocAllocator : public Allocator {
+    void* allocate(size_t size, size_t alignment) override {
+        if (alignment <= alignof(std::max_align_t))
+            return std::malloc(size);
+#if defined(_WIN32)
+        return _aligned_malloc(size, alignment);
+#else
+        void* ptr = nullptr;
+        if (posix_memalign(&ptr, alignment, size) != 0)
+            return nullptr;
+        return ptr;
+#endif
+    }
+
+    void deallocate(void* ptr, size_t /*size*/, size_t alignment) override {
+        if (alignment <= alignof(std::max_align_t)) {
+            std::free(ptr);
+            return;
+        }
+#if defined(_WIN32)
+        _aligned_free(ptr);
+#else
+        std::free(ptr);
+#endif
+    }
+
+    void* reallocate(void* ptr, size_t old_size, size_t new_size, size_t alignment) override {
+        if (alignment <= alignof(std::max_align_t))
+            return std::realloc(ptr, new_size);
+        return Allocator::reallocate(ptr, old_size, new_size, alignment);
+    }
+};
+
+}
+
+void*
+Allocator::reallocate(void* ptr, size_t old_size, size_t new_size, size_t alignment) {
+    void* result = allocate(new_size, alignment);
+    if (result == nullptr)
+        return nullptr;
+    if (ptr != nullptr) {
+        std::memcpy(result, ptr, std::min(old_size, new_size));
+        deallocate(ptr, old_size, alignment);
+    }
+    return result;
+}
+
+std::shared_ptr<Allocator>
+Allocator::getDefault() {
+    static std::shared_ptr<Allocator> allocator = std::make_shared<MallocAllocator>();
+    return allocator;
+}
+
+}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+namespace stage {
+namespace backstage {
+
+/*
+ * Source of the memory that holds vertex buffers and decoded textures, see Config::allocator.
+ * Every allocation is released through the allocator that created it, with the same size and alignment it was requested with.
+ * Alignments are powers of two, the returned memory must be aligned accordingly.
+ * Buffers and images keep their allocator alive, so it may be released by the application before the scene is.
+ * Allocators can be called from multiple loading threads at once and must be thread-safe.
+ */
+struct Allocator {
+    virtual ~Allocator() = default;
+
+    virtual void* allocate(size_t size, size_t alignment) = 0;
+    virtual void deallocate(void* ptr, size_t size, size_t alignment) = 0;
+    /* Resizes an allocation, preserving its contents up to the smaller size. The default allocates, copies and deallocates. */
+    virtual void* reallocate(void* ptr, size_t old_size, size_t new_size, size_t alignment);
+
+    /* The allocator used when none is configured, based on std::malloc */
+    static std::shared_ptr<Allocator> getDefault();
+};
+
+}
+}
@@ -0,0 +1,173 @@
+#include "asset_cache.h"
+#include "scene.h"
+
+#include <filesystem>
+
+namespace stage {
+namespace backstage {
+
+namespace {
+
+/* Identifies a file by its canonical path and modification time, so edited files are loaded again */
+std::string
+fileKey(const std::string& filename) {
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::weakly_canonical(filename, error);
+    if (error)
+        path = std::filesystem::absolute(filename, error);
+    auto mtime = std::filesystem::last_write_time(path, error);
+    return path.string() + "@" + (error ? std::string("?") : std::to_string(mtime.time_since_epoch().count()));
+}
+
+/* Cached data lives in the memory of the allocator it was loaded with, so it is only shared between loads that use the same one */
+std::string
+allocatorKey(const Allocator* allocator) {
+    if (allocator == nullptr || allocator == Allocator::getDefault().get())
+        return "default";
+    return std::to_string(reinterpret_cast<uintptr_t>(allocator));
+}
+
+std::string
+imageKey(const std::string& filename, bool is_hdr, bool lazy, MipFilter mip_filter, const Allocator* allocator) {
+    return "image:" + fileKey(filename) + ":" + std::to_string(is_hdr) + ":" + std::to_string(lazy) + ":" + std::to_string(mip_filter) + ":" + allocatorKey(allocator);
+}
+
+/* Only the Config fields that change the loaded data belong in the key */
+std::string
+configKey(const Config& config) {
+    return std::to_string(config.layout) + ":" + 
+           std::to_string(config.vertex_alignment) + ":" +
+           std::to_string(config.obj_parser) + ":" +
+           std::to_string(config.lazy_textures) + ":" +
+           std::to_string(config.mip_filter) + ":" +
+           std::to_string(config.texture_compression) + ":" +
+           std::to_string(config.optimize_vertex_cache) + ":" +
+           std::to_string(config.index_format) + ":" +
+           (config.build_meshlets ? std::to_string(config.meshlet_max_vertices) + "/" + std::to_string(config.meshlet_max_triangles) : "0") + ":" +
+           allocatorKey(config.allocator.get());
+}
+
+}
+
+AssetCache&
+AssetCache::get() {
+    static AssetCache cache;
+    return cache;
+}
+
+std::shared_ptr<Image>
+AssetCache::findImage(std::string filename, bool is_hdr, bool lazy, MipFilter mip_filter, const Allocator* allocator) {
+    std::string key = imageKey(filename, is_hdr, lazy, mip_filter, allocator);
+    return std::static_pointer_cast<Image>(find(key));
+}
+
+void
+AssetCache::insertImage(std::string filename, bool is_hdr, bool lazy, MipFilter mip_filter, std::shared_ptr<Image> image, const Allocator* allocator) {
+    std::string key = imageKey(filename, is_hdr, lazy, mip_filter, allocator);
+    insert(key, image, image->getSizeInBytes());
+}
+
+std::shared_ptr<SceneAssets>
+AssetCache::findScene(std::string filename, const Config& config) {
+    std::string key = "scene:" + fileKey(filename) + ":" + configKey(config);
+    return std::static_pointer_cast<SceneAssets>(find(key));
+}
+
+void
+AssetCache::insertScene(std::string filename, const Config& config, Scene& scene) {
+    auto assets = std::make_shared<SceneAssets>();
+    size_t size_in_bytes = 0;
+
+    assets->camera = scene.getCamera() ? std::make_shared<Camera>(*scene.getCamera()) : nullptr;
+    assets->objects = scene.getObjects();
+    assets->instances = scene.getInstances();
+    assets->materials = scene.getMaterials();
+    assets->lights = scene.getLights();
+    assets->scene_scale = scene.getSceneScale();
+
+    for (auto& object : assets->objects) {
+        size_in_bytes += object.data->size();
+        for (auto& geometry : object.geometries) {
+            size_in_bytes += geometry.numIndices() * geometry.indexSize();
+        }
+    }
+
+    // Move the scene's images into shared storage, the scene keeps using them through lightweight references
+    for (auto& texture : scene.getTextures()) {
+        auto shared = std::make_shared<Image>(std::move(texture));
+        texture = Image(shared);
+        assets->textures.push_back(shared);
+        size_in_bytes += shared->getSizeInBytes();
+    }
+
+    std::string key = "scene:" + fileKey(filename) + ":" + configKey(config);
+    insert(key, assets, size_in_bytes);
+}
+
+void
+AssetCache::setBudget(size_t budget_in_bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budget = budget_in_bytes;
+    evict();
+}
+
+size_t
+AssetCache::getBudget() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_budget;
+}
+
+size_t
+AssetCache::getSize() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_size;
+}
+
+void
+AssetCache::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_index.clear();
+    m_size = 0;
+}
+
+std::shared_ptr<void>
+AssetCache::find(const std::string& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_index.find(key);
+    if (it == m_index.end()) return nullptr;
+
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return it->second->asset;
+}
+
+void
+AssetCache::insert(const std::string& key, std::shared_ptr<void> asset, size_t size_in_bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (size_in_bytes > m_budget) return;
+
+    auto it = m_index.find(key);
+    if (it != m_index.end()) {
+        m_size -= it->second->size_in_bytes;
+        m_entries.erase(it->second);
+        m_index.erase(it);
+    }
+
+    m_entries.push_front({ key, asset, size_in_bytes });
+    m_index[key] = m_entries.begin();
+    m_size += size_in_bytes;
+    evict();
+}
+
+void
+AssetCache::evict() {
+    while (m_size > m_budget && !m_entries.empty()) {
+        Entry& entry = m_entries.back();
+        m_size -= entry.size_in_bytes;
+        m_index.erase(entry.key);
+        m_entries.pop_back();
+    }
+}
+
+}
+}
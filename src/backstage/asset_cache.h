@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "config.h"
+#include "camera.h"
+#include "image.h"
+#include "light.h"
+#include "material.h"
+#include "mesh.h"
+
+namespace stage {
+namespace backstage {
+
+struct Scene;
+
+/* Loaded scene data that can be shared between Scene instances. Objects share their vertex buffers. */
+struct SceneAssets {
+    std::shared_ptr<Camera> camera;
+    std::vector<Object> objects;
+    std::vector<ObjectInstance> instances;
+    std::vector<OpenPBRMaterial> materials;
+    std::vector<Light> lights;
+    std::vector<std::shared_ptr<Image>> textures;
+    float scene_scale { 1.f };
+};
+
+/*
+ * Process-wide cache of decoded images and loaded scenes, used when Config::use_asset_cache is set.
+ * Entries are keyed by canonical path, modification time, and the Config fields that change the loaded data.
+ * For scenes only the top-level file is checked, files it references are not part of the key.
+ * Assets are reference counted, scenes created from the cache share vertex buffers and pixels with it. 
+ * Cached data must therefore be treated as read-only, Image::scale() and Image::mix() copy shared pixels before writing.
+ * When the cached bytes exceed the budget, the least recently used entries are dropped. Scenes that still use them keep them alive.
+ */
+struct AssetCache {
+    static AssetCache& get();
+
+    /* Images are only shared between loads that use the same allocator, a null allocator stands for the default */
+    std::shared_ptr<Image> findImage(std::string filename, bool is_hdr, bool lazy, MipFilter mip_filter, const Allocator* allocator = nullptr);
+    void insertImage(std::string filename, bool is_hdr, bool lazy, MipFilter mip_filter, std::shared_ptr<Image> image, const Allocator* allocator = nullptr);
+
+    std::shared_ptr<SceneAssets> findScene(std::string filename, const Config& config);
+    void insertScene(std::string filename, const Config& config, Scene& scene);
+
+    void setBudget(size_t budget_in_bytes);
+    size_t getBudget();
+    size_t getSize();
+    void clear();
+
+private:
+    AssetCache() = default;
+
+    struct Entry {
+        std::string key;
+        std::shared_ptr<void> asset;
+        size_t size_in_bytes;
+    };
+
+    std::shared_ptr<void> find(const std::string& key);
+    void insert(const std::string& key, std::shared_ptr<void> asset, size_t size_in_bytes);
+    void evict();
+
+    std::mutex m_mutex;
+    std::list<Entry> m_entries;     // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+    size_t m_size { 0 };
+    size_t m_budget { size_t(1) << 30 };
+};
+
+}
+}
@@ -0,0 +1,653 @@
+#include "block_compression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <tbb/tbb.h>
+
+#include "quantization.h"
+
+namespace stage {
+namespace backstage {
+
+namespace {
+
+/* Interpolation weights of the 4 bit indices of BC6H and BC7, in 64ths */
+constexpr int32_t weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+/* Largest unsigned half float that BC6H can represent, 65504 */
+constexpr float max_half = 31743.f;
+
+/* Packs fields of a 16 byte block least significant bit first, fields must not be wider than 32 bits */
+struct BitWriter {
+    uint64_t words[2] { 0, 0 };
+    uint32_t position { 0 };
+
+    void write(uint32_t value, uint32_t bits) {
+        if (position < 64) {
+            words[0] |= uint64_t(value) << position;
+            if (position + bits > 64)
+                words[1] |= uint64_t(value) >> (64 - position);
+        } else {
+            words[1] |= uint64_t(value) << (position - 64);
+        }
+        position += bits;
+    }
+
+    void store(uint8_t* out) {
+        for (int32_t b = 0; b < 16; b++) {
+            out[b] = uint8_t(words[b / 8] >> (8 * (b % 8)));
+        }
+    }
+};
+
+/* The 16 texels of a block as RGBA, in [0, 255] for LDR formats and as half float bit patterns for BC6H */
+struct Block {
+    float texels[16][4];
+};
+
+void
+loadBlock(const uint8_t* texels, uint32_t width, uint32_t height, int32_t channels, uint32_t bx, uint32_t by, Block& block) {
+    for (uint32_t i = 0; i < 16; i++) {
+        uint32_t x = std::min(bx * 4 + i % 4, width - 1);
+        uint32_t y = std::min(by * 4 + i / 4, height - 1);
+        const uint8_t* texel = texels + (size_t(y) * width + x) * channels;
+        float* value = block.texels[i];
+        if (channels <= 2) {
+            value[0] = value[1] = value[2] = texel[0];
+            value[3] = channels == 2 ? texel[1] : 255.f;
+        } else {
+            value[0] = texel[0];
+            value[1] = texel[1];
+            value[2] = texel[2];
+            value[3] = channels == 4 ? texel[3] : 255.f;
+        }
+    }
+}
+
+void
+loadChannel(const uint8_t* texels, uint32_t width, uint32_t height, int32_t channels, int32_t channel, uint32_t bx, uint32_t by, float values[16]) {
+    channel = std::min(channel, channels - 1);
+    for (uint32_t i = 0; i < 16; i++) {
+        uint32_t x = std::min(bx * 4 + i % 4, width - 1);
+        uint32_t y = std::min(by * 4 + i / 4, height - 1);
+        values[i] = texels[(size_t(y) * width + x) * channels + channel];
+    }
+}
+
+void
+loadBlockHalf(const float* texels, uint32_t width, uint32_t height, int32_t channels, uint32_t bx, uint32_t by, Block& block) {
+    for (uint32_t i = 0; i < 16; i++) {
+        uint32_t x = std::min(bx * 4 + i % 4, width - 1);
+        uint32_t y = std::min(by * 4 + i / 4, height - 1);
+        const float* texel = texels + (size_t(y) * width + x) * channels;
+        for (int32_t c = 0; c < 3; c++) {
+            float value = texel[channels <= 2 ? 0 : c];
+            // NaNs and negative values become zero, values beyond the half range the largest half
+            value = value > 0.f ? std::min(value, 65504.f) : 0.f;
+            block.texels[i][c] = floatToHalf(value);
+        }
+        block.texels[i][3] = 0.f;
+    }
+}
+
+/* Mean and principal axis of `count` points with N channels, found by power iteration on their covariance */
+template<int32_t N>
+void
+fitAxis(const float (*points)[4], uint32_t count, float mean[N], float axis[N]) {
+    for (int32_t c = 0; c < N; c++) {
+        mean[c] = 0.f;
+        for (uint32_t i = 0; i < count; i++) {
+            mean[c] += points[i][c];
+        }
+        mean[c] /= count;
+    }
+
+    float covariance[N][N] = {};
+    for (uint32_t i = 0; i < count; i++) {
+        for (int32_t a = 0; a < N; a++) {
+            for (int32_t b = 0; b < N; b++) {
+                covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+            }
+        }
+    }
+
+    // Start from the channel with the largest variance, which converges quickly for typical blocks
+    int32_t start = 0;
+    for (int32_t c = 1; c < N; c++) {
+        if (covariance[c][c] > covariance[start][start]) start = c;
+    }
+    for (int32_t c = 0; c < N; c++) {
+        axis[c] = c == start ? 1.f : 0.f;
+    }
+    for (int32_t iteration = 0; iteration < 8; iteration++) {
+        float next[N] = {};
+        float length = 0.f;
+        for (int32_t a = 0; a < N; a++) {
+            for (int32_t b = 0; b < N; b++) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length += next[a] * next[a];
+        }
+        if (length < 1e-12f) break;
+        length = std::sqrt(length);
+        for (int32_t c = 0; c < N; c++) {
+            axis[c] = next[c] / length;
+        }
+    }
+}
+
+/* Endpoints at the extremes of the points along their principal axis */
+template<int32_t N>
+void
+fitEndpoints(const float (*points)[4], uint32_t count, float e0[N], float e1[N]) {
+    float mean[N];
+    float axis[N];
+    fitAxis<N>(points, count, mean, axis);
+
+    float t_min = 0.f;
+    float t_max = 0.f;
+    for (uint32_t i = 0; i < count; i++) {
+        float t = 0.f;
+        for (int32_t c = 0; c < N; c++) {
+            t += (points[i][c] - mean[c]) * axis[c];
+        }
+        t_min = std::min(t_min, t);
+        t_max = std::max(t_max, t);
+    }
+    for (int32_t c = 0; c < N; c++) {
+        e0[c] = mean[c] + axis[c] * t_min;
+        e1[c] = mean[c] + axis[c] * t_max;
+    }
+}
+
+/* Least squares endpoints for fixed interpolation weights from 0 (e0) to 1 (e1), returns false if they are not determined */
+template<int32_t N>
+bool
+refineEndpoints(const float (*points)[4], const float* weights, uint32_t count, float e0[N], float e1[N]) {
+    float aa = 0.f, ab = 0.f, bb = 0.f;
+    float ax[N] = {};
+    float bx[N] = {};
+    for (uint32_t i = 0; i < count; i++) {
+        float a = 1.f - weights[i];
+        float b = weights[i];
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int32_t c = 0; c < N; c++) {
+            ax[c] += a * points[i][c];
+            bx[c] += b * points[i][c];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) < 1e-6f) return false;
+    for (int32_t c = 0; c < N; c++) {
+        e0[c] = (bb * ax[c] - ab * bx[c]) / determinant;
+        e1[c] = (aa * bx[c] - ab * ax[c]) / determinant;
+    }
+    return true;
+}
+
+/* BC1 */
+
+uint16_t
+packRGB565(const float color[3]) {
+    int32_t r = std::clamp(int32_t(std::lround(color[0] * 31.f / 255.f)), 0, 31);
+    int32_t g = std::clamp(int32_t(std::lround(color[1] * 63.f / 255.f)), 0, 63);
+    int32_t b = std::clamp(int32_t(std::lround(color[2] * 31.f / 255.f)), 0, 31);
+    return uint16_t((r << 11) | (g << 5) | b);
+}
+
+void
+unpackRGB565(uint16_t value, float color[3]) {
+    int32_t r = value >> 11;
+    int32_t g = (value >> 5) & 63;
+    int32_t b = value & 31;
+    color[0] = float((r << 3) | (r >> 2));
+    color[1] = float((g << 2) | (g >> 4));
+    color[2] = float((b << 3) | (b >> 2));
+}
+
+struct BC1Candidate {
+    uint16_t c0 { 0 };
+    uint16_t c1 { 0 };
+    uint32_t indices { 0 };
+    float error { 1e30f };
+};
+
+/* Picks the closest palette entry for every opaque texel, transparent texels use index 3 of the three color mode */
+BC1Candidate
+selectBC1Indices(const Block& block, const bool transparent[16], uint16_t c0, uint16_t c1) {
+    float palette[4][3];
+    unpackRGB565(c0, palette[0]);
+    unpackRGB565(c1, palette[1]);
+    bool four_colors = c0 > c1;
+    for (int32_t c = 0; c < 3; c++) {
+        if (four_colors) {
+            palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+            palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2.f;
+            palette[3][c] = 0.f;
+        }
+    }
+
+    BC1Candidate candidate;
+    candidate.c0 = c0;
+    candidate.c1 = c1;
+    candidate.error = 0.f;
+    for (uint32_t i = 0; i < 16; i++) {
+        uint32_t best = 3;
+        if (!transparent[i]) {
+            float best_error = 1e30f;
+            for (uint32_t p = 0; p < (four_colors ? 4u : 3u); p++) {
+                float error = 0.f;
+                for (int32_t c = 0; c < 3; c++) {
+                    float d = block.texels[i][c] - palette[p][c];
+                    error += d * d;
+                }
+                if (error < best_error) {
+                    best_error = error;
+                    best = p;
+                }
+            }
+            candidate.error += best_error;
+        }
+        candidate.indices |= best << (2 * i);
+    }
+    return candidate;
+}
+
+/* Opaque blocks use the four color mode (c0 > c1), blocks with transparent texels the three color mode (c0 <= c1) */
+BC1Candidate
+evaluateBC1(const Block& block, const bool transparent[16], bool has_transparency, const float e0[3], const float e1[3]) {
+    uint16_t a = packRGB565(e0);
+    uint16_t b = packRGB565(e1);
+    if (has_transparency)
+        return selectBC1Indices(block, transparent, std::min(a, b), std::max(a, b));
+    return selectBC1Indices(block, transparent, std::max(a, b), std::min(a, b));
+}
+
+void
+encodeBC1(const Block& block, uint8_t* out) {
+    bool transparent[16];
+    float points[16][4];
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        transparent[i] = block.texels[i][3] < 128.f;
+        if (!transparent[i])
+            std::memcpy(points[count++], block.texels[i], sizeof(points[0]));
+    }
+
+    BC1Candidate best;
+    if (count == 0) {
+        best.indices = 0xffffffff;
+    } else {
+        bool has_transparency = count < 16;
+        float e0[3], e1[3];
+        fitEndpoints<3>(points, count, e0, e1);
+        best = evaluateBC1(block, transparent, has_transparency, e0, e1);
+
+        // One least squares pass over the chosen indices
+        bool four_colors = best.c0 > best.c1;
+        const float palette_weights[4] = { 0.f, 1.f, four_colors ? 1.f / 3.f : 0.5f, 2.f / 3.f };
+        float weights[16];
+        for (uint32_t i = 0, j = 0; i < 16; i++) {
+            if (!transparent[i])
+                weights[j++] = palette_weights[(best.indices >> (2 * i)) & 3];
+        }
+        if (refineEndpoints<3>(points, weights, count, e0, e1)) {
+            BC1Candidate refined = evaluateBC1(block, transparent, has_transparency, e0, e1);
+            if (refined.error < best.error)
+                best = refined;
+        }
+    }
+
+    out[0] = uint8_t(best.c0);
+    out[1] = uint8_t(best.c0 >> 8);
+    out[2] = uint8_t(best.c1);
+    out[3] = uint8_t(best.c1 >> 8);
+    for (int32_t b = 0; b < 4; b++) {
+        out[4 + b] = uint8_t(best.indices >> (8 * b));
+    }
+}
+
+/* BC4, the eight value mode interpolates between the largest and smallest value */
+void
+encodeBC4(const float values[16], uint8_t* out) {
+    float lo = *std::min_element(values, values + 16);
+    float hi = *std::max_element(values, values + 16);
+    out[0] = uint8_t(hi);
+    out[1] = uint8_t(lo);
+    if (hi == lo) return;
+
+    float palette[8] = { hi, lo };
+    for (int32_t p = 2; p < 8; p++) {
+        palette[p] = ((8 - p) * hi + (p - 1) * lo) / 7.f;
+    }
+    uint64_t indices = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        uint64_t best = 0;
+        for (uint64_t p = 1; p < 8; p++) {
+            if (std::abs(values[i] - palette[p]) < std::abs(values[i] - palette[best])) best = p;
+        }
+        indices |= best << (3 * i);
+    }
+    for (int32_t b = 0; b < 6; b++) {
+        out[2 + b] = uint8_t(indices >> (8 * b));
+    }
+}
+
+/*
+ * Picks the closest of the 16 palette entries of BC6H and BC7 for every texel and returns the squared error.
+ * The palette is close to evenly spaced on a line, so only the entries next to the projection onto that line are tried.
+ */
+template<int32_t N>
+float
+selectIndices(const Block& block, const float palette[16][4], uint8_t indices[16]) {
+    float axis[N];
+    float length_squared = 0.f;
+    for (int32_t c = 0; c < N; c++) {
+        axis[c] = palette[15][c] - palette[0][c];
+        length_squared += axis[c] * axis[c];
+    }
+    float scale = length_squared > 0.f ? 15.f / length_squared : 0.f;
+
+    float error = 0.f;
+    for (uint32_t i = 0; i < 16; i++) {
+        float t = 0.f;
+        for (int32_t c = 0; c < N; c++) {
+            t += (block.texels[i][c] - palette[0][c]) * axis[c];
+        }
+        int32_t guess = std::clamp(int32_t(std::lround(t * scale)), 0, 15);
+
+        float best_error = 1e30f;
+        for (int32_t p = std::max(guess - 1, 0); p <= std::min(guess + 1, 15); p++) {
+            float candidate_error = 0.f;
+            for (int32_t c = 0; c < N; c++) {
+                float d = block.texels[i][c] - palette[p][c];
+                candidate_error += d * d;
+            }
+            if (candidate_error < best_error) {
+                best_error = candidate_error;
+                indices[i] = uint8_t(p);
+            }
+        }
+        error += best_error;
+    }
+    return error;
+}
+
+/* BC7 mode 6 */
+
+struct BC7Endpoint {
+    uint32_t value[4];  // 7 bits per channel
+    uint32_t p_bit;
+};
+
+/*
+ * Picks the p-bit, which is shared by all channels of the endpoint, that gives the smaller error.
+ * Opaque blocks always use a p-bit of 1, which is the only way to keep their alpha at 255.
+ */
+BC7Endpoint
+quantizeBC7Endpoint(const float endpoint[4], bool is_opaque) {
+    BC7Endpoint best;
+    float best_error = 1e30f;
+    for (uint32_t p = is_opaque ? 1 : 0; p < 2; p++) {
+        BC7Endpoint candidate;
+        candidate.p_bit = p;
+        float error = 0.f;
+        for (int32_t c = 0; c < 4; c++) {
+            candidate.value[c] = uint32_t(std::clamp(int32_t(std::lround((endpoint[c] - p) / 2.f)), 0, 127));
+            float d = float(2 * candidate.value[c] + p) - endpoint[c];
+            error += d * d;
+        }
+        if (error < best_error) {
+            best_error = error;
+            best = candidate;
+        }
+    }
+    return best;
+}
+
+struct BC7Candidate {
+    BC7Endpoint e0;
+    BC7Endpoint e1;
+    uint8_t indices[16];
+    float error { 1e30f };
+};
+
+BC7Candidate
+evaluateBC7(const Block& block, bool is_opaque, const float e0[4], const float e1[4]) {
+    BC7Candidate candidate;
+    candidate.e0 = quantizeBC7Endpoint(e0, is_opaque);
+    candidate.e1 = quantizeBC7Endpoint(e1, is_opaque);
+
+    float palette[16][4];
+    for (int32_t c = 0; c < 4; c++) {
+        int32_t a = 2 * candidate.e0.value[c] + candidate.e0.p_bit;
+        int32_t b = 2 * candidate.e1.value[c] + candidate.e1.p_bit;
+        for (int32_t p = 0; p < 16; p++) {
+            palette[p][c] = float(((64 - weights4[p]) * a + weights4[p] * b + 32) >> 6);
+        }
+    }
+
+    candidate.error = selectIndices<4>(block, palette, candidate.indices);
+    return candidate;
+}
+
+void
+encodeBC7(const Block& block, uint8_t* out) {
+    bool is_opaque = true;
+    for (uint32_t i = 0; i < 16; i++) {
+        is_opaque = is_opaque && block.texels[i][3] == 255.f;
+    }
+
+    float e0[4], e1[4];
+    fitEndpoints<4>(block.texels, 16, e0, e1);
+    BC7Candidate best = evaluateBC7(block, is_opaque, e0, e1);
+
+    float weights[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        weights[i] = weights4[best.indices[i]] / 64.f;
+    }
+    if (refineEndpoints<4>(block.texels, weights, 16, e0, e1)) {
+        BC7Candidate refined = evaluateBC7(block, is_opaque, e0, e1);
+        if (refined.error < best.error)
+            best = refined;
+    }
+
+    // The most significant index bit of the first texel is implicitly zero
+    if (best.indices[0] >= 8) {
+        std::swap(best.e0, best.e1);
+        for (auto& index : best.indices) {
+            index = 15 - index;
+        }
+    }
+
+    BitWriter writer;
+    writer.write(1u << 6, 7);
+    for (int32_t c = 0; c < 4; c++) {
+        writer.write(best.e0.value[c], 7);
+        writer.write(best.e1.value[c], 7);
+    }
+    writer.write(best.e0.p_bit, 1);
+    writer.write(best.e1.p_bit, 1);
+    writer.write(best.indices[0], 3);
+    for (uint32_t i = 1; i < 16; i++) {
+        writer.write(best.indices[i], 4);
+    }
+    writer.store(out);
+}
+
+/* BC6H mode 11, endpoints and interpolation work on half float bit patterns */
+
+int32_t
+unquantizeBC6H(int32_t value) {
+    if (value == 0) return 0;
+    if (value == 1023) return 0xffff;
+    return ((value << 16) + 0x8000) >> 10;
+}
+
+int32_t
+finishBC6H(int32_t value) {
+    return (value * 31) >> 6;
+}
+
+/* The 10 bit endpoint that decodes closest to `half` */
+int32_t
+quantizeBC6H(float half) {
+    int32_t estimate = std::clamp(int32_t(half / 31.f), 0, 1023);
+    int32_t best = estimate;
+    for (int32_t q = std::max(estimate - 1, 0); q <= std::min(estimate + 1, 1023); q++) {
+        if (std::abs(finishBC6H(unquantizeBC6H(q)) - half) < std::abs(finishBC6H(unquantizeBC6H(best)) - half)) best = q;
+    }
+    return best;
+}
+
+struct BC6HCandidate {
+    int32_t e0[3];
+    int32_t e1[3];
+    uint8_t indices[16];
+    float error { 1e30f };
+};
+
+BC6HCandidate
+evaluateBC6H(const Block& block, const float e0[3], const float e1[3]) {
+    BC6HCandidate candidate;
+    float palette[16][4];
+    for (int32_t c = 0; c < 3; c++) {
+        candidate.e0[c] = quantizeBC6H(std::clamp(e0[c], 0.f, max_half));
+        candidate.e1[c] = quantizeBC6H(std::clamp(e1[c], 0.f, max_half));
+        int32_t a = unquantizeBC6H(candidate.e0[c]);
+        int32_t b = unquantizeBC6H(candidate.e1[c]);
+        for (int32_t p = 0; p < 16; p++) {
+            palette[p][c] = float(finishBC6H((a * (64 - weights4[p]) + b * weights4[p] + 32) >> 6));
+        }
+    }
+
+    candidate.error = selectIndices<3>(block, palette, candidate.indices);
+    return candidate;
+}
+
+void
+encodeBC6H(const Block& block, uint8_t* out) {
+    float e0[3], e1[3];
+    fitEndpoints<3>(block.texels, 16, e0, e1);
+    BC6HCandidate best = evaluateBC6H(block, e0, e1);
+
+    float weights[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        weights[i] = weights4[best.indices[i]] / 64.f;
+    }
+    if (refineEndpoints<3>(block.texels, weights, 16, e0, e1)) {
+        BC6HCandidate refined = evaluateBC6H(block, e0, e1);
+        if (refined.error < best.error)
+            best = refined;
+    }
+
+    // The most significant index bit of the first texel is implicitly zero
+    if (best.indices[0] >= 8) {
+        std::swap(best.e0, best.e1);
+        for (auto& index : best.indices) {
+            index = 15 - index;
+        }
+    }
+
+    BitWriter writer;
+    writer.write(0x03, 5);
+    for (int32_t c = 0; c < 3; c++) {
+        writer.write(best.e0[c], 10);
+    }
+    for (int32_t c = 0; c < 3; c++) {
+        writer.write(best.e1[c], 10);
+    }
+    writer.write(best.indices[0], 3);
+    for (uint32_t i = 1; i < 16; i++) {
+        writer.write(best.indices[i], 4);
+    }
+    writer.store(out);
+}
+
+/* Runs `encode(bx, by, block)` for every block of a level in parallel */
+template<typename F>
+void
+forEachBlock(uint32_t width, uint32_t height, TextureFormat format, uint8_t* blocks, F encode) {
+    uint32_t blocks_x = (width + 3) / 4;
+    uint32_t blocks_y = (height + 3) / 4;
+    size_t block_size = blockSize(format);
+    tbb::parallel_for(tbb::blocked_range<uint32_t>(0, blocks_y), [&](const auto& r) {
+    for (uint32_t by = r.begin(); by != r.end(); by++) {
+        for (uint32_t bx = 0; bx < blocks_x; bx++) {
+            uint8_t* out = blocks + (size_t(by) * blocks_x + bx) * block_size;
+            std::memset(out, 0, block_size);
+            encode(bx, by, out);
+        }
+    }
+    });
+}
+
+}
+
+size_t
+blockSize(TextureFormat format) {
+    switch (format) {
+        case TextureFormat_BC1:
+        case TextureFormat_BC4:
+            return 8;
+        case TextureFormat_BC5:
+        case TextureFormat_BC6H:
+        case TextureFormat_BC7:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+size_t
+compressedSize(TextureFormat format, uint32_t width, uint32_t height) {
+    return size_t((width + 3) / 4) * ((height + 3) / 4) * blockSize(format);
+}
+
+void
+compressBlocks(const uint8_t* texels, uint32_t width, uint32_t height, int32_t channels, TextureFormat format, uint8_t* blocks, int32_t bc4_channel) {
+    forEachBlock(width, height, format, blocks, [&](uint32_t bx, uint32_t by, uint8_t* out) {
+        Block block;
+        float values[16];
+        switch (format) {
+            case TextureFormat_BC1:
+                loadBlock(texels, width, height, channels, bx, by, block);
+                encodeBC1(block, out);
+                break;
+            case TextureFormat_BC4:
+                loadChannel(texels, width, height, channels, bc4_channel, bx, by, values);
+                encodeBC4(values, out);
+                break;
+            case TextureFormat_BC5:
+                loadChannel(texels, width, height, channels, 0, bx, by, values);
+                encodeBC4(values, out);
+                loadChannel(texels, width, height, channels, 1, bx, by, values);
+                encodeBC4(values, out + 8);
+                break;
+            case TextureFormat_BC7:
+                loadBlock(texels, width, height, channels, bx, by, block);
+                encodeBC7(block, out);
+                break;
+            default:
+                break;
+        }
+    });
+}
+
+void
+compressBlocksBC6H(const float* texels, uint32_t width, uint32_t height, int32_t channels, uint8_t* blocks) {
+    forEachBlock(width, height, TextureFormat_BC6H, blocks, [&](uint32_t bx, uint32_t by, uint8_t* out) {
+        Block block;
+        loadBlockHalf(texels, width, height, channels, bx, by, block);
+        encodeBC6H(block, out);
+    });
+}
+
+}
+}
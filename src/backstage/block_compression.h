@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "image.h"
+
+namespace stage {
+namespace backstage {
+
+/*
+ * CPU encoders for the BCn block compressed texture formats.
+ * Every 4x4 texel block is encoded independently and blocks are processed in parallel. Texels of partial blocks at the right and
+ * bottom edges are replicated from the last row and column. The encoders favor speed over the best possible quality:
+ * BC7 only uses mode 6 (one subset, RGBA endpoints with 4 bit indices) and BC6H only mode 11 (one region, 10 bit endpoints),
+ * which all BC7 and BC6H decoders support.
+ */
+
+/* Bytes per 4x4 block of `format`, 0 for TextureFormat_Uncompressed */
+size_t blockSize(TextureFormat format);
+
+/* Size of a `width` x `height` level in `format`, partial blocks count as full blocks */
+size_t compressedSize(TextureFormat format, uint32_t width, uint32_t height);
+
+/*
+ * Encodes 8 bit texels with 1 to 4 channels as BC1, BC4, BC5 or BC7.
+ * BC1 keeps texels with alpha below 128 as transparent, BC4 encodes channel `bc4_channel` and BC5 the first two channels.
+ */
+void compressBlocks(const uint8_t* texels, uint32_t width, uint32_t height, int32_t channels, TextureFormat format, uint8_t* blocks, int32_t bc4_channel = 0);
+
+/* Encodes float texels with 1 to 4 channels as unsigned BC6H, negative values become zero and alpha is dropped */
+void compressBlocksBC6H(const float* texels, uint32_t width, uint32_t height, int32_t channels, uint8_t* blocks);
+
+}
+}
@@ -1,5 +1,8 @@
 #include "buffer.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <new>
 #include <stdexcept>
 
 #include "log.h"
@@ -7,11 +10,32 @@
 namespace stage {
 namespace backstage {
 
+Buffer::Buffer(std::shared_ptr<Allocator> allocator, size_t alignment) {
+    if (allocator)
+        m_allocator = allocator;
+    // Vertex alignments that are not a power of two are rounded up, so that strides that are multiples of them stay aligned
+    m_alignment = alignof(std::max_align_t);
+    while (m_alignment < alignment) m_alignment *= 2;
+}
+
+Buffer::Buffer(uint8_t* external, size_t size, std::shared_ptr<void> owner, size_t alignment) {
+    m_alignment = alignof(std::max_align_t);
+    while (m_alignment < alignment) m_alignment *= 2;
+    m_data = external;
+    m_size_in_bytes = size;
+    m_capacity_in_bytes = size;
+    m_has_ownership = false;
+    m_owner = owner;
+}
 
 Buffer::Buffer(Buffer& other) {
     m_data = other.m_data;
     m_size_in_bytes = other.m_size_in_bytes;
+    m_capacity_in_bytes = other.m_capacity_in_bytes;
+    m_alignment = other.m_alignment;
     m_has_ownership = other.m_has_ownership;
+    m_owner = other.m_owner;
+    m_allocator = other.m_allocator;
 
     other.m_has_ownership = false;
 }
@@ -20,7 +44,11 @@ Buffer&
 Buffer::operator=(Buffer& other) {
     m_data = other.m_data;
     m_size_in_bytes = other.m_size_in_bytes;
+    m_capacity_in_bytes = other.m_capacity_in_bytes;
+    m_alignment = other.m_alignment;
     m_has_ownership = other.m_has_ownership;
+    m_owner = other.m_owner;
+    m_allocator = other.m_allocator;
 
     other.m_has_ownership = false;
     return *this;
@@ -29,7 +57,7 @@ Buffer::operator=(Buffer& other) {
 
 Buffer::~Buffer() {
     if (m_data != nullptr && m_has_ownership) {
-        std::free(m_data);
+        m_allocator->deallocate(m_data, m_capacity_in_bytes, m_alignment);
     }
 }
 
@@ -51,13 +79,45 @@ Buffer::resize(size_t newsize_in_bytes) {
     if (!m_has_ownership)
         throw std::runtime_error("Cannot resize buffer that is not owned");
 
-    if (m_data != nullptr) {
-        m_data = (uint8_t*)std::realloc(m_data, newsize_in_bytes);
-    } else {
-        m_data = (uint8_t*)std::malloc(newsize_in_bytes);
-    }
+    if (newsize_in_bytes > m_capacity_in_bytes)
+        reallocate(std::max(newsize_in_bytes, 2 * m_capacity_in_bytes));
     m_size_in_bytes = newsize_in_bytes;
 }
 
+void
+Buffer::reserve(size_t capacity_in_bytes) {
+    if (capacity_in_bytes <= m_capacity_in_bytes) return;
+    if (!m_has_ownership)
+        throw std::runtime_error("Cannot reserve buffer that is not owned");
+
+    reallocate(capacity_in_bytes);
+}
+
+void
+Buffer::shrink_to_fit() {
+    if (m_size_in_bytes == m_capacity_in_bytes || !m_has_ownership) return;
+
+    if (m_size_in_bytes == 0) {
+        m_allocator->deallocate(m_data, m_capacity_in_bytes, m_alignment);
+        m_data = nullptr;
+        m_capacity_in_bytes = 0;
+        return;
+    }
+    reallocate(m_size_in_bytes);
+}
+
+void
+Buffer::reallocate(size_t capacity_in_bytes) {
+    uint8_t* data;
+    if (m_data != nullptr)
+        data = (uint8_t*)m_allocator->reallocate(m_data, m_capacity_in_bytes, capacity_in_bytes, m_alignment);
+    else
+        data = (uint8_t*)m_allocator->allocate(capacity_in_bytes, m_alignment);
+    if (data == nullptr)
+        throw std::bad_alloc();
+    m_data = data;
+    m_capacity_in_bytes = capacity_in_bytes;
+}
+
 }
 }
\ No newline at end of file
@@ -1,48 +1,72 @@
 #pragma once
 #include <vector>
 #include <memory>
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
+#include "allocator.h"
 
 namespace stage {
 namespace backstage {
 
 struct Buffer {
     Buffer() = default;
+    /*
+     * Allocates the buffer's memory from `allocator`, or from the default allocator if it is null.
+     * The data pointer is aligned to at least `alignment` bytes, rounded up to a power of two.
+     */
+    Buffer(std::shared_ptr<Allocator> allocator, size_t alignment = alignof(std::max_align_t));
     Buffer(uint8_t* blob, size_t size) { data(blob, size); }
     Buffer(std::vector<uint8_t> blob) { data(blob); }
+    /*
+     * Wraps memory owned by `owner` without copying it. The buffer keeps `owner` alive and cannot be resized.
+     * `alignment` is the alignment the caller guarantees for `external`, rounded up to a power of two.
+     */
+    Buffer(uint8_t* external, size_t size, std::shared_ptr<void> owner, size_t alignment = alignof(std::max_align_t));
     Buffer(Buffer& other);
     Buffer& operator=(Buffer& other);
     ~Buffer();
 
     uint8_t* data() { return m_data; };
+    /* Gives up ownership of the data, which has to be released through allocator() by the caller */
     uint8_t* release() { 
         m_has_ownership = false;
         return m_data;
     };
+    std::shared_ptr<Allocator> allocator() { return m_allocator; }
 
     void data(uint8_t* blob, size_t size);
     void data(std::vector<uint8_t> blob);
 
+    /* Changes the size of the buffer. Growing beyond the capacity at least doubles it, so repeated appends are amortized linear. */
     void resize(size_t newsize_in_bytes);
+    /* Ensures that the buffer can grow to `capacity_in_bytes` without reallocating */
+    void reserve(size_t capacity_in_bytes);
+    /* Releases unused capacity */
+    void shrink_to_fit();
 
     size_t size() { return m_size_in_bytes; }
+    size_t capacity() { return m_capacity_in_bytes; }
+    size_t alignment() { return m_alignment; }
 
 private:
+    void reallocate(size_t capacity_in_bytes);
+
     uint8_t* m_data { nullptr };
     size_t m_size_in_bytes { 0 };
     size_t m_capacity_in_bytes { 0 };
+    size_t m_alignment { alignof(std::max_align_t) };
 
     bool m_has_ownership { true };
+    std::shared_ptr<void> m_owner;
+    std::shared_ptr<Allocator> m_allocator { Allocator::getDefault() };
 };
 
 template<typename T>
 struct BufferView {
 
     BufferView() = default;
-    BufferView(std::shared_ptr<Buffer> source, size_t offset, size_t num_elements, size_t stride = sizeof(T), size_t alignment = alignof(T)) : m_offset(offset), m_size(num_elements), m_stride(stride), m_alignment(alignment) {
-        m_buffer = source;
-    }
+    BufferView(std::shared_ptr<Buffer> source, size_t offset, size_t num_elements, size_t stride = sizeof(T), size_t alignment = alignof(T)) : m_buffer(source), m_offset(offset), m_stride(stride), m_alignment(alignment), m_size(num_elements) {}
 
     void setBuffer(std::shared_ptr<Buffer> source) {
         m_offset = source->size();
@@ -65,6 +89,8 @@ struct BufferView {
         return (m_buffer->data() + m_offset); 
     }
 
+    bool isValid() const { return m_buffer != nullptr; }
+
     void push_back(const T& element) {
         if (!m_buffer)
             return;
@@ -92,10 +118,24 @@ struct BufferView {
         m_size += elements.size();
     }
 
-    size_t sizeInBytes() const { return m_size * (sizeof(T) + (sizeof(T) % m_alignment)); }
+    /* Overwrites `count` existing elements starting at `first` */
+    void write(size_t first, const T* elements, size_t count) {
+        if (!m_buffer || count == 0)
+            return;
+        if (m_stride == sizeof(T)) {
+            std::memcpy(data() + first * m_stride, elements, sizeof(T) * count);
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                std::memcpy(data() + (first + i) * m_stride, elements + i, sizeof(T));
+            }
+        }
+    }
+
+    size_t sizeInBytes() const { return m_size * ((sizeof(T) + m_alignment - 1) / m_alignment * m_alignment); }
     size_t size() const { return m_size; }
     size_t offset() const { return m_offset; }
     size_t stride() const { return m_stride; }
+    size_t alignment() const { return m_alignment; }
 
     T& operator[](uint32_t id) const { 
         return *(T*)(data() + (id * m_stride));
@@ -103,9 +143,9 @@ struct BufferView {
 
 private:
     std::shared_ptr<Buffer> m_buffer;
-    size_t m_offset;
-    size_t m_stride;
-    size_t m_alignment;
+    size_t m_offset { 0 };
+    size_t m_stride { sizeof(T) };
+    size_t m_alignment { alignof(T) };
     size_t m_size { 0 };
 
     size_t positionInBuffer() {
@@ -0,0 +1,378 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include <tbb/tbb.h>
+
+namespace stage {
+namespace backstage {
+
+namespace {
+
+constexpr uint32_t max_bins = 64;
+
+/* Ranges larger than this are binned and built in parallel */
+constexpr size_t parallel_threshold = 4096;
+
+stage_vec3f
+center(const AABB& b) {
+    return (b.lower + b.upper) * stage_vec3f(0.5f);
+}
+
+float
+area(const AABB& b) {
+    if (b.isEmpty()) return 0.f;
+    stage_vec3f d = b.upper - b.lower;
+    return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+struct BuildPrimitive {
+    AABB bounds;
+    stage_vec3f centroid;
+    BVHPrimitive primitive;
+};
+
+/* Bounds of the primitives and of their centroids */
+struct RangeBounds {
+    AABB bounds;
+    AABB centroids;
+
+    void extend(const BuildPrimitive& p) { bounds.extend(p.bounds); centroids.extend(p.centroid); }
+    void extend(const RangeBounds& b) { bounds.extend(b.bounds); centroids.extend(b.centroids); }
+};
+
+/* Trivially constructible so that only the bins in use are initialized, the table is reset for every node */
+struct Bin {
+    AABB bounds() const { AABB b; b.lower = lower; b.upper = upper; return b; }
+
+    stage_vec3f lower;
+    stage_vec3f upper;
+    uint32_t count;
+};
+
+/* Maps centroids to one of `num_bins` bins along each axis of the centroid bounds */
+struct BinMapping {
+    BinMapping(const AABB& centroids, uint32_t num_bins) : lower(centroids.lower), num_bins(num_bins) {
+        stage_vec3f extent = centroids.upper - centroids.lower;
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            scale[axis] = extent[axis] > 0.f ? num_bins / extent[axis] : 0.f;
+        }
+    }
+
+    uint32_t operator()(const stage_vec3f& centroid, uint32_t axis) const {
+        int32_t bin = int32_t((centroid[axis] - lower[axis]) * scale[axis]);
+        return uint32_t(std::min(std::max(bin, 0), int32_t(num_bins) - 1));
+    }
+
+    stage_vec3f lower;
+    float scale[3];
+    uint32_t num_bins;
+};
+
+struct Binning {
+    Binning(uint32_t num_bins) : num_bins(num_bins) {
+        AABB empty;
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            for (uint32_t i = 0; i < num_bins; i++) {
+                bins[axis][i] = { empty.lower, empty.upper, 0 };
+            }
+        }
+    }
+
+    void add(const BinMapping& mapping, const BuildPrimitive& p) {
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            Bin& bin = bins[axis][mapping(p.centroid, axis)];
+            bin.lower = min(bin.lower, p.bounds.lower);
+            bin.upper = max(bin.upper, p.bounds.upper);
+            bin.count++;
+        }
+    }
+
+    void merge(const Binning& other) {
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            for (uint32_t i = 0; i < num_bins; i++) {
+                bins[axis][i].lower = min(bins[axis][i].lower, other.bins[axis][i].lower);
+                bins[axis][i].upper = max(bins[axis][i].upper, other.bins[axis][i].upper);
+                bins[axis][i].count += other.bins[axis][i].count;
+            }
+        }
+    }
+
+    Bin bins[3][max_bins];
+    uint32_t num_bins;
+};
+
+struct Builder {
+    Builder(std::vector<BuildPrimitive>& primitives, const BVHBuildOptions& options) : m_primitives(primitives), m_options(options) {
+        m_options.num_bins = std::min(std::max(m_options.num_bins, 2u), max_bins);
+        m_options.max_leaf_size = std::max(m_options.max_leaf_size, 1u);
+        m_nodes.resize(2 * primitives.size() - 1);
+    }
+
+    BVH build() {
+        build(0, 0, m_primitives.size());
+
+        BVH bvh;
+        m_nodes.resize(m_num_nodes.load());
+        bvh.nodes = depthFirstOrder();
+        bvh.primitives.resize(m_primitives.size());
+        for (size_t i = 0; i < m_primitives.size(); i++) {
+            bvh.primitives[i] = m_primitives[i].primitive;
+        }
+        return bvh;
+    }
+
+private:
+    /*
+     * Parallel subtrees claim their children in whatever order they run, the nodes are renumbered so that the layout is deterministic.
+     * Children are placed from index 2, after a padding node, so that sibling pairs are cache line aligned.
+     */
+    std::vector<BVHNode, CacheLineAllocator<BVHNode>> depthFirstOrder() const {
+        std::vector<BVHNode, CacheLineAllocator<BVHNode>> nodes(m_nodes[0].isLeaf() ? 1 : m_nodes.size() + 1);
+        nodes[0] = m_nodes[0];
+        if (nodes.size() == 1)
+            return nodes;
+
+        AABB empty;
+        nodes[1] = { empty.lower, 0, empty.upper, 0 };
+        uint32_t num_nodes = 2;
+        std::vector<uint32_t> stack = { 0 };
+        while (!stack.empty()) {
+            BVHNode& node = nodes[stack.back()];
+            stack.pop_back();
+            if (node.isLeaf()) continue;
+
+            nodes[num_nodes] = m_nodes[node.offset];
+            nodes[num_nodes + 1] = m_nodes[node.offset + 1];
+            node.offset = num_nodes;
+            stack.push_back(num_nodes + 1);
+            stack.push_back(num_nodes);
+            num_nodes += 2;
+        }
+        return nodes;
+    }
+
+    RangeBounds computeBounds(size_t begin, size_t end) {
+        auto fn = [&](const tbb::blocked_range<size_t>& r, RangeBounds local) {
+            for (size_t i = r.begin(); i != r.end(); i++) {
+                local.extend(m_primitives[i]);
+            }
+            return local;
+        };
+        if (end - begin < parallel_threshold)
+            return fn(tbb::blocked_range<size_t>(begin, end), RangeBounds());
+        return tbb::parallel_reduce(tbb::blocked_range<size_t>(begin, end, parallel_threshold), RangeBounds(), fn,
+            [](RangeBounds a, const RangeBounds& b) { a.extend(b); return a; });
+    }
+
+    Binning computeBins(const BinMapping& mapping, size_t begin, size_t end) {
+        if (end - begin < parallel_threshold) {
+            Binning binning(m_options.num_bins);
+            for (size_t i = begin; i < end; i++) {
+                binning.add(mapping, m_primitives[i]);
+            }
+            return binning;
+        }
+        tbb::combinable<Binning> local([&] { return Binning(m_options.num_bins); });
+        tbb::parallel_for(tbb::blocked_range<size_t>(begin, end, parallel_threshold), [&](const auto& r) {
+            Binning& binning = local.local();
+            for (size_t i = r.begin(); i != r.end(); i++) {
+                binning.add(mapping, m_primitives[i]);
+            }
+        });
+        Binning binning(m_options.num_bins);
+        local.combine_each([&](const Binning& b) { binning.merge(b); });
+        return binning;
+    }
+
+    void makeLeaf(BVHNode& node, size_t begin, size_t end) {
+        node.offset = uint32_t(begin);
+        node.count = uint32_t(end - begin);
+    }
+
+    void build(uint32_t node_index, size_t begin, size_t end) {
+        BVHNode& node = m_nodes[node_index];
+        size_t count = end - begin;
+        RangeBounds range = computeBounds(begin, end);
+        node.lower = range.bounds.lower;
+        node.upper = range.bounds.upper;
+
+        if (count == 1) {
+            makeLeaf(node, begin, end);
+            return;
+        }
+
+        // Find the cheapest split plane between two bins on any axis
+        BinMapping mapping(range.centroids, m_options.num_bins);
+        Binning binning = computeBins(mapping, begin, end);
+        uint32_t num_bins = m_options.num_bins;
+        float best_cost = 1e30f;
+        uint32_t best_axis = 0, best_split = 0;
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            if (mapping.scale[axis] == 0.f) continue;
+            const Bin* bins = binning.bins[axis];
+
+            float right_cost[max_bins];
+            AABB right;
+            uint32_t right_count = 0;
+            for (uint32_t i = num_bins - 1; i > 0; i--) {
+                right.extend(bins[i].bounds());
+                right_count += bins[i].count;
+                right_cost[i] = area(right) * right_count;
+            }
+            AABB left;
+            uint32_t left_count = 0;
+            for (uint32_t i = 1; i < num_bins; i++) {
+                left.extend(bins[i - 1].bounds());
+                left_count += bins[i - 1].count;
+                float cost = area(left) * left_count + right_cost[i];
+                if (left_count > 0 && left_count < count && cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_split = i;
+                }
+            }
+        }
+
+        float node_area = area(range.bounds);
+        float split_cost = m_options.traversal_cost + (node_area > 0.f ? best_cost / node_area : 0.f);
+        bool has_split = best_split > 0;
+        if (count <= m_options.max_leaf_size && (!has_split || split_cost >= float(count))) {
+            makeLeaf(node, begin, end);
+            return;
+        }
+
+        size_t middle;
+        if (has_split) {
+            auto it = std::partition(m_primitives.begin() + begin, m_primitives.begin() + end, [&](const BuildPrimitive& p) {
+                return mapping(p.centroid, best_axis) < best_split;
+            });
+            middle = it - m_primitives.begin();
+        } else {
+            // All centroids coincide, any split is as good as another
+            middle = begin + count / 2;
+        }
+
+        uint32_t children = m_num_nodes.fetch_add(2);
+        node.offset = children;
+        node.count = 0;
+        if (count >= parallel_threshold) {
+            tbb::parallel_invoke([&] { build(children, begin, middle); }, [&] { build(children + 1, middle, end); });
+        } else {
+            build(children, begin, middle);
+            build(children + 1, middle, end);
+        }
+    }
+
+    std::vector<BuildPrimitive>& m_primitives;
+    std::vector<BVHNode> m_nodes;
+    std::atomic<uint32_t> m_num_nodes { 1 };
+    BVHBuildOptions m_options;
+};
+
+BVH
+buildBVH(std::vector<BuildPrimitive>& primitives, const BVHBuildOptions& options) {
+    if (primitives.empty())
+        return BVH();
+    return Builder(primitives, options).build();
+}
+
+}
+
+float
+BVH::sahCost(float traversal_cost) const {
+    if (nodes.empty())
+        return 0.f;
+    auto node_area = [](const BVHNode& node) {
+        AABB bounds;
+        bounds.lower = node.lower;
+        bounds.upper = node.upper;
+        return area(bounds);
+    };
+
+    float root_area = node_area(nodes[0]);
+    float cost = 0.f;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        // The padding node after the root is never visited
+        if (i == 1 && !nodes[0].isLeaf()) continue;
+        const BVHNode& node = nodes[i];
+        float probability = root_area > 0.f ? node_area(node) / root_area : 1.f;
+        cost += probability * (node.isLeaf() ? float(node.count) : traversal_cost);
+    }
+    return cost;
+}
+
+BVH
+buildObjectBVH(const Object& object, const BVHBuildOptions& options) {
+    std::vector<size_t> offsets(object.geometries.size() + 1, 0);
+    for (size_t i = 0; i < object.geometries.size(); i++) {
+        offsets[i + 1] = offsets[i] + object.geometries[i].numIndices() / 3;
+    }
+
+    std::vector<BuildPrimitive> primitives(offsets.back());
+    for (size_t geometry_id = 0; geometry_id < object.geometries.size(); geometry_id++) {
+        const Geometry& geometry = object.geometries[geometry_id];
+        size_t num_vertices = geometry.numVertices();
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, offsets[geometry_id + 1] - offsets[geometry_id]), [&](const auto& r) {
+            for (size_t triangle = r.begin(); triangle != r.end(); triangle++) {
+                BuildPrimitive& p = primitives[offsets[geometry_id] + triangle];
+                p.primitive = { uint32_t(geometry_id), uint32_t(triangle) };
+                uint32_t corners[3] = { geometry.getIndex(3 * triangle), geometry.getIndex(3 * triangle + 1), geometry.getIndex(3 * triangle + 2) };
+                if (corners[0] >= num_vertices || corners[1] >= num_vertices || corners[2] >= num_vertices)
+                    continue;
+                for (uint32_t corner : corners) {
+                    p.bounds.extend(geometry.getPosition(corner));
+                }
+                p.centroid = center(p.bounds);
+            }
+        });
+    }
+
+    // Triangles with out of range indices keep empty bounds and are left out of the BVH
+    primitives.erase(std::remove_if(primitives.begin(), primitives.end(), [](const BuildPrimitive& p) { return p.bounds.isEmpty(); }), primitives.end());
+
+    return buildBVH(primitives, options);
+}
+
+BVH
+buildInstanceBVH(const std::vector<ObjectInstance>& instances, const std::vector<BVH>& objects, const BVHBuildOptions& options) {
+    std::vector<BuildPrimitive> primitives;
+    primitives.reserve(instances.size());
+    for (size_t instance_id = 0; instance_id < instances.size(); instance_id++) {
+        const ObjectInstance& instance = instances[instance_id];
+        if (instance.object_id >= objects.size() || !objects[instance.object_id].isValid())
+            continue;
+
+        // Instances of a finalized scene already know their world space bounds
+        BuildPrimitive p;
+        p.bounds = instance.bounds;
+        if (p.bounds.isEmpty()) {
+            const BVHNode& root = objects[instance.object_id].nodes[0];
+            AABB object_bounds;
+            object_bounds.lower = root.lower;
+            object_bounds.upper = root.upper;
+            p.bounds = object_bounds.transform(instance.instance_to_world);
+        }
+        p.centroid = center(p.bounds);
+        p.primitive = { 0, uint32_t(instance_id) };
+        primitives.push_back(p);
+    }
+    return buildBVH(primitives, options);
+}
+
+SceneBVH
+buildSceneBVH(const std::vector<Object>& objects, const std::vector<ObjectInstance>& instances, const BVHBuildOptions& options) {
+    SceneBVH bvh;
+    bvh.objects.resize(objects.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, objects.size(), 1), [&](const auto& r) {
+        for (size_t i = r.begin(); i != r.end(); i++) {
+            bvh.objects[i] = buildObjectBVH(objects[i], options);
+        }
+    });
+    bvh.instances = buildInstanceBVH(instances, bvh.objects, options);
+    return bvh;
+}
+
+}
+}
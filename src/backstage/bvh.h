@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include "math.h"
+#include "mesh.h"
+
+namespace stage {
+namespace backstage {
+
+/*
+ * A node of a BVH, 32 bytes so that two siblings share a cache line.
+ * Inner nodes have `count == 0` and their children are stored next to each other at `offset` and `offset + 1`.
+ * Leaves reference `count` consecutive primitives starting at `offset`.
+ */
+struct BVHNode {
+    stage_vec3f lower;
+    uint32_t offset;
+    stage_vec3f upper;
+    uint32_t count;
+
+    bool isLeaf() const { return count > 0; }
+};
+
+/* A triangle of a bottom-level BVH or an instance of a top-level BVH, where `geometry_id` is always 0 */
+struct BVHPrimitive {
+    uint32_t geometry_id;
+    uint32_t primitive_id;
+};
+
+struct BVHBuildOptions {
+    uint32_t num_bins           { 16 };
+    uint32_t max_leaf_size      { 8 };      // Larger leaves are always split, smaller ones only when the SAH favors it
+    float    traversal_cost     { 1.f };    // Cost of visiting a node relative to intersecting a primitive
+};
+
+/* Allocates arrays on 64 byte cache line boundaries */
+template<typename T>
+struct CacheLineAllocator {
+    using value_type = T;
+    static constexpr size_t alignment = 64;
+
+    CacheLineAllocator() = default;
+    template<typename U> CacheLineAllocator(const CacheLineAllocator<U>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignment))); }
+    void deallocate(T* ptr, size_t) { ::operator delete(ptr, std::align_val_t(alignment)); }
+
+    template<typename U> bool operator==(const CacheLineAllocator<U>&) const { return true; }
+    template<typename U> bool operator!=(const CacheLineAllocator<U>&) const { return false; }
+};
+
+/*
+ * Nodes in depth first order of their sibling pairs, the root is `nodes[0]`.
+ * Unless the root is a leaf, `nodes[1]` is an unreachable padding node with empty bounds, so that every sibling pair
+ * starts at an even index and, with the array aligned to 64 bytes, occupies a single cache line.
+ */
+struct BVH {
+    std::vector<BVHNode, CacheLineAllocator<BVHNode>> nodes;
+    std::vector<BVHPrimitive> primitives;
+
+    bool isValid() const { return !nodes.empty(); }
+
+    /* Expected cost of a ray traversal according to the surface area heuristic */
+    float sahCost(float traversal_cost = 1.f) const;
+};
+
+/* One bottom-level BVH per object and a top-level BVH over the world space bounds of the instances */
+struct SceneBVH {
+    std::vector<BVH> objects;
+    BVH instances;
+};
+
+/* Builds a binned SAH BVH over the triangles of all geometries of `object` */
+BVH buildObjectBVH(const Object& object, const BVHBuildOptions& options = BVHBuildOptions());
+
+/*
+ * Builds a BVH over the world space bounds of `instances`. Instances without bounds, e.g. ones that are not part of a finalized scene,
+ * use the root bounds of the bottom-level BVH of their object transformed to world space. Instances of objects without a BVH are left out.
+ */
+BVH buildInstanceBVH(const std::vector<ObjectInstance>& instances, const std::vector<BVH>& objects, const BVHBuildOptions& options = BVHBuildOptions());
+
+/* Builds the bottom-level BVHs of all objects in parallel, followed by the top-level BVH */
+SceneBVH buildSceneBVH(const std::vector<Object>& objects, const std::vector<ObjectInstance>& instances, const BVHBuildOptions& options = BVHBuildOptions());
+
+}
+}
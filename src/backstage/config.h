@@ -1,16 +1,47 @@
 #pragma once
 #include <functional>
+#include <memory>
+#include <string>
+#include "allocator.h"
 #include "image.h"
 #include "light.h"
 #include "material.h"
 #include "mesh.h"
+#include "sink.h"
 
 namespace stage {
 namespace backstage {
 
+enum ObjParser {
+    ObjParser_TinyObj   = 0,    // Single-threaded reference parser
+    ObjParser_Parallel  = 1,    // Memory-mapped, multithreaded parser
+};
+
+/* Block compression applied to the textures of a scene, see Image::compress() */
+enum TextureCompression {
+    TextureCompression_None = 0,
+    TextureCompression_BC1  = 1,    // Color textures as BC1, half the size of BC7 with 1 bit alpha
+    TextureCompression_BC7  = 2,    // Color textures as BC7
+};
+
 struct Config {
     VertexLayout    layout              { VertexLayout_Interleaved_VNT };
     size_t          vertex_alignment    { 16 };
+    ObjParser       obj_parser          { ObjParser_TinyObj };
+    bool            lazy_textures       { false };  // Defer texture decoding until the pixels are first accessed
+    MipFilter       mip_filter          { MipFilter_None };  // Generate a mip chain for every texture, see Image::generateMips()
+    TextureCompression texture_compression { TextureCompression_None };  // Opacity textures use BC4 and HDR textures BC6H unless this is None
+    bool            optimize_vertex_cache { false };  // Reorder triangles and vertices of every geometry for vertex cache and fetch locality
+    IndexFormat     index_format        { IndexFormat_UInt32 };
+    bool            build_meshlets      { false };  // Partition every geometry into meshlets, see Meshlet
+    size_t          meshlet_max_vertices  { 64 };
+    size_t          meshlet_max_triangles { 124 };
+    bool            use_asset_cache     { false };  // Share loaded scenes and decoded images with other scenes through the AssetCache.
+                                                    // Scenes are keyed on the modification time of the scene file only, edits to its
+                                                    // .mtl files, PBRT includes or textures are not picked up until the cache is cleared.
+    std::string     snapshot_path       { "" };     // If set, a binary snapshot of every successfully loaded scene is written here
+    std::shared_ptr<SceneSink> sink     { nullptr };  // If set, the scene is streamed to the sink and its objects and textures are not kept
+    std::shared_ptr<Allocator> allocator { nullptr }; // If set, vertex buffers and textures are allocated from it instead of std::malloc
 };
 
 }
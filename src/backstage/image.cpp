@@ -1,8 +1,16 @@
 #include "image.h"
 
 #include <cstdlib>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
 #include <cstring>
 #include <filesystem>
+#include <limits>
+#include <mutex>
+#include <tuple>
+#include <vector>
 
 #include <tbb/tbb.h>
 
@@ -12,130 +20,545 @@
 #define TINY_EXRIMPLEMENTATION
 #include "tinyexr.h"
 
+#include "block_compression.h"
 #include "log.h"
 
 namespace stage {
 namespace backstage {
 
-Image::Image(std::string filename, bool is_hdr) : m_is_hdr(is_hdr) {
-    uint8_t* image = nullptr;
-    size_t image_size = 0;
+namespace {
 
-    std::filesystem::path filepath(filename);
-    if (filepath.extension().string() == ".exr") {
+struct DecodedImage {
+    uint8_t* data { nullptr };
+    int32_t width { 0 };
+    int32_t height { 0 };
+    int32_t channels { 0 };
+    bool is_hdr { false };
+};
+
+void
+flipRows(float* image, int32_t width, int32_t height, int32_t channels) {
+    tbb::parallel_for(tbb::blocked_range<uint32_t>(0, height/2), [&](const auto& r) {
+    for (uint32_t row = r.begin(); row != r.end(); row++) {
+        tbb::parallel_for(tbb::blocked_range<uint32_t>(0, width * channels), [&](const auto& rr) {
+        for (uint32_t el = rr.begin(); el != rr.end(); el++) {
+            uint32_t id_a = row * width * channels + el;
+            uint32_t id_b = (height - row - 1) * width * channels + el;
+            std::swap(image[id_a], image[id_b]);
+        }
+        });
+    }
+    });
+}
+
+bool
+isEXR(const std::string& filename) {
+    return std::filesystem::path(filename).extension().string() == ".exr";
+}
+
+/* stbi and tinyexr both allocate with malloc, the result is handed to Image::adopt() */
+DecodedImage
+decodeFile(const std::string& filename, bool is_hdr) {
+    DecodedImage result;
+    result.is_hdr = is_hdr;
+
+    if (isEXR(filename)) {
         const char* err = nullptr;
         float* image_float = nullptr;
-        int ret = LoadEXR(&image_float, &m_width, &m_height, filepath.string().c_str(), &err);
-        m_channels = 4;
+        int ret = LoadEXR(&image_float, &result.width, &result.height, filename.c_str(), &err);
 
         if (ret != TINYEXR_SUCCESS) {
-            ERR("Unable to load image '" + filepath.string() + "'");
+            ERR("Unable to load image '" + filename + "'");
             if (err) {
                 ERR(err);
                 FreeEXRErrorMessage(err);
             }
-            return;
-        }
-
-        // Flip y axis
-        tbb::parallel_for(tbb::blocked_range<uint32_t>(0, m_height/2), [&](const auto& r) {
-        for (uint32_t row = r.begin(); row != r.end(); row++) {
-            tbb::parallel_for(tbb::blocked_range<uint32_t>(0, m_width * m_channels), [&](const auto& rr) {
-            for (uint32_t el = rr.begin(); el != rr.end(); el++) {
-                uint32_t id_a = row * m_width * m_channels + el;
-                uint32_t id_b = (m_height - row - 1) * m_width * m_channels + el;
-                std::swap(image_float[id_a], image_float[id_b]);
-            }
-            });
+            return DecodedImage();
         }
-        });
 
-        m_is_hdr = true;
-        image = (uint8_t*)image_float;
+        result.channels = 4;
+        flipRows(image_float, result.width, result.height, result.channels);
 
-        image_size = sizeof(float) * m_width * m_height * m_channels;
+        result.is_hdr = true;
+        result.data = (uint8_t*)image_float;
     } else {
-        stbi_set_flip_vertically_on_load(true);  
+        stbi_set_flip_vertically_on_load_thread(true);
         if (is_hdr)
-            image = (uint8_t*)stbi_loadf(filepath.string().c_str(), &m_width, &m_height, &m_channels, 4);
+            result.data = (uint8_t*)stbi_loadf(filename.c_str(), &result.width, &result.height, &result.channels, 4);
         else
-            image = stbi_load(filepath.string().c_str(), &m_width, &m_height, &m_channels, 4);
-        m_channels = 4;
+            result.data = stbi_load(filename.c_str(), &result.width, &result.height, &result.channels, 4);
+        result.channels = 4;
 
-        if (image == nullptr) {
-            ERR("Unable to load image '" + filepath.string() + "'");
-            return;
+        if (result.data == nullptr) {
+            ERR("Unable to load image '" + filename + "'");
+            return DecodedImage();
         }
-
-        image_size = (is_hdr ? sizeof(float) : sizeof(uint8_t)) * m_width * m_height * m_channels;
-    }
-    
-    if (image) {
-        m_image = (uint8_t*)std::malloc(image_size);
-        std::memcpy(m_image, image, image_size);
-        std::free(image);
     }
+    return result;
 }
 
-Image::Image(uint8_t* blob, size_t size, bool is_hdr) {
-    m_is_hdr = is_hdr;
-    uint8_t* image = nullptr;
-    size_t image_size = 0;
+DecodedImage
+decodeBlob(const uint8_t* blob, size_t size, bool is_hdr) {
+    DecodedImage result;
+    result.is_hdr = is_hdr;
 
     // Try stbi first, assuming the image is not EXR
-    stbi_set_flip_vertically_on_load(true);  
+    stbi_set_flip_vertically_on_load_thread(true);
     if (is_hdr)
-        image = (uint8_t*)stbi_loadf_from_memory(blob, size, &m_width, &m_height, &m_channels, 4);
+        result.data = (uint8_t*)stbi_loadf_from_memory(blob, size, &result.width, &result.height, &result.channels, 4);
     else
-        image = stbi_load_from_memory(blob, size, &m_width, &m_height, &m_channels, 4);
-    m_channels = 4;
-    image_size = (is_hdr ? sizeof(float) : sizeof(uint8_t)) * m_width * m_height * m_channels;
+        result.data = stbi_load_from_memory(blob, size, &result.width, &result.height, &result.channels, 4);
+    result.channels = 4;
 
     // If the blob failed to load with stbi, try tinyexr
-    if (image == nullptr) {
+    if (result.data == nullptr) {
         const char* err = nullptr;
-        float* image_float;
-        int ret = LoadEXRFromMemory(&image_float, &m_width, &m_height, blob, size, &err);
+        float* image_float = nullptr;
+        int ret = LoadEXRFromMemory(&image_float, &result.width, &result.height, blob, size, &err);
         if (ret != TINYEXR_SUCCESS) {
             ERR("Unable to load image blob");
             if (err) {
                 ERR(err);
                 FreeEXRErrorMessage(err);
             }
-            return;
+            return DecodedImage();
+        }
+
+        flipRows(image_float, result.width, result.height, result.channels);
+
+        result.is_hdr = true;
+        result.data = (uint8_t*)image_float;
+    }
+    return result;
+}
+
+bool
+probeEXRHeader(EXRHeader& header, DecodedImage& result) {
+    result.width = header.data_window.max_x - header.data_window.min_x + 1;
+    result.height = header.data_window.max_y - header.data_window.min_y + 1;
+    result.channels = 4;
+    result.is_hdr = true;
+    FreeEXRHeader(&header);
+    return true;
+}
+
+/* Reads only the dimensions of an image, the result holds no data */
+bool
+probeFile(const std::string& filename, bool is_hdr, DecodedImage& result) {
+    result.is_hdr = is_hdr;
+    if (isEXR(filename)) {
+        EXRVersion version;
+        EXRHeader header;
+        InitEXRHeader(&header);
+        const char* err = nullptr;
+        if (ParseEXRVersionFromFile(&version, filename.c_str()) != TINYEXR_SUCCESS ||
+            ParseEXRHeaderFromFile(&header, &version, filename.c_str(), &err) != TINYEXR_SUCCESS) {
+            if (err) FreeEXRErrorMessage(err);
+            return false;
+        }
+        return probeEXRHeader(header, result);
+    }
+
+    int channels;
+    if (!stbi_info(filename.c_str(), &result.width, &result.height, &channels))
+        return false;
+    result.channels = 4;
+    return true;
+}
+
+bool
+probeBlob(const uint8_t* blob, size_t size, bool is_hdr, DecodedImage& result) {
+    result.is_hdr = is_hdr;
+    int channels;
+    if (stbi_info_from_memory(blob, size, &result.width, &result.height, &channels)) {
+        result.channels = 4;
+        return true;
+    }
+
+    EXRVersion version;
+    EXRHeader header;
+    InitEXRHeader(&header);
+    const char* err = nullptr;
+    if (ParseEXRVersionFromMemory(&version, blob, size) != TINYEXR_SUCCESS ||
+        ParseEXRHeaderFromMemory(&header, &version, blob, size, &err) != TINYEXR_SUCCESS) {
+        if (err) FreeEXRErrorMessage(err);
+        return false;
+    }
+    return probeEXRHeader(header, result);
+}
+
+/*
+ * Per channel coefficients for scale() and mix(), repeated over a block of elements.
+ * The block size is a multiple of every channel count so that a block always starts at channel 0,
+ * which lets the inner loops run without a per-element modulo and be auto-vectorized.
+ */
+constexpr size_t pattern_size = 48;
+
+struct ChannelPattern {
+    float a[pattern_size];
+    float b[pattern_size];
+};
+
+/* Only images with 2 or 4 channels have alpha, which is always the last channel */
+template<typename F>
+ChannelPattern
+makeChannelPattern(int32_t channels, F coefficients) {
+    ChannelPattern pattern;
+    bool has_alpha = channels == 2 || channels == 4;
+    for (size_t i = 0; i < pattern_size; i++) {
+        int32_t channel = int32_t(i % channels);
+        bool is_alpha = has_alpha && channel == channels - 1;
+        std::tie(pattern.a[i], pattern.b[i]) = coefficients(std::min(channel, 2), is_alpha);
+    }
+    return pattern;
+}
+
+inline float toFloat(float value) { return value; }
+inline float toFloat(uint8_t value) { return value * (1.f / 255.f); }
+
+template<typename T> T fromFloat(float value);
+template<> inline float fromFloat<float>(float value) { return value; }
+template<> inline uint8_t fromFloat<uint8_t>(float value) { return uint8_t(std::clamp(value * 255.f + 0.5f, 0.f, 255.f)); }
+
+/* Applies op(value, other_value, a, b) to all `count` elements of `image`. LDR values are normalized to [0, 1], `other` may be null. */
+template<typename T, typename U, typename Op>
+void
+transformPixels(T* image, const U* other, size_t count, const ChannelPattern& pattern, Op op) {
+    size_t num_blocks = count / pattern_size;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, num_blocks), [&](const auto& r) {
+    for (size_t block = r.begin(); block != r.end(); block++) {
+        T* dst = image + block * pattern_size;
+        const U* src = other ? other + block * pattern_size : nullptr;
+        float values[pattern_size];
+        float other_values[pattern_size];
+        for (size_t i = 0; i < pattern_size; i++) {
+            values[i] = toFloat(dst[i]);
+        }
+        if (src) {
+            for (size_t i = 0; i < pattern_size; i++) {
+                other_values[i] = toFloat(src[i]);
+            }
+        } else {
+            std::fill(other_values, other_values + pattern_size, 0.f);
+        }
+        for (size_t i = 0; i < pattern_size; i++) {
+            values[i] = op(values[i], other_values[i], pattern.a[i], pattern.b[i]);
+        }
+        for (size_t i = 0; i < pattern_size; i++) {
+            dst[i] = fromFloat<T>(values[i]);
+        }
+    }
+    });
+
+    for (size_t i = num_blocks * pattern_size; i < count; i++) {
+        size_t p = i - num_blocks * pattern_size;
+        float other_value = other ? toFloat(other[i]) : 0.f;
+        image[i] = fromFloat<T>(op(toFloat(image[i]), other_value, pattern.a[p], pattern.b[p]));
+    }
+}
+
+/* Picks the element types of both images, mixing HDR and LDR images is allowed */
+template<typename Op>
+void
+transformPixels(uint8_t* image, bool image_hdr, const uint8_t* other, bool other_hdr, size_t count, const ChannelPattern& pattern, Op op) {
+    if (image_hdr && other_hdr)
+        transformPixels(reinterpret_cast<float*>(image), reinterpret_cast<const float*>(other), count, pattern, op);
+    else if (image_hdr)
+        transformPixels(reinterpret_cast<float*>(image), other, count, pattern, op);
+    else if (other_hdr)
+        transformPixels(image, reinterpret_cast<const float*>(other), count, pattern, op);
+    else
+        transformPixels(image, other, count, pattern, op);
+}
+
+struct MipLevel {
+    int32_t width;
+    int32_t height;
+    size_t offset;      // In elements from the start of the chain
+};
+
+float
+srgbToLinear(float value) {
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+/* Linear values of 8 bit sRGB color and 8 bit alpha, indexed by the stored value */
+const std::array<float, 256>&
+srgbDecodeTable() {
+    static const std::array<float, 256> table = []() {
+        std::array<float, 256> table;
+        for (size_t i = 0; i < table.size(); i++) {
+            table[i] = srgbToLinear(i / 255.f);
+        }
+        return table;
+    }();
+    return table;
+}
+
+const std::array<float, 256>&
+alphaDecodeTable() {
+    static const std::array<float, 256> table = []() {
+        std::array<float, 256> table;
+        for (size_t i = 0; i < table.size(); i++) {
+            table[i] = i / 255.f;
+        }
+        return table;
+    }();
+    return table;
+}
+
+/*
+ * Rounds linear values in [0, 1] to 8 bit sRGB. `thresholds` holds the linear values at which the encoding rounds up to the
+ * next value, a table over 4096 buckets gives the value at the start of each bucket so that at most a step or two remain.
+ */
+struct SRGBEncoder {
+    static constexpr int32_t num_buckets = 4096;
+    float thresholds[256];
+    uint8_t start[num_buckets];
+
+    SRGBEncoder() {
+        for (int32_t i = 0; i < 255; i++) {
+            thresholds[i] = srgbToLinear((i + 0.5f) / 255.f);
+        }
+        thresholds[255] = std::numeric_limits<float>::infinity();
+        uint8_t value = 0;
+        for (int32_t bucket = 0; bucket < num_buckets; bucket++) {
+            float lower = float(bucket) / (num_buckets - 1);
+            while (lower >= thresholds[value]) value++;
+            start[bucket] = value;
+        }
+    }
+
+    uint8_t encode(float value) const {
+        uint8_t result = start[int32_t(value * (num_buckets - 1))];
+        while (value >= thresholds[result]) result++;
+        return result;
+    }
+};
+
+const SRGBEncoder&
+srgbEncoder() {
+    static const SRGBEncoder encoder;
+    return encoder;
+}
+
+/* Zeroth order modified Bessel function of the first kind */
+float
+besselI0(float x) {
+    float sum = 1.f;
+    float term = 1.f;
+    for (int32_t k = 1; k < 16; k++) {
+        term *= (x * x) / (4.f * k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+/* Sinc windowed by a Kaiser window that spans `kaiser_radius` destination texels to each side */
+constexpr float kaiser_radius = 1.5f;
+constexpr float kaiser_alpha = 4.f;
+constexpr float pi = 3.14159265358979f;
+
+float
+kaiser(float x) {
+    float t = x / kaiser_radius;
+    if (std::abs(t) >= 1.f) return 0.f;
+    float sinc = x == 0.f ? 1.f : std::sin(pi * x) / (pi * x);
+    return sinc * besselI0(kaiser_alpha * std::sqrt(1.f - t * t)) / besselI0(kaiser_alpha);
+}
+
+/* Source texels and normalized weights for every destination texel along one axis, taps outside the source are clamped to the edge */
+struct FilterTaps {
+    int32_t num_taps { 0 };
+    std::vector<int32_t> indices;
+    std::vector<float> weights;
+};
+
+FilterTaps
+makeFilterTaps(int32_t src_size, int32_t dst_size, MipFilter filter) {
+    float ratio = float(src_size) / dst_size;
+    float radius = (filter == MipFilter_Kaiser ? kaiser_radius : 0.5f) * ratio;
+
+    FilterTaps taps;
+    taps.num_taps = int32_t(std::ceil(2.f * radius)) + 1;
+    taps.indices.resize(size_t(dst_size) * taps.num_taps);
+    taps.weights.resize(size_t(dst_size) * taps.num_taps);
+    for (int32_t i = 0; i < dst_size; i++) {
+        float center = (i + 0.5f) * ratio;
+        int32_t first = int32_t(std::floor(center - radius));
+        float sum = 0.f;
+        for (int32_t k = 0; k < taps.num_taps; k++) {
+            int32_t s = first + k;
+            float weight;
+            if (filter == MipFilter_Kaiser)
+                weight = kaiser((s + 0.5f - center) / ratio);
+            else
+                weight = std::max(0.f, std::min(s + 1.f, center + radius) - std::max(float(s), center - radius));
+            taps.indices[i * taps.num_taps + k] = std::clamp(s, 0, src_size - 1);
+            taps.weights[i * taps.num_taps + k] = weight;
+            sum += weight;
+        }
+        for (int32_t k = 0; k < taps.num_taps; k++) {
+            taps.weights[i * taps.num_taps + k] /= sum;
+        }
+    }
+    return taps;
+}
+
+/* 
+ * Fills levels 1 and up of `chain` from level 0, filtering columns first and then rows. Every level is filtered from the previous one.
+ * LDR levels are kept in linear floating point for the next level so that they are not quantized more than once,
+ * HDR levels are read back from the chain.
+ */
+template<typename T>
+void
+downsampleChain(T* chain, const std::vector<MipLevel>& levels, int32_t channels, MipFilter filter) {
+    constexpr bool is_ldr = std::is_same<T, uint8_t>::value;
+    // Channels at or above `num_colors` are alpha, which is never gamma encoded
+    int32_t num_colors = channels == 2 || channels == 4 ? channels - 1 : channels;
+    const float* decoders[4];
+    for (int32_t c = 0; c < 4; c++) {
+        decoders[c] = c < num_colors ? srgbDecodeTable().data() : alphaDecodeTable().data();
+    }
+    auto& encoder = srgbEncoder();
+
+    std::vector<float> previous;
+    std::vector<float> current;
+    for (size_t level = 1; level < levels.size(); level++) {
+        const MipLevel& src = levels[level - 1];
+        const MipLevel& dst = levels[level];
+        FilterTaps taps_x = makeFilterTaps(src.width, dst.width, filter);
+        FilterTaps taps_y = makeFilterTaps(src.height, dst.height, filter);
+        size_t src_row = size_t(src.width) * channels;
+        size_t dst_row = size_t(dst.width) * channels;
+
+        // LDR level 0 is decoded while it is filtered
+        const float* src_linear = nullptr;
+        float* dst_linear = nullptr;
+        if constexpr (is_ldr) {
+            src_linear = level > 1 ? previous.data() : nullptr;
+            current.resize(dst.height * dst_row);
+            dst_linear = current.data();
+        } else {
+            src_linear = chain + src.offset;
+            dst_linear = chain + dst.offset;
         }
 
-        // Flip y axis
-        tbb::parallel_for(tbb::blocked_range<uint32_t>(0, m_height/2), [&](const auto& r) {
-        for (uint32_t row = r.begin(); row != r.end(); row++) {
-            tbb::parallel_for(tbb::blocked_range<uint32_t>(0, m_width * m_channels), [&](const auto& rr) {
-            for (uint32_t el = rr.begin(); el != rr.end(); el++) {
-                uint32_t id_a = row * m_width * m_channels + el;
-                uint32_t id_b = (m_height - row - 1) * m_width * m_channels + el;
-                std::swap(image_float[id_a], image_float[id_b]);
+        tbb::parallel_for(tbb::blocked_range<int32_t>(0, dst.height), [&](const auto& r) {
+        std::vector<float> column(src_row);
+        for (int32_t y = r.begin(); y != r.end(); y++) {
+            std::fill(column.begin(), column.end(), 0.f);
+            for (int32_t k = 0; k < taps_y.num_taps; k++) {
+                float weight = taps_y.weights[y * taps_y.num_taps + k];
+                if (weight == 0.f) continue;
+                size_t row = taps_y.indices[y * taps_y.num_taps + k];
+                if (src_linear) {
+                    const float* in = src_linear + row * src_row;
+                    for (size_t i = 0; i < src_row; i++) {
+                        column[i] += weight * in[i];
+                    }
+                } else {
+                    const T* in = chain + src.offset + row * src_row;
+                    for (size_t i = 0; i < src_row; i += channels) {
+                        for (int32_t c = 0; c < channels; c++) {
+                            column[i + c] += weight * decoders[c][size_t(in[i + c])];
+                        }
+                    }
+                }
+            }
+
+            // The Kaiser filter rings around edges, values are clamped before they feed into the next level
+            float* out = dst_linear + y * dst_row;
+            T* out_stored = chain + dst.offset + y * dst_row;
+            for (int32_t x = 0; x < dst.width; x++) {
+                float sum[4] = { 0.f, 0.f, 0.f, 0.f };
+                for (int32_t k = 0; k < taps_x.num_taps; k++) {
+                    const float* texel = column.data() + taps_x.indices[x * taps_x.num_taps + k] * channels;
+                    float weight = taps_x.weights[x * taps_x.num_taps + k];
+                    for (int32_t c = 0; c < channels; c++) {
+                        sum[c] += weight * texel[c];
+                    }
+                }
+                for (int32_t c = 0; c < channels; c++) {
+                    size_t i = x * channels + c;
+                    if constexpr (is_ldr) {
+                        out[i] = std::clamp(sum[c], 0.f, 1.f);
+                        out_stored[i] = c < num_colors ? encoder.encode(out[i]) : uint8_t(out[i] * 255.f + 0.5f);
+                    } else {
+                        out[i] = std::max(sum[c], 0.f);
+                    }
+                }
             }
-            });
         }
         });
+        previous.swap(current);
+    }
+}
+
+}
 
-        m_is_hdr = true;
-        image = (uint8_t*)image_float;
-        image_size = sizeof(float) * m_width * m_height * m_channels;
+/* Source of an image that is decoded on first access */
+struct Image::LazySource {
+    std::string filename;
+    std::vector<uint8_t> blob;
+    std::shared_ptr<Image> shared;
+    std::once_flag decoded;
+    std::atomic<bool> is_valid { true };
+    std::atomic<bool> is_loaded { false };
+};
+
+Image::Image(std::string filename, bool is_hdr, bool lazy, std::shared_ptr<Allocator> allocator) : m_is_hdr(is_hdr) {
+    if (allocator)
+        m_allocator = allocator;
+
+    DecodedImage image;
+    if (lazy) {
+        if (!probeFile(filename, is_hdr, image)) {
+            ERR("Unable to load image '" + filename + "'");
+            return;
+        }
+        m_source = std::make_shared<LazySource>();
+        m_source->filename = filename;
+    } else {
+        image = decodeFile(filename, is_hdr);
     }
 
+    m_width = image.width;
+    m_height = image.height;
+    m_channels = image.channels;
+    m_is_hdr = image.is_hdr;
+    adopt(image.data);
+}
 
-    if (image == nullptr) {
-        ERR("Unable to load image blob");
-        return;
+Image::Image(uint8_t* blob, size_t size, bool is_hdr, bool lazy, std::shared_ptr<Allocator> allocator) : m_is_hdr(is_hdr) {
+    if (allocator)
+        m_allocator = allocator;
+
+    DecodedImage image;
+    if (lazy) {
+        if (!probeBlob(blob, size, is_hdr, image)) {
+            ERR("Unable to load image blob");
+            return;
+        }
+        // The blob usually belongs to the parser and does not outlive the scene load
+        m_source = std::make_shared<LazySource>();
+        m_source->blob.assign(blob, blob + size);
+    } else {
+        image = decodeBlob(blob, size, is_hdr);
     }
 
-    m_image = (uint8_t*)std::malloc(image_size);
-    std::memcpy(m_image, image, image_size);
-    std::free(image);
+    m_width = image.width;
+    m_height = image.height;
+    m_channels = image.channels;
+    m_is_hdr = image.is_hdr;
+    adopt(image.data);
 }
 
-Image::Image(stage_vec3f color) {
-    m_image = (uint8_t*)std::malloc(sizeof(uint8_t) * 4);
+Image::Image(stage_vec3f color, std::shared_ptr<Allocator> allocator) {
+    if (allocator)
+        m_allocator = allocator;
+
+    m_image = (uint8_t*)m_allocator->allocate(sizeof(uint8_t) * 4, alignof(float));
     m_image[0] = color.x * 255;
     m_image[1] = color.y * 255;
     m_image[2] = color.z * 255;
@@ -146,80 +569,375 @@ Image::Image(stage_vec3f color) {
     m_channels = 4;
 }
 
+Image::Image(std::shared_ptr<Image> shared) {
+    if (!shared) return;
+    m_owner = shared;
+    m_source = std::make_shared<LazySource>();
+    m_source->shared = shared;
+    m_source->is_valid = shared->isValid();
+    m_allocator = shared->m_allocator;
+    m_width = shared->getWidth();
+    m_height = shared->getHeight();
+    m_channels = shared->getChannels();
+    m_is_hdr = shared->isHDR();
+    m_mip_filter = shared->getMipFilter();
+    m_format = shared->getFormat();
+}
+
+Image::Image(uint8_t* data, int32_t width, int32_t height, int32_t channels, bool is_hdr, std::shared_ptr<void> owner, MipFilter mip_filter, TextureFormat format) {
+    m_image = data;
+    m_owner = owner;
+    m_width = width;
+    m_height = height;
+    m_channels = channels;
+    m_is_hdr = is_hdr;
+    m_mip_filter = mip_filter;
+    m_format = format;
+}
+
 Image::Image(Image&& other) {
     m_image = other.m_image;
+    m_owner = std::move(other.m_owner);
+    m_source = std::move(other.m_source);
+    m_allocator = other.m_allocator;
     m_width = other.m_width;
     m_height = other.m_height;
     m_channels = other.m_channels;
     m_is_hdr = other.m_is_hdr;
+    m_mip_filter = other.m_mip_filter;
+    m_format = other.m_format;
     other.m_image = nullptr;
 }
 
 Image&
 Image::operator=(Image&& other) {
-    if (m_image != nullptr)
-        std::free(m_image);
+    release();
     m_image = other.m_image;
+    m_owner = std::move(other.m_owner);
+    m_source = std::move(other.m_source);
+    m_allocator = other.m_allocator;
     m_width = other.m_width;
     m_height = other.m_height;
     m_channels = other.m_channels;
     m_is_hdr = other.m_is_hdr;
+    m_mip_filter = other.m_mip_filter;
+    m_format = other.m_format;
     other.m_image = nullptr;
 
     return *this;
 }
 
 Image::~Image() {
-    if (m_image != nullptr)
-        std::free(m_image);
+    release();
+}
+
+uint8_t*
+Image::getData() {
+    if (m_source) {
+        std::call_once(m_source->decoded, [this]() {
+            DecodedImage image;
+            if (m_source->shared)
+                image.data = m_source->shared->getData();
+            else if (m_source->filename.empty())
+                image = decodeBlob(m_source->blob.data(), m_source->blob.size(), m_is_hdr);
+            else
+                image = decodeFile(m_source->filename, m_is_hdr);
+
+            if (m_source->shared) {
+                m_image = image.data;
+            } else if (image.data == nullptr || (m_mip_filter == MipFilter_None && m_format == TextureFormat_Uncompressed)) {
+                adopt(image.data);
+            } else {
+                // Pending mip levels are generated first and then compressed along with level 0
+                uint8_t* chain = image.data;
+                if (m_mip_filter != MipFilter_None) {
+                    chain = buildChain(image.data);
+                    std::free(image.data);
+                }
+                if (m_format == TextureFormat_Uncompressed) {
+                    m_image = chain;
+                } else {
+                    m_image = encodeBlocks(chain);
+                    if (m_mip_filter != MipFilter_None)
+                        m_allocator->deallocate(chain, levelOffset(getLevelCount(), TextureFormat_Uncompressed), alignof(float));
+                    else
+                        std::free(chain);
+                }
+            }
+            m_source->is_valid = m_image != nullptr;
+            m_source->is_loaded = m_image != nullptr;
+            std::vector<uint8_t>().swap(m_source->blob);
+        });
+    }
+    return m_image;
+}
+
+void
+Image::detach() {
+    uint8_t* data = getData();
+    if (!m_owner) return;
+    if (data != nullptr) {
+        m_image = (uint8_t*)m_allocator->allocate(getSizeInBytes(), alignof(float));
+        std::memcpy(m_image, data, getSizeInBytes());
+    }
+    m_owner.reset();
+    m_source.reset();
+}
+
+void
+Image::adopt(uint8_t* data) {
+    if (data == nullptr || m_allocator == Allocator::getDefault()) {
+        m_image = data;
+        return;
+    }
+    size_t size_in_bytes = levelSizeInBytes(0, TextureFormat_Uncompressed);
+    m_image = (uint8_t*)m_allocator->allocate(size_in_bytes, alignof(float));
+    std::memcpy(m_image, data, size_in_bytes);
+    std::free(data);
+}
+
+void
+Image::release() {
+    if (m_image != nullptr && !m_owner)
+        m_allocator->deallocate(m_image, getSizeInBytes(), alignof(float));
+    m_image = nullptr;
+}
+
+uint8_t*
+Image::buildChain(const uint8_t* level0) {
+    uint8_t* chain = (uint8_t*)m_allocator->allocate(levelOffset(getLevelCount(), TextureFormat_Uncompressed), alignof(float));
+    std::memcpy(chain, level0, levelSizeInBytes(0, TextureFormat_Uncompressed));
+    buildLevels(chain);
+    return chain;
+}
+
+void
+Image::buildLevels(uint8_t* chain) {
+    size_t element_size = m_is_hdr ? sizeof(float) : sizeof(uint8_t);
+    std::vector<MipLevel> levels(getLevelCount());
+    for (uint32_t level = 0; level < levels.size(); level++) {
+        levels[level] = { int32_t(getLevelWidth(level)), int32_t(getLevelHeight(level)), levelOffset(level, TextureFormat_Uncompressed) / element_size };
+    }
+
+    if (m_is_hdr)
+        downsampleChain(reinterpret_cast<float*>(chain), levels, m_channels, m_mip_filter);
+    else
+        downsampleChain(chain, levels, m_channels, m_mip_filter);
+}
+
+void
+Image::generateMips(MipFilter filter) {
+    if (filter == m_mip_filter) return;
+    if (isCompressed()) {
+        WARN("Cannot generate mip levels for a block compressed image");
+        return;
+    }
+
+    // Lazy images that decode their own source build the chain right after decoding
+    if (m_source && !m_source->shared && !isLoaded()) {
+        m_mip_filter = filter;
+        return;
+    }
+
+    uint8_t* data = getData();
+    size_t size_in_bytes = getSizeInBytes();
+    m_mip_filter = filter;
+    if (data == nullptr) return;
+
+    m_image = buildChain(data);
+    if (!m_owner)
+        m_allocator->deallocate(data, size_in_bytes, alignof(float));
+    m_owner.reset();
+    m_source.reset();
+}
+
+uint32_t
+Image::getLevelCount() {
+    if (m_mip_filter == MipFilter_None) return 1;
+    uint32_t count = 1;
+    for (int32_t size = std::max(m_width, m_height); size > 1; size /= 2) {
+        count++;
+    }
+    return count;
+}
+
+uint32_t
+Image::getLevelWidth(uint32_t level) {
+    return level == 0 ? m_width : std::max(m_width >> level, 1);
+}
+
+uint32_t
+Image::getLevelHeight(uint32_t level) {
+    return level == 0 ? m_height : std::max(m_height >> level, 1);
+}
+
+uint8_t*
+Image::encodeBlocks(const uint8_t* chain) {
+    // Opacity textures often come as RGBA with the opacity in alpha, or as grayscale without alpha
+    int32_t bc4_channel = 0;
+    if (m_format == TextureFormat_BC4 && (m_channels == 2 || m_channels == 4)) {
+        size_t num_texels = size_t(m_width) * m_height;
+        for (size_t i = 0; i < num_texels && bc4_channel == 0; i++) {
+            if (chain[i * m_channels + m_channels - 1] != 255) bc4_channel = m_channels - 1;
+        }
+    }
+
+    uint8_t* blocks = (uint8_t*)m_allocator->allocate(getSizeInBytes(), alignof(float));
+    for (uint32_t level = 0; level < getLevelCount(); level++) {
+        const uint8_t* texels = chain + levelOffset(level, TextureFormat_Uncompressed);
+        if (m_format == TextureFormat_BC6H)
+            compressBlocksBC6H(reinterpret_cast<const float*>(texels), getLevelWidth(level), getLevelHeight(level), m_channels, blocks + getLevelOffset(level));
+        else
+            compressBlocks(texels, getLevelWidth(level), getLevelHeight(level), m_channels, m_format, blocks + getLevelOffset(level), bc4_channel);
+    }
+    return blocks;
+}
+
+void
+Image::compress(TextureFormat format) {
+    if (format == m_format) return;
+    if (isCompressed()) {
+        WARN("Cannot change the format of a block compressed image");
+        return;
+    }
+    if ((format == TextureFormat_BC6H) != m_is_hdr) {
+        WARN(m_is_hdr ? "HDR images can only be compressed as BC6H" : "BC6H is only supported for HDR images");
+        return;
+    }
+
+    // Lazy images that decode their own source are compressed right after decoding
+    if (m_source && !m_source->shared && !isLoaded()) {
+        m_format = format;
+        return;
+    }
+
+    uint8_t* data = getData();
+    if (data == nullptr) return;
+    size_t size_in_bytes = getSizeInBytes();
+    m_format = format;
+
+    m_image = encodeBlocks(data);
+    if (!m_owner)
+        m_allocator->deallocate(data, size_in_bytes, alignof(float));
+    m_owner.reset();
+    m_source.reset();
+}
+
+size_t
+Image::levelOffset(uint32_t level, TextureFormat format) {
+    size_t offset = 0;
+    for (uint32_t i = 0; i < level; i++) {
+        offset += levelSizeInBytes(i, format);
+    }
+    return offset;
+}
+
+size_t
+Image::levelSizeInBytes(uint32_t level, TextureFormat format) {
+    if (format != TextureFormat_Uncompressed)
+        return compressedSize(format, getLevelWidth(level), getLevelHeight(level));
+    return (m_is_hdr ? sizeof(float) : sizeof(uint8_t)) * getLevelWidth(level) * getLevelHeight(level) * m_channels;
+}
+
+bool
+Image::isValid() {
+    if (m_source)
+        return m_source->is_valid;
+    return m_image != nullptr;
+}
+
+bool
+Image::isLoaded() {
+    if (m_source)
+        return m_source->is_loaded;
+    return m_image != nullptr;
 }
 
 void
 Image::scale(stage_vec3f scale) {
     if (!isValid()) return;
-    for (int i = 0; i < m_width * m_height * m_channels; i++) {
-        int channel = i % m_channels;
-        if (channel == m_channels-1) continue; // Don't scale alpha
-        m_image[i] *= scale[channel];
+    if (isCompressed()) {
+        WARN("Cannot scale a block compressed image");
+        return;
     }
+    detach();
+    ChannelPattern pattern = makeChannelPattern(m_channels, [&](int32_t channel, bool is_alpha) {
+        return std::make_pair(is_alpha ? 1.f : scale[channel], 0.f);
+    });
+    auto op = [](float value, float, float a, float b) { return value * a + b; };
+    if (m_is_hdr)
+        transformPixels(reinterpret_cast<float*>(m_image), (const float*)nullptr, numElements(), pattern, op);
+    else
+        transformPixels(m_image, (const uint8_t*)nullptr, numElements(), pattern, op);
+    if (m_mip_filter != MipFilter_None)
+        buildLevels(m_image);
 }
 
 void
 Image::scale(Image& other) {
     if (!isValid() || !other.isValid()) return;
+    if (isCompressed() || other.isCompressed()) {
+        WARN("Cannot scale block compressed images");
+        return;
+    }
+    uint8_t* other_data = other.getData();
     if (m_width != other.getWidth() || m_height != other.getHeight() || m_channels != other.getChannels()) {
         WARN("Cannot scale image with another image of different dimensions");
         return;
     }
-    
-    for (int i = 0; i < m_width * m_height * m_channels; i++) {
-        m_image[i] *= other.getData()[i];
-    }
+    detach();
+
+    // Color channels are multiplied by the other image, alpha is kept
+    ChannelPattern pattern = makeChannelPattern(m_channels, [&](int32_t, bool is_alpha) {
+        return is_alpha ? std::make_pair(0.f, 1.f) : std::make_pair(1.f, 0.f);
+    });
+    auto op = [](float value, float other_value, float a, float b) { return value * (other_value * a + b); };
+    transformPixels(m_image, m_is_hdr, other_data, other.isHDR(), numElements(), pattern, op);
+    if (m_mip_filter != MipFilter_None)
+        buildLevels(m_image);
 }
 
 void
 Image::mix(stage_vec3f color, stage_vec3f amount) {
     if (!isValid()) return;
-    for (int i = 0; i < m_width * m_height * m_channels; i++) {
-        int channel = i % m_channels;
-        if (channel == m_channels-1) continue; // Don't scale alpha
-        m_image[i] = m_image[i] * (1.f - amount[channel]) + color[channel] * amount[channel];
+    if (isCompressed()) {
+        WARN("Cannot mix a block compressed image");
+        return;
     }
+    detach();
+    ChannelPattern pattern = makeChannelPattern(m_channels, [&](int32_t channel, bool is_alpha) {
+        return is_alpha ? std::make_pair(1.f, 0.f) : std::make_pair(1.f - amount[channel], color[channel] * amount[channel]);
+    });
+    auto op = [](float value, float, float a, float b) { return value * a + b; };
+    if (m_is_hdr)
+        transformPixels(reinterpret_cast<float*>(m_image), (const float*)nullptr, numElements(), pattern, op);
+    else
+        transformPixels(m_image, (const uint8_t*)nullptr, numElements(), pattern, op);
+    if (m_mip_filter != MipFilter_None)
+        buildLevels(m_image);
 }
 
 void
 Image::mix(Image& other, stage_vec3f amount) {
     if (!isValid() || !other.isValid()) return;
+    if (isCompressed() || other.isCompressed()) {
+        WARN("Cannot mix block compressed images");
+        return;
+    }
+    uint8_t* other_data = other.getData();
     if (m_width != other.getWidth() || m_height != other.getHeight() || m_channels != other.getChannels()) {
         WARN("Cannot mix image with another image of different dimensions");
         return;
     }
-    
-    for (int i = 0; i < m_width * m_height * m_channels; i++) {
-        int channel = i % m_channels;
-        if (channel == m_channels-1) continue; // Don't scale alpha
-        m_image[i] = m_image[i] * (1.f - amount[channel]) + other.getData()[i] * amount[channel];
-    }
+    detach();
+
+    ChannelPattern pattern = makeChannelPattern(m_channels, [&](int32_t channel, bool is_alpha) {
+        return is_alpha ? std::make_pair(1.f, 0.f) : std::make_pair(1.f - amount[channel], amount[channel]);
+    });
+    auto op = [](float value, float other_value, float a, float b) { return value * a + other_value * b; };
+    transformPixels(m_image, m_is_hdr, other_data, other.isHDR(), numElements(), pattern, op);
+    if (m_mip_filter != MipFilter_None)
+        buildLevels(m_image);
 }
 
 }
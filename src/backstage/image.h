@@ -1,29 +1,88 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <string>
+#include "allocator.h"
 #include "math.h"
 
 namespace stage {
 namespace backstage {
 
+/* Filter used to generate mip levels, see Image::generateMips() */
+enum MipFilter {
+    MipFilter_None      = 0,    // Level 0 only
+    MipFilter_Box       = 1,    // Area weighted average over the footprint of every texel
+    MipFilter_Kaiser    = 2,    // Kaiser windowed sinc, keeps more detail than the box filter
+};
+
+/* Layout of the pixels of an image, see Image::compress() */
+enum TextureFormat {
+    TextureFormat_Uncompressed  = 0,    // 8 bit or float texels with the image's channels
+    TextureFormat_BC1           = 1,    // RGB with 1 bit alpha, 8 bytes per 4x4 block
+    TextureFormat_BC4           = 2,    // Single channel, 8 bytes per 4x4 block
+    TextureFormat_BC5           = 3,    // Two channels, 16 bytes per 4x4 block
+    TextureFormat_BC6H          = 4,    // Unsigned half float RGB, 16 bytes per 4x4 block
+    TextureFormat_BC7           = 5,    // RGBA, 16 bytes per 4x4 block
+};
+
 struct Image {
 
     public:
-        Image(std::string filename, bool is_hdr = false);
-        Image(uint8_t* blob, size_t size, bool is_hdr = false);
-        Image(stage_vec3f color);
+        /* 
+         * Lazy images only read the image header here and decode the pixels on the first call to getData().
+         * Pixels are stored in memory from `allocator`, or from the default allocator if it is null.
+         */
+        Image(std::string filename, bool is_hdr = false, bool lazy = false, std::shared_ptr<Allocator> allocator = nullptr);
+        Image(uint8_t* blob, size_t size, bool is_hdr = false, bool lazy = false, std::shared_ptr<Allocator> allocator = nullptr);
+        Image(stage_vec3f color, std::shared_ptr<Allocator> allocator = nullptr);
+        /* Shares the pixels of `shared` without copying them. Lazy images are decoded on the first access through either image. */
+        Image(std::shared_ptr<Image> shared);
+        /* 
+         * Wraps decoded pixels owned by `owner` without copying them. Passing a null `data` creates an invalid image.
+         * Unless `mip_filter` is MipFilter_None, `data` holds the complete mip chain generated with that filter.
+         * Unless `format` is TextureFormat_Uncompressed, `data` holds the blocks of every level in that format.
+         */
+        Image(uint8_t* data, int32_t width, int32_t height, int32_t channels, bool is_hdr, std::shared_ptr<void> owner, MipFilter mip_filter = MipFilter_None, TextureFormat format = TextureFormat_Uncompressed);
         Image(Image& other) = delete;
         Image(Image&& other);
         Image& operator=(Image& other) = delete;
         Image& operator=(Image&& other);
         ~Image();
 
-        uint8_t* getData() { return m_image; }
+        /* Decodes lazy images on first access, safe to call from multiple threads */
+        uint8_t* getData();
         uint32_t getWidth() { return m_width; }
         uint32_t getHeight() { return m_height; }
         uint32_t getChannels() { return m_channels; }
+        /* Size of all mip levels */
+        size_t getSizeInBytes() { return getLevelOffset(getLevelCount()); }
 
+        /*
+         * Replaces the pixels by a chain of mip levels down to 1x1, stored in a single allocation with level 0 first.
+         * LDR color channels are filtered in linear space and stored as sRGB again, HDR images and alpha are filtered as they are.
+         * Lazy images generate the levels when they are decoded, MipFilter_None drops existing levels.
+         */
+        void generateMips(MipFilter filter);
+        MipFilter getMipFilter() { return m_mip_filter; }
+        uint32_t getLevelCount();
+        uint32_t getLevelWidth(uint32_t level);
+        uint32_t getLevelHeight(uint32_t level);
+        /* Byte offset of `level` from getData() */
+        size_t getLevelOffset(uint32_t level) { return levelOffset(level, m_format); }
+        size_t getLevelSizeInBytes(uint32_t level) { return levelSizeInBytes(level, m_format); }
+
+        /*
+         * Replaces the pixels of every mip level by 4x4 blocks in `format`, which cannot be changed again afterwards.
+         * BC6H is for HDR images only, all other formats for LDR images. BC4 keeps the alpha channel if it is not fully opaque,
+         * otherwise the first channel. Lazy images are compressed when they are decoded, after their mip levels were generated.
+         * Compressed images can no longer be scaled, mixed or get new mip levels.
+         */
+        void compress(TextureFormat format);
+        TextureFormat getFormat() { return m_format; }
+        bool isCompressed() { return m_format != TextureFormat_Uncompressed; }
+
+        /* Modify level 0 and generate the other mip levels again */
         void scale(stage_vec3f scale);
         void scale(Image& other);
 
@@ -31,16 +90,40 @@ struct Image {
         void mix(Image& other, stage_vec3f amount);
 
         bool isHDR() { return m_is_hdr; }
-        bool isValid() { return m_image != nullptr; }
+        bool isValid();
+        /* Returns false for lazy images that have not been decoded yet */
+        bool isLoaded();
 
     private:
+        struct LazySource;
+
+        /* Decodes the image and makes a private copy of pixels that are owned elsewhere before they are modified */
+        void detach();
+        /* Takes over pixels decoded by stbi or tinyexr, which are moved to the image's allocator if it is not the default one */
+        void adopt(uint8_t* data);
+        void release();
+        /* Allocates a mip chain for `level0` and fills levels 1 and up */
+        uint8_t* buildChain(const uint8_t* level0);
+        void buildLevels(uint8_t* chain);
+        /* Allocates the blocks of all levels of the uncompressed `chain` in m_format */
+        uint8_t* encodeBlocks(const uint8_t* chain);
+        size_t levelOffset(uint32_t level, TextureFormat format);
+        size_t levelSizeInBytes(uint32_t level, TextureFormat format);
+        /* Number of elements in level 0 */
+        size_t numElements() { return size_t(m_width) * m_height * m_channels; }
+
         uint8_t* m_image { nullptr };
+        std::shared_ptr<void> m_owner;
+        std::shared_ptr<LazySource> m_source;
+        std::shared_ptr<Allocator> m_allocator { Allocator::getDefault() };
 
-        int32_t m_width;
-        int32_t m_height;
-        int32_t m_channels;
+        int32_t m_width { 0 };
+        int32_t m_height { 0 };
+        int32_t m_channels { 0 };
 
         bool m_is_hdr { false };
+        MipFilter m_mip_filter { MipFilter_None };
+        TextureFormat m_format { TextureFormat_Uncompressed };
 };
 
 }
@@ -0,0 +1,533 @@
+#include "kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define STAGE_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define STAGE_TARGET(isa)
+#else
+#define STAGE_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace stage {
+namespace backstage {
+
+namespace {
+
+/*
+ * The kernels work on the raw bytes of a view. Matrices are passed as 12 floats, the xyz parts of the four columns, so that
+ * a vector v transforms to c0 * v.x + c1 * v.y + c2 * v.z + c3.
+ */
+struct Kernels {
+    void (*transform)(uint8_t* data, size_t count, size_t stride, const float* m, bool normalize);
+    void (*normalize)(uint8_t* data, size_t count, size_t stride);
+    void (*bounds)(const uint8_t* data, size_t count, size_t stride, float* lower, float* upper);
+};
+
+inline float*
+at(uint8_t* data, size_t i, size_t stride) {
+    return reinterpret_cast<float*>(data + i * stride);
+}
+
+inline const float*
+at(const uint8_t* data, size_t i, size_t stride) {
+    return reinterpret_cast<const float*>(data + i * stride);
+}
+
+inline void
+normalizeScalar(float& x, float& y, float& z) {
+    float length_squared = x * x + y * y + z * z;
+    if (length_squared > 0.f) {
+        float inverse_length = 1.f / std::sqrt(length_squared);
+        x *= inverse_length;
+        y *= inverse_length;
+        z *= inverse_length;
+    }
+}
+
+/* Scalar */
+void
+transformScalar(uint8_t* data, size_t count, size_t stride, const float* m, bool normalize) {
+    for (size_t i = 0; i < count; i++) {
+        float* p = at(data, i, stride);
+        float x = p[0], y = p[1], z = p[2];
+        float rx = m[0] * x + m[3] * y + m[6] * z + m[9];
+        float ry = m[1] * x + m[4] * y + m[7] * z + m[10];
+        float rz = m[2] * x + m[5] * y + m[8] * z + m[11];
+        if (normalize)
+            normalizeScalar(rx, ry, rz);
+        p[0] = rx;
+        p[1] = ry;
+        p[2] = rz;
+    }
+}
+
+void
+normalizeVectorsScalar(uint8_t* data, size_t count, size_t stride) {
+    for (size_t i = 0; i < count; i++) {
+        float* p = at(data, i, stride);
+        normalizeScalar(p[0], p[1], p[2]);
+    }
+}
+
+void
+boundsScalar(const uint8_t* data, size_t count, size_t stride, float* lower, float* upper) {
+    for (size_t i = 0; i < count; i++) {
+        const float* p = at(data, i, stride);
+        for (size_t k = 0; k < 3; k++) {
+            lower[k] = std::min(lower[k], p[k]);
+            upper[k] = std::max(upper[k], p[k]);
+        }
+    }
+}
+
+constexpr Kernels scalar_kernels = { transformScalar, normalizeVectorsScalar, boundsScalar };
+
+#ifdef STAGE_SIMD_X86
+
+/* SSE4.2, four vectors at a time. There are no gathers, the components are loaded and stored one by one. */
+STAGE_TARGET("sse4.2") inline void
+loadSSE42(const uint8_t* data, size_t stride, __m128& x, __m128& y, __m128& z) {
+    const float* p0 = at(data, 0, stride);
+    const float* p1 = at(data, 1, stride);
+    const float* p2 = at(data, 2, stride);
+    const float* p3 = at(data, 3, stride);
+    x = _mm_setr_ps(p0[0], p1[0], p2[0], p3[0]);
+    y = _mm_setr_ps(p0[1], p1[1], p2[1], p3[1]);
+    z = _mm_setr_ps(p0[2], p1[2], p2[2], p3[2]);
+}
+
+STAGE_TARGET("sse4.2") inline void
+storeSSE42(uint8_t* data, size_t stride, __m128 x, __m128 y, __m128 z) {
+    alignas(16) float xs[4], ys[4], zs[4];
+    _mm_store_ps(xs, x);
+    _mm_store_ps(ys, y);
+    _mm_store_ps(zs, z);
+    for (size_t k = 0; k < 4; k++) {
+        float* p = at(data, k, stride);
+        p[0] = xs[k];
+        p[1] = ys[k];
+        p[2] = zs[k];
+    }
+}
+
+STAGE_TARGET("sse4.2") inline void
+normalizeSSE42(__m128& x, __m128& y, __m128& z) {
+    __m128 length_squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+    __m128 inverse_length = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(length_squared));
+    __m128 mask = _mm_cmpgt_ps(length_squared, _mm_setzero_ps());
+    x = _mm_blendv_ps(x, _mm_mul_ps(x, inverse_length), mask);
+    y = _mm_blendv_ps(y, _mm_mul_ps(y, inverse_length), mask);
+    z = _mm_blendv_ps(z, _mm_mul_ps(z, inverse_length), mask);
+}
+
+STAGE_TARGET("sse4.2") void
+transformSSE42(uint8_t* data, size_t count, size_t stride, const float* m, bool normalize) {
+    __m128 c[12];
+    for (size_t k = 0; k < 12; k++) {
+        c[k] = _mm_set1_ps(m[k]);
+    }
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint8_t* block = data + i * stride;
+        __m128 x, y, z;
+        loadSSE42(block, stride, x, y, z);
+        __m128 rx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c[0], x), _mm_mul_ps(c[3], y)), _mm_mul_ps(c[6], z)), c[9]);
+        __m128 ry = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c[1], x), _mm_mul_ps(c[4], y)), _mm_mul_ps(c[7], z)), c[10]);
+        __m128 rz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c[2], x), _mm_mul_ps(c[5], y)), _mm_mul_ps(c[8], z)), c[11]);
+        if (normalize)
+            normalizeSSE42(rx, ry, rz);
+        storeSSE42(block, stride, rx, ry, rz);
+    }
+    transformScalar(data + i * stride, count - i, stride, m, normalize);
+}
+
+STAGE_TARGET("sse4.2") void
+normalizeVectorsSSE42(uint8_t* data, size_t count, size_t stride) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint8_t* block = data + i * stride;
+        __m128 x, y, z;
+        loadSSE42(block, stride, x, y, z);
+        normalizeSSE42(x, y, z);
+        storeSSE42(block, stride, x, y, z);
+    }
+    normalizeVectorsScalar(data + i * stride, count - i, stride);
+}
+
+STAGE_TARGET("sse4.2") void
+boundsSSE42(const uint8_t* data, size_t count, size_t stride, float* lower, float* upper) {
+    __m128 lx = _mm_set1_ps(lower[0]), ly = _mm_set1_ps(lower[1]), lz = _mm_set1_ps(lower[2]);
+    __m128 ux = _mm_set1_ps(upper[0]), uy = _mm_set1_ps(upper[1]), uz = _mm_set1_ps(upper[2]);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 x, y, z;
+        loadSSE42(data + i * stride, stride, x, y, z);
+        lx = _mm_min_ps(lx, x); ly = _mm_min_ps(ly, y); lz = _mm_min_ps(lz, z);
+        ux = _mm_max_ps(ux, x); uy = _mm_max_ps(uy, y); uz = _mm_max_ps(uz, z);
+    }
+    alignas(16) float lanes[6][4];
+    _mm_store_ps(lanes[0], lx); _mm_store_ps(lanes[1], ly); _mm_store_ps(lanes[2], lz);
+    _mm_store_ps(lanes[3], ux); _mm_store_ps(lanes[4], uy); _mm_store_ps(lanes[5], uz);
+    for (size_t k = 0; k < 4; k++) {
+        for (size_t axis = 0; axis < 3; axis++) {
+            lower[axis] = std::min(lower[axis], lanes[axis][k]);
+            upper[axis] = std::max(upper[axis], lanes[3 + axis][k]);
+        }
+    }
+    boundsScalar(data + i * stride, count - i, stride, lower, upper);
+}
+
+/* AVX2, eight vectors at a time with gathered loads. Stores go through memory, scatters need AVX-512. */
+STAGE_TARGET("avx2,fma") inline void
+loadAVX2(const uint8_t* data, __m256i offsets, __m256& x, __m256& y, __m256& z) {
+    const float* base = reinterpret_cast<const float*>(data);
+    x = _mm256_i32gather_ps(base, offsets, 4);
+    y = _mm256_i32gather_ps(base + 1, offsets, 4);
+    z = _mm256_i32gather_ps(base + 2, offsets, 4);
+}
+
+STAGE_TARGET("avx2,fma") inline void
+storeAVX2(uint8_t* data, size_t stride, __m256 x, __m256 y, __m256 z) {
+    alignas(32) float xs[8], ys[8], zs[8];
+    _mm256_store_ps(xs, x);
+    _mm256_store_ps(ys, y);
+    _mm256_store_ps(zs, z);
+    for (size_t k = 0; k < 8; k++) {
+        float* p = at(data, k, stride);
+        p[0] = xs[k];
+        p[1] = ys[k];
+        p[2] = zs[k];
+    }
+}
+
+STAGE_TARGET("avx2,fma") inline __m256i
+offsetsAVX2(size_t stride) {
+    int32_t s = int32_t(stride / sizeof(float));
+    return _mm256_setr_epi32(0, s, 2 * s, 3 * s, 4 * s, 5 * s, 6 * s, 7 * s);
+}
+
+STAGE_TARGET("avx2,fma") inline void
+normalizeAVX2(__m256& x, __m256& y, __m256& z) {
+    __m256 length_squared = _mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_mul_ps(z, z)));
+    __m256 inverse_length = _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_sqrt_ps(length_squared));
+    __m256 mask = _mm256_cmp_ps(length_squared, _mm256_setzero_ps(), _CMP_GT_OQ);
+    x = _mm256_blendv_ps(x, _mm256_mul_ps(x, inverse_length), mask);
+    y = _mm256_blendv_ps(y, _mm256_mul_ps(y, inverse_length), mask);
+    z = _mm256_blendv_ps(z, _mm256_mul_ps(z, inverse_length), mask);
+}
+
+STAGE_TARGET("avx2,fma") void
+transformAVX2(uint8_t* data, size_t count, size_t stride, const float* m, bool normalize) {
+    __m256 c[12];
+    for (size_t k = 0; k < 12; k++) {
+        c[k] = _mm256_set1_ps(m[k]);
+    }
+    __m256i offsets = offsetsAVX2(stride);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint8_t* block = data + i * stride;
+        __m256 x, y, z;
+        loadAVX2(block, offsets, x, y, z);
+        __m256 rx = _mm256_fmadd_ps(c[6], z, _mm256_fmadd_ps(c[3], y, _mm256_fmadd_ps(c[0], x, c[9])));
+        __m256 ry = _mm256_fmadd_ps(c[7], z, _mm256_fmadd_ps(c[4], y, _mm256_fmadd_ps(c[1], x, c[10])));
+        __m256 rz = _mm256_fmadd_ps(c[8], z, _mm256_fmadd_ps(c[5], y, _mm256_fmadd_ps(c[2], x, c[11])));
+        if (normalize)
+            normalizeAVX2(rx, ry, rz);
+        storeAVX2(block, stride, rx, ry, rz);
+    }
+    transformScalar(data + i * stride, count - i, stride, m, normalize);
+}
+
+STAGE_TARGET("avx2,fma") void
+normalizeVectorsAVX2(uint8_t* data, size_t count, size_t stride) {
+    __m256i offsets = offsetsAVX2(stride);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint8_t* block = data + i * stride;
+        __m256 x, y, z;
+        loadAVX2(block, offsets, x, y, z);
+        normalizeAVX2(x, y, z);
+        storeAVX2(block, stride, x, y, z);
+    }
+    normalizeVectorsScalar(data + i * stride, count - i, stride);
+}
+
+STAGE_TARGET("avx2,fma") void
+boundsAVX2(const uint8_t* data, size_t count, size_t stride, float* lower, float* upper) {
+    __m256 lx = _mm256_set1_ps(lower[0]), ly = _mm256_set1_ps(lower[1]), lz = _mm256_set1_ps(lower[2]);
+    __m256 ux = _mm256_set1_ps(upper[0]), uy = _mm256_set1_ps(upper[1]), uz = _mm256_set1_ps(upper[2]);
+    __m256i offsets = offsetsAVX2(stride);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x, y, z;
+        loadAVX2(data + i * stride, offsets, x, y, z);
+        lx = _mm256_min_ps(lx, x); ly = _mm256_min_ps(ly, y); lz = _mm256_min_ps(lz, z);
+        ux = _mm256_max_ps(ux, x); uy = _mm256_max_ps(uy, y); uz = _mm256_max_ps(uz, z);
+    }
+    alignas(32) float lanes[6][8];
+    _mm256_store_ps(lanes[0], lx); _mm256_store_ps(lanes[1], ly); _mm256_store_ps(lanes[2], lz);
+    _mm256_store_ps(lanes[3], ux); _mm256_store_ps(lanes[4], uy); _mm256_store_ps(lanes[5], uz);
+    for (size_t k = 0; k < 8; k++) {
+        for (size_t axis = 0; axis < 3; axis++) {
+            lower[axis] = std::min(lower[axis], lanes[axis][k]);
+            upper[axis] = std::max(upper[axis], lanes[3 + axis][k]);
+        }
+    }
+    boundsScalar(data + i * stride, count - i, stride, lower, upper);
+}
+
+/*
+ * AVX-512, sixteen vectors at a time with gathered loads and scattered stores.
+ * GCC implements the unmasked gather, min, max and sqrt intrinsics on top of _mm512_undefined_ps(), which initializes
+ * itself and trips -Wmaybe-uninitialized at -O2. They are used in their masked form with an explicit, all-lanes mask instead.
+ */
+STAGE_TARGET("avx512f") inline __m512
+minAVX512(__m512 a, __m512 b) {
+    return _mm512_mask_min_ps(a, 0xffff, a, b);
+}
+
+STAGE_TARGET("avx512f") inline __m512
+maxAVX512(__m512 a, __m512 b) {
+    return _mm512_mask_max_ps(a, 0xffff, a, b);
+}
+
+STAGE_TARGET("avx512f") inline __m512i
+offsetsAVX512(size_t stride) {
+    return _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(int32_t(stride / sizeof(float))));
+}
+
+STAGE_TARGET("avx512f") inline void
+loadAVX512(const uint8_t* data, __m512i offsets, __m512& x, __m512& y, __m512& z) {
+    const float* base = reinterpret_cast<const float*>(data);
+    x = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xffff, offsets, base, 4);
+    y = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xffff, offsets, base + 1, 4);
+    z = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xffff, offsets, base + 2, 4);
+}
+
+STAGE_TARGET("avx512f") inline void
+storeAVX512(uint8_t* data, __m512i offsets, __m512 x, __m512 y, __m512 z) {
+    float* base = reinterpret_cast<float*>(data);
+    _mm512_i32scatter_ps(base, offsets, x, 4);
+    _mm512_i32scatter_ps(base + 1, offsets, y, 4);
+    _mm512_i32scatter_ps(base + 2, offsets, z, 4);
+}
+
+STAGE_TARGET("avx512f") inline void
+normalizeAVX512(__m512& x, __m512& y, __m512& z) {
+    __m512 length_squared = _mm512_fmadd_ps(x, x, _mm512_fmadd_ps(y, y, _mm512_mul_ps(z, z)));
+    __m512 inverse_length = _mm512_div_ps(_mm512_set1_ps(1.f), _mm512_mask_sqrt_ps(length_squared, 0xffff, length_squared));
+    __mmask16 mask = _mm512_cmp_ps_mask(length_squared, _mm512_setzero_ps(), _CMP_GT_OQ);
+    x = _mm512_mask_mul_ps(x, mask, x, inverse_length);
+    y = _mm512_mask_mul_ps(y, mask, y, inverse_length);
+    z = _mm512_mask_mul_ps(z, mask, z, inverse_length);
+}
+
+STAGE_TARGET("avx512f") void
+transformAVX512(uint8_t* data, size_t count, size_t stride, const float* m, bool normalize) {
+    __m512 c[12];
+    for (size_t k = 0; k < 12; k++) {
+        c[k] = _mm512_set1_ps(m[k]);
+    }
+    __m512i offsets = offsetsAVX512(stride);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8_t* block = data + i * stride;
+        __m512 x, y, z;
+        loadAVX512(block, offsets, x, y, z);
+        __m512 rx = _mm512_fmadd_ps(c[6], z, _mm512_fmadd_ps(c[3], y, _mm512_fmadd_ps(c[0], x, c[9])));
+        __m512 ry = _mm512_fmadd_ps(c[7], z, _mm512_fmadd_ps(c[4], y, _mm512_fmadd_ps(c[1], x, c[10])));
+        __m512 rz = _mm512_fmadd_ps(c[8], z, _mm512_fmadd_ps(c[5], y, _mm512_fmadd_ps(c[2], x, c[11])));
+        if (normalize)
+            normalizeAVX512(rx, ry, rz);
+        storeAVX512(block, offsets, rx, ry, rz);
+    }
+    transformScalar(data + i * stride, count - i, stride, m, normalize);
+}
+
+STAGE_TARGET("avx512f") void
+normalizeVectorsAVX512(uint8_t* data, size_t count, size_t stride) {
+    __m512i offsets = offsetsAVX512(stride);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8_t* block = data + i * stride;
+        __m512 x, y, z;
+        loadAVX512(block, offsets, x, y, z);
+        normalizeAVX512(x, y, z);
+        storeAVX512(block, offsets, x, y, z);
+    }
+    normalizeVectorsScalar(data + i * stride, count - i, stride);
+}
+
+STAGE_TARGET("avx512f") void
+boundsAVX512(const uint8_t* data, size_t count, size_t stride, float* lower, float* upper) {
+    __m512 lx = _mm512_set1_ps(lower[0]), ly = _mm512_set1_ps(lower[1]), lz = _mm512_set1_ps(lower[2]);
+    __m512 ux = _mm512_set1_ps(upper[0]), uy = _mm512_set1_ps(upper[1]), uz = _mm512_set1_ps(upper[2]);
+    __m512i offsets = offsetsAVX512(stride);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512 x, y, z;
+        loadAVX512(data + i * stride, offsets, x, y, z);
+        lx = minAVX512(lx, x); ly = minAVX512(ly, y); lz = minAVX512(lz, z);
+        ux = maxAVX512(ux, x); uy = maxAVX512(uy, y); uz = maxAVX512(uz, z);
+    }
+    alignas(64) float lanes[6][16];
+    _mm512_store_ps(lanes[0], lx); _mm512_store_ps(lanes[1], ly); _mm512_store_ps(lanes[2], lz);
+    _mm512_store_ps(lanes[3], ux); _mm512_store_ps(lanes[4], uy); _mm512_store_ps(lanes[5], uz);
+    for (size_t k = 0; k < 16; k++) {
+        for (size_t axis = 0; axis < 3; axis++) {
+            lower[axis] = std::min(lower[axis], lanes[axis][k]);
+            upper[axis] = std::max(upper[axis], lanes[3 + axis][k]);
+        }
+    }
+    boundsScalar(data + i * stride, count - i, stride, lower, upper);
+}
+
+constexpr Kernels sse42_kernels = { transformSSE42, normalizeVectorsSSE42, boundsSSE42 };
+constexpr Kernels avx2_kernels = { transformAVX2, normalizeVectorsAVX2, boundsAVX2 };
+constexpr Kernels avx512_kernels = { transformAVX512, normalizeVectorsAVX512, boundsAVX512 };
+
+SIMDLevel
+detectSIMDLevel() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    __cpuid(info, 1);
+    bool sse42 = info[2] & (1 << 20);
+    bool fma = info[2] & (1 << 12);
+    bool osxsave = info[2] & (1 << 27);
+    // The OS has to save the YMM and ZMM registers on context switches as well
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool avx2 = false, avx512f = false;
+    if (max_leaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = info[1] & (1 << 5);
+        avx512f = info[1] & (1 << 16);
+    }
+    if (avx512f && (xcr0 & 0xe6) == 0xe6)
+        return SIMDLevel_AVX512;
+    if (avx2 && fma && (xcr0 & 0x6) == 0x6)
+        return SIMDLevel_AVX2;
+    if (sse42)
+        return SIMDLevel_SSE42;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SIMDLevel_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return SIMDLevel_AVX2;
+    if (__builtin_cpu_supports("sse4.2"))
+        return SIMDLevel_SSE42;
+#endif
+    return SIMDLevel_Scalar;
+}
+
+#else
+
+SIMDLevel
+detectSIMDLevel() {
+    return SIMDLevel_Scalar;
+}
+
+#endif
+
+std::atomic<int> active_level { -1 };
+
+/* Gathers address whole floats, views with other strides always use the scalar kernels */
+const Kernels&
+selectKernels(size_t stride) {
+    if (stride % sizeof(float) != 0)
+        return scalar_kernels;
+    switch (activeSIMDLevel()) {
+#ifdef STAGE_SIMD_X86
+    case SIMDLevel_AVX512: return avx512_kernels;
+    case SIMDLevel_AVX2: return avx2_kernels;
+    case SIMDLevel_SSE42: return sse42_kernels;
+#endif
+    default: return scalar_kernels;
+    }
+}
+
+void
+packMatrix(const stage_mat4f& m, float* packed) {
+    for (size_t column = 0; column < 4; column++) {
+        for (size_t row = 0; row < 3; row++) {
+            packed[3 * column + row] = m.c[column][row];
+        }
+    }
+}
+
+}
+
+SIMDLevel
+supportedSIMDLevel() {
+    static const SIMDLevel level = detectSIMDLevel();
+    return level;
+}
+
+SIMDLevel
+activeSIMDLevel() {
+    int level = active_level.load(std::memory_order_relaxed);
+    return level < 0 ? supportedSIMDLevel() : SIMDLevel(level);
+}
+
+void
+setSIMDLevel(SIMDLevel level) {
+    active_level.store(std::min(level, supportedSIMDLevel()), std::memory_order_relaxed);
+}
+
+const char*
+simdLevelName(SIMDLevel level) {
+    switch (level) {
+    case SIMDLevel_SSE42: return "SSE4.2";
+    case SIMDLevel_AVX2: return "AVX2";
+    case SIMDLevel_AVX512: return "AVX-512";
+    default: return "Scalar";
+    }
+}
+
+void
+transformPositions(BufferView<stage_vec3f>& positions, const stage_mat4f& m) {
+    float packed[12];
+    packMatrix(m, packed);
+    selectKernels(positions.stride()).transform(positions.data(), positions.size(), positions.stride(), packed, false);
+}
+
+void
+transformNormals(BufferView<stage_vec3f>& normals, const stage_mat4f& m) {
+    // The columns of the inverse transpose are the cross products of the other two columns divided by the determinant.
+    // The vectors are renormalized anyway, so only the sign of the determinant matters.
+    stage_vec3f c0(m.c[0]), c1(m.c[1]), c2(m.c[2]);
+    stage_vec3f n0 = cross(c1, c2), n1 = cross(c2, c0), n2 = cross(c0, c1);
+    float determinant = c0.x * n0.x + c0.y * n0.y + c0.z * n0.z;
+    stage_vec3f sign(determinant < 0.f ? -1.f : 1.f);
+    stage_mat4f inverse_transpose(stage_vec4f(n0 * sign, 0.f), stage_vec4f(n1 * sign, 0.f), stage_vec4f(n2 * sign, 0.f), stage_vec4f(0.f, 0.f, 0.f, 1.f));
+
+    float packed[12];
+    packMatrix(inverse_transpose, packed);
+    selectKernels(normals.stride()).transform(normals.data(), normals.size(), normals.stride(), packed, true);
+}
+
+void
+normalizeVectors(BufferView<stage_vec3f>& vectors) {
+    selectKernels(vectors.stride()).normalize(vectors.data(), vectors.size(), vectors.stride());
+}
+
+AABB
+computeBounds(const BufferView<stage_vec3f>& positions) {
+    AABB bounds;
+    if (positions.size() == 0)
+        return bounds;
+    selectKernels(positions.stride()).bounds(positions.data(), positions.size(), positions.stride(), bounds.lower.v, bounds.upper.v);
+    return bounds;
+}
+
+}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include "math.h"
+#include "buffer.h"
+#include "mesh.h"
+
+namespace stage {
+namespace backstage {
+
+/*
+ * Batched math over strided vertex data.
+ * Every kernel has a scalar implementation and SSE4.2, AVX2 and AVX-512 implementations on x86, the fastest one the CPU supports
+ * is picked at runtime. The SIMD paths process the data in blocks of 4, 8 or 16 vectors and use gathers (and scatters with
+ * AVX-512) so that they work on interleaved and blocked layouts alike. Results may differ from the scalar path by rounding.
+ */
+enum SIMDLevel {
+    SIMDLevel_Scalar    = 0,
+    SIMDLevel_SSE42     = 1,
+    SIMDLevel_AVX2      = 2,    // Includes FMA
+    SIMDLevel_AVX512    = 3,    // AVX-512F
+};
+
+/* Highest level supported by both the build and the CPU */
+SIMDLevel supportedSIMDLevel();
+
+/* Level used by the kernels, defaults to supportedSIMDLevel() */
+SIMDLevel activeSIMDLevel();
+
+/* Overrides the level used by the kernels, e.g. for benchmarks. Levels above supportedSIMDLevel() are clamped. */
+void setSIMDLevel(SIMDLevel level);
+
+const char* simdLevelName(SIMDLevel level);
+
+/* Transforms `positions` in place as points by `m` */
+void transformPositions(BufferView<stage_vec3f>& positions, const stage_mat4f& m);
+
+/* Transforms `normals` in place by the inverse transpose of the upper 3x3 part of `m` and renormalizes them */
+void transformNormals(BufferView<stage_vec3f>& normals, const stage_mat4f& m);
+
+/* Normalizes `vectors` in place, zero vectors are left unchanged */
+void normalizeVectors(BufferView<stage_vec3f>& vectors);
+
+AABB computeBounds(const BufferView<stage_vec3f>& positions);
+
+}
+}
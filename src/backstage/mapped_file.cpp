@@ -0,0 +1,91 @@
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "log.h"
+
+namespace stage {
+namespace backstage {
+
+#if defined(_WIN32)
+MappedFile::MappedFile(std::string filename) {
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        ERR("Unable to open file '" + filename + "'");
+        return;
+    }
+    m_file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        ERR("Unable to read size of file '" + filename + "'");
+        return;
+    }
+    m_size = size_t(size.QuadPart);
+    if (m_size == 0) {
+        m_is_valid = true;
+        return;
+    }
+
+    m_mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (m_mapping == nullptr) {
+        ERR("Unable to map file '" + filename + "'");
+        return;
+    }
+    m_data = (uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_COPY, 0, 0, m_size);
+    m_is_valid = m_data != nullptr;
+    if (!m_is_valid) ERR("Unable to map file '" + filename + "'");
+}
+
+MappedFile::~MappedFile() {
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_mapping) CloseHandle(m_mapping);
+    if (m_file) CloseHandle(m_file);
+}
+#else
+MappedFile::MappedFile(std::string filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        ERR("Unable to open file '" + filename + "'");
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ERR("Unable to read size of file '" + filename + "'");
+        close(fd);
+        return;
+    }
+    m_size = size_t(st.st_size);
+    if (m_size == 0) {
+        m_is_valid = true;
+        close(fd);
+        return;
+    }
+
+    void* data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        ERR("Unable to map file '" + filename + "'");
+        return;
+    }
+    m_data = (uint8_t*)data;
+    m_is_valid = true;
+}
+
+MappedFile::~MappedFile() {
+    if (m_data) munmap(m_data, m_size);
+}
+#endif
+
+}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace stage {
+namespace backstage {
+
+/* 
+ * Read-only view of a file mapped into memory.
+ * The mapping is private, writes to data() are visible to this process only and never reach the file.
+ */
+struct MappedFile {
+    MappedFile(std::string filename);
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+    ~MappedFile();
+
+    uint8_t* data() { return m_data; }
+    size_t size() { return m_size; }
+
+    bool isValid() { return m_is_valid; }
+
+private:
+    uint8_t* m_data { nullptr };
+    size_t m_size { 0 };
+    bool m_is_valid { false };
+
+#if defined(_WIN32)
+    void* m_file { nullptr };
+    void* m_mapping { nullptr };
+#endif
+};
+
+}
+}
@@ -143,28 +143,31 @@ typedef stage_vec3<float>       stage_vec3f;
 typedef stage_vec3<uint32_t>    stage_vec3i;
 typedef stage_vec2<float>       stage_vec2f;
 typedef stage_vec2<uint32_t>    stage_vec2i;
+typedef stage_vec3<uint16_t>    stage_vec3us;
+typedef stage_vec2<uint16_t>    stage_vec2us;
+typedef stage_vec2<int16_t>     stage_vec2s;
 
 typedef stage_mat4<float>       stage_mat4f;
 
 /* Common vector and Matrix Functions */
 
 template<typename T> stage_vec2<T>
-make_vec2(T* value_ptr) {
+make_vec2(const T* value_ptr) {
     return stage_vec2<T>(value_ptr[0], value_ptr[1]);
 }
 
 template<typename T> stage_vec3<T>
-make_vec3(T* value_ptr) {
+make_vec3(const T* value_ptr) {
     return stage_vec3<T>(value_ptr[0], value_ptr[1], value_ptr[2]);
 }
 
 template<typename T> stage_vec4<T>
-make_vec4(T* value_ptr) {
+make_vec4(const T* value_ptr) {
     return stage_vec4<T>(value_ptr[0], value_ptr[1], value_ptr[2], value_ptr[3]);
 }
 
 template<typename T> stage_mat4<T>
-make_mat4(T* value_ptr) {
+make_mat4(const T* value_ptr) {
     stage_mat4<T> mat;
     for (size_t i = 0; i < 16; i++) mat.v[i] = value_ptr[i]; 
     return mat;
@@ -191,6 +194,16 @@ cross(const stage_vec3<T>& a, const stage_vec3<T>& b) {
     return stage_vec3<T>(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
 }
 
+template<typename T> stage_vec3<T>
+min(const stage_vec3<T>& a, const stage_vec3<T>& b) {
+    return stage_vec3<T>(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z));
+}
+
+template<typename T> stage_vec3<T>
+max(const stage_vec3<T>& a, const stage_vec3<T>& b) {
+    return stage_vec3<T>(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z));
+}
+
 template<typename T> T
 compMax(const stage_vec3<T>& v) {
     T max = v.x > v.y ? v.x : v.y;
@@ -203,9 +216,11 @@ compMin(const stage_vec3<T>& v) {
     return min < v.z ? min : v.z;
 }
 
+/* Size of T rounded up to the next multiple of `alignment` */
 template<typename T> size_t
 sizeofAligned(size_t alignment) {
-    return sizeof(T) + (sizeof(T) % alignment);
+    if (alignment == 0) return sizeof(T);
+    return (sizeof(T) + alignment - 1) / alignment * alignment;
 }
 
 }
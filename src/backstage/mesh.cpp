@@ -1,81 +1,197 @@
 #include "mesh.h"
+#include "kernels.h"
+
+#include <algorithm>
 
 namespace stage {
 namespace backstage {
 
-Geometry::Geometry(Object& parent, std::vector<stage_vec3f> positions, std::vector<stage_vec3f> normals, std::vector<stage_vec2f> uvs, std::vector<uint32_t> material_ids, std::vector<uint32_t> indices) {
-    this->indices = indices;
-    VertexLayout layout = parent.layout();
+namespace {
 
-    size_t stride_positions, stride_normals, stride_uvs, stride_material_ids;
-    stride_positions = stride_normals = stride_uvs = stride_material_ids = 0;
+struct GeometryLayout {
+    size_t stride_positions { 0 }, stride_normals { 0 }, stride_uvs { 0 }, stride_material_ids { 0 };
+    size_t offset_positions { 0 }, offset_normals { 0 }, offset_uvs { 0 }, offset_material_ids { 0 };
+    size_t size_in_bytes { 0 };
+};
 
-    size_t offset_positions, offset_normals, offset_uvs, offset_material_ids;
-    offset_positions = offset_normals = offset_uvs = offset_material_ids = 0;
+/* Computes where the attributes of a geometry with `num_vertices` vertices are placed relative to its start */
+GeometryLayout
+computeGeometryLayout(VertexLayout layout, size_t alignment, size_t num_vertices, size_t num_normals, size_t num_uvs) {
+    GeometryLayout l;
 
-    switch (layout)
+    size_t size_position = (layout & VertexLayout_Compressed_V) ? sizeofAligned<stage_vec3us>(alignment) : sizeofAligned<stage_vec3f>(alignment);
+    size_t size_normal = (layout & VertexLayout_Compressed_N) ? sizeofAligned<stage_vec2s>(alignment) : sizeofAligned<stage_vec3f>(alignment);
+    size_t size_uv = (layout & VertexLayout_Compressed_T) ? sizeofAligned<stage_vec2us>(alignment) : sizeofAligned<stage_vec2f>(alignment);
+    size_t size_material_id = sizeofAligned<uint32_t>(alignment);
+
+    switch (layout & ~(VertexLayout_Compressed_V | VertexLayout_Compressed_N | VertexLayout_Compressed_T))
     {
     case VertexLayout_Block_V:
-        stride_positions = sizeofAligned<stage_vec3f>(parent.alignment());
-        offset_positions = 0;
-        stride_material_ids = sizeofAligned<uint32_t>(parent.alignment());
-        offset_material_ids = positions.size() * stride_positions;
+        l.stride_positions = size_position;
+        l.offset_positions = 0;
+        l.stride_material_ids = size_material_id;
+        l.offset_material_ids = num_vertices * l.stride_positions;
+        l.size_in_bytes = l.offset_material_ids + num_vertices * l.stride_material_ids;
         break;
     case VertexLayout_Block_VN:
-        stride_positions = sizeofAligned<stage_vec3f>(parent.alignment());
-        offset_positions = 0;
-        stride_normals = sizeofAligned<stage_vec3f>(parent.alignment());
-        offset_normals = positions.size() * stride_positions;
-        stride_material_ids = sizeofAligned<uint32_t>(parent.alignment());
-        offset_material_ids = offset_normals + normals.size() * stride_normals;
+        l.stride_positions = size_position;
+        l.offset_positions = 0;
+        l.stride_normals = size_normal;
+        l.offset_normals = num_vertices * l.stride_positions;
+        l.stride_material_ids = size_material_id;
+        l.offset_material_ids = l.offset_normals + num_normals * l.stride_normals;
+        l.size_in_bytes = l.offset_material_ids + num_vertices * l.stride_material_ids;
         break;
     case VertexLayout_Block_VNT:
-        stride_positions = sizeofAligned<stage_vec3f>(parent.alignment());
-        offset_positions = 0;
-        stride_normals = sizeofAligned<stage_vec3f>(parent.alignment());
-        offset_normals = positions.size() * stride_positions;
-        stride_uvs = sizeofAligned<stage_vec2f>(parent.alignment());
-        offset_uvs = offset_normals + normals.size() * stride_normals;
-        stride_material_ids = sizeofAligned<uint32_t>(parent.alignment());
-        offset_material_ids = offset_uvs + uvs.size() * stride_uvs;
+        l.stride_positions = size_position;
+        l.offset_positions = 0;
+        l.stride_normals = size_normal;
+        l.offset_normals = num_vertices * l.stride_positions;
+        l.stride_uvs = size_uv;
+        l.offset_uvs = l.offset_normals + num_normals * l.stride_normals;
+        l.stride_material_ids = size_material_id;
+        l.offset_material_ids = l.offset_uvs + num_uvs * l.stride_uvs;
+        l.size_in_bytes = l.offset_material_ids + num_vertices * l.stride_material_ids;
         break;
     case VertexLayout_Interleaved_V:
-        offset_positions = 0;
-        offset_material_ids = sizeofAligned<stage_vec3f>(parent.alignment());
-        stride_positions = stride_material_ids = sizeofAligned<stage_vec3f>(parent.alignment()) + sizeofAligned<uint32_t>(parent.alignment());
+        l.offset_positions = 0;
+        l.offset_material_ids = size_position;
+        l.stride_positions = l.stride_material_ids = size_position + size_material_id;
+        l.size_in_bytes = num_vertices * l.stride_positions;
         break;
     case VertexLayout_Interleaved_VN:
-        offset_positions = 0;
-        offset_normals = sizeofAligned<stage_vec3f>(parent.alignment());
-        offset_material_ids = offset_normals + sizeofAligned<stage_vec3f>(parent.alignment());
-        stride_positions = stride_normals = stride_material_ids = 2 * sizeofAligned<stage_vec3f>(parent.alignment()) + sizeofAligned<uint32_t>(parent.alignment());
+        l.offset_positions = 0;
+        l.offset_normals = size_position;
+        l.offset_material_ids = l.offset_normals + size_normal;
+        l.stride_positions = l.stride_normals = l.stride_material_ids = size_position + size_normal + size_material_id;
+        l.size_in_bytes = num_vertices * l.stride_positions;
         break;
     case VertexLayout_Interleaved_VNT:
-        offset_positions = 0;
-        offset_normals = sizeofAligned<stage_vec3f>(parent.alignment());
-        offset_uvs = offset_normals + sizeofAligned<stage_vec3f>(parent.alignment());
-        offset_material_ids = offset_uvs + sizeofAligned<stage_vec2f>(parent.alignment());
-        stride_positions = stride_normals = stride_uvs = stride_material_ids = 2 * sizeofAligned<stage_vec3f>(parent.alignment()) + sizeofAligned<stage_vec2f>(parent.alignment()) + sizeofAligned<uint32_t>(parent.alignment());
+        l.offset_positions = 0;
+        l.offset_normals = size_position;
+        l.offset_uvs = l.offset_normals + size_normal;
+        l.offset_material_ids = l.offset_uvs + size_uv;
+        l.stride_positions = l.stride_normals = l.stride_uvs = l.stride_material_ids = size_position + size_normal + size_uv + size_material_id;
+        l.size_in_bytes = num_vertices * l.stride_positions;
         break;
     default:
         break;
     }
+    return l;
+}
+
+/* Lays out `num_vertices` vertices in the parent's layout at the end of its buffer and grows the buffer to fit them */
+void
+reserveGeometry(Object& parent, Geometry& geometry, size_t num_vertices, size_t num_normals, size_t num_uvs) {
+    VertexLayout layout = parent.layout();
+    GeometryLayout l = computeGeometryLayout(layout, parent.alignment(), num_vertices, num_normals, num_uvs);
+
+    if (layout & VertexLayout_Compressed_V)
+        geometry.quantized_positions.setBuffer(parent.data, l.offset_positions, num_vertices, l.stride_positions, parent.alignment());
+    else
+        geometry.positions.setBuffer(parent.data, l.offset_positions, num_vertices, l.stride_positions, parent.alignment());
+    if (layout & (VertexLayout_Block_VN | VertexLayout_Interleaved_VN | VertexLayout_Block_VNT | VertexLayout_Interleaved_VNT)) {
+        if (layout & VertexLayout_Compressed_N)
+            geometry.octahedral_normals.setBuffer(parent.data, l.offset_normals, num_normals, l.stride_normals, parent.alignment());
+        else
+            geometry.normals.setBuffer(parent.data, l.offset_normals, num_normals, l.stride_normals, parent.alignment());
+    }
+    if (layout & (VertexLayout_Block_VNT | VertexLayout_Interleaved_VNT)) {
+        if (layout & VertexLayout_Compressed_T)
+            geometry.half_uvs.setBuffer(parent.data, l.offset_uvs, num_uvs, l.stride_uvs, parent.alignment());
+        else
+            geometry.uvs.setBuffer(parent.data, l.offset_uvs, num_uvs, l.stride_uvs, parent.alignment());
+    }
+    geometry.material_ids.setBuffer(parent.data, l.offset_material_ids, num_vertices, l.stride_material_ids, parent.alignment());
+
+    if (l.size_in_bytes > 0)
+        parent.data->resize(parent.data->size() + l.size_in_bytes);
+}
+
+/* Sets the dequantization constants of `geometry` from the bounds of `positions` and writes the quantized positions */
+void
+quantizePositions(Geometry& geometry, const stage_vec3f* positions, size_t count) {
+    if (count == 0) return;
+    stage_vec3f lo = positions[0], hi = positions[0];
+    for (size_t i = 1; i < count; i++) {
+        lo = min(lo, positions[i]);
+        hi = max(hi, positions[i]);
+    }
+    geometry.position_offset = lo;
+    geometry.position_scale = positionScale(lo, hi);
+    for (size_t i = 0; i < count; i++) {
+        geometry.quantized_positions[i] = quantizePosition(positions[i], geometry.position_offset, geometry.position_scale);
+    }
+}
+
+}
+
+Geometry::Geometry(Object& parent, std::vector<stage_vec3f> positions, std::vector<stage_vec3f> normals, std::vector<stage_vec2f> uvs, std::vector<uint32_t> material_ids, std::vector<uint32_t> indices) {
+    this->indices = std::move(indices);
+    reserveGeometry(parent, *this, positions.size(), normals.size(), uvs.size());
+
+    this->positions.write(0, positions.data(), this->positions.size());
+    this->normals.write(0, normals.data(), this->normals.size());
+    this->uvs.write(0, uvs.data(), this->uvs.size());
+    this->material_ids.write(0, material_ids.data(), std::min(material_ids.size(), this->material_ids.size()));
+
+    quantizePositions(*this, positions.data(), this->quantized_positions.size());
+    for (size_t i = 0; i < this->octahedral_normals.size(); i++) {
+        this->octahedral_normals[i] = encodeOctahedral(normals[i]);
+    }
+    for (size_t i = 0; i < this->half_uvs.size(); i++) {
+        this->half_uvs[i] = encodeHalf(uvs[i]);
+    }
+    updateBounds();
+}
+
+void
+Geometry::compactIndices() {
+    if (indices.empty() || numVertices() > 65536)
+        return;
+    indices16.assign(indices.begin(), indices.end());
+    std::vector<uint32_t>().swap(indices);
+}
 
-    this->positions.setBuffer(parent.data, offset_positions, 0, stride_positions, parent.alignment());
-    if (layout & (VertexLayout_Block_VN | VertexLayout_Interleaved_VN | VertexLayout_Block_VNT | VertexLayout_Interleaved_VNT))
-        this->normals.setBuffer(parent.data, offset_normals, 0, stride_normals, parent.alignment());
-    if (layout & (VertexLayout_Block_VNT | VertexLayout_Interleaved_VNT))
-        this->uvs.setBuffer(parent.data, offset_uvs, 0, stride_uvs, parent.alignment());
-    this->material_ids.setBuffer(parent.data, offset_material_ids, 0, stride_material_ids, parent.alignment());
-
-    this->positions.push_back(positions);
-    if (layout & (VertexLayout_Block_VN | VertexLayout_Interleaved_VN | VertexLayout_Block_VNT | VertexLayout_Interleaved_VNT))
-        this->normals.push_back(normals);
-    if (layout & (VertexLayout_Block_VNT | VertexLayout_Interleaved_VNT))
-        this->uvs.push_back(uvs);
-    this->material_ids.push_back(material_ids);
+/* Bounds of the decoded positions, so that they also enclose quantized positions exactly */
+void
+Geometry::updateBounds() {
+    if (positions.isValid()) {
+        bounds = computeBounds(positions);
+        return;
+    }
+    bounds = AABB();
+    for (size_t vertex = 0; vertex < numVertices(); vertex++) {
+        bounds.extend(getPosition(vertex));
+    }
 }
 
-Object::Object(VertexLayout layout, size_t alignment) : m_layout(layout), m_alignment(alignment), data(std::make_shared<Buffer>()) {}
+GeometryBuilder::GeometryBuilder(Object& parent, size_t num_vertices, bool has_uvs) : m_buffer(parent.data) {
+    reserveGeometry(parent, m_geometry, num_vertices, num_vertices, has_uvs ? num_vertices : 0);
+    m_positions.resize(m_geometry.quantized_positions.size());
+}
+
+Geometry
+GeometryBuilder::build() {
+    quantizePositions(m_geometry, m_positions.data(), m_positions.size());
+    std::vector<stage_vec3f>().swap(m_positions);
+    m_geometry.updateBounds();
+    return std::move(m_geometry);
+}
+
+Object::Object(VertexLayout layout, size_t alignment, std::shared_ptr<Allocator> allocator) : m_layout(layout), m_alignment(alignment), data(std::make_shared<Buffer>(allocator, alignment)) {}
+
+void
+Object::updateBounds() {
+    bounds = AABB();
+    for (auto& geometry : geometries) {
+        bounds.extend(geometry.bounds);
+    }
+}
+
+size_t
+Object::geometrySizeInBytes(size_t num_vertices, bool has_uvs) {
+    return computeGeometryLayout(m_layout, m_alignment, num_vertices, num_vertices, has_uvs ? num_vertices : 0).size_in_bytes;
+}
 }
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <vector>
 #include "math.h"
 #include "buffer.h"
+#include "quantization.h"
 
 namespace stage {
 namespace backstage {
@@ -15,34 +16,167 @@ enum VertexLayout {
     VertexLayout_Block_VNT       = 0x008,
     VertexLayout_Block_VN        = 0x010,
     VertexLayout_Block_V         = 0x020,
+
+    // Flags that can be combined with any of the layouts above to store attributes in compressed form
+    VertexLayout_Compressed_N    = 0x100,   // Octahedral encoded normals, two snorm16 values
+    VertexLayout_Compressed_T    = 0x200,   // Half float UVs
+    VertexLayout_Compressed_V    = 0x400,   // Positions as three unorm16 values relative to the geometry's bounds
+};
+
+enum IndexFormat {
+    IndexFormat_UInt32      = 0,    // Every geometry uses 32 bit indices
+    IndexFormat_Adaptive    = 1,    // Geometries with at most 65536 vertices use 16 bit indices
+};
+
+inline VertexLayout
+operator|(VertexLayout a, VertexLayout b) {
+    return VertexLayout(uint32_t(a) | uint32_t(b));
+}
+
+/*
+ * A cluster of triangles with a bounded number of vertices, see Config::build_meshlets.
+ * Its vertices are `meshlet_vertices[vertex_offset, vertex_offset + vertex_count)` and each of its triangles are three bytes in 
+ * `meshlet_triangles` starting at `3 * triangle_offset` that index into those vertices.
+ * All triangle normals lie within acos(cone_cutoff) of `cone_axis`, a cone_cutoff of 0 or less means the cluster cannot be backface culled.
+ */
+struct Meshlet {
+    uint32_t vertex_offset;
+    uint32_t triangle_offset;
+    uint32_t vertex_count;
+    uint32_t triangle_count;
+    stage_vec3f center;
+    float radius;
+    stage_vec3f cone_axis;
+    float cone_cutoff;
+};
+
+/* An axis aligned bounding box, default constructed boxes are empty */
+struct AABB {
+    stage_vec3f lower { 1e30f };
+    stage_vec3f upper { -1e30f };
+
+    bool isEmpty() const { return lower.x > upper.x || lower.y > upper.y || lower.z > upper.z; }
+    void extend(const stage_vec3f& p) { lower = min(lower, p); upper = max(upper, p); }
+    void extend(const AABB& b) { lower = min(lower, b.lower); upper = max(upper, b.upper); }
+
+    /* Bounds of the eight corners transformed by `m`, empty boxes stay empty */
+    AABB transform(const stage_mat4f& m) const {
+        AABB result;
+        if (isEmpty()) return result;
+        for (uint32_t corner = 0; corner < 8; corner++) {
+            stage_vec3f p (corner & 1 ? upper.x : lower.x, corner & 2 ? upper.y : lower.y, corner & 4 ? upper.z : lower.z);
+            result.extend(stage_vec3f(m * stage_vec4f(p, 1.f)));
+        }
+        return result;
+    }
 };
 
 struct Object;
 struct Geometry {
+    Geometry() = default;
     Geometry(Object& parent, std::vector<stage_vec3f> positions, std::vector<stage_vec3f> normals, std::vector<stage_vec2f> uvs, std::vector<uint32_t> material_ids, std::vector<uint32_t> indices);
 
-    std::vector<uint32_t> indices;
+    std::vector<uint32_t> indices;      // Empty if the geometry uses 16 bit indices
+    std::vector<uint16_t> indices16;    // Only used after compactIndices()
     BufferView<stage_vec3f> positions;
     BufferView<stage_vec3f> normals;
     BufferView<stage_vec2f> uvs;
     BufferView<uint32_t> material_ids;
+
+    /* 
+     * Compressed attributes, these replace the views above in layouts with the matching VertexLayout_Compressed_* flag.
+     * Quantized positions decode to `position_offset + position_scale * q`.
+     */
+    BufferView<stage_vec3us> quantized_positions;
+    BufferView<stage_vec2s> octahedral_normals;
+    BufferView<stage_vec2us> half_uvs;
+    stage_vec3f position_offset { 0.f };
+    stage_vec3f position_scale { 0.f };
+    AABB bounds;                        // Object space bounds of the positions, set when the geometry is built
+
+    /* Meshlets and their local index lists, stored after the vertex data in the object's buffer. Empty unless meshlets were built. */
+    BufferView<Meshlet> meshlets;
+    BufferView<uint32_t> meshlet_vertices;
+    BufferView<uint8_t> meshlet_triangles;
+
+    /* Moves the indices to `indices16` if every vertex can be addressed with 16 bits */
+    void compactIndices();
+    void updateBounds();
+    size_t indexSize() const { return indices16.empty() ? sizeof(uint32_t) : sizeof(uint16_t); }
+    size_t numIndices() const { return indices.size() + indices16.size(); }
+    uint32_t getIndex(size_t i) const { return indices16.empty() ? indices[i] : indices16[i]; }
+
+    /* Attribute access independent of the layout, compressed attributes are decoded */
+    size_t numVertices() const { return material_ids.size(); }
+    size_t numNormals() const { return normals.size() + octahedral_normals.size(); }
+    size_t numUVs() const { return uvs.size() + half_uvs.size(); }
+    stage_vec3f getPosition(size_t vertex) const { 
+        return positions.isValid() ? positions[vertex] : dequantizePosition(quantized_positions[vertex], position_offset, position_scale); 
+    }
+    stage_vec3f getNormal(size_t vertex) const { return normals.isValid() ? normals[vertex] : decodeOctahedral(octahedral_normals[vertex]); }
+    stage_vec2f getUV(size_t vertex) const { return uvs.isValid() ? uvs[vertex] : decodeHalf(half_uvs[vertex]); }
 };
 
 struct Object {
-    Object(VertexLayout layout, size_t alignment);
+    Object(VertexLayout layout, size_t alignment, std::shared_ptr<Allocator> allocator = nullptr);
     std::shared_ptr<Buffer> data;
     std::vector<Geometry> geometries;
+    AABB bounds;                        // Union of the bounds of all geometries, set when the object is added to the scene
 
     VertexLayout layout() { return m_layout; }
     size_t       alignment() { return m_alignment; }
+
+    void updateBounds();
+
+    /* Number of bytes a geometry with `num_vertices` vertices occupies in `data`, used to reserve the buffer up front */
+    size_t geometrySizeInBytes(size_t num_vertices, bool has_uvs = true);
 private:
     VertexLayout m_layout;
     size_t m_alignment;
 };
 
+/*
+ * Builds a Geometry directly in its final location in the object's buffer.
+ * The constructor reserves the region for `num_vertices` vertices in the object's layout, the loader then writes each attribute 
+ * once through the setters. Setters for attributes that are not part of the layout are ignored. Compressed attributes are
+ * encoded as they are set, except for quantized positions which are encoded in build() once the bounds are known.
+ * Every builder resizes the buffer when it is created, so all builders for an object have to be created before any of them is 
+ * written to. After that, builders for distinct geometries may be filled concurrently.
+ */
+struct GeometryBuilder {
+    GeometryBuilder(Object& parent, size_t num_vertices, bool has_uvs = true);
+
+    void setPosition(size_t vertex, const stage_vec3f& position) { 
+        if (m_geometry.positions.isValid()) m_geometry.positions[vertex] = position;
+        else m_positions[vertex] = position;
+    }
+    void setNormal(size_t vertex, const stage_vec3f& normal) { 
+        if (m_geometry.normals.size() > 0) m_geometry.normals[vertex] = normal; 
+        else if (m_geometry.octahedral_normals.size() > 0) m_geometry.octahedral_normals[vertex] = encodeOctahedral(normal);
+    }
+    void setUV(size_t vertex, const stage_vec2f& uv) { 
+        if (m_geometry.uvs.size() > 0) m_geometry.uvs[vertex] = uv; 
+        else if (m_geometry.half_uvs.size() > 0) m_geometry.half_uvs[vertex] = encodeHalf(uv);
+    }
+    void setMaterialId(size_t vertex, uint32_t material_id) { m_geometry.material_ids[vertex] = material_id; }
+
+    std::vector<uint32_t>& indices() { return m_geometry.indices; }
+    std::shared_ptr<Buffer> buffer() { return m_buffer; }
+
+    /* Returns the finished geometry, the builder must not be used afterwards */
+    Geometry build();
+
+private:
+    Geometry m_geometry;
+    std::shared_ptr<Buffer> m_buffer;
+    // Positions are only quantized once the bounds of the geometry are known
+    std::vector<stage_vec3f> m_positions;
+};
+
 struct ObjectInstance {
     stage_mat4f instance_to_world;
     uint32_t object_id;
+    AABB bounds;                        // World space bounds of the instanced object, set when the scene is finalized
 };
 
 }
@@ -0,0 +1,140 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace stage {
+namespace backstage {
+
+namespace {
+
+constexpr uint8_t unused_vertex = 0xff;
+
+/* Bounding sphere around the center of the vertices' bounding box and normal cone of the triangles of `meshlet` */
+void
+computeMeshletBounds(const Geometry& geometry, const MeshletData& data, Meshlet& meshlet) {
+    std::vector<stage_vec3f> positions(meshlet.vertex_count);
+    for (size_t i = 0; i < meshlet.vertex_count; i++) {
+        positions[i] = geometry.getPosition(data.vertices[meshlet.vertex_offset + i]);
+    }
+
+    stage_vec3f lo = positions[0], hi = positions[0];
+    for (auto& p : positions) {
+        lo = min(lo, p);
+        hi = max(hi, p);
+    }
+    meshlet.center = (lo + hi) * stage_vec3f(0.5f);
+    float radius_squared = 0.f;
+    for (auto& p : positions) {
+        stage_vec3f d = p - meshlet.center;
+        radius_squared = std::max(radius_squared, d.x * d.x + d.y * d.y + d.z * d.z);
+    }
+    meshlet.radius = std::sqrt(radius_squared);
+
+    std::vector<stage_vec3f> normals;
+    normals.reserve(meshlet.triangle_count);
+    stage_vec3f axis(0.f);
+    for (size_t i = 0; i < meshlet.triangle_count; i++) {
+        const uint8_t* triangle = &data.triangles[3 * (meshlet.triangle_offset + i)];
+        stage_vec3f n = cross(positions[triangle[1]] - positions[triangle[0]], positions[triangle[2]] - positions[triangle[0]]);
+        float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+        // Degenerate triangles are invisible and do not constrain the cone
+        if (length == 0.f)
+            continue;
+        normals.push_back(n * stage_vec3f(1.f / length));
+        axis = axis + normals.back();
+    }
+
+    float axis_length = std::sqrt(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+    if (normals.empty() || axis_length == 0.f) {
+        meshlet.cone_axis = stage_vec3f(0.f, 0.f, 1.f);
+        meshlet.cone_cutoff = -1.f;
+        return;
+    }
+    meshlet.cone_axis = axis * stage_vec3f(1.f / axis_length);
+    meshlet.cone_cutoff = 1.f;
+    for (auto& n : normals) {
+        meshlet.cone_cutoff = std::min(meshlet.cone_cutoff, n.x * meshlet.cone_axis.x + n.y * meshlet.cone_axis.y + n.z * meshlet.cone_axis.z);
+    }
+}
+
+template<typename T>
+void
+appendArray(Object& parent, BufferView<T>& view, std::vector<T>& elements) {
+    // Keep everything that follows in the buffer at the object's alignment
+    size_t alignment = std::max(parent.alignment(), alignof(T));
+    size_t size = parent.data->size();
+    parent.data->resize((size + alignment - 1) / alignment * alignment);
+    view.setBuffer(parent.data);
+    view.push_back(elements);
+}
+
+}
+
+MeshletData
+buildMeshlets(const Geometry& geometry, size_t max_vertices, size_t max_triangles) {
+    MeshletData data;
+    size_t num_vertices = geometry.numVertices();
+    size_t num_triangles = geometry.numIndices() / 3;
+    max_vertices = std::min<size_t>(std::max<size_t>(max_vertices, 3), 255);
+    max_triangles = std::max<size_t>(max_triangles, 1);
+    if (num_triangles == 0)
+        return data;
+
+    // Local index of every geometry vertex in the meshlet that is being filled
+    std::vector<uint8_t> local(num_vertices, unused_vertex);
+    Meshlet meshlet {};
+
+    auto flush = [&]() {
+        if (meshlet.triangle_count == 0)
+            return;
+        computeMeshletBounds(geometry, data, meshlet);
+        for (size_t i = 0; i < meshlet.vertex_count; i++) {
+            local[data.vertices[meshlet.vertex_offset + i]] = unused_vertex;
+        }
+        data.meshlets.push_back(meshlet);
+        meshlet = Meshlet {};
+        meshlet.vertex_offset = uint32_t(data.vertices.size());
+        meshlet.triangle_offset = uint32_t(data.triangles.size() / 3);
+    };
+
+    for (size_t triangle = 0; triangle < num_triangles; triangle++) {
+        uint32_t corners[3] = { geometry.getIndex(3 * triangle), geometry.getIndex(3 * triangle + 1), geometry.getIndex(3 * triangle + 2) };
+        if (corners[0] >= num_vertices || corners[1] >= num_vertices || corners[2] >= num_vertices)
+            continue;
+
+        size_t new_vertices = 0;
+        for (size_t k = 0; k < 3; k++) {
+            bool repeated = (k > 0 && corners[k] == corners[0]) || (k > 1 && corners[k] == corners[1]);
+            if (local[corners[k]] == unused_vertex && !repeated)
+                new_vertices++;
+        }
+        if (meshlet.vertex_count + new_vertices > max_vertices || meshlet.triangle_count + 1 > max_triangles)
+            flush();
+
+        for (size_t k = 0; k < 3; k++) {
+            uint32_t vertex = corners[k];
+            if (local[vertex] == unused_vertex) {
+                local[vertex] = uint8_t(meshlet.vertex_count++);
+                data.vertices.push_back(vertex);
+            }
+            data.triangles.push_back(local[vertex]);
+        }
+        meshlet.triangle_count++;
+    }
+    flush();
+
+    return data;
+}
+
+void
+storeMeshlets(Object& parent, Geometry& geometry, MeshletData& data) {
+    if (data.meshlets.empty())
+        return;
+    appendArray(parent, geometry.meshlets, data.meshlets);
+    appendArray(parent, geometry.meshlet_vertices, data.vertices);
+    appendArray(parent, geometry.meshlet_triangles, data.triangles);
+}
+
+}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "mesh.h"
+
+namespace stage {
+namespace backstage {
+
+/* Meshlets of a single geometry before they are stored in the object's buffer */
+struct MeshletData {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices;
+    std::vector<uint8_t> triangles;
+};
+
+/*
+ * Partitions the triangles of `geometry` into meshlets of at most `max_vertices` (up to 255) vertices and `max_triangles` triangles.
+ * Triangles are grouped in index order, so running the vertex cache optimization first yields tighter clusters.
+ */
+MeshletData buildMeshlets(const Geometry& geometry, size_t max_vertices, size_t max_triangles);
+
+/* Appends `data` to the end of the parent's buffer and points the meshlet views of `geometry` to it */
+void storeMeshlets(Object& parent, Geometry& geometry, MeshletData& data);
+
+}
+}
@@ -0,0 +1,586 @@
+#include "obj_parser.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+#include <tbb/tbb.h>
+
+#include <tiny_obj_loader.h>
+
+#include "mapped_file.h"
+#include "weld.h"
+
+namespace stage {
+namespace backstage {
+
+/* Parsing Primitives */
+
+static const double pow10_table[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool
+isSpace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static inline bool
+isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline void
+skipSpace(const char*& p, const char* end) {
+    while (p < end && isSpace(*p)) p++;
+}
+
+static inline bool
+parseInt(const char*& p, const char* end, int& value) {
+    skipSpace(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (p >= end || !isDigit(*p)) return false;
+
+    int64_t result = 0;
+    while (p < end && isDigit(*p)) {
+        result = result * 10 + (*p - '0');
+        if (result > INT32_MAX) return false;
+        p++;
+    }
+    value = int(negative ? -result : result);
+    return true;
+}
+
+/*
+ * Parses a decimal floating point number. Up to 19 significant digits are accumulated exactly as an integer,
+ * which is then scaled with a single double multiply or divide by a power of ten. This is not exact: the result can
+ * differ from strtod's correctly rounded double in the last bits, far below the precision of the float it is stored in.
+ * Anything else (inf, nan, hex floats) falls back to strtod.
+ */
+static inline bool
+parseFloat(const char*& p, const char* end, tinyobj::real_t& value) {
+    skipSpace(p, end);
+    const char* start = p;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int significant_digits = 0;
+    int exponent = 0;
+    bool has_digits = false;
+    while (p < end && isDigit(*p)) {
+        if (significant_digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) significant_digits++;
+        } else {
+            exponent++;
+        }
+        has_digits = true;
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && isDigit(*p)) {
+            if (significant_digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) significant_digits++;
+                exponent--;
+            }
+            has_digits = true;
+            p++;
+        }
+    }
+
+    if (!has_digits) {
+        // Fall back to the C library for special values
+        char token[64];
+        size_t length = 0;
+        p = start;
+        while (p + length < end && !isSpace(p[length]) && length < sizeof(token) - 1) {
+            token[length] = p[length];
+            length++;
+        }
+        token[length] = '\0';
+        char* token_end = nullptr;
+        double result = std::strtod(token, &token_end);
+        if (token_end == token) return false;
+        p += token_end - token;
+        value = tinyobj::real_t(result);
+        return true;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* e = p + 1;
+        bool exponent_negative = false;
+        if (e < end && (*e == '-' || *e == '+')) {
+            exponent_negative = *e == '-';
+            e++;
+        }
+        if (e < end && isDigit(*e)) {
+            int exponent_value = 0;
+            while (e < end && isDigit(*e)) {
+                if (exponent_value < 10000) exponent_value = exponent_value * 10 + (*e - '0');
+                e++;
+            }
+            exponent += exponent_negative ? -exponent_value : exponent_value;
+            p = e;
+        }
+    }
+
+    double result = double(mantissa);
+    if (exponent < 0) {
+        result = exponent >= -22 ? result / pow10_table[-exponent] : result * std::pow(10.0, exponent);
+    } else if (exponent > 0) {
+        result = exponent <= 22 ? result * pow10_table[exponent] : result * std::pow(10.0, exponent);
+    }
+    value = tinyobj::real_t(negative ? -result : result);
+    return true;
+}
+
+static inline std::string
+parseName(const char* p, const char* end) {
+    skipSpace(p, end);
+    while (end > p && isSpace(end[-1])) end--;
+    return std::string(p, end);
+}
+
+static inline bool
+startsWith(const char* p, const char* end, const char* keyword) {
+    size_t length = std::strlen(keyword);
+    return size_t(end - p) > length && std::memcmp(p, keyword, length) == 0 && isSpace(p[length]);
+}
+
+/* Chunk Parsing */
+
+static constexpr uint32_t inherited_smoothing_group = ~0u;
+
+struct ObjChunk {
+    std::vector<tinyobj::real_t> vertices;
+    std::vector<tinyobj::real_t> normals;
+    std::vector<tinyobj::real_t> texcoords;
+
+    // Three corners per triangle. Positive indices are zero based and global,
+    // relative indices are local to the chunk and fixed up once all chunks are parsed.
+    std::vector<tinyobj::index_t> indices;
+    std::vector<std::pair<size_t, uint8_t>> relative_indices;
+
+    // Per triangle state. Triangles before the first `usemtl` or `s` statement of a chunk inherit the state of the previous chunk.
+    std::vector<int32_t> material_ids;
+    std::vector<uint32_t> smoothing_group_ids;
+    std::vector<std::string> material_names;
+    int32_t final_material_id { -1 };
+    uint32_t final_smoothing_group_id { inherited_smoothing_group };
+
+    std::vector<std::pair<size_t, std::string>> groups;
+    std::vector<std::string> material_libraries;
+
+    std::string error;
+};
+
+static void
+parseChunk(const char* begin, const char* end, ObjChunk& chunk) {
+    std::unordered_map<std::string, int32_t> material_name_map;
+    int32_t material_id = -1;
+    uint32_t smoothing_group_id = inherited_smoothing_group;
+    std::vector<tinyobj::index_t> face;
+
+    auto resolve = [&](int index, size_t count, uint8_t component, int& resolved) {
+        if (index > 0) {
+            resolved = index - 1;
+        } else if (index < 0) {
+            resolved = int(count) + index;
+            chunk.relative_indices.push_back(std::make_pair(chunk.indices.size() + face.size(), component));
+        } else {
+            return false;
+        }
+        return true;
+    };
+
+    const char* line = begin;
+    while (line < end) {
+        const char* line_end = (const char*)std::memchr(line, '\n', end - line);
+        if (!line_end) line_end = end;
+        const char* next_line = line_end + (line_end < end ? 1 : 0);
+        if (line_end > line && line_end[-1] == '\r') line_end--;
+
+        const char* p = line;
+        skipSpace(p, line_end);
+
+        if (p + 1 < line_end && p[0] == 'v' && isSpace(p[1])) {
+            p += 2;
+            tinyobj::real_t x = 0, y = 0, z = 0;
+            if (!parseFloat(p, line_end, x) || !parseFloat(p, line_end, y) || !parseFloat(p, line_end, z)) {
+                chunk.error = "Malformed vertex '" + std::string(line, line_end) + "'";
+                return;
+            }
+            chunk.vertices.push_back(x);
+            chunk.vertices.push_back(y);
+            chunk.vertices.push_back(z);
+        } else if (p + 2 < line_end && p[0] == 'v' && p[1] == 'n' && isSpace(p[2])) {
+            p += 3;
+            tinyobj::real_t x = 0, y = 0, z = 0;
+            if (!parseFloat(p, line_end, x) || !parseFloat(p, line_end, y) || !parseFloat(p, line_end, z)) {
+                chunk.error = "Malformed normal '" + std::string(line, line_end) + "'";
+                return;
+            }
+            chunk.normals.push_back(x);
+            chunk.normals.push_back(y);
+            chunk.normals.push_back(z);
+        } else if (p + 2 < line_end && p[0] == 'v' && p[1] == 't' && isSpace(p[2])) {
+            p += 3;
+            tinyobj::real_t u = 0, v = 0;
+            if (!parseFloat(p, line_end, u)) {
+                chunk.error = "Malformed texture coordinate '" + std::string(line, line_end) + "'";
+                return;
+            }
+            parseFloat(p, line_end, v);
+            chunk.texcoords.push_back(u);
+            chunk.texcoords.push_back(v);
+        } else if (p + 1 < line_end && p[0] == 'f' && isSpace(p[1])) {
+            p += 2;
+            face.clear();
+            skipSpace(p, line_end);
+            while (p < line_end) {
+                // v, v/vt, v//vn or v/vt/vn
+                int v = 0, vt = 0, vn = 0;
+                tinyobj::index_t index { -1, -1, -1 };
+                bool valid = parseInt(p, line_end, v) && resolve(v, chunk.vertices.size() / 3, 0, index.vertex_index);
+                if (valid && p < line_end && *p == '/') {
+                    p++;
+                    if (p < line_end && *p != '/')
+                        valid = parseInt(p, line_end, vt) && resolve(vt, chunk.texcoords.size() / 2, 2, index.texcoord_index);
+                    if (valid && p < line_end && *p == '/') {
+                        p++;
+                        valid = parseInt(p, line_end, vn) && resolve(vn, chunk.normals.size() / 3, 1, index.normal_index);
+                    }
+                }
+                if (!valid) {
+                    chunk.error = "Malformed face '" + std::string(line, line_end) + "'";
+                    return;
+                }
+                face.push_back(index);
+                skipSpace(p, line_end);
+            }
+
+            // Triangulate as a fan. Relative index positions were recorded for the untriangulated face and are remapped here.
+            if (face.size() >= 3) {
+                size_t face_begin = chunk.indices.size();
+                size_t first_relative = chunk.relative_indices.size();
+                while (first_relative > 0 && chunk.relative_indices[first_relative - 1].first >= face_begin)
+                    first_relative--;
+                std::vector<std::pair<size_t, uint8_t>> face_relative(chunk.relative_indices.begin() + first_relative, chunk.relative_indices.end());
+                chunk.relative_indices.resize(first_relative);
+
+                for (size_t corner = 1; corner + 1 < face.size(); corner++) {
+                    for (size_t c : { size_t(0), corner, corner + 1 }) {
+                        for (auto& relative : face_relative) {
+                            if (relative.first == face_begin + c)
+                                chunk.relative_indices.push_back(std::make_pair(chunk.indices.size(), relative.second));
+                        }
+                        chunk.indices.push_back(face[c]);
+                    }
+                    chunk.material_ids.push_back(material_id);
+                    chunk.smoothing_group_ids.push_back(smoothing_group_id);
+                }
+            } else {
+                while (!chunk.relative_indices.empty() && chunk.relative_indices.back().first >= chunk.indices.size())
+                    chunk.relative_indices.pop_back();
+            }
+        } else if (p + 1 < line_end && (p[0] == 'o' || p[0] == 'g') && isSpace(p[1])) {
+            chunk.groups.push_back(std::make_pair(chunk.material_ids.size(), parseName(p + 2, line_end)));
+        } else if (startsWith(p, line_end, "usemtl")) {
+            std::string name = parseName(p + 6, line_end);
+            auto it = material_name_map.find(name);
+            if (it == material_name_map.end()) {
+                chunk.material_names.push_back(name);
+                it = material_name_map.insert(std::make_pair(name, int32_t(chunk.material_names.size() - 1))).first;
+            }
+            material_id = it->second;
+        } else if (startsWith(p, line_end, "mtllib")) {
+            p += 6;
+            while (p < line_end) {
+                skipSpace(p, line_end);
+                const char* name_end = p;
+                while (name_end < line_end && !isSpace(*name_end)) name_end++;
+                if (name_end > p) chunk.material_libraries.push_back(std::string(p, name_end));
+                p = name_end;
+            }
+        } else if (p + 1 < line_end && p[0] == 's' && isSpace(p[1])) {
+            p += 2;
+            skipSpace(p, line_end);
+            int group = 0;
+            smoothing_group_id = parseInt(p, line_end, group) ? uint32_t(group) : 0; // `s off` disables smoothing
+        }
+
+        line = next_line;
+    }
+
+    chunk.final_material_id = material_id;
+    chunk.final_smoothing_group_id = smoothing_group_id;
+}
+
+/* Merging */
+
+bool
+parseObj(std::string filename,
+         std::string mtl_search_path,
+         std::vector<ObjShape>& shapes,
+         std::vector<tinyobj::material_t>& materials,
+         std::string& warning,
+         std::string& error) {
+    MappedFile file(filename);
+    if (!file.isValid()) {
+        error = "Unable to read file '" + filename + "'";
+        return false;
+    }
+    const char* data = (const char*)file.data();
+    size_t size = file.size();
+
+    // Split the file into line-aligned chunks
+    const size_t min_chunk_size = 1 << 20;
+    size_t n_chunks = std::max<size_t>(1, std::min<size_t>(size / min_chunk_size, 4 * tbb::this_task_arena::max_concurrency()));
+    std::vector<size_t> chunk_begins = { 0 };
+    for (size_t i = 1; i < n_chunks; i++) {
+        const char* split = data + i * size / n_chunks;
+        const char* line_end = (const char*)std::memchr(split, '\n', data + size - split);
+        if (!line_end) break;
+        size_t begin = line_end - data + 1;
+        if (begin > chunk_begins.back() && begin < size) chunk_begins.push_back(begin);
+    }
+    chunk_begins.push_back(size);
+    n_chunks = chunk_begins.size() - 1;
+
+    // Parse
+    std::vector<ObjChunk> chunks(n_chunks);
+    tbb::parallel_for(size_t(0), n_chunks, [&](size_t i) {
+        parseChunk(data + chunk_begins[i], data + chunk_begins[i + 1], chunks[i]);
+    });
+    for (auto& chunk : chunks) {
+        if (!chunk.error.empty()) {
+            error = chunk.error;
+            return false;
+        }
+    }
+
+    // Offsets of each chunk in the merged data
+    std::vector<size_t> vertex_offsets(n_chunks + 1, 0), normal_offsets(n_chunks + 1, 0), texcoord_offsets(n_chunks + 1, 0), triangle_offsets(n_chunks + 1, 0);
+    for (size_t i = 0; i < n_chunks; i++) {
+        vertex_offsets[i + 1] = vertex_offsets[i] + chunks[i].vertices.size() / 3;
+        normal_offsets[i + 1] = normal_offsets[i] + chunks[i].normals.size() / 3;
+        texcoord_offsets[i + 1] = texcoord_offsets[i] + chunks[i].texcoords.size() / 2;
+        triangle_offsets[i + 1] = triangle_offsets[i] + chunks[i].material_ids.size();
+    }
+
+    // Resolve relative indices and validate all indices
+    std::atomic<bool> has_invalid_index { false };
+    tbb::parallel_for(size_t(0), n_chunks, [&](size_t i) {
+        auto& chunk = chunks[i];
+        for (auto& relative : chunk.relative_indices) {
+            auto& index = chunk.indices[relative.first];
+            if (relative.second == 0) index.vertex_index += int(vertex_offsets[i]);
+            if (relative.second == 1) index.normal_index += int(normal_offsets[i]);
+            if (relative.second == 2) index.texcoord_index += int(texcoord_offsets[i]);
+        }
+        for (auto& index : chunk.indices) {
+            if (index.vertex_index < 0 || size_t(index.vertex_index) >= vertex_offsets[n_chunks] ||
+                index.normal_index < -1 || (index.normal_index >= 0 && size_t(index.normal_index) >= normal_offsets[n_chunks]) ||
+                index.texcoord_index < -1 || (index.texcoord_index >= 0 && size_t(index.texcoord_index) >= texcoord_offsets[n_chunks])) {
+                has_invalid_index = true;
+                return;
+            }
+        }
+    });
+    if (has_invalid_index) {
+        error = "Face index out of range in '" + filename + "'";
+        return false;
+    }
+
+    // Load material libraries
+    std::map<std::string, int> material_map;
+    std::set<std::string> material_libraries;
+    for (auto& chunk : chunks) {
+        for (auto& library : chunk.material_libraries) {
+            if (!material_libraries.insert(library).second) continue;
+
+            std::ifstream stream(mtl_search_path + library);
+            if (!stream) {
+                warning += "Material library '" + library + "' not found\n";
+                continue;
+            }
+            std::string mtl_warning, mtl_error;
+            tinyobj::LoadMtl(&material_map, &materials, &stream, &mtl_warning, &mtl_error);
+            warning += mtl_warning;
+            if (!mtl_error.empty()) warning += mtl_error;
+        }
+    }
+
+    // Resolve material and smoothing group state across chunks
+    std::vector<std::vector<int>> chunk_material_ids(n_chunks);
+    std::vector<int> inherited_material_ids(n_chunks, -1);
+    std::vector<uint32_t> inherited_smoothing_group_ids(n_chunks, 0);
+    std::set<std::string> missing_materials;
+    for (size_t i = 0; i < n_chunks; i++) {
+        auto& chunk = chunks[i];
+        for (auto& name : chunk.material_names) {
+            auto it = material_map.find(name);
+            if (it == material_map.end() && missing_materials.insert(name).second)
+                warning += "Material '" + name + "' not found\n";
+            chunk_material_ids[i].push_back(it == material_map.end() ? -1 : it->second);
+        }
+
+        if (i + 1 < n_chunks) {
+            inherited_material_ids[i + 1] = inherited_material_ids[i];
+            inherited_smoothing_group_ids[i + 1] = inherited_smoothing_group_ids[i];
+            if (chunk.final_material_id >= 0)
+                inherited_material_ids[i + 1] = chunk_material_ids[i][chunk.final_material_id];
+            if (chunk.final_smoothing_group_id != inherited_smoothing_group)
+                inherited_smoothing_group_ids[i + 1] = chunk.final_smoothing_group_id;
+        }
+    }
+
+    // Split triangles into shapes at 'o' and 'g' statements
+    struct ShapeRange {
+        std::string name;
+        size_t begin;
+        size_t end;
+    };
+    std::vector<ShapeRange> ranges;
+    std::string current_name;
+    size_t current_begin = 0;
+    for (size_t i = 0; i < n_chunks; i++) {
+        for (auto& group : chunks[i].groups) {
+            size_t triangle = triangle_offsets[i] + group.first;
+            if (triangle > current_begin)
+                ranges.push_back({ current_name, current_begin, triangle });
+            current_name = group.second;
+            current_begin = triangle;
+        }
+    }
+    if (triangle_offsets[n_chunks] > current_begin)
+        ranges.push_back({ current_name, current_begin, triangle_offsets[n_chunks] });
+
+    // Attributes stay in the chunks they were parsed into, global indices are mapped back to their chunk
+    auto locate = [](const std::vector<size_t>& offsets, int index, size_t& chunk_id) {
+        if (size_t(index) < offsets[chunk_id] || size_t(index) >= offsets[chunk_id + 1])
+            chunk_id = std::upper_bound(offsets.begin(), offsets.end(), size_t(index)) - offsets.begin() - 1;
+        return size_t(index) - offsets[chunk_id];
+    };
+    bool has_uvs = texcoord_offsets[n_chunks] > 0;
+
+    // Weld shapes
+    // Corners with a normal are welded by their position, normal and uv index. Corners without one are welded by their
+    // position, smoothing group and uv index and share a normal accumulator with all corners of the same position and
+    // smoothing group, so uv seams do not split the smoothed normal. With smoothing off, every corner is a new vertex.
+    static constexpr uint32_t provided_normal = ~0u;
+    shapes.resize(ranges.size());
+    tbb::parallel_for(size_t(0), ranges.size(), [&](size_t shape_id) {
+        auto& range = ranges[shape_id];
+        auto& shape = shapes[shape_id];
+        shape.name = range.name;
+
+        size_t n_triangles = range.end - range.begin;
+        VertexWelder<stage_vec3i> welder(3 * n_triangles / 4);
+        VertexWelder<stage_vec3i> smoothing_welder;
+        std::vector<uint32_t> welded_vertices;  // Vertex of each welded key, corners with smoothing off are not welded
+        std::vector<uint32_t> welded_sources;
+        std::vector<uint32_t> normal_sources;   // Index of the accumulated normal of each vertex, or provided_normal
+        std::vector<stage_vec3f> accumulated_normals;
+        shape.indices.reserve(3 * n_triangles);
+
+        size_t chunk_id = std::upper_bound(triangle_offsets.begin(), triangle_offsets.end(), range.begin) - triangle_offsets.begin() - 1;
+        size_t vertex_chunk = 0, normal_chunk = 0, texcoord_chunk = 0;
+        for (size_t triangle = range.begin; triangle < range.end; triangle++) {
+            while (triangle >= triangle_offsets[chunk_id + 1]) chunk_id++;
+            auto& chunk = chunks[chunk_id];
+            size_t local = triangle - triangle_offsets[chunk_id];
+
+            int32_t material_id = chunk.material_ids[local];
+            material_id = material_id < 0 ? inherited_material_ids[chunk_id] : chunk_material_ids[chunk_id][material_id];
+            uint32_t smoothing_group_id = chunk.smoothing_group_ids[local];
+            if (smoothing_group_id == inherited_smoothing_group) smoothing_group_id = inherited_smoothing_group_ids[chunk_id];
+
+            stage_vec3f p[3];
+            for (size_t c = 0; c < 3; c++) {
+                size_t v = locate(vertex_offsets, chunk.indices[3 * local + c].vertex_index, vertex_chunk);
+                p[c] = make_vec3(&chunks[vertex_chunk].vertices[3 * v]);
+            }
+            stage_vec3f face_normal = cross(p[1] - p[0], p[2] - p[0]);
+
+            for (size_t c = 0; c < 3; c++) {
+                const tinyobj::index_t& index = chunk.indices[3 * local + c];
+                bool has_normal = index.normal_index >= 0;
+                bool is_new_vertex = true;
+                uint32_t vertex_id = uint32_t(shape.positions.size());
+                if (has_normal || smoothing_group_id != 0) {
+                    // Smoothing groups are encoded above all normal indices, which are below 2^31
+                    uint32_t normal_key = has_normal ? uint32_t(index.normal_index) : ~0u - smoothing_group_id;
+                    uint32_t welded = welder.weld(stage_vec3i(uint32_t(index.vertex_index), normal_key, uint32_t(index.texcoord_index)), is_new_vertex);
+                    if (is_new_vertex) welded_vertices.push_back(vertex_id);
+                    vertex_id = welded_vertices[welded];
+                }
+                shape.indices.push_back(vertex_id);
+
+                if (is_new_vertex) {
+                    shape.positions.push_back(p[c]);
+                    if (has_normal) {
+                        size_t n = locate(normal_offsets, index.normal_index, normal_chunk);
+                        shape.normals.push_back(make_vec3(&chunks[normal_chunk].normals[3 * n]));
+                        normal_sources.push_back(provided_normal);
+                    } else {
+                        shape.normals.push_back(stage_vec3f(0.f));
+                        bool is_new_source = true;
+                        uint32_t source = uint32_t(accumulated_normals.size());
+                        if (smoothing_group_id != 0) {
+                            uint32_t welded = smoothing_welder.weld(stage_vec3i(uint32_t(index.vertex_index), smoothing_group_id, 0u), is_new_source);
+                            if (is_new_source) welded_sources.push_back(source);
+                            source = welded_sources[welded];
+                        }
+                        if (is_new_source) accumulated_normals.push_back(stage_vec3f(0.f));
+                        normal_sources.push_back(source);
+                    }
+                    if (has_uvs) {
+                        stage_vec2f uv(0.f);
+                        if (index.texcoord_index >= 0) {
+                            size_t t = locate(texcoord_offsets, index.texcoord_index, texcoord_chunk);
+                            uv = make_vec2(&chunks[texcoord_chunk].texcoords[2 * t]);
+                        }
+                        shape.uvs.push_back(uv);
+                    }
+                    shape.material_ids.push_back(material_id);
+                }
+
+                // Area weighted, every position of a smoothing group receives each face normal once
+                if (normal_sources[vertex_id] != provided_normal)
+                    accumulated_normals[normal_sources[vertex_id]] = accumulated_normals[normal_sources[vertex_id]] + face_normal;
+            }
+        }
+
+        for (size_t vertex_id = 0; vertex_id < shape.normals.size(); vertex_id++) {
+            if (normal_sources[vertex_id] == provided_normal) continue;
+            stage_vec3f n = accumulated_normals[normal_sources[vertex_id]];
+            float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+            shape.normals[vertex_id] = length == 0.f ? n : n * stage_vec3f(1.f / length);
+        }
+    });
+
+    return true;
+}
+
+}
+}
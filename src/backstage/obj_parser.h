@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "math.h"
+
+// foward declaration for method signatures
+namespace tinyobj {
+    struct material_t;
+}
+
+namespace stage {
+namespace backstage {
+
+/* A welded OBJ shape, staged to be written into a geometry */
+struct ObjShape {
+    std::string name;
+    std::vector<stage_vec3f> positions;
+    std::vector<stage_vec3f> normals;
+    std::vector<stage_vec2f> uvs;           // Empty if the file has no texture coordinates
+    std::vector<int32_t> material_ids;      // -1 for faces without a material
+    std::vector<uint32_t> indices;
+};
+
+/*
+ * Memory-mapped, multithreaded OBJ parser.
+ * The file is split into line-aligned chunks that are parsed in parallel. Each shape is then welded in parallel,
+ * reading the attributes of its unique vertices straight from the chunks, without merging them into tinyobj structures first.
+ * Polygons are triangulated as fans around their first corner and shapes are split at the same `o` and `g` statements as tinyobj.
+ * Corners without a normal get one averaged over the faces of their smoothing group, or the face normal if smoothing is off.
+ * Materials are read with tinyobj's MTL parser, as material libraries are small.
+ */
+bool parseObj(std::string filename,
+              std::string mtl_search_path,
+              std::vector<ObjShape>& shapes,
+              std::vector<tinyobj::material_t>& materials,
+              std::string& warning,
+              std::string& error);
+
+}
+}
@@ -0,0 +1,207 @@
+#include "optimize.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace stage {
+namespace backstage {
+
+namespace {
+
+/* Size of the LRU cache modelled by the optimizer, larger than the FIFO it is evaluated with so that it works well across GPUs */
+constexpr size_t forsyth_cache_size = 32;
+
+constexpr uint32_t invalid_index = ~0u;
+
+/* Vertices in the cache score higher the more recently they were used, vertices with few remaining triangles are preferred to finish them off */
+float
+forsythVertexScore(int32_t cache_position, uint32_t remaining_triangles) {
+    if (remaining_triangles == 0)
+        return -1.f;
+
+    float score = 0.f;
+    if (cache_position >= 0) {
+        // The vertices of the last triangle get a fixed score so that the next triangle does not simply reuse its strip order
+        if (cache_position < 3)
+            score = 0.75f;
+        else
+            score = std::pow(1.f - float(cache_position - 3) / (forsyth_cache_size - 3), 1.5f);
+    }
+    return score + 2.f / std::sqrt(float(remaining_triangles));
+}
+
+template<typename T>
+void
+permuteAttribute(BufferView<T>& view, const std::vector<uint32_t>& order) {
+    if (view.size() != order.size())
+        return;
+    std::vector<T> source(view.size());
+    for (size_t i = 0; i < source.size(); i++) {
+        source[i] = view[i];
+    }
+    for (size_t i = 0; i < source.size(); i++) {
+        view[i] = source[order[i]];
+    }
+}
+
+}
+
+size_t
+countCacheMisses(const std::vector<uint32_t>& indices, size_t num_vertices, size_t cache_size) {
+    // A vertex stays in the FIFO until `cache_size` other vertices have been inserted after it
+    std::vector<size_t> inserted_at(num_vertices, ~size_t(0));
+    size_t misses = 0;
+    for (uint32_t index : indices) {
+        if (inserted_at[index] == ~size_t(0) || misses - inserted_at[index] > cache_size) {
+            inserted_at[index] = misses;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+void
+optimizeVertexCache(std::vector<uint32_t>& indices, size_t num_vertices) {
+    size_t num_triangles = indices.size() / 3;
+    if (num_triangles == 0)
+        return;
+
+    // Triangles adjacent to each vertex, the first `remaining[v]` entries of a vertex are the ones not emitted yet
+    std::vector<uint32_t> offsets(num_vertices + 1, 0);
+    for (uint32_t index : indices) {
+        offsets[index + 1]++;
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> remaining(num_vertices, 0);
+    for (size_t i = 0; i < indices.size(); i++) {
+        uint32_t vertex = indices[i];
+        adjacency[offsets[vertex] + remaining[vertex]++] = uint32_t(i / 3);
+    }
+
+    std::vector<int32_t> cache_position(num_vertices, -1);
+    std::vector<float> vertex_score(num_vertices);
+    for (size_t vertex = 0; vertex < num_vertices; vertex++) {
+        vertex_score[vertex] = forsythVertexScore(-1, remaining[vertex]);
+    }
+    std::vector<float> triangle_score(num_triangles);
+    for (size_t triangle = 0; triangle < num_triangles; triangle++) {
+        triangle_score[triangle] = vertex_score[indices[3 * triangle]] + vertex_score[indices[3 * triangle + 1]] + vertex_score[indices[3 * triangle + 2]];
+    }
+
+    std::vector<bool> emitted(num_triangles, false);
+    std::vector<uint32_t> cache, next_cache;
+    cache.reserve(forsyth_cache_size + 3);
+    next_cache.reserve(forsyth_cache_size + 3);
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+
+    size_t cursor = 0;
+    uint32_t best = invalid_index;
+    for (size_t n = 0; n < num_triangles; n++) {
+        // Continue with the next triangle in input order when no triangle in the cache is left
+        if (best == invalid_index) {
+            while (emitted[cursor]) cursor++;
+            best = uint32_t(cursor);
+        }
+        emitted[best] = true;
+        const uint32_t* triangle = &indices[3 * best];
+
+        next_cache.clear();
+        for (size_t k = 0; k < 3; k++) {
+            uint32_t vertex = triangle[k];
+            result.push_back(vertex);
+
+            uint32_t* begin = &adjacency[offsets[vertex]];
+            uint32_t* end = begin + remaining[vertex];
+            std::iter_swap(std::find(begin, end, best), end - 1);
+            remaining[vertex]--;
+
+            if (std::find(next_cache.begin(), next_cache.end(), vertex) == next_cache.end())
+                next_cache.push_back(vertex);
+        }
+        for (uint32_t vertex : cache) {
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+                next_cache.push_back(vertex);
+        }
+
+        // Vertices pushed out of the cache are rescored as well, their triangles lose the cache bonus
+        for (size_t i = 0; i < next_cache.size(); i++) {
+            uint32_t vertex = next_cache[i];
+            cache_position[vertex] = i < forsyth_cache_size ? int32_t(i) : -1;
+            float score = forsythVertexScore(cache_position[vertex], remaining[vertex]);
+            float delta = score - vertex_score[vertex];
+            vertex_score[vertex] = score;
+            for (uint32_t j = offsets[vertex]; j < offsets[vertex] + remaining[vertex]; j++) {
+                triangle_score[adjacency[j]] += delta;
+            }
+        }
+
+        best = invalid_index;
+        float best_score = -1.f;
+        next_cache.resize(std::min(next_cache.size(), forsyth_cache_size));
+        for (uint32_t vertex : next_cache) {
+            for (uint32_t j = offsets[vertex]; j < offsets[vertex] + remaining[vertex]; j++) {
+                uint32_t candidate = adjacency[j];
+                if (triangle_score[candidate] > best_score) {
+                    best_score = triangle_score[candidate];
+                    best = candidate;
+                }
+            }
+        }
+        std::swap(cache, next_cache);
+    }
+
+    indices.swap(result);
+}
+
+std::vector<uint32_t>
+optimizeVertexFetch(std::vector<uint32_t>& indices, size_t num_vertices) {
+    std::vector<uint32_t> remap(num_vertices, invalid_index);
+    std::vector<uint32_t> order;
+    order.reserve(num_vertices);
+    for (uint32_t& index : indices) {
+        if (remap[index] == invalid_index) {
+            remap[index] = uint32_t(order.size());
+            order.push_back(index);
+        }
+        index = remap[index];
+    }
+    for (uint32_t vertex = 0; vertex < num_vertices; vertex++) {
+        if (remap[vertex] == invalid_index)
+            order.push_back(vertex);
+    }
+    return order;
+}
+
+VertexCacheStats
+optimizeGeometry(Geometry& geometry) {
+    VertexCacheStats stats;
+    size_t num_vertices = geometry.numVertices();
+    std::vector<uint32_t>& indices = geometry.indices;
+    if (indices.empty() || indices.size() % 3 != 0)
+        return stats;
+    if (*std::max_element(indices.begin(), indices.end()) >= num_vertices)
+        return stats;
+
+    stats.num_triangles = indices.size() / 3;
+    stats.misses_before = countCacheMisses(indices, num_vertices);
+
+    optimizeVertexCache(indices, num_vertices);
+    std::vector<uint32_t> order = optimizeVertexFetch(indices, num_vertices);
+    permuteAttribute(geometry.positions, order);
+    permuteAttribute(geometry.normals, order);
+    permuteAttribute(geometry.uvs, order);
+    permuteAttribute(geometry.material_ids, order);
+    permuteAttribute(geometry.quantized_positions, order);
+    permuteAttribute(geometry.octahedral_normals, order);
+    permuteAttribute(geometry.half_uvs, order);
+
+    stats.misses_after = countCacheMisses(indices, num_vertices);
+    return stats;
+}
+
+}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace stage {
+namespace backstage {
+
+struct Geometry;
+
+/* Size of the FIFO post-transform cache that ACMR is reported for */
+constexpr size_t acmr_cache_size = 16;
+
+/* Vertex cache misses of a set of triangles before and after optimization, ACMR is misses per triangle */
+struct VertexCacheStats {
+    size_t num_triangles { 0 };
+    size_t misses_before { 0 };
+    size_t misses_after { 0 };
+
+    float acmrBefore() const { return num_triangles > 0 ? float(misses_before) / num_triangles : 0.f; }
+    float acmrAfter() const { return num_triangles > 0 ? float(misses_after) / num_triangles : 0.f; }
+
+    VertexCacheStats& operator+=(const VertexCacheStats& other) {
+        num_triangles += other.num_triangles;
+        misses_before += other.misses_before;
+        misses_after += other.misses_after;
+        return *this;
+    }
+};
+
+/* Number of vertex transforms a FIFO cache with `cache_size` entries needs for `indices` */
+size_t countCacheMisses(const std::vector<uint32_t>& indices, size_t num_vertices, size_t cache_size = acmr_cache_size);
+
+/* Reorders triangles for post-transform cache efficiency using Forsyth's linear-speed vertex cache optimization */
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t num_vertices);
+
+/*
+ * Renumbers vertices in the order they are first referenced by `indices` and rewrites the indices accordingly.
+ * Unreferenced vertices are moved to the end. Returns the previous index of every vertex in the new order.
+ */
+std::vector<uint32_t> optimizeVertexFetch(std::vector<uint32_t>& indices, size_t num_vertices);
+
+/* Runs both passes on `geometry`, permuting all of its vertex attributes in place. Geometry that is not a triangle list is left unchanged. */
+VertexCacheStats optimizeGeometry(Geometry& geometry);
+
+}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <stdexcept>
+
+namespace stage {
+namespace backstage {
+
+enum LoadPhase {
+    LoadPhase_Parse     = 0,    // Reading and parsing the scene file
+    LoadPhase_Normals   = 1,    // Generating missing normals
+    LoadPhase_Geometry  = 2,    // Converting and packing geometry into objects
+    LoadPhase_Textures  = 3,    // Loading materials and texture images
+    LoadPhase_Scale     = 4,    // Computing the scene scale
+    LoadPhase_Done      = 5,
+};
+
+struct LoadCancelled : public std::runtime_error {
+    LoadCancelled() : std::runtime_error("Loading was cancelled") {}
+};
+
+/*
+ * Progress of a scene load, shared between the loading thread and any number of observers.
+ * Cancellation is cooperative: the loader checks for it whenever it reports progress and unwinds by throwing LoadCancelled.
+ */
+struct LoadProgress {
+    void report(LoadPhase phase, float fraction) {
+        check();
+        set(phase, fraction);
+    }
+
+    /* Updates the progress without checking for cancellation, for callbacks that must not throw */
+    void set(LoadPhase phase, float fraction) {
+        m_phase.store(phase, std::memory_order_relaxed);
+        m_fraction.store(fraction, std::memory_order_relaxed);
+    }
+
+    void check() const {
+        if (isCancelled())
+            throw LoadCancelled();
+    }
+
+    void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+    LoadPhase getPhase() const { return m_phase.load(std::memory_order_relaxed); }
+    float getFraction() const { return m_fraction.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<LoadPhase> m_phase { LoadPhase_Parse };
+    std::atomic<float> m_fraction { 0.f };
+    std::atomic<bool> m_cancelled { false };
+};
+
+}
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "math.h"
+
+namespace stage {
+namespace backstage {
+
+/* Encoding and decoding of the compressed vertex attributes used by the VertexLayout_Compressed_* layouts */
+
+/* Converts to an IEEE 754 half float, rounding to nearest even. Values beyond the half range become infinity. */
+inline uint16_t
+floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(float));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent == 0xff)
+        return uint16_t(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+    int32_t half_exponent = int32_t(exponent) - 127 + 15;
+    if (half_exponent >= 31)
+        return uint16_t(sign | 0x7c00);
+
+    if (half_exponent <= 0) {
+        // Subnormal half, values below half the smallest subnormal round to zero
+        if (half_exponent < -10)
+            return uint16_t(sign);
+        mantissa |= 0x800000;
+        uint32_t shift = uint32_t(14 - half_exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1)))
+            half++;
+        return uint16_t(sign | half);
+    }
+
+    // A carry out of the mantissa correctly rounds up into the exponent
+    uint32_t half = (uint32_t(half_exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        half++;
+    return uint16_t(sign | half);
+}
+
+inline float
+halfToFloat(uint16_t value) {
+    uint32_t sign = uint32_t(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+
+    if (exponent == 0) {
+        float result = std::ldexp(float(mantissa), -24);
+        return sign ? -result : result;
+    }
+
+    uint32_t bits;
+    if (exponent == 0x1f)
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    float result;
+    std::memcpy(&result, &bits, sizeof(float));
+    return result;
+}
+
+inline stage_vec2us
+encodeHalf(const stage_vec2f& v) {
+    return stage_vec2us(floatToHalf(v.x), floatToHalf(v.y));
+}
+
+inline stage_vec2f
+decodeHalf(const stage_vec2us& v) {
+    return stage_vec2f(halfToFloat(v.x), halfToFloat(v.y));
+}
+
+/*
+ * Octahedral encoding of unit vectors into two snorm16 values.
+ * The unit sphere is projected onto an octahedron whose lower half is folded over the upper one, the error is below 1e-4 radians.
+ */
+inline stage_vec2s
+encodeOctahedral(const stage_vec3f& n) {
+    float length = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (length == 0.f)
+        return stage_vec2s(int16_t(0), int16_t(0));
+
+    float x = n.x / length;
+    float y = n.y / length;
+    if (n.z < 0.f) {
+        float folded_x = (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f);
+        float folded_y = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+        x = folded_x;
+        y = folded_y;
+    }
+    auto snorm16 = [](float v) { return int16_t(std::round(std::min(1.f, std::max(-1.f, v)) * 32767.f)); };
+    return stage_vec2s(snorm16(x), snorm16(y));
+}
+
+inline stage_vec3f
+decodeOctahedral(const stage_vec2s& e) {
+    float x = std::max(-1.f, e.x / 32767.f);
+    float y = std::max(-1.f, e.y / 32767.f);
+    float z = 1.f - std::abs(x) - std::abs(y);
+    if (z < 0.f) {
+        float unfolded_x = (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f);
+        float unfolded_y = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+        x = unfolded_x;
+        y = unfolded_y;
+    }
+    return normalize(stage_vec3f(x, y, z));
+}
+
+/*
+ * Positions are stored as unorm16 relative to the bounds of their geometry and decoded as `offset + scale * q`.
+ * The scale for bounds [lo, hi] is (hi - lo) / 65535, which bounds the error to half of that per axis.
+ */
+inline stage_vec3f
+positionScale(const stage_vec3f& lo, const stage_vec3f& hi) {
+    return stage_vec3f((hi.x - lo.x) / 65535.f, (hi.y - lo.y) / 65535.f, (hi.z - lo.z) / 65535.f);
+}
+
+inline stage_vec3us
+quantizePosition(const stage_vec3f& p, const stage_vec3f& offset, const stage_vec3f& scale) {
+    auto unorm16 = [](float v, float offset, float scale) {
+        if (scale <= 0.f) return uint16_t(0);
+        return uint16_t(std::min(65535.f, std::max(0.f, std::round((v - offset) / scale))));
+    };
+    return stage_vec3us(unorm16(p.x, offset.x, scale.x), unorm16(p.y, offset.y, scale.y), unorm16(p.z, offset.z, scale.z));
+}
+
+inline stage_vec3f
+dequantizePosition(const stage_vec3us& q, const stage_vec3f& offset, const stage_vec3f& scale) {
+    return stage_vec3f(offset.x + scale.x * q.x, offset.y + scale.y * q.y, offset.z + scale.z * q.z);
+}
+
+}
+}
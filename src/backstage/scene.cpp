@@ -1,8 +1,16 @@
 #include "scene.h"
+#include "asset_cache.h"
 #include "cie.h"
+#include "meshlet.h"
+#include "obj_parser.h"
+#include "snapshot.h"
+#include "texture_loader.h"
+#include "weld.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <cstring>
 #include <stdexcept>
 #include <unordered_map>
 
@@ -18,24 +26,300 @@
 namespace stage {
 namespace backstage {
 
-std::unique_ptr<Scene> createScene(std::string scene, const Config& config) {
+std::unique_ptr<Scene> createScene(std::string scene, const Config& config, LoadProgress* progress) {
     std::string extension = std::filesystem::path(scene).extension().string();
     std::unique_ptr<Scene> scene_ptr;
+    std::shared_ptr<SceneAssets> cached_assets;
     try {
-        if (extension == ".obj")
-            scene_ptr = std::make_unique<OBJScene>(scene, config);
+        if (config.use_asset_cache)
+            cached_assets = AssetCache::get().findScene(scene, config);
+
+        if (cached_assets)
+            scene_ptr = std::make_unique<CachedScene>(scene, config, *cached_assets, progress);
+        else if (extension == ".obj")
+            scene_ptr = std::make_unique<OBJScene>(scene, config, progress);
         else if (extension == ".pbrt")
-            scene_ptr = std::make_unique<PBRTScene>(scene, config);
+            scene_ptr = std::make_unique<PBRTScene>(scene, config, progress);
         else if (extension == ".fbx")
-            scene_ptr = std::make_unique<FBXScene>(scene, config);
+            scene_ptr = std::make_unique<FBXScene>(scene, config, progress);
+        else if (extension == ".stage")
+            scene_ptr = std::make_unique<SnapshotScene>(scene, config, progress);
         else
             throw std::runtime_error("Unexpected file format " + extension);
+    } catch (LoadCancelled& e) {
+        WARN("Cancelled loading " + scene);
     } catch (std::runtime_error e) {
         ERR("Error parsing " + scene + ": " + std::string(e.what()));
     }
+
+    // Streamed scenes no longer hold their geometry, so they can neither be cached nor written to a snapshot
+    if (scene_ptr && config.sink) {
+        if (!config.snapshot_path.empty())
+            WARN("Snapshots are not written for streamed scenes");
+        return scene_ptr;
+    }
+
+    if (scene_ptr && config.use_asset_cache && !cached_assets)
+        AssetCache::get().insertScene(scene, config, *scene_ptr);
+
+    // Never overwrite the snapshot we are currently reading from, its buffers are mapped from the file
+    std::error_code error;
+    if (scene_ptr && !config.snapshot_path.empty() && !std::filesystem::equivalent(scene, config.snapshot_path, error)) {
+        try {
+            writeSnapshot(*scene_ptr, config.snapshot_path);
+            SUCC("Wrote snapshot " + config.snapshot_path);
+        } catch (const std::runtime_error& e) {
+            ERR("Error writing snapshot " + config.snapshot_path + ": " + std::string(e.what()));
+        }
+    }
     return scene_ptr;
 }
 
+AsyncLoad createSceneAsync(std::string scene, const Config& config) {
+    // Loads run in their own arena so that a long load cannot starve parallel work submitted by the application
+    static tbb::task_arena load_arena;
+
+    auto progress = std::make_shared<LoadProgress>();
+    auto promise = std::make_shared<std::promise<std::unique_ptr<Scene>>>();
+
+    AsyncLoad load;
+    load.progress = progress;
+    load.result = promise->get_future();
+
+    load_arena.enqueue([scene, config, progress, promise]() {
+        try {
+            promise->set_value(createScene(scene, config, progress.get()));
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return load;
+}
+
+void
+Scene::finalize(bool process_geometry) {
+    if (process_geometry) {
+        if (m_config.optimize_vertex_cache) {
+            optimizeObjects();
+            SUCC("Optimized " + std::to_string(m_vertex_cache_stats.num_triangles) + " triangles for the vertex cache, ACMR " + 
+                 std::to_string(m_vertex_cache_stats.acmrBefore()) + " -> " + std::to_string(m_vertex_cache_stats.acmrAfter()));
+        }
+        if (m_config.build_meshlets)
+            buildObjectMeshlets();
+        if (m_config.index_format == IndexFormat_Adaptive)
+            compactIndices();
+    } else {
+        // Loaders generate mip levels while decoding. Snapshot and cached textures are converted to the configured filter,
+        // which keeps their stored levels when the filters match and otherwise rebuilds or strips them.
+        generateTextureMips();
+    }
+    if (m_config.texture_compression != TextureCompression_None)
+        compressTextures();
+    reportProgress(LoadPhase_Scale, 0.f);
+    updateSceneBounds();
+    if (m_config.sink)
+        streamScene();
+    reportProgress(LoadPhase_Done, 1.f);
+    SUCC("Finished loading " + std::to_string(m_config.sink ? m_num_objects : m_objects.size()) + " objects and " + std::to_string(m_instances.size()) + " instances.");
+}
+
+GeometryBuilder
+Scene::beginGeometry(Object& object, size_t num_vertices, bool has_uvs) {
+    if (!m_config.sink)
+        return GeometryBuilder(object, num_vertices, has_uvs);
+
+    // Streamed geometry gets a buffer of its own, which is released as soon as the sink returns
+    Object chunk(object.layout(), object.alignment(), m_config.allocator);
+    return GeometryBuilder(chunk, num_vertices, has_uvs);
+}
+
+void
+Scene::addGeometry(Object& object, uint32_t object_id, GeometryBuilder& builder) {
+    if (!m_config.sink) {
+        Geometry g = builder.build();
+        LOG("Read geometry (v: " + std::to_string(g.numVertices()) + ", i: " + std::to_string(g.indices.size()) + ")");
+        object.geometries.push_back(std::move(g));
+        return;
+    }
+
+    Object chunk(object.layout(), object.alignment(), m_config.allocator);
+    chunk.data = builder.buffer();
+    chunk.geometries.push_back(builder.build());
+    Geometry& g = chunk.geometries.back();
+    if (m_config.optimize_vertex_cache)
+        m_vertex_cache_stats += optimizeGeometry(g);
+    if (m_config.build_meshlets) {
+        MeshletData meshlets = buildMeshlets(g, m_config.meshlet_max_vertices, m_config.meshlet_max_triangles);
+        storeMeshlets(chunk, g, meshlets);
+    }
+    if (m_config.index_format == IndexFormat_Adaptive)
+        g.compactIndices();
+
+    // Only the bounds are kept to compute the instance bounds later
+    if (m_object_bounds.size() <= object_id)
+        m_object_bounds.resize(object_id + 1);
+    m_object_bounds[object_id].extend(g.bounds);
+    chunk.updateBounds();
+
+    LOG("Streamed geometry (v: " + std::to_string(g.numVertices()) + ", i: " + std::to_string(g.numIndices()) + ")");
+    m_config.sink->onGeometry(object_id, chunk);
+
+    // An empty placeholder keeps the geometry count of `object` intact for the loader
+    object.geometries.emplace_back();
+}
+
+/* Optimizes all geometries in parallel, streamed geometries are optimized in addGeometry before they are passed on */
+void
+Scene::optimizeObjects() {
+    std::vector<Geometry*> geometries;
+    for (auto& object : m_objects) {
+        for (auto& geometry : object.geometries) {
+            geometries.push_back(&geometry);
+        }
+    }
+
+    auto reduce_fn = [](VertexCacheStats a, const VertexCacheStats& b) { return a += b; };
+    m_vertex_cache_stats += tbb::parallel_reduce(tbb::blocked_range<size_t>(0, geometries.size()), VertexCacheStats(), [&](const auto& r, VertexCacheStats local) {
+        for (size_t i = r.begin(); i != r.end(); i++) {
+            local += optimizeGeometry(*geometries[i]);
+        }
+        return local;
+    },
+    reduce_fn);
+}
+
+/* Meshlets are built in parallel across all geometries, each object then appends those of its geometries to its buffer in order */
+void
+Scene::buildObjectMeshlets() {
+    tbb::parallel_for_each(m_objects.begin(), m_objects.end(), [&](Object& object) {
+        std::vector<MeshletData> meshlets(object.geometries.size());
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, object.geometries.size()), [&](const auto& r) {
+            for (size_t i = r.begin(); i != r.end(); i++) {
+                meshlets[i] = buildMeshlets(object.geometries[i], m_config.meshlet_max_vertices, m_config.meshlet_max_triangles);
+            }
+        });
+        for (size_t i = 0; i < object.geometries.size(); i++) {
+            storeMeshlets(object, object.geometries[i], meshlets[i]);
+        }
+        object.data->shrink_to_fit();
+    });
+}
+
+void
+Scene::compactIndices() {
+    tbb::parallel_for_each(m_objects.begin(), m_objects.end(), [](Object& object) {
+        tbb::parallel_for_each(object.geometries.begin(), object.geometries.end(), [](Geometry& geometry) {
+            geometry.compactIndices();
+        });
+    });
+}
+
+void
+Scene::generateTextureMips() {
+    tbb::parallel_for_each(m_textures.begin(), m_textures.end(), [&](Image& texture) {
+        texture.generateMips(m_config.mip_filter);
+    });
+}
+
+/* The format of every texture follows from how the materials and lights use it, textures that are only used as opacity get BC4 */
+void
+Scene::compressTextures() {
+    std::vector<bool> is_color(m_textures.size(), false);
+    std::vector<bool> is_opacity(m_textures.size(), false);
+    auto mark = [&](std::vector<bool>& role, int32_t texture_id) {
+        if (texture_id >= 0 && size_t(texture_id) < role.size())
+            role[texture_id] = true;
+    };
+    for (auto& material : m_materials) {
+        mark(is_color, material.base_color_texid);
+        mark(is_opacity, material.geometry_opacity_texid);
+    }
+    for (auto& light : m_lights) {
+        mark(is_color, light.map_texid);
+    }
+
+    TextureFormat color_format = m_config.texture_compression == TextureCompression_BC1 ? TextureFormat_BC1 : TextureFormat_BC7;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, m_textures.size()), [&](const auto& r) {
+    for (size_t i = r.begin(); i != r.end(); i++) {
+        Image& texture = m_textures[i];
+        if (texture.isHDR())
+            texture.compress(TextureFormat_BC6H);
+        else if (is_opacity[i] && !is_color[i])
+            texture.compress(TextureFormat_BC4);
+        else
+            texture.compress(color_format);
+    }
+    });
+}
+
+uint32_t
+Scene::addObject(Object&& object) {
+    if (!m_config.sink) {
+        object.data->shrink_to_fit();
+        object.updateBounds();
+        m_objects.push_back(std::move(object));
+    }
+    return m_num_objects++;
+}
+
+void
+Scene::streamScene() {
+    SceneSink& sink = *m_config.sink;
+
+    // Snapshots and cached scenes are restored as whole objects, their geometries are handed over one at a time as well.
+    // The chunks share the object's buffer instead of copying their region, so mapped snapshots stay zero-copy.
+    if (!m_objects.empty()) {
+        for (uint32_t object_id = 0; object_id < m_objects.size(); object_id++) {
+            Object& object = m_objects[object_id];
+            for (auto& geometry : object.geometries) {
+                Object chunk(object.layout(), object.alignment(), m_config.allocator);
+                chunk.data = object.data;
+                chunk.geometries.push_back(geometry);
+                chunk.updateBounds();
+                sink.onGeometry(object_id, chunk);
+            }
+        }
+        m_num_objects = m_objects.size();
+        m_objects.clear();
+    }
+
+    for (uint32_t texture_id = 0; texture_id < m_textures.size(); texture_id++) {
+        sink.onTexture(texture_id, m_textures[texture_id]);
+    }
+    m_textures.clear();
+
+    for (uint32_t material_id = 0; material_id < m_materials.size(); material_id++) {
+        sink.onMaterial(material_id, m_materials[material_id]);
+    }
+    for (auto& light : m_lights) {
+        sink.onLight(light);
+    }
+    for (auto& instance : m_instances) {
+        sink.onInstance(instance);
+    }
+}
+
+void
+Scene::remapTextureIds(const std::vector<int32_t>& remap) {
+    auto remap_id = [&](int32_t& texid) {
+        if (texid >= 0 && size_t(texid) < remap.size())
+            texid = remap[texid];
+    };
+    for (auto& material : m_materials) {
+        remap_id(material.base_color_texid);
+        remap_id(material.geometry_opacity_texid);
+    }
+    for (auto& light : m_lights) {
+        remap_id(light.map_texid);
+    }
+}
+
+void
+Scene::reportProgress(LoadPhase phase, float fraction) {
+    if (m_progress)
+        m_progress->report(phase, fraction);
+}
+
 void
 Scene::updateFilePaths(std::string scene) {
     m_scene_path = std::filesystem::absolute(std::filesystem::path(scene));
@@ -76,98 +360,147 @@ Scene::getAbsolutePath(std::filesystem::path p) {
 #endif
 }
 
+/* World space bounds of every instance from the transformed corners of its object's bounds, the scene bounds are their union */
 void
-Scene::updateSceneScale() {
-    float min_coord = 1e30f;
-    float max_coord = -1e30f;
-    stage_vec3f min_vertex (1e30f);
-    stage_vec3f max_vertex (-1e30f);
-    std::tuple<stage_vec3f, stage_vec3f> initial = std::make_tuple(min_vertex, max_vertex);
-
-    auto reduce_fn = [](const std::tuple<stage_vec3f, stage_vec3f>& a, const std::tuple<stage_vec3f, stage_vec3f>& b) {
-        auto& a_min = std::get<0>(a);
-        auto& a_max = std::get<1>(a);
-        auto& b_min = std::get<0>(b);
-        auto& b_max = std::get<1>(b);
-        stage_vec3f min = compMin(a_min) < compMin(b_min) ? a_min : b_min;
-        stage_vec3f max = compMax(a_max) > compMax(b_max) ? a_max : b_max;
-        return std::make_tuple(min, max);
+Scene::updateSceneBounds() {
+    // Streamed objects are gone by now, only their bounds were kept
+    auto object_bounds = [&](uint32_t object_id) {
+        if (object_id < m_objects.size())
+            return m_objects[object_id].bounds;
+        return object_id < m_object_bounds.size() ? m_object_bounds[object_id] : AABB();
     };
 
-    std::tuple<stage_vec3f, stage_vec3f> extrema = tbb::parallel_reduce(tbb::blocked_range<size_t>(0, m_instances.size()), initial, [&](const auto& r, auto current) {
-    auto local = current;
-    for (size_t instance_id = r.begin(); instance_id != r.end(); instance_id++) {
-        stage_mat4 instance_to_world = m_instances[instance_id].instance_to_world;
-        // stage_mat4 instance_to_world = make_mat4(&instance_to_world_[0][0]);
-
-        for (auto& geometry : m_objects[m_instances[instance_id].object_id].geometries) {
-            auto extent = tbb::parallel_reduce(tbb::blocked_range<size_t>(0, geometry.positions.size()), local, [&](const auto& rr, auto ccurrent) {
-                auto llocal = ccurrent;
-                for (size_t vertex_id = rr.begin(); vertex_id != rr.end(); vertex_id++) {
-                    stage_vec3f vertex = stage_vec3f(instance_to_world * stage_vec4f(geometry.positions[vertex_id], 1.f));
-                    llocal = reduce_fn(std::make_tuple(vertex, vertex), llocal);
-                }
-                return llocal;
-            },
-            reduce_fn);
-            local = reduce_fn(extent, local);
+    m_scene_bounds = tbb::parallel_reduce(tbb::blocked_range<size_t>(0, m_instances.size()), AABB(), [&](const auto& r, AABB local) {
+        for (size_t instance_id = r.begin(); instance_id != r.end(); instance_id++) {
+            ObjectInstance& instance = m_instances[instance_id];
+            instance.bounds = object_bounds(instance.object_id).transform(instance.instance_to_world);
+            local.extend(instance.bounds);
         }
+        return local;
+    },
+    [](AABB a, const AABB& b) { a.extend(b); return a; });
+
+    m_scene_scale = m_scene_bounds.isEmpty() ? 1.f : compMax(m_scene_bounds.upper) - compMin(m_scene_bounds.lower);
+}
+
+
+/*
+ * Loads the OBJ file with tinyobj and welds its shapes into the same staging data as the parallel parser.
+ * Each shape is welded in parallel and its unique vertices' attributes are copied out of the tinyobj attributes.
+ */
+bool
+OBJScene::loadTinyObj(std::string mtl_search_path,
+                      std::vector<ObjShape>& shapes,
+                      std::vector<tinyobj::material_t>& materials,
+                      std::string& warning,
+                      std::string& error) {
+    tinyobj::attrib_t in_attrib;
+    std::vector<tinyobj::shape_t> in_shapes;
+    if (!tinyobj::LoadObj(&in_attrib, &in_shapes, &materials, &warning, &error, m_scene_path.string().c_str(), mtl_search_path.c_str()))
+        return false;
+
+    // Deal with normals
+    bool calculate_normals = in_attrib.normals.size() == 0;
+    tinyobj::attrib_t smoothed_attrib;
+    std::vector<tinyobj::shape_t> smoothed_shapes;
+    if (calculate_normals) {
+        reportProgress(LoadPhase_Normals, 0.f);
+        LOG("Calculating normals");
+        computeSmoothingShapes(in_attrib, smoothed_attrib, in_shapes, smoothed_shapes);
+        computeAllSmoothingNormals(smoothed_attrib, smoothed_shapes);
+    } else {
+        LOG("Using normals provided by OBJ");
     }
-    return local;
-    }, 
-    reduce_fn);
+    const tinyobj::attrib_t& attrib = calculate_normals ? smoothed_attrib : in_attrib;
+    const std::vector<tinyobj::shape_t>& tiny_shapes = calculate_normals ? smoothed_shapes : in_shapes;
 
-    min_vertex = std::get<0>(extrema);
-    max_vertex = std::get<1>(extrema);
+    bool has_uvs = attrib.texcoords.size() > 0;
+    std::vector<size_t> non_triangular_fv(tiny_shapes.size(), 0);
+    shapes.resize(tiny_shapes.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, tiny_shapes.size()), [&](const auto& r) {
+    if (m_progress) m_progress->check();
+    for (size_t shape_id = r.begin(); shape_id != r.end(); shape_id++) {
+        const auto& mesh = tiny_shapes[shape_id].mesh;
+        auto& shape = shapes[shape_id];
+        shape.name = tiny_shapes[shape_id].name;
 
-    min_coord = compMin(min_vertex);
-    max_coord = compMax(max_vertex);
+        VertexWelder<stage_vec3i> welder(mesh.indices.size() / 4);
 
-    m_scene_scale = max_coord - min_coord;
-}
+        // Loop over faces in the mesh
+        for (size_t f = 0; f < mesh.num_face_vertices.size(); f++) {
+            size_t fv = size_t(mesh.num_face_vertices[f]);
 
+            if (fv != 3) {
+                non_triangular_fv[shape_id] = fv;
+                break;
+            }
 
-void
-OBJScene::loadObj() {
+            // Loop over vertices in the face
+            for (size_t v = 0; v < fv; v++){
 
-    tinyobj::ObjReaderConfig reader_config;
-    reader_config.mtl_search_path = m_base_path.string() + "/";
+                tinyobj::index_t idx = mesh.indices[3 * f + v]; 
 
-    tinyobj::ObjReader reader;
-    if (!reader.ParseFromFile(m_scene_path, reader_config)) { 
-        if (!reader.Error().empty()) { 
-            throw std::runtime_error(reader.Error());
+                bool is_new_vertex;
+                stage_vec3i vertex (idx.vertex_index, idx.normal_index, idx.texcoord_index);
+                uint32_t g_index = welder.weld(vertex, is_new_vertex);
+                if (is_new_vertex) {
+                    shape.positions.push_back(make_vec3(&attrib.vertices[3 * idx.vertex_index]));
+                    shape.normals.push_back(idx.normal_index >= 0 ? make_vec3(&attrib.normals[3 * idx.normal_index]) : stage_vec3f(0.f));
+                    if (has_uvs)
+                        shape.uvs.push_back(idx.texcoord_index >= 0 ? make_vec2(&attrib.texcoords[2 * idx.texcoord_index]) : stage_vec2f(0.f));
+                    shape.material_ids.push_back(mesh.material_ids[f]);
+                }
+                shape.indices.push_back(g_index);
+            }
         }
-        return;
     }
-    
-    if (!reader.Warning().empty()) {
-        WARN("TinyObjLoader Warning: " + reader.Warning());
+    });
+
+    for (size_t fv : non_triangular_fv) {
+        if (fv != 0) {
+            ERR("Found non-triangular primitive with " + std::to_string(fv) + " vertices.");
+            shapes.clear();
+            return false;
+        }
     }
+    return true;
+}
 
-    auto& in_attrib = reader.GetAttrib();
-    auto& in_shapes = reader.GetShapes();
-    auto& materials = reader.GetMaterials();
+void
+OBJScene::loadObj() {
 
-    // Deal with normals
-    bool calculate_normals = in_attrib.normals.size() == 0;
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    if (calculate_normals) {
-        LOG("Calculating normals");
-        computeSmoothingShapes(in_attrib, attrib, in_shapes, shapes);
-        computeAllSmoothingNormals(attrib, shapes);
+    std::string mtl_search_path = m_base_path.string() + "/";
+
+    // Both parsers weld each shape into staging data that is written into the geometry below
+    std::vector<ObjShape> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warning, error;
+    bool success = false;
+    reportProgress(LoadPhase_Parse, 0.f);
+    if (m_config.obj_parser == ObjParser_Parallel) {
+        success = parseObj(m_scene_path.string(), mtl_search_path, shapes, materials, warning, error);
     } else {
-        LOG("Using normals provided by OBJ");
-        attrib = in_attrib;
-        shapes = in_shapes;
+        success = loadTinyObj(mtl_search_path, shapes, materials, warning, error);
+    }
+
+    if (!success) { 
+        if (!error.empty()) { 
+            throw std::runtime_error(error);
+        }
+        return;
+    }
+    
+    if (!warning.empty()) {
+        WARN("OBJ Parser Warning: " + warning);
     }
 
     SUCC("Parsed OBJ file " + m_scene_path.string());
 
     // Parse materials and textures
-    std::unordered_map<std::string, uint32_t> texture_index_map;
+    // Textures are decoded in the background while the geometry is converted below
+    TextureLoader texture_loader(m_textures, m_config.lazy_textures, m_config.use_asset_cache, m_config.allocator, m_config.mip_filter);
     for (const auto& material : materials) {
+        reportProgress(LoadPhase_Textures, float(m_materials.size()) / materials.size());
         OpenPBRMaterial pbr_mat = OpenPBRMaterial::defaultMaterial();
         pbr_mat.base_color = stage_vec3f(material.diffuse[0], material.diffuse[1], material.diffuse[2]);
         pbr_mat.specular_color = stage_vec3f(material.specular[0], material.specular[1], material.specular[2]);
@@ -177,18 +510,9 @@ OBJScene::loadObj() {
         pbr_mat.transmission_weight = 1.f - material.dissolve;
         
         if (!material.diffuse_texname.empty()) {
-            if (texture_index_map.find(material.diffuse_texname) != texture_index_map.end()) {
-                pbr_mat.base_color_texid = texture_index_map.at(material.diffuse_texname);
-            } else {
-                std::filesystem::path texture_filename = getAbsolutePath(material.diffuse_texname);
-                Image diffuse_texture(texture_filename.string());
-                if (diffuse_texture.isValid()) { 
-                    m_textures.push_back(std::move(diffuse_texture));
-                    pbr_mat.base_color_texid = m_textures.size() - 1;
-                    texture_index_map[material.diffuse_texname] = m_textures.size() - 1;
-                    LOG("Read texture image '" + material.diffuse_texname + "'");
-                }
-            }
+            std::filesystem::path texture_filename = getAbsolutePath(material.diffuse_texname);
+            pbr_mat.base_color_texid = texture_loader.load(texture_filename.string());
+            LOG("Read texture image '" + material.diffuse_texname + "'");
         }
 
         LOG("Read material '" + material.name + "'");
@@ -196,65 +520,69 @@ OBJScene::loadObj() {
     }
     // Add a default material for faces that do not have a material id
     m_materials.push_back(OpenPBRMaterial::defaultMaterial());
+    uint32_t default_material_id = uint32_t(m_materials.size() - 1);
 
     // Parse meshes
-    Object obj(m_config.layout, m_config.vertex_alignment);
-    for (const auto& shape : shapes) {
-        const auto& mesh = shape.mesh;
-
-        std::map<std::tuple<uint32_t, uint32_t, uint32_t>, uint32_t> index_map; 
-
-        std::vector<stage_vec3f> positions;
-        std::vector<stage_vec3f> normals;
-        std::vector<stage_vec2f> uvs;
-        std::vector<uint32_t> material_ids;
-        std::vector<uint32_t> indices;
-
-        // Keep track of all the unique indices we use
-        uint32_t g_n_unique_idx_cnt = 0;
-
-        // Loop over faces in the mesh
-        for (size_t f = 0; f < mesh.num_face_vertices.size(); f++) {
-            size_t fv = size_t(mesh.num_face_vertices[f]);
-
-            if (fv != 3) {
-                ERR("Found non-triangular primitive with " + std::to_string(fv) + " vertices.");
-                return;
-            }
-
-            // Loop over vertices in the face
-            for (size_t v = 0; v < fv; v++){
-
-                tinyobj::index_t idx = mesh.indices[3 * f + v]; 
+    // The shapes' regions are reserved in the object in order, so the result is identical to a serial conversion,
+    // and the welded vertex attributes are copied from the staging data straight into their final location.
+    // Progress is only reported from this thread, so observers see it in order.
+    // The workers still check for cancellation, which TBB rethrows here.
+    reportProgress(LoadPhase_Geometry, 0.f);
+    bool has_uvs = std::any_of(shapes.begin(), shapes.end(), [](const ObjShape& shape) { return !shape.uvs.empty(); });
+    auto writeShape = [&](ObjShape& shape, GeometryBuilder& builder) {
+        for (size_t vertex_id = 0; vertex_id < shape.positions.size(); vertex_id++) {
+            builder.setPosition(vertex_id, shape.positions[vertex_id]);
+            builder.setNormal(vertex_id, shape.normals[vertex_id]);
+            if (has_uvs)
+                builder.setUV(vertex_id, shape.uvs[vertex_id]);
+            builder.setMaterialId(vertex_id, shape.material_ids[vertex_id] < 0 ? default_material_id : uint32_t(shape.material_ids[vertex_id]));
+        }
+        builder.indices() = std::move(shape.indices);
+        shape = ObjShape();
+    };
 
-                auto key = std::make_tuple(idx.vertex_index, idx.normal_index, idx.texcoord_index);
+    Object obj(m_config.layout, m_config.vertex_alignment, m_config.allocator);
+    if (m_config.sink) {
+        // Streamed shapes are built one at a time, so only a single chunk buffer is alive at once
+        for (size_t shape_id = 0; shape_id < shapes.size(); shape_id++) {
+            reportProgress(LoadPhase_Geometry, float(shape_id) / shapes.size());
+            auto& shape = shapes[shape_id];
+            GeometryBuilder builder = beginGeometry(obj, shape.positions.size(), has_uvs);
+            writeShape(shape, builder);
+            addGeometry(obj, m_num_objects, builder);
+        }
+    } else {
+        // All regions are reserved before any shape is written, the buffer must not be resized while shapes are written in parallel
+        size_t object_size = 0;
+        for (auto& shape : shapes) {
+            object_size += obj.geometrySizeInBytes(shape.positions.size(), has_uvs);
+        }
+        obj.data->reserve(object_size);
 
-                uint32_t g_index = 0;
-                if (index_map.find(key) != index_map.end()) {
-                    g_index = index_map.at(key);
-                } else {
-                    g_index = g_n_unique_idx_cnt++;
+        std::vector<GeometryBuilder> builders;
+        builders.reserve(shapes.size());
+        for (auto& shape : shapes) {
+            builders.push_back(beginGeometry(obj, shape.positions.size(), has_uvs));
+        }
 
-                    positions.push_back(make_vec3(&attrib.vertices[3 * idx.vertex_index]));
-                    normals.push_back(make_vec3(&attrib.normals[3 * idx.normal_index]));
-                    if (attrib.texcoords.size() > 0) {
-                        uvs.push_back(make_vec2(&attrib.texcoords[2 * idx.texcoord_index]));
-                    }
-                    material_ids.push_back(mesh.material_ids[f] < 0 ? m_materials.size() - 1 : mesh.material_ids[f]);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, shapes.size()), [&](const auto& r) {
+        if (m_progress) m_progress->check();
+        for (size_t shape_id = r.begin(); shape_id != r.end(); shape_id++) {
+            writeShape(shapes[shape_id], builders[shape_id]);
+        }
+        });
 
-                    index_map[key] = g_index;
-                }
-                indices.push_back(g_index);
-            }
+        for (auto& builder : builders) {
+            addGeometry(obj, m_num_objects, builder);
         }
-        Geometry g(obj, positions, normals, uvs, material_ids, indices);
-        obj.geometries.push_back(g);
-        LOG("Read geometry (v: " + std::to_string(g.positions.size()) + ", i: " + std::to_string(g.indices.size()) + ")");
     }
-    m_objects.push_back(obj);
+    addObject(std::move(obj));
+
+    reportProgress(LoadPhase_Textures, 1.f);
+    remapTextureIds(texture_loader.finish(true));
 
     // OBJ does not support instancing, so each object has one instance
-    for (uint32_t i = 0; i < m_objects.size(); i++) {
+    for (uint32_t i = 0; i < m_num_objects; i++) {
         ObjectInstance instance;
         instance.object_id = i;
         instance.instance_to_world = stage_mat4f(1.f);
@@ -415,14 +743,22 @@ void
 PBRTScene::loadPBRT() {
 
     std::shared_ptr<pbrt::Scene> pbrt_scene;
+    reportProgress(LoadPhase_Parse, 0.f);
     pbrt_scene = pbrt::importPBRT(m_scene_path);
 
     // Flatten hierarchy to avoid the pain of combining hierarchical instance transforms
     pbrt_scene->makeSingleLevel();
+    // After flattening, objects are the world and the objects referenced by its instances
+    m_num_pbrt_objects = 1 + pbrt_scene->world->instances.size();
+    reportProgress(LoadPhase_Geometry, 0.f);
 
     // Add a default material for faces that do not have a material id
     m_materials.push_back(OpenPBRMaterial::defaultMaterial());
 
+    // Textures are decoded in the background while the objects are imported
+    TextureLoader texture_loader(m_textures, m_config.lazy_textures, m_config.use_asset_cache, m_config.allocator, m_config.mip_filter);
+    m_texture_loader = &texture_loader;
+
     // Import objects
     std::map<std::shared_ptr<pbrt::Object>, uint32_t> object_map;
     std::map<std::shared_ptr<pbrt::Material>, uint32_t> material_map;
@@ -432,7 +768,7 @@ PBRTScene::loadPBRT() {
     // Import instances
     for(auto& instance : pbrt_scene->world->instances)
         loadPBRTInstancesRecursive(instance, object_map);
-    if (m_instances.size() == 0 && m_objects.size() > 0) {
+    if (m_instances.size() == 0 && m_num_objects > 0) {
         ObjectInstance root;
         root.object_id = 0;
         root.instance_to_world = stage_mat4f(1.f);
@@ -441,15 +777,17 @@ PBRTScene::loadPBRT() {
     }
 
     if (m_lights.size() == 0) {
-        Image sky_texture("sky.exr", true);
-        m_textures.push_back(std::move(sky_texture));
-
         Light light = Light::defaultLight();
         light.type = LightType::InfiniteLight;
-        light.map_texid = m_textures.size() - 1;
+        light.map_texid = texture_loader.load("sky.exr", true);
         m_lights.push_back(light);
     }
 
+    // PBRT keeps textures that failed to load, so no indices change here
+    reportProgress(LoadPhase_Textures, 1.f);
+    texture_loader.finish(false);
+    m_texture_loader = nullptr;
+
     // Import camera
     if (pbrt_scene->cameras.size() > 0) {
         auto& camera = pbrt_scene->cameras[0]; // parse the first available camera
@@ -471,8 +809,20 @@ PBRTScene::loadPBRTObjectsRecursive(std::shared_ptr<pbrt::Object> current,
     if (!current || object_map.find(current) != object_map.end()) return;
 
     // Load shapes
-    Object obj(m_config.layout, m_config.vertex_alignment);
+    // The buffer is reserved for the source vertex counts. Shapes that need face normals may have more vertices after welding and grow it.
+    Object obj(m_config.layout, m_config.vertex_alignment, m_config.allocator);
+    if (!m_config.sink) {
+        size_t object_size = 0;
+        for (auto& shape : current->shapes) {
+            pbrt::TriangleMesh::SP mesh = std::dynamic_pointer_cast<pbrt::TriangleMesh>(shape);
+            if (mesh)
+                object_size += obj.geometrySizeInBytes(mesh->vertex.size(), mesh->texcoord.size() == mesh->vertex.size());
+        }
+        obj.data->reserve(object_size);
+    }
     for (auto& shape : current->shapes) {
+        reportProgress(LoadPhase_Geometry, std::min(float(object_map.size()) / m_num_pbrt_objects, 1.f));
+
         // Non-triangle shapes are not supported
         pbrt::TriangleMesh::SP mesh = std::dynamic_pointer_cast<pbrt::TriangleMesh>(shape);
         if (!mesh) continue;
@@ -488,40 +838,72 @@ PBRTScene::loadPBRTObjectsRecursive(std::shared_ptr<pbrt::Object> current,
             LOG("Parsed material '" + mesh->material->name + "'");
         }
 
-        std::vector<stage_vec3f> positions;
-        std::vector<stage_vec3f> normals;
-        std::vector<stage_vec2f> uvs;
-        std::vector<uint32_t> material_ids;
-        std::vector<uint32_t> indices;
-        uint32_t g_n_idx_cnt = 0;
-
-        for (auto& index : mesh->index) {
-            for (int i = 0; i < 3; i++) {
-                auto position = mesh->vertex[*(&index.x + i)];
-                positions.push_back(make_vec3(&position.x));
-
-                if (mesh->normal.size() > 0) {
-                    auto normal = mesh->normal[*(&index.x + i)];
-                    normals.push_back(make_vec3(&normal.x));
-                } else {
-                    const auto& v0 = make_vec3(&mesh->vertex[index.x].x);
-                    const auto& v1 = make_vec3(&mesh->vertex[index.y].x);
-                    const auto& v2 = make_vec3(&mesh->vertex[index.z].x);
-                    normals.push_back(normalize(cross((v1 - v0), (v2 - v0))));
-                }
+        bool has_normals = mesh->normal.size() == mesh->vertex.size();
+        bool has_uvs = mesh->texcoord.size() == mesh->vertex.size();
+        if (has_normals) {
+            // Per-vertex normals are available, so the source vertices and indices can be used as they are
+            GeometryBuilder builder = beginGeometry(obj, mesh->vertex.size(), has_uvs);
+            for (size_t vertex_id = 0; vertex_id < mesh->vertex.size(); vertex_id++) {
+                builder.setPosition(vertex_id, make_vec3(&mesh->vertex[vertex_id].x));
+                builder.setNormal(vertex_id, make_vec3(&mesh->normal[vertex_id].x));
+                if (has_uvs)
+                    builder.setUV(vertex_id, make_vec2(&mesh->texcoord[vertex_id].x));
+                builder.setMaterialId(vertex_id, material_id);
+            }
 
-                if (mesh->texcoord.size() > 0) {
-                    auto uv = mesh->texcoord[*(&index.x + i)];
-                    uvs.push_back(make_vec2(&uv.x));
+            auto& indices = builder.indices();
+            indices.reserve(3 * mesh->index.size());
+            for (auto& index : mesh->index) {
+                indices.push_back(index.x);
+                indices.push_back(index.y);
+                indices.push_back(index.z);
+            }
+            addGeometry(obj, m_num_objects, builder);
+        } else {
+            // Face normals have to be generated. A vertex is only shared between triangles that have the same face normal.
+            // Welding only records the source vertex and normal of each unique vertex, the attributes are written once the count is known.
+            VertexWelder<stage_vec3i> normal_welder;
+            VertexWelder<uint64_t> welder(mesh->vertex.size());
+            std::vector<stage_vec3f> face_normals;
+            std::vector<uint64_t> vertices;     // Source vertex id in the low and normal id in the high bits
+            std::vector<uint32_t> indices;
+            indices.reserve(3 * mesh->index.size());
+
+            for (auto& index : mesh->index) {
+                const auto& v0 = make_vec3(&mesh->vertex[index.x].x);
+                const auto& v1 = make_vec3(&mesh->vertex[index.y].x);
+                const auto& v2 = make_vec3(&mesh->vertex[index.z].x);
+                stage_vec3f normal = normalize(cross((v1 - v0), (v2 - v0)));
+
+                stage_vec3i normal_key;
+                std::memcpy(&normal_key, &normal, sizeof(normal));
+                bool is_new_normal;
+                uint64_t normal_id = normal_welder.weld(normal_key, is_new_normal);
+                if (is_new_normal)
+                    face_normals.push_back(normal);
+
+                for (int i = 0; i < 3; i++) {
+                    uint32_t vertex_id = *(&index.x + i);
+                    uint64_t vertex = uint64_t(vertex_id) | normal_id << 32;
+                    bool is_new_vertex;
+                    indices.push_back(welder.weld(vertex, is_new_vertex));
+                    if (is_new_vertex)
+                        vertices.push_back(vertex);
                 }
-                material_ids.push_back(material_id);
-                indices.emplace_back(g_n_idx_cnt++);
             }
-        }
 
-        Geometry g(obj, positions, normals, uvs, material_ids, indices);
-        obj.geometries.push_back(g);
-        LOG("Read geometry (v: " + std::to_string(g.positions.size()) + ", i: " + std::to_string(g.indices.size()) + ")");
+            GeometryBuilder builder = beginGeometry(obj, vertices.size(), has_uvs);
+            for (size_t i = 0; i < vertices.size(); i++) {
+                uint32_t vertex_id = uint32_t(vertices[i]);
+                builder.setPosition(i, make_vec3(&mesh->vertex[vertex_id].x));
+                builder.setNormal(i, face_normals[vertices[i] >> 32]);
+                if (has_uvs)
+                    builder.setUV(i, make_vec2(&mesh->texcoord[vertex_id].x));
+                builder.setMaterialId(i, material_id);
+            }
+            builder.indices() = std::move(indices);
+            addGeometry(obj, m_num_objects, builder);
+        }
     }
 
     // Load light sources
@@ -537,10 +919,7 @@ PBRTScene::loadPBRTObjectsRecursive(std::shared_ptr<pbrt::Object> current,
 
             if (!infinite_light->mapName.empty()) {
                 std::filesystem::path filename = getAbsolutePath(infinite_light->mapName);
-                Image infinite_light_map(filename.string(), true);
-                m_textures.push_back(std::move(infinite_light_map));
-
-                light.map_texid = m_textures.size() - 1;
+                light.map_texid = m_texture_loader->load(filename.string(), true);
             }
             LOG("Parsed infinite light source");
         }
@@ -602,8 +981,7 @@ PBRTScene::loadPBRTObjectsRecursive(std::shared_ptr<pbrt::Object> current,
     }
 
     if (obj.geometries.size() > 0) {
-        object_map[current] = m_objects.size();
-        m_objects.push_back(obj);
+        object_map[current] = addObject(std::move(obj));
     }
 
     for (auto& instance : current->instances) {
@@ -788,8 +1166,11 @@ PBRTScene::loadPBRTMaterialUber(pbrt::UberMaterial& material, OpenPBRMaterial& p
 
 bool
 PBRTScene::loadPBRTTexture(std::shared_ptr<pbrt::Texture> texture, std::map<std::shared_ptr<pbrt::Texture>, uint32_t>& texture_index_map, uint32_t& texture_index) {
-    if (texture_index_map.find(texture) != texture_index_map.end()) {
-        texture_index = texture_index_map[texture];
+    auto it = texture_index_map.find(texture);
+    if (it != texture_index_map.end()) {
+        // Every user counts, so that Scale and Mix nodes never modify pixels another material still uses
+        texture_index = m_texture_loader->reference(it->second);
+        it->second = texture_index;
         return true;
     }
 
@@ -804,11 +1185,9 @@ PBRTScene::loadPBRTTexture(std::shared_ptr<pbrt::Texture> texture, std::map<std:
 
     if (constant_texture) {
         stage_vec3f color = make_vec3(&constant_texture->value.x);
-        Image img(color);
-        m_textures.push_back(std::move(img));
+        texture_index = m_texture_loader->add(Image(color, m_config.allocator));
         LOG("Read constant image (" + std::to_string(color.x) + ", " + std::to_string(color.y) + ", " + std::to_string(color.z) + ")");
-        texture_index_map[texture] = m_textures.size() - 1;
-        texture_index = m_textures.size() - 1;
+        texture_index_map[texture] = texture_index;
         return true;
     }
 
@@ -817,17 +1196,21 @@ PBRTScene::loadPBRTTexture(std::shared_ptr<pbrt::Texture> texture, std::map<std:
         bool has_tex1 = scale_texture->tex1 && loadPBRTTexture(scale_texture->tex1, texture_index_map, tex1_idx);
         bool has_tex2 = scale_texture->tex2 && loadPBRTTexture(scale_texture->tex2, texture_index_map, tex2_idx);
 
+        // The textures may still be decoding, so the operations are applied once loading has finished.
+        // The result is written to the first texture, which must not be shared with other texture nodes.
+        if (has_tex1) tex1_idx = m_texture_loader->makeUnique(tex1_idx);
+        if (has_tex2 && !has_tex1) tex2_idx = m_texture_loader->makeUnique(tex2_idx);
+
         if (has_tex1 && !has_tex2) {
-            // m_textures[tex1_idx].scale(make_vec3(&scale_texture->scale2.x));
-            m_textures[tex1_idx].scale(make_vec3(&scale_texture->scale2.x));
+            stage_vec3f scale = make_vec3(&scale_texture->scale2.x);
+            m_texture_loader->defer([=](std::vector<Image>& textures) { textures[tex1_idx].scale(scale); });
             texture_index = tex1_idx;
         } else if (has_tex2 && !has_tex1) {
-            // m_textures[tex2_idx].scale(make_vec3(&scale_texture->scale1.x));
-            m_textures[tex2_idx].scale(make_vec3(&scale_texture->scale1.x));
+            stage_vec3f scale = make_vec3(&scale_texture->scale1.x);
+            m_texture_loader->defer([=](std::vector<Image>& textures) { textures[tex2_idx].scale(scale); });
             texture_index = tex2_idx;
         } else if (has_tex1 && has_tex2) {
-            auto& tex2 = m_textures[tex2_idx];
-            m_textures[tex1_idx].scale(tex2);
+            m_texture_loader->defer([=](std::vector<Image>& textures) { textures[tex1_idx].scale(textures[tex2_idx]); });
             texture_index = tex1_idx;
         } else {
             return false;
@@ -841,24 +1224,20 @@ PBRTScene::loadPBRTTexture(std::shared_ptr<pbrt::Texture> texture, std::map<std:
         bool has_tex1 = mix_texture->tex1 && loadPBRTTexture(mix_texture->tex1, texture_index_map, tex1_idx);
         bool has_tex2 = mix_texture->tex2 && loadPBRTTexture(mix_texture->tex2, texture_index_map, tex2_idx);
 
+        if (has_tex1) tex1_idx = m_texture_loader->makeUnique(tex1_idx);
+        if (has_tex2 && !has_tex1) tex2_idx = m_texture_loader->makeUnique(tex2_idx);
+
+        stage_vec3f amount = make_vec3(&mix_texture->amount.x);
         if (has_tex1 && !has_tex2) {
-            // m_textures[tex1_idx].mix(make_vec3(&mix_texture->scale2.x), 
-                                //   make_vec3(&mix_texture->amount.x));
-            m_textures[tex1_idx].mix(make_vec3(&mix_texture->scale2.x), 
-                                  make_vec3(&mix_texture->amount.x));
+            stage_vec3f color = make_vec3(&mix_texture->scale2.x);
+            m_texture_loader->defer([=](std::vector<Image>& textures) { textures[tex1_idx].mix(color, amount); });
             texture_index = tex1_idx;
         } else if (has_tex2 && !has_tex1) {
-            // m_textures[tex2_idx].mix(make_vec3(&mix_texture->scale1.x), 
-                                //   make_vec3(&mix_texture->amount.x));
-            m_textures[tex2_idx].mix(make_vec3(&mix_texture->scale1.x), 
-                                  make_vec3(&mix_texture->amount.x));
+            stage_vec3f color = make_vec3(&mix_texture->scale1.x);
+            m_texture_loader->defer([=](std::vector<Image>& textures) { textures[tex2_idx].mix(color, amount); });
             texture_index = tex2_idx;
         } else if (has_tex1 && has_tex2) {
-            auto& tex2 = m_textures[tex2_idx];
-            // m_textures[tex1_idx].mix(tex2, 
-                                //   make_vec3(&mix_texture->amount.x));
-            m_textures[tex1_idx].mix(tex2, 
-                                  make_vec3(&mix_texture->amount.x));
+            m_texture_loader->defer([=](std::vector<Image>& textures) { textures[tex1_idx].mix(textures[tex2_idx], amount); });
             texture_index = tex1_idx;
         } else {
             return false;
@@ -869,11 +1248,9 @@ PBRTScene::loadPBRTTexture(std::shared_ptr<pbrt::Texture> texture, std::map<std:
 
     if (image_texture) {
         std::filesystem::path texture_filename = getAbsolutePath(image_texture->fileName);
-        Image img(texture_filename.string()); 
-        m_textures.push_back(std::move(img));
+        texture_index = m_texture_loader->load(texture_filename.string());
         LOG("Read texture image '" + image_texture->fileName + "'");
-        texture_index_map[texture] = m_textures.size() - 1;
-        texture_index = m_textures.size() - 1;
+        texture_index_map[texture] = texture_index;
         return true;
     }
 
@@ -958,18 +1335,36 @@ PBRTScene::loadPBRTSpectrum(pbrt::Spectrum& spectrum) {
 
 void FBXScene::loadFBX() {
     ufbx_load_opts opts = { }; // Optional, pass NULL for defaults
-    opts.progress_cb.fn = nullptr;
-    opts.progress_cb.user = nullptr;
+    // ufbx is C code, so the callback must not throw. Cancellation is requested through the return value instead.
+    opts.progress_cb.fn = [](void* user, const ufbx_progress* progress) {
+        LoadProgress* load_progress = (LoadProgress*)user;
+        if (load_progress->isCancelled())
+            return UFBX_PROGRESS_CANCEL;
+        load_progress->set(LoadPhase_Parse, progress->bytes_total > 0 ? float(progress->bytes_read) / progress->bytes_total : 0.f);
+        return UFBX_PROGRESS_CONTINUE;
+    };
+    opts.progress_cb.user = m_progress;
+    if (!m_progress)
+        opts.progress_cb.fn = nullptr;
 
     ufbx_error error; // Optional, pass NULL if you don't care about errors
     ufbx_scene *fbx_scene = ufbx_load_file(m_scene_path.string().c_str(), &opts, &error);
     if (!fbx_scene) {
+        if (m_progress) m_progress->check();
         throw std::runtime_error(error.description.data);
     }
+    // Frees the scene also when loading is cancelled part way through
+    std::unique_ptr<ufbx_scene, void(*)(ufbx_scene*)> fbx_scene_guard(fbx_scene, ufbx_free_scene);
+
+    // Textures are decoded in the background while the meshes are converted.
+    // Embedded textures point into the ufbx scene, so the loader must finish before the scene is freed.
+    TextureLoader texture_loader(m_textures, m_config.lazy_textures, m_config.use_asset_cache, m_config.allocator, m_config.mip_filter);
+    m_texture_loader = &texture_loader;
 
     // Parse materials
     std::map<uint32_t, uint32_t> material_map;
     for (size_t materialid = 0; materialid < fbx_scene->materials.count; materialid++) {
+        reportProgress(LoadPhase_Textures, float(materialid) / fbx_scene->materials.count);
         auto* fbx_material = fbx_scene->materials.data[materialid];
 
         OpenPBRMaterial material = OpenPBRMaterial::defaultMaterial();
@@ -994,15 +1389,16 @@ void FBXScene::loadFBX() {
         material.geometry_opacity = fbx_material->pbr.opacity.value_real;
 
         // Load textures
+        uint32_t texture_index;
         if (fbx_material->pbr.base_color.texture_enabled) {
-            if (loadFBXTexture(fbx_material->pbr.base_color.texture)) {
-                material.base_color_texid = m_textures.size() - 1;
+            if (loadFBXTexture(fbx_material->pbr.base_color.texture, texture_index)) {
+                material.base_color_texid = texture_index;
             }
         }
 
         if (fbx_material->pbr.opacity.texture_enabled) {
-            if (loadFBXTexture(fbx_material->pbr.opacity.texture)) {
-                material.geometry_opacity_texid = m_textures.size() - 1;
+            if (loadFBXTexture(fbx_material->pbr.opacity.texture, texture_index)) {
+                material.geometry_opacity_texid = texture_index;
             }
         }
 
@@ -1016,52 +1412,29 @@ void FBXScene::loadFBX() {
     // Parse objects
     uint32_t triangulate_indices[1024];
     for (size_t meshid = 0; meshid < fbx_scene->meshes.count; meshid++) {
+        reportProgress(LoadPhase_Geometry, float(meshid) / fbx_scene->meshes.count);
         auto* fbx_mesh = fbx_scene->meshes[meshid];
         if (fbx_mesh->instances.count == 0) continue;
 
-        Object obj(m_config.layout, m_config.vertex_alignment);
+        Object obj(m_config.layout, m_config.vertex_alignment, m_config.allocator);
 
-        std::map<uint32_t, uint32_t> index_map;
-
-        std::vector<stage_vec3f> positions;
-        std::vector<stage_vec3f> normals;
-        std::vector<stage_vec2f> uvs;
+        // Welding only records the source index of each unique vertex, the attributes are written once the count is known
+        VertexWelder<uint32_t> welder(fbx_mesh->num_indices);
+        std::vector<uint32_t> vertices;
         std::vector<uint32_t> material_ids;
         std::vector<uint32_t> indices;
 
-        // Keep track of all the unique indices we use
-        uint32_t g_n_unique_idx_cnt = 0;
-
         for (uint32_t faceid = 0; faceid < fbx_mesh->num_faces; faceid++) {
             size_t num_tris = ufbx_triangulate_face(triangulate_indices, 1024, fbx_mesh, fbx_mesh->faces[faceid]);
 
             for (uint32_t triangleid = 0; triangleid < num_tris; triangleid++) {
                 for (uint32_t vertexid = 0; vertexid < 3; vertexid++) {
                     uint32_t index = triangulate_indices[triangleid*3 + vertexid];
-                    uint32_t g_index = 0;
-                    if (index_map.find(index) != index_map.end()) {
-                        g_index = index_map.at(index);
-                    } else {
-                        g_index = g_n_unique_idx_cnt++;
-
-                        ufbx_vec3 position = ufbx_get_vertex_vec3(&fbx_mesh->vertex_position, index);
-                        ufbx_vec3 normal = ufbx_get_vertex_vec3(&fbx_mesh->vertex_normal, index);
-                        ufbx_vec2 uv = fbx_mesh->vertex_uv.exists ? ufbx_get_vertex_vec2(&fbx_mesh->vertex_uv, index) : ufbx_vec2({0, 0});
-                        stage_vec3f stage_position;
-                        stage_position.x = position.x;
-                        stage_position.y = position.y;
-                        stage_position.z = position.z;
-                        stage_vec3f stage_normal;
-                        stage_normal.x = normal.x;
-                        stage_normal.y = normal.y;
-                        stage_normal.z = normal.z;
-                        stage_vec2f stage_uv;
-                        stage_uv.x = uv.x;
-                        stage_uv.y = uv.y;
-                        positions.push_back(stage_position);
-                        normals.push_back(stage_normal);
-                        uvs.push_back(stage_uv);
-                        
+                    bool is_new_vertex;
+                    uint32_t g_index = welder.weld(index, is_new_vertex);
+                    if (is_new_vertex) {
+                        vertices.push_back(index);
+
                         if (fbx_mesh->face_material.count > 0) {
                             auto* fbx_material = fbx_mesh->materials.data[fbx_mesh->face_material[faceid]];
                             uint32_t materialid = fbx_material->element_id;
@@ -1073,24 +1446,33 @@ void FBXScene::loadFBX() {
                         } else {
                             material_ids.push_back(m_materials.size() - 1);
                         }
-
-                        index_map[index] = g_index;
                     }
                     indices.push_back(g_index);
                 }
             }
         }
-        Geometry g(obj, positions, normals, uvs, material_ids, indices);
-        obj.geometries.push_back(g);
-        LOG("Read geometry (v: " + std::to_string(g.positions.size()) +", i: " + std::to_string(g.indices.size()) + ")");
-        m_objects.push_back(obj);
+
+        GeometryBuilder builder = beginGeometry(obj, vertices.size());
+        for (size_t vertex_id = 0; vertex_id < vertices.size(); vertex_id++) {
+            uint32_t index = vertices[vertex_id];
+            ufbx_vec3 position = ufbx_get_vertex_vec3(&fbx_mesh->vertex_position, index);
+            ufbx_vec3 normal = ufbx_get_vertex_vec3(&fbx_mesh->vertex_normal, index);
+            ufbx_vec2 uv = fbx_mesh->vertex_uv.exists ? ufbx_get_vertex_vec2(&fbx_mesh->vertex_uv, index) : ufbx_vec2({0, 0});
+            builder.setPosition(vertex_id, stage_vec3f(position.x, position.y, position.z));
+            builder.setNormal(vertex_id, stage_vec3f(normal.x, normal.y, normal.z));
+            builder.setUV(vertex_id, stage_vec2f(uv.x, uv.y));
+            builder.setMaterialId(vertex_id, material_ids[vertex_id]);
+        }
+        builder.indices() = std::move(indices);
+        addGeometry(obj, m_num_objects, builder);
+        uint32_t object_id = addObject(std::move(obj));
 
         // Parse instances
         for (uint32_t instanceid = 0; instanceid < fbx_mesh->instances.count; instanceid++) {
             auto* fbx_instance = fbx_mesh->instances[instanceid];
 
             ObjectInstance instance;
-            instance.object_id = m_objects.size() - 1;
+            instance.object_id = object_id;
             instance.instance_to_world = stage_mat4f(
                 stage_vec4f(stage_vec3f(fbx_instance->node_to_world.cols[0].x, fbx_instance->node_to_world.cols[0].y, fbx_instance->node_to_world.cols[0].z), 0.f),
                 stage_vec4f(stage_vec3f(fbx_instance->node_to_world.cols[1].x, fbx_instance->node_to_world.cols[1].y, fbx_instance->node_to_world.cols[1].z), 0.f),
@@ -1110,30 +1492,44 @@ void FBXScene::loadFBX() {
         // m_camera->position = make_vec3(&fbx_camera->element.instances[0]->unscaled_node_to_world.cols[3].x);
     }
 
-    ufbx_free_scene(fbx_scene);
+    reportProgress(LoadPhase_Textures, 1.f);
+    remapTextureIds(texture_loader.finish(true));
+    m_texture_loader = nullptr;
 }
 
 bool 
-FBXScene::loadFBXTexture(ufbx_texture *texture)
+FBXScene::loadFBXTexture(ufbx_texture *texture, uint32_t& texture_index)
 {
-    std::unique_ptr<Image> image;
+    if (!texture) return false;
+
     if (texture->content.size > 0)
     {
-        image = std::make_unique<Image>((uint8_t*)texture->content.data, texture->content.size);
-        if (image->isValid()) LOG("Read texture image blob");
+        texture_index = m_texture_loader->load((uint8_t*)texture->content.data, texture->content.size);
+        LOG("Read texture image blob");
     }
     else
     {
         std::filesystem::path filepath = getAbsolutePath(texture->relative_filename.data);
-        image = std::make_unique<Image>(filepath.string());
-        if (image->isValid()) LOG("Read texture image '" + filename + "'");
+        texture_index = m_texture_loader->load(filepath.string());
+        LOG("Read texture image '" + filepath.string() + "'");
     }
-    if (image->isValid())
-    {
-        m_textures.push_back(std::move(*image));
-        return true;
+    return true;
+}
+
+void
+CachedScene::loadAssets(const SceneAssets& assets) {
+    m_camera = assets.camera ? std::make_shared<Camera>(*assets.camera) : nullptr;
+    m_objects = assets.objects;
+    m_instances = assets.instances;
+    m_materials = assets.materials;
+    m_lights = assets.lights;
+    m_scene_scale = assets.scene_scale;
+
+    m_textures.reserve(assets.textures.size());
+    for (auto& texture : assets.textures) {
+        m_textures.emplace_back(texture);
     }
-    return false;
 }
+
 }
 }
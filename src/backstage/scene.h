@@ -5,12 +5,15 @@
 #include <map>
 #include <string>
 #include <filesystem>
+#include <future>
 
 #include "log.h"
 #include "config.h"
+#include "progress.h"
 #include "math.h"
 #include "camera.h"
 #include "mesh.h"
+#include "optimize.h"
 #include "material.h"
 #include "light.h"
 #include "image.h"
@@ -19,6 +22,7 @@
 namespace tinyobj {
     struct attrib_t;
     struct shape_t;
+    struct material_t;
 }
 
 namespace pbrt {
@@ -43,10 +47,14 @@ struct ufbx_texture;
 namespace stage {
 namespace backstage {
 
+struct TextureLoader;
+struct SceneAssets;
+struct ObjShape;
+
 struct Scene {
 
     public:
-        ~Scene() = default;
+        virtual ~Scene() = default;
         Scene(const Scene &) = delete;
         Scene &operator=(const Scene &) = delete;
         
@@ -58,16 +66,31 @@ struct Scene {
         std::vector<Image>& getTextures() { return m_textures; }
 
         float getSceneScale() { return m_scene_scale; }
+        AABB getSceneBounds() { return m_scene_bounds; }
 
     protected:
-        Scene(std::string scene, const Config& config) {
+        Scene(std::string scene, const Config& config, LoadProgress* progress) {
             updateFilePaths(scene);
             m_config = config;
+            m_progress = progress;
         }
 
         /* Utility Functions */
+        /* Scenes restored from snapshots or the asset cache pass `process_geometry = false`, their geometry was processed when it was first loaded */
+        void finalize(bool process_geometry = true);
+        void reportProgress(LoadPhase phase, float fraction);
+        void remapTextureIds(const std::vector<int32_t>& remap);
+        GeometryBuilder beginGeometry(Object& object, size_t num_vertices, bool has_uvs = true);
+        void addGeometry(Object& object, uint32_t object_id, GeometryBuilder& builder);
+        uint32_t addObject(Object&& object);
+        void optimizeObjects();
+        void compactIndices();
+        void buildObjectMeshlets();
+        void generateTextureMips();
+        void compressTextures();
+        void streamScene();
         void updateFilePaths(std::string scene);
-        void updateSceneScale();
+        void updateSceneBounds();
         float luminance(stage_vec3f c);
         std::filesystem::path getAbsolutePath(std::filesystem::path p);
 
@@ -80,21 +103,31 @@ struct Scene {
         std::vector<Image> m_textures;
 
         float m_scene_scale { 1.f };
+        AABB m_scene_bounds;
+        uint32_t m_num_objects { 0 };
+        std::vector<AABB> m_object_bounds;      // Only tracked when streaming to a sink
+        VertexCacheStats m_vertex_cache_stats;
         std::filesystem::path m_scene_path;
         std::filesystem::path m_base_path;
         Config m_config;
+        LoadProgress* m_progress { nullptr };
+        TextureLoader* m_texture_loader { nullptr };    // Only set while loading
 };
 
 struct OBJScene : public Scene {
     public:
-        OBJScene(std::string scene, const Config& config) : Scene(scene, config) { 
+        OBJScene(std::string scene, const Config& config, LoadProgress* progress = nullptr) : Scene(scene, config, progress) { 
             loadObj();
-            updateSceneScale();
-            SUCC("Finished loading " + std::to_string(m_objects.size()) + " objects and " + std::to_string(m_instances.size()) + " instances."); }
+            finalize(); }
 
     private:
         /* OBJ Parsing */
         void loadObj();
+        bool loadTinyObj(std::string mtl_search_path,
+                         std::vector<ObjShape>& shapes,
+                         std::vector<tinyobj::material_t>& materials,
+                         std::string& warning,
+                         std::string& error);
 
         void computeSmoothingShape(const tinyobj::attrib_t& in_attrib, const tinyobj::shape_t& in_shape,
                                   std::vector<std::pair<unsigned int, unsigned int>>& sorted_ids,
@@ -111,10 +144,9 @@ struct OBJScene : public Scene {
 
 struct PBRTScene : public Scene {
     public:
-        PBRTScene(std::string scene, const Config& config) : Scene(scene, config) { 
-            loadPBRT(); 
-            updateSceneScale();
-            SUCC("Finished loading " + std::to_string(m_objects.size()) + " objects and " + std::to_string(m_instances.size()) + " instances."); }
+        PBRTScene(std::string scene, const Config& config, LoadProgress* progress = nullptr) : Scene(scene, config, progress) { 
+            loadPBRT();
+            finalize(); }
     
     private:
         /* PBRT Parsing */
@@ -139,21 +171,51 @@ struct PBRTScene : public Scene {
         bool loadPBRTTexture(std::shared_ptr<pbrt::Texture> texture, std::map<std::shared_ptr<pbrt::Texture>, uint32_t>& texture_index_map, uint32_t& texture_index);        
 
         stage_vec3f loadPBRTSpectrum(pbrt::Spectrum& spectrum);
+
+        size_t m_num_pbrt_objects { 1 };
 };
 
 struct FBXScene : public Scene {
     public:
-        FBXScene(std::string scene, const Config& config) : Scene(scene, config) { 
-            loadFBX(); 
-            updateSceneScale();
-            SUCC("Finished loading " + std::to_string(m_objects.size()) + " objects and " + std::to_string(m_instances.size()) + " instances."); }
+        FBXScene(std::string scene, const Config& config, LoadProgress* progress = nullptr) : Scene(scene, config, progress) { 
+            loadFBX();
+            finalize(); }
     
     private:
         void loadFBX();
-        bool loadFBXTexture(ufbx_texture* texture);
+        bool loadFBXTexture(ufbx_texture* texture, uint32_t& texture_index);
+};
+
+struct SnapshotScene : public Scene {
+    public:
+        SnapshotScene(std::string scene, const Config& config, LoadProgress* progress = nullptr) : Scene(scene, config, progress) { 
+            loadSnapshot(); 
+            finalize(false); }
+    
+    private:
+        void loadSnapshot();
+};
+
+struct CachedScene : public Scene {
+    public:
+        CachedScene(std::string scene, const Config& config, const SceneAssets& assets, LoadProgress* progress = nullptr) : Scene(scene, config, progress) { 
+            loadAssets(assets); 
+            finalize(false); }
+    
+    private:
+        void loadAssets(const SceneAssets& assets);
+};
+
+/* Loads a scene synchronously. Returns nullptr on failure or if loading was cancelled through `progress`. */
+std::unique_ptr<Scene> createScene(std::string scene, const Config& config, LoadProgress* progress = nullptr);
+
+struct AsyncLoad {
+    std::shared_ptr<LoadProgress> progress;
+    std::future<std::unique_ptr<Scene>> result;
 };
 
-std::unique_ptr<Scene> createScene(std::string scene, const Config& config);
+/* Loads a scene in a background task on the TBB scheduler. The result is nullptr on failure or cancellation. */
+AsyncLoad createSceneAsync(std::string scene, const Config& config);
 
 }
 }
\ No newline at end of file
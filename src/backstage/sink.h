@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include "image.h"
+#include "light.h"
+#include "material.h"
+#include "mesh.h"
+
+namespace stage {
+namespace backstage {
+
+/*
+ * Receives scene data while a scene is loaded in streaming mode, see Config::sink.
+ * Every geometry is handed over as soon as it has been converted, packed into an Object of its own that only holds this geometry.
+ * Geometries of snapshots and cached scenes are not copied: their Object shares the buffer of the source object, 
+ * whose other regions belong to the geometries delivered before and after it.
+ * `object_id` identifies the source object the geometry belongs to and is what instances refer to.
+ * Once all geometry has been delivered, textures, materials, lights and instances follow with their final indices.
+ * The loader releases its copy of geometry and texture data right after the callback returns, so a sink that wants 
+ * to keep it must take ownership of it, e.g. by copying the shared buffer pointer or moving the image.
+ * Callbacks are invoked one at a time from the loading thread. Exceptions thrown by a callback abort the load.
+ */
+struct SceneSink {
+    virtual ~SceneSink() = default;
+
+    virtual void onGeometry(uint32_t /*object_id*/, Object& /*object*/) {}
+    virtual void onTexture(uint32_t /*texture_id*/, Image& /*texture*/) {}
+    virtual void onMaterial(uint32_t /*material_id*/, const OpenPBRMaterial& /*material*/) {}
+    virtual void onLight(const Light& /*light*/) {}
+    virtual void onInstance(const ObjectInstance& /*instance*/) {}
+};
+
+}
+}
@@ -0,0 +1,308 @@
+#include "snapshot.h"
+#include "scene.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace stage {
+namespace backstage {
+
+namespace {
+
+/* Marker to detect snapshots written on a host with a different byte order */
+constexpr uint32_t snapshot_byte_order = 0x01020304;
+
+struct SnapshotWriter {
+    SnapshotWriter(std::string filename) : m_out(filename, std::ios::binary | std::ios::trunc) {
+        if (!m_out)
+            throw std::runtime_error("Unable to open " + filename + " for writing");
+    }
+
+    void write(const void* data, size_t size) {
+        if (size == 0) return;
+        m_out.write((const char*)data, size);
+        if (!m_out)
+            throw std::runtime_error("Failed to write snapshot");
+        m_offset += size;
+    }
+
+    template<typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Snapshot values must be trivially copyable");
+        write(&value, sizeof(T));
+    }
+
+    /* Writes a count followed by the aligned array contents */
+    template<typename T>
+    void putArray(const T* data, size_t count, size_t alignment = snapshot_alignment) {
+        static_assert(std::is_trivially_copyable<T>::value, "Snapshot values must be trivially copyable");
+        put<uint64_t>(count);
+        align(alignment);
+        write(data, count * sizeof(T));
+    }
+
+    void align(size_t alignment = snapshot_alignment) {
+        static const char zeros[snapshot_alignment] = {};
+        size_t padding = (alignment - m_offset % alignment) % alignment;
+        for (; padding > 0; padding -= std::min(padding, snapshot_alignment)) {
+            write(zeros, std::min(padding, snapshot_alignment));
+        }
+    }
+
+    void close() {
+        m_out.close();
+        if (!m_out)
+            throw std::runtime_error("Failed to write snapshot");
+    }
+
+private:
+    std::ofstream m_out;
+    size_t m_offset { 0 };
+};
+
+struct SnapshotReader {
+    SnapshotReader(uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+    uint8_t* take(size_t size) {
+        if (size > m_size - m_offset)
+            throw std::runtime_error("Snapshot is truncated or corrupt");
+        uint8_t* ptr = m_data + m_offset;
+        m_offset += size;
+        return ptr;
+    }
+
+    template<typename T>
+    T get() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    /* Returns a pointer to an array written by SnapshotWriter::putArray, the data is not copied */
+    template<typename T>
+    T* getArray(size_t& count, size_t alignment = snapshot_alignment) {
+        count = get<uint64_t>();
+        align(alignment);
+        if (count > (m_size - m_offset) / sizeof(T))
+            throw std::runtime_error("Snapshot is truncated or corrupt");
+        return (T*)take(count * sizeof(T));
+    }
+
+    template<typename T>
+    std::vector<T> getVector() {
+        size_t count;
+        T* data = getArray<T>(count);
+        return std::vector<T>(data, data + count);
+    }
+
+    void align(size_t alignment = snapshot_alignment) {
+        size_t padding = (alignment - m_offset % alignment) % alignment;
+        take(padding);
+    }
+
+private:
+    uint8_t* m_data;
+    size_t m_size;
+    size_t m_offset { 0 };
+};
+
+struct SnapshotView {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t stride;
+    uint64_t alignment;
+    uint8_t valid;
+};
+
+template<typename T>
+SnapshotView
+makeSnapshotView(const BufferView<T>& view) {
+    SnapshotView result {};
+    result.valid = view.isValid();
+    if (result.valid) {
+        result.offset = view.offset();
+        result.size = view.size();
+        result.stride = view.stride();
+        result.alignment = view.alignment();
+    }
+    return result;
+}
+
+template<typename T>
+BufferView<T>
+makeBufferView(std::shared_ptr<Buffer> buffer, const SnapshotView& view) {
+    if (!view.valid)
+        return BufferView<T>();
+    if (view.size > 0 && (view.stride < sizeof(T) || view.offset + (view.size - 1) * view.stride + sizeof(T) > buffer->size()))
+        throw std::runtime_error("Snapshot contains an out of bounds buffer view");
+    return BufferView<T>(buffer, view.offset, view.size, view.stride, view.alignment);
+}
+
+}
+
+void
+writeSnapshot(Scene& scene, std::string filename) {
+    // Write to a temporary file first so that readers never observe a partially written snapshot
+    std::string temporary = filename + ".tmp";
+    {
+        SnapshotWriter out(temporary);
+
+        out.write(snapshot_magic, sizeof(snapshot_magic));
+        out.put<uint32_t>(snapshot_version);
+        out.put<uint32_t>(snapshot_byte_order);
+
+        out.put<float>(scene.getSceneScale());
+        auto camera = scene.getCamera();
+        out.put<uint8_t>(camera != nullptr);
+        if (camera)
+            out.put<Camera>(*camera);
+
+        auto& materials = scene.getMaterials();
+        out.putArray(materials.data(), materials.size());
+        auto& lights = scene.getLights();
+        out.putArray(lights.data(), lights.size());
+        auto& instances = scene.getInstances();
+        out.putArray(instances.data(), instances.size());
+
+        auto& textures = scene.getTextures();
+        out.put<uint64_t>(textures.size());
+        for (auto& texture : textures) {
+            // Decodes lazy textures, which may turn out to be invalid only now
+            uint8_t* data = texture.getData();
+            out.put<uint8_t>(texture.isValid());
+            out.put<uint8_t>(texture.isHDR());
+            out.put<int32_t>(texture.getWidth());
+            out.put<int32_t>(texture.getHeight());
+            out.put<int32_t>(texture.getChannels());
+            out.put<uint8_t>(texture.getMipFilter());
+            out.put<uint8_t>(texture.getFormat());
+            size_t size = texture.isValid() ? texture.getSizeInBytes() : 0;
+            out.putArray(data, size);
+        }
+
+        auto& objects = scene.getObjects();
+        out.put<uint64_t>(objects.size());
+        for (auto& object : objects) {
+            out.put<uint32_t>(object.layout());
+            out.put<uint64_t>(object.alignment());
+            // Vertex data keeps its alignment when the file is mapped, mappings start at a page boundary
+            out.putArray(object.data->data(), object.data->size(), std::max(snapshot_alignment, object.data->alignment()));
+
+            out.put<uint64_t>(object.geometries.size());
+            for (auto& geometry : object.geometries) {
+                out.put<SnapshotView>(makeSnapshotView(geometry.positions));
+                out.put<SnapshotView>(makeSnapshotView(geometry.normals));
+                out.put<SnapshotView>(makeSnapshotView(geometry.uvs));
+                out.put<SnapshotView>(makeSnapshotView(geometry.material_ids));
+                out.put<SnapshotView>(makeSnapshotView(geometry.quantized_positions));
+                out.put<SnapshotView>(makeSnapshotView(geometry.octahedral_normals));
+                out.put<SnapshotView>(makeSnapshotView(geometry.half_uvs));
+                out.put<SnapshotView>(makeSnapshotView(geometry.meshlets));
+                out.put<SnapshotView>(makeSnapshotView(geometry.meshlet_vertices));
+                out.put<SnapshotView>(makeSnapshotView(geometry.meshlet_triangles));
+                out.put<stage_vec3f>(geometry.position_offset);
+                out.put<stage_vec3f>(geometry.position_scale);
+                out.put<AABB>(geometry.bounds);
+                out.putArray(geometry.indices.data(), geometry.indices.size());
+                out.putArray(geometry.indices16.data(), geometry.indices16.size());
+            }
+        }
+
+        out.close();
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, filename, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        throw std::runtime_error("Unable to replace " + filename);
+    }
+}
+
+void
+SnapshotScene::loadSnapshot() {
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(m_scene_path.string());
+    if (!file->isValid())
+        throw std::runtime_error("Unable to map snapshot");
+
+    reportProgress(LoadPhase_Parse, 0.f);
+    SnapshotReader in(file->data(), file->size());
+
+    if (std::memcmp(in.take(sizeof(snapshot_magic)), snapshot_magic, sizeof(snapshot_magic)) != 0)
+        throw std::runtime_error("Not a stage snapshot");
+    uint32_t version = in.get<uint32_t>();
+    if (version != snapshot_version)
+        throw std::runtime_error("Unsupported snapshot version " + std::to_string(version) + ", expected " + std::to_string(snapshot_version));
+    if (in.get<uint32_t>() != snapshot_byte_order)
+        throw std::runtime_error("Snapshot was written on a host with a different byte order");
+
+    m_scene_scale = in.get<float>();
+    if (in.get<uint8_t>())
+        m_camera = std::make_shared<Camera>(in.get<Camera>());
+
+    m_materials = in.getVector<OpenPBRMaterial>();
+    m_lights = in.getVector<Light>();
+    m_instances = in.getVector<ObjectInstance>();
+
+    size_t num_textures = in.get<uint64_t>();
+    m_textures.reserve(num_textures);
+    for (size_t i = 0; i < num_textures; ++i) {
+        reportProgress(LoadPhase_Textures, float(i) / num_textures);
+        bool is_valid = in.get<uint8_t>();
+        bool is_hdr = in.get<uint8_t>();
+        int32_t width = in.get<int32_t>();
+        int32_t height = in.get<int32_t>();
+        int32_t channels = in.get<int32_t>();
+        MipFilter mip_filter = MipFilter(in.get<uint8_t>());
+        TextureFormat format = TextureFormat(in.get<uint8_t>());
+        size_t size;
+        uint8_t* data = in.getArray<uint8_t>(size);
+        m_textures.emplace_back(is_valid ? data : nullptr, width, height, channels, is_hdr, file, mip_filter, format);
+        if (is_valid && m_textures.back().getSizeInBytes() != size)
+            throw std::runtime_error("Snapshot contains a texture with inconsistent size");
+    }
+
+    size_t num_objects = in.get<uint64_t>();
+    m_objects.reserve(num_objects);
+    for (size_t i = 0; i < num_objects; ++i) {
+        reportProgress(LoadPhase_Geometry, float(i) / num_objects);
+        VertexLayout layout = (VertexLayout)in.get<uint32_t>();
+        size_t alignment = in.get<uint64_t>();
+        Object object(layout, alignment);
+
+        size_t size;
+        size_t data_alignment = std::max(snapshot_alignment, object.data->alignment());
+        uint8_t* data = in.getArray<uint8_t>(size, data_alignment);
+        object.data = std::make_shared<Buffer>(data, size, file, data_alignment);
+
+        size_t num_geometries = in.get<uint64_t>();
+        object.geometries.resize(num_geometries);
+        for (auto& geometry : object.geometries) {
+            geometry.positions = makeBufferView<stage_vec3f>(object.data, in.get<SnapshotView>());
+            geometry.normals = makeBufferView<stage_vec3f>(object.data, in.get<SnapshotView>());
+            geometry.uvs = makeBufferView<stage_vec2f>(object.data, in.get<SnapshotView>());
+            geometry.material_ids = makeBufferView<uint32_t>(object.data, in.get<SnapshotView>());
+            geometry.quantized_positions = makeBufferView<stage_vec3us>(object.data, in.get<SnapshotView>());
+            geometry.octahedral_normals = makeBufferView<stage_vec2s>(object.data, in.get<SnapshotView>());
+            geometry.half_uvs = makeBufferView<stage_vec2us>(object.data, in.get<SnapshotView>());
+            geometry.meshlets = makeBufferView<Meshlet>(object.data, in.get<SnapshotView>());
+            geometry.meshlet_vertices = makeBufferView<uint32_t>(object.data, in.get<SnapshotView>());
+            geometry.meshlet_triangles = makeBufferView<uint8_t>(object.data, in.get<SnapshotView>());
+            geometry.position_offset = in.get<stage_vec3f>();
+            geometry.position_scale = in.get<stage_vec3f>();
+            geometry.bounds = in.get<AABB>();
+            geometry.indices = in.getVector<uint32_t>();
+            geometry.indices16 = in.getVector<uint16_t>();
+        }
+        object.updateBounds();
+        m_objects.push_back(object);
+    }
+}
+
+}
+}
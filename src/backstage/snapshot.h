@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace stage {
+namespace backstage {
+
+struct Scene;
+
+/*
+ * Binary scene snapshots.
+ * A snapshot stores a fully processed scene (vertex buffers in their final layout, materials, lights, instances and decoded textures)
+ * so that it can be reloaded by memory-mapping the file instead of parsing and post-processing the source scene again.
+ * Large blobs are 64 byte aligned within the file (vertex buffers to their object's alignment if larger) and are referenced in place after reloading, only the index lists are copied.
+ * Snapshots are tied to the host byte order and to `snapshot_version`, older or foreign files are rejected when loading.
+ */
+constexpr char snapshot_magic[8] = { 'S', 'T', 'A', 'G', 'E', 'S', 'N', 'P' };
+constexpr uint32_t snapshot_version = 8;
+constexpr size_t snapshot_alignment = 64;
+
+/* Writes `scene` to `filename`. The file is replaced atomically, throws std::runtime_error on failure. */
+void writeSnapshot(Scene& scene, std::string filename);
+
+}
+}
@@ -0,0 +1,243 @@
+#include "texture_loader.h"
+
+#include <cstring>
+#include <filesystem>
+
+#include "asset_cache.h"
+#include "log.h"
+
+namespace stage {
+namespace backstage {
+
+TextureLoader::TextureLoader(std::vector<Image>& textures, bool lazy, bool use_cache, std::shared_ptr<Allocator> allocator, MipFilter mip_filter) : m_textures(textures), m_lazy(lazy), m_use_cache(use_cache), m_allocator(allocator), m_mip_filter(mip_filter) {
+    m_base_index = textures.size();
+}
+
+TextureLoader::~TextureLoader() {
+    // Loading was aborted before finish(), remaining decodes are no longer needed
+    m_tasks.cancel();
+    try {
+        m_tasks.wait();
+    } catch (...) {}
+}
+
+uint32_t
+TextureLoader::load(std::string filename, bool is_hdr) {
+    std::string key = fileKey(filename, is_hdr);
+    auto it = m_file_registry.find(key);
+    if (it != m_file_registry.end()) {
+        m_sources[it->second].references++;
+        return m_base_index + it->second;
+    }
+
+    Source source;
+    source.filename = filename;
+    source.is_hdr = is_hdr;
+    source.is_registered = true;
+    uint32_t slot = schedule(source);
+    m_file_registry[key] = slot;
+    return m_base_index + slot;
+}
+
+uint32_t
+TextureLoader::load(uint8_t* blob, size_t size, bool is_hdr) {
+    uint64_t key = blobKey(blob, size, is_hdr);
+    auto range = m_blob_registry.equal_range(key);
+    for (auto it = range.first; it != range.second; it++) {
+        // Confirm the match, different blobs may share a hash
+        Source& source = m_sources[it->second];
+        if (source.size == size && source.is_hdr == is_hdr && std::memcmp(source.blob, blob, size) == 0) {
+            source.references++;
+            return m_base_index + it->second;
+        }
+    }
+
+    Source source;
+    source.blob = blob;
+    source.size = size;
+    source.is_hdr = is_hdr;
+    source.is_registered = true;
+    uint32_t slot = schedule(source);
+    m_blob_registry.emplace(key, slot);
+    return m_base_index + slot;
+}
+
+uint32_t
+TextureLoader::add(Image&& image) {
+    image.generateMips(m_mip_filter);
+    m_images.push_back(std::make_unique<Image>(std::move(image)));
+    m_sources.emplace_back();
+    return m_base_index + m_images.size() - 1;
+}
+
+uint32_t
+TextureLoader::reference(uint32_t index) {
+    if (index < m_base_index) return index;
+    uint32_t slot = index - m_base_index;
+
+    // A claimed image is modified for its claimant only, everyone else gets the unmodified pixels
+    if (m_sources[slot].is_claimed)
+        return m_base_index + copy(slot);
+    m_sources[slot].references++;
+    return index;
+}
+
+uint32_t
+TextureLoader::makeUnique(uint32_t index) {
+    if (index < m_base_index) return index;
+    uint32_t slot = index - m_base_index;
+    Source& source = m_sources[slot];
+
+    if (source.references > 1) {
+        source.references--;
+        return m_base_index + copy(slot);
+    }
+
+    // Only the caller uses this image, but later requests for the same source must not see the modifications
+    if (source.is_registered) {
+        source.is_registered = false;
+        if (source.blob) {
+            auto range = m_blob_registry.equal_range(blobKey(source.blob, source.size, source.is_hdr));
+            for (auto it = range.first; it != range.second; it++) {
+                if (it->second == slot) {
+                    m_blob_registry.erase(it);
+                    break;
+                }
+            }
+        } else {
+            m_file_registry.erase(fileKey(source.filename, source.is_hdr));
+        }
+    }
+    source.is_claimed = true;
+    return index;
+}
+
+uint32_t
+TextureLoader::copy(uint32_t slot) {
+    Source source = m_sources[slot];
+    source.references = 1;
+    source.is_registered = false;
+    source.is_claimed = false;
+    if (source.blob || !source.filename.empty())
+        return schedule(source);
+
+    // Added images are available right away, both slots share the pixels until one of them is modified
+    std::shared_ptr<Image> shared(std::move(m_images[slot]));
+    m_images[slot] = std::make_unique<Image>(shared);
+    m_images.push_back(std::make_unique<Image>(shared));
+    m_sources.push_back(source);
+    return m_images.size() - 1;
+}
+
+void
+TextureLoader::defer(std::function<void(std::vector<Image>&)> operation) {
+    m_deferred.push_back(operation);
+}
+
+std::vector<int32_t>
+TextureLoader::finish(bool drop_invalid) {
+    m_tasks.wait();
+
+    m_textures.reserve(m_base_index + m_images.size());
+    for (size_t i = 0; i < m_images.size(); i++) {
+        Image& image = *m_images[i];
+        Source& source = m_sources[i];
+        if (image.isValid())
+            m_saved_bytes += (source.references - 1) * image.getSizeInBytes();
+
+        // Newly decoded files are handed to the cache, the scene keeps a reference to the shared pixels
+        if (m_use_cache && !source.is_cached && !source.blob && !source.filename.empty() && image.isValid()) {
+            auto shared = std::make_shared<Image>(std::move(image));
+            AssetCache::get().insertImage(source.filename, source.is_hdr, m_lazy, m_mip_filter, shared, m_allocator.get());
+            image = Image(shared);
+        }
+        m_textures.push_back(std::move(image));
+    }
+    m_images.clear();
+    m_sources.clear();
+    m_file_registry.clear();
+    m_blob_registry.clear();
+
+    if (m_saved_bytes > 0)
+        SUCC("Shared textures between materials, saved " + std::to_string(m_saved_bytes / (1024 * 1024)) + " MB");
+
+    for (auto& operation : m_deferred) {
+        operation(m_textures);
+    }
+    m_deferred.clear();
+
+    std::vector<int32_t> remap(m_textures.size());
+    size_t count = 0;
+    for (size_t i = 0; i < m_textures.size(); i++) {
+        if (i >= m_base_index && drop_invalid && !m_textures[i].isValid()) {
+            remap[i] = -1;
+            continue;
+        }
+        remap[i] = count;
+        if (count != i)
+            m_textures[count] = std::move(m_textures[i]);
+        count++;
+    }
+    m_textures.erase(m_textures.begin() + count, m_textures.end());
+    return remap;
+}
+
+uint32_t
+TextureLoader::schedule(Source source) {
+    m_images.emplace_back();
+    m_sources.push_back(source);
+
+    auto& slot = m_images.back();
+    bool lazy = m_lazy;
+    if (m_use_cache && !source.blob) {
+        if (auto shared = AssetCache::get().findImage(source.filename, source.is_hdr, lazy, m_mip_filter, m_allocator.get())) {
+            slot = std::make_unique<Image>(shared);
+            m_sources.back().is_cached = true;
+            return m_images.size() - 1;
+        }
+    }
+
+    // Mip levels are generated in the decode task, lazy images defer them until they are decoded
+    auto allocator = m_allocator;
+    MipFilter mip_filter = m_mip_filter;
+    if (source.blob) {
+        m_tasks.run([&slot, source, lazy, allocator, mip_filter]() {
+            slot = std::make_unique<Image>(source.blob, source.size, source.is_hdr, lazy, allocator);
+            slot->generateMips(mip_filter);
+        });
+    } else {
+        m_tasks.run([&slot, source, lazy, allocator, mip_filter]() {
+            slot = std::make_unique<Image>(source.filename, source.is_hdr, lazy, allocator);
+            slot->generateMips(mip_filter);
+        });
+    }
+    return m_images.size() - 1;
+}
+
+std::string
+TextureLoader::fileKey(const std::string& filename, bool is_hdr) {
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::weakly_canonical(filename, error);
+    if (error)
+        path = std::filesystem::absolute(filename, error);
+    return path.string() + (is_hdr ? ":hdr" : ":ldr");
+}
+
+uint64_t
+TextureLoader::blobKey(const uint8_t* blob, size_t size, bool is_hdr) {
+    // FNV-1a over 64 bit words, the tail is mixed in byte by byte
+    uint64_t hash = 0xcbf29ce484222325ull ^ size ^ uint64_t(is_hdr);
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, blob + i, sizeof(uint64_t));
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ blob[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+}
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <tbb/task_group.h>
+
+#include "image.h"
+
+namespace stage {
+namespace backstage {
+
+/*
+ * Decodes textures on a TBB task group while the loader keeps parsing geometry.
+ * Every request is assigned the next texture index right away, so indices are deterministic and do not depend on
+ * which decode finishes first. The decoded images are appended to the scene's texture list by finish().
+ *
+ * The loader also acts as the scene's texture registry. Files are identified by their canonical path and embedded
+ * blobs by their content, so every unique source is decoded once and shared by all materials that reference it.
+ */
+struct TextureLoader {
+    /* 
+     * With `use_cache` set, decoded image files are shared with other scenes through the AssetCache.
+     * Images are allocated from `allocator`, or from the default allocator if it is null.
+     * Unless `mip_filter` is MipFilter_None, every image gets a mip chain right after it is decoded.
+     */
+    TextureLoader(std::vector<Image>& textures, bool lazy, bool use_cache = false, std::shared_ptr<Allocator> allocator = nullptr, MipFilter mip_filter = MipFilter_None);
+    TextureLoader(const TextureLoader& other) = delete;
+    TextureLoader& operator=(const TextureLoader& other) = delete;
+    ~TextureLoader();
+
+    /* Schedules decoding of an image file and returns its texture index */
+    uint32_t load(std::string filename, bool is_hdr = false);
+    /* Schedules decoding of an image blob and returns its texture index. The blob must stay alive until finish() returns. */
+    uint32_t load(uint8_t* blob, size_t size, bool is_hdr = false);
+    /* Adds an image that is already available and returns its texture index */
+    uint32_t add(Image&& image);
+
+    /*
+     * Registers another user of `index` that the caller handed out before, e.g. from a texture map of its own, and returns
+     * the index that user has to use. Images claimed by makeUnique() are copied, so the new user does not see their modifications.
+     */
+    uint32_t reference(uint32_t index);
+
+    /* 
+     * Returns the index of an image that can be modified without affecting other references to `index`.
+     * Shared sources are decoded again into a new image, added images are copied when they are first modified.
+     * The returned image is claimed: later requests for the source and reference() calls no longer share it.
+     */
+    uint32_t makeUnique(uint32_t index);
+
+    /* Runs `operation` on the final texture list after all images are decoded, in the order operations were added */
+    void defer(std::function<void(std::vector<Image>&)> operation);
+
+    /*
+     * Waits for all decodes, appends the images to the texture list and runs the deferred operations.
+     * If `drop_invalid` is set, images that failed to load are removed afterwards.
+     * Returns a map from the index returned on scheduling to the final index, or -1 for dropped images.
+     */
+    std::vector<int32_t> finish(bool drop_invalid);
+
+    /* Bytes that did not have to be decoded because a source was shared, valid after finish() */
+    size_t getSavedBytes() { return m_saved_bytes; }
+
+private:
+    struct Source {
+        std::string filename;
+        uint8_t* blob { nullptr };
+        size_t size { 0 };
+        bool is_hdr { false };
+        uint32_t references { 1 };
+        bool is_registered { false };
+        bool is_cached { false };
+        bool is_claimed { false };      // Handed out by makeUnique() to be modified
+    };
+
+    uint32_t schedule(Source source);
+    /* Adds an image with the unmodified pixels of `slot` and returns its slot */
+    uint32_t copy(uint32_t slot);
+    std::string fileKey(const std::string& filename, bool is_hdr);
+    uint64_t blobKey(const uint8_t* blob, size_t size, bool is_hdr);
+
+    std::vector<Image>& m_textures;
+    bool m_lazy;
+    bool m_use_cache;
+    std::shared_ptr<Allocator> m_allocator;
+    MipFilter m_mip_filter;
+    size_t m_base_index;
+    size_t m_saved_bytes { 0 };
+
+    // A deque keeps the slots in place while tasks write to them and new requests are appended
+    std::deque<std::unique_ptr<Image>> m_images;
+    std::vector<Source> m_sources;
+    std::unordered_map<std::string, uint32_t> m_file_registry;
+    std::unordered_multimap<uint64_t, uint32_t> m_blob_registry;
+    std::vector<std::function<void(std::vector<Image>&)>> m_deferred;
+    tbb::task_group m_tasks;
+};
+
+}
+}
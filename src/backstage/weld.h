@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "math.h"
+
+namespace stage {
+namespace backstage {
+
+/* Hash functions for the key types used by the loaders */
+
+inline uint64_t
+weldHash(uint64_t key) {
+    // splitmix64 finalizer
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ull;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebull;
+    key ^= key >> 31;
+    return key;
+}
+
+inline uint64_t
+weldHash(uint32_t key) {
+    return weldHash(uint64_t(key));
+}
+
+inline uint64_t
+weldHash(const stage_vec3i& key) {
+    return weldHash((uint64_t(uint32_t(key.x)) << 32 | uint32_t(key.y)) ^ weldHash(uint64_t(uint32_t(key.z))));
+}
+
+/*
+ * Assigns consecutive indices to unique vertex keys in order of first occurrence.
+ * Uses open addressing with linear probing, so a lookup does not allocate and touches
+ * a single contiguous slot array instead of walking a tree.
+ */
+template<typename Key>
+struct VertexWelder {
+    VertexWelder(size_t expected_keys = 0) { reserve(expected_keys); }
+
+    /* Returns the welded index of `key` and sets `inserted` if the key was not seen before */
+    uint32_t weld(const Key& key, bool& inserted) {
+        if ((m_size + 1) * 2 > m_slots.size())
+            rehash(std::max<size_t>(m_slots.size() * 2, 64));
+
+        size_t mask = m_slots.size() - 1;
+        size_t slot = weldHash(key) & mask;
+        while (m_slots[slot].index != empty_slot) {
+            if (m_slots[slot].key == key) {
+                inserted = false;
+                return m_slots[slot].index;
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        m_slots[slot].key = key;
+        m_slots[slot].index = uint32_t(m_size++);
+        inserted = true;
+        return m_slots[slot].index;
+    }
+
+    uint32_t weld(const Key& key) {
+        bool inserted;
+        return weld(key, inserted);
+    }
+
+    void reserve(size_t num_keys) {
+        size_t capacity = 64;
+        while (capacity < num_keys * 2) capacity *= 2;
+        if (capacity > m_slots.size())
+            rehash(capacity);
+    }
+
+    void clear() {
+        m_slots.clear();
+        m_size = 0;
+    }
+
+    size_t size() const { return m_size; }
+
+private:
+    static constexpr uint32_t empty_slot = ~0u;
+
+    struct Slot {
+        Key key;
+        uint32_t index { empty_slot };
+    };
+
+    std::vector<Slot> m_slots;
+    size_t m_size { 0 };
+
+    void rehash(size_t capacity) {
+        std::vector<Slot> slots(capacity);
+        size_t mask = capacity - 1;
+        for (auto& s : m_slots) {
+            if (s.index == empty_slot) continue;
+            size_t slot = weldHash(s.key) & mask;
+            while (slots[slot].index != empty_slot)
+                slot = (slot + 1) & mask;
+            slots[slot] = s;
+        }
+        m_slots.swap(slots);
+    }
+};
+
+}
+}
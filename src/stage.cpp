@@ -43,4 +43,48 @@ Scene::getSceneScale() {
     return m_pimpl->getSceneScale();
 }
 
+AABB
+Scene::getSceneBounds() {
+    return m_pimpl->getSceneBounds();
+}
+
+SceneLoad::SceneLoad(backstage::AsyncLoad load) {
+    m_load = std::make_unique<backstage::AsyncLoad>(std::move(load));
+}
+
+SceneLoad::~SceneLoad() = default;
+
+LoadPhase
+SceneLoad::getPhase() {
+    return m_load->progress->getPhase();
+}
+
+float
+SceneLoad::getProgress() {
+    return m_load->progress->getFraction();
+}
+
+bool
+SceneLoad::isReady() {
+    // get() consumes the future, after which the load has finished by definition
+    if (!m_load->result.valid())
+        return true;
+    return m_load->result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void
+SceneLoad::cancel() {
+    m_load->progress->cancel();
+}
+
+std::unique_ptr<Scene>
+SceneLoad::get() {
+    return std::unique_ptr<Scene>(new Scene(std::shared_ptr<backstage::Scene>(m_load->result.get())));
+}
+
+std::unique_ptr<SceneLoad>
+loadSceneAsync(std::string scene, Config config) {
+    return std::unique_ptr<SceneLoad>(new SceneLoad(backstage::createSceneAsync(scene, config)));
+}
+
 }
\ No newline at end of file
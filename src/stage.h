@@ -8,15 +8,20 @@
 #include "backstage/light.h"
 #include "backstage/material.h"
 #include "backstage/mesh.h"
+#include "backstage/progress.h"
 
 namespace stage {
 namespace backstage {
     struct Scene;
+    struct AsyncLoad;
 }
 
 /* Forward math types */
 using backstage::stage_vec2i;
 using backstage::stage_vec2f;
+using backstage::stage_vec2s;
+using backstage::stage_vec2us;
+using backstage::stage_vec3us;
 using backstage::stage_vec3f;
 using backstage::stage_vec3i;
 using backstage::stage_vec4f;
@@ -30,9 +35,18 @@ using backstage::Image;
 using backstage::Light;
 using backstage::OpenPBRMaterial;
 using backstage::VertexLayout;
+using backstage::IndexFormat;
+using backstage::MipFilter;
+using backstage::TextureCompression;
+using backstage::TextureFormat;
 using backstage::Geometry;
+using backstage::Meshlet;
+using backstage::AABB;
 using backstage::Object;
 using backstage::ObjectInstance;
+using backstage::LoadPhase;
+using backstage::SceneSink;
+using backstage::Allocator;
 
 /* Scene Facade */
 struct Scene {
@@ -49,12 +63,42 @@ struct Scene {
     std::vector<Image>& getTextures();
 
     float getSceneScale();
+    AABB getSceneBounds();
 
     bool isValid() { return m_pimpl != nullptr; }
 
 private:
+    friend struct SceneLoad;
+    Scene(std::shared_ptr<backstage::Scene> pimpl) : m_pimpl(pimpl) {}
+
     std::shared_ptr<backstage::Scene> m_pimpl;
 
 };
 
+/* Handle to a scene that is loaded in the background */
+struct SceneLoad {
+    ~SceneLoad();
+    SceneLoad(const SceneLoad &) = delete;
+    SceneLoad &operator=(const SceneLoad &) = delete;
+
+    LoadPhase getPhase();
+    float getProgress();
+
+    /* Returns true once loading has finished, failed, or was cancelled */
+    bool isReady();
+    /* Requests cancellation, the loader stops at the next progress report */
+    void cancel();
+    /* Blocks until loading has finished. May only be called once. */
+    std::unique_ptr<Scene> get();
+
+private:
+    friend std::unique_ptr<SceneLoad> loadSceneAsync(std::string scene, Config config);
+    SceneLoad(backstage::AsyncLoad load);
+
+    std::unique_ptr<backstage::AsyncLoad> m_load;
+};
+
+/* Starts loading a scene on the TBB scheduler and returns immediately */
+std::unique_ptr<SceneLoad> loadSceneAsync(std::string scene, Config config);
+
 }
@@ -8,6 +8,7 @@
 #include "backstage/light.h"
 #include "backstage/material.h"
 #include "backstage/mesh.h"
+#include "backstage/asset_cache.h"
 #include "backstage/scene.h"
 #include "stage_c.h"
 
@@ -22,6 +23,54 @@ struct stage_object : public Object {};
 struct stage_object_instance : public ObjectInstance {};
 struct stage_scene : public Scene {};
 struct stage_config : public Config {};
+struct stage_load : public AsyncLoad {};
+
+static_assert(sizeof(stage_meshlet_t) == sizeof(Meshlet), "stage_meshlet_t must match the layout of Meshlet");
+static_assert(sizeof(stage_aabb_t) == sizeof(AABB), "stage_aabb_t must match the layout of AABB");
+
+/* Forwards the C++ allocator interface to the callbacks of a stage_allocator_t */
+struct CallbackAllocator : public Allocator {
+    CallbackAllocator(const stage_allocator_t& callbacks) : m_callbacks(callbacks) {}
+
+    void* allocate(size_t size, size_t alignment) override {
+        return m_callbacks.allocate(m_callbacks.user_data, size, alignment);
+    }
+    void deallocate(void* ptr, size_t size, size_t alignment) override {
+        m_callbacks.deallocate(m_callbacks.user_data, ptr, size, alignment);
+    }
+    void* reallocate(void* ptr, size_t old_size, size_t new_size, size_t alignment) override {
+        if (m_callbacks.reallocate)
+            return m_callbacks.reallocate(m_callbacks.user_data, ptr, old_size, new_size, alignment);
+        return Allocator::reallocate(ptr, old_size, new_size, alignment);
+    }
+
+private:
+    stage_allocator_t m_callbacks;
+};
+
+/* Forwards the C++ sink interface to the callbacks of a stage_sink_t */
+struct CallbackSink : public SceneSink {
+    CallbackSink(const stage_sink_t& callbacks) : m_callbacks(callbacks) {}
+
+    void onGeometry(uint32_t object_id, Object& object) override {
+        if (m_callbacks.on_geometry) m_callbacks.on_geometry(m_callbacks.user_data, object_id, reinterpret_cast<stage_object_t>(&object));
+    }
+    void onTexture(uint32_t texture_id, Image& texture) override {
+        if (m_callbacks.on_texture) m_callbacks.on_texture(m_callbacks.user_data, texture_id, reinterpret_cast<stage_image_t>(&texture));
+    }
+    void onMaterial(uint32_t material_id, const OpenPBRMaterial& material) override {
+        if (m_callbacks.on_material) m_callbacks.on_material(m_callbacks.user_data, material_id, reinterpret_cast<stage_openpbr_material_t>(const_cast<OpenPBRMaterial*>(&material)));
+    }
+    void onLight(const Light& light) override {
+        if (m_callbacks.on_light) m_callbacks.on_light(m_callbacks.user_data, reinterpret_cast<stage_light_t>(const_cast<Light*>(&light)));
+    }
+    void onInstance(const ObjectInstance& instance) override {
+        if (m_callbacks.on_instance) m_callbacks.on_instance(m_callbacks.user_data, reinterpret_cast<stage_object_instance_t>(const_cast<ObjectInstance*>(&instance)));
+    }
+
+private:
+    stage_sink_t m_callbacks;
+};
 
 stage_config_t
 stage_config_get_default() {
@@ -36,6 +85,78 @@ stage_config_set_layout(stage_config_t config, stage_vertex_layout_t layout) {
     config->layout = VertexLayout(layout);
 }
 
+void
+stage_config_set_obj_parser(stage_config_t config, stage_obj_parser_t parser) {
+    if (config == nullptr) return;
+    config->obj_parser = ObjParser(parser);
+}
+
+void
+stage_config_set_lazy_textures(stage_config_t config, bool lazy_textures) {
+    if (config == nullptr) return;
+    config->lazy_textures = lazy_textures;
+}
+
+void
+stage_config_set_mip_filter(stage_config_t config, stage_mip_filter_t mip_filter) {
+    if (config == nullptr) return;
+    config->mip_filter = MipFilter(mip_filter);
+}
+
+void
+stage_config_set_texture_compression(stage_config_t config, stage_texture_compression_t texture_compression) {
+    if (config == nullptr) return;
+    config->texture_compression = TextureCompression(texture_compression);
+}
+
+void
+stage_config_set_optimize_vertex_cache(stage_config_t config, bool optimize_vertex_cache) {
+    if (config == nullptr) return;
+    config->optimize_vertex_cache = optimize_vertex_cache;
+}
+
+void
+stage_config_set_index_format(stage_config_t config, stage_index_format_t index_format) {
+    if (config == nullptr) return;
+    config->index_format = IndexFormat(index_format);
+}
+
+void
+stage_config_set_meshlets(stage_config_t config, bool build_meshlets, size_t max_vertices, size_t max_triangles) {
+    if (config == nullptr) return;
+    config->build_meshlets = build_meshlets;
+    config->meshlet_max_vertices = max_vertices;
+    config->meshlet_max_triangles = max_triangles;
+}
+
+void
+stage_config_set_use_asset_cache(stage_config_t config, bool use_asset_cache) {
+    if (config == nullptr) return;
+    config->use_asset_cache = use_asset_cache;
+}
+
+void
+stage_config_set_snapshot_path(stage_config_t config, const char* snapshot_path) {
+    if (config == nullptr) return;
+    config->snapshot_path = snapshot_path ? std::string(snapshot_path) : std::string();
+}
+
+void
+stage_config_set_sink(stage_config_t config, const stage_sink_t* sink) {
+    if (config == nullptr) return;
+    config->sink = sink ? std::make_shared<CallbackSink>(*sink) : nullptr;
+}
+
+void
+stage_config_set_allocator(stage_config_t config, const stage_allocator_t* allocator) {
+    if (config == nullptr) return;
+    if (allocator == nullptr || allocator->allocate == nullptr || allocator->deallocate == nullptr) {
+        config->allocator = nullptr;
+        return;
+    }
+    config->allocator = std::make_shared<CallbackAllocator>(*allocator);
+}
+
 stage_scene_t
 stage_load(char *scene_file, stage_config_t config, stage_error_t* error) {
     std::string scene_file_str(scene_file);
@@ -54,11 +175,65 @@ stage_load(char *scene_file, stage_config_t config, stage_error_t* error) {
 
 void
 stage_free(stage_scene_t scene) {
+    // Scenes are released through their destructor, so buffers and textures are returned to their allocator
     if (scene != nullptr) {
-        free(scene);
+        delete reinterpret_cast<Scene*>(scene);
     }
 }
 
+/* Asset Cache API */
+void
+stage_asset_cache_set_budget(size_t budget_in_bytes) {
+    AssetCache::get().setBudget(budget_in_bytes);
+}
+
+void
+stage_asset_cache_clear() {
+    AssetCache::get().clear();
+}
+
+/* Asynchronous Loading API */
+stage_load_t
+stage_load_async(char *scene_file, stage_config_t config) {
+    stage_load_t load = new struct stage_load();
+    static_cast<AsyncLoad&>(*load) = createSceneAsync(std::string(scene_file), *config);
+    return load;
+}
+
+bool
+stage_load_poll(stage_load_t load, stage_load_phase_t* phase, float* progress) {
+    if (load == nullptr) return true;
+    if (phase != nullptr) *phase = stage_load_phase_t(load->progress->getPhase());
+    if (progress != nullptr) *progress = load->progress->getFraction();
+    if (!load->result.valid()) return true;
+    return load->result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void
+stage_load_cancel(stage_load_t load) {
+    if (load == nullptr) return;
+    load->progress->cancel();
+}
+
+stage_scene_t
+stage_load_wait(stage_load_t load, stage_error_t* error) {
+    std::unique_ptr<Scene> scene_ptr;
+    if (load != nullptr) {
+        try {
+            scene_ptr = load->result.get();
+        } catch (...) {}
+        delete load;
+    }
+
+    if (!scene_ptr) {
+        *error = STAGE_ERROR;
+        return nullptr;
+    }
+
+    *error = STAGE_NO_ERROR;
+    return reinterpret_cast<stage_scene_t>(scene_ptr.release());
+}
+
 /* Camera API */
 stage_vec3f_t
 stage_camera_get_position(stage_camera_t camera) {
@@ -116,6 +291,31 @@ stage_image_is_valid(stage_image_t image) {
     return image->isValid();
 }
 
+uint32_t
+stage_image_get_level_count(stage_image_t image) {
+    return image->getLevelCount();
+}
+
+uint32_t
+stage_image_get_level_width(stage_image_t image, uint32_t level) {
+    return image->getLevelWidth(level);
+}
+
+uint32_t
+stage_image_get_level_height(stage_image_t image, uint32_t level) {
+    return image->getLevelHeight(level);
+}
+
+size_t
+stage_image_get_level_offset(stage_image_t image, uint32_t level) {
+    return image->getLevelOffset(level);
+}
+
+stage_texture_format_t
+stage_image_get_format(stage_image_t image) {
+    return stage_texture_format_t(image->getFormat());
+}
+
 /* Light API */
 stage_light_t
 stage_light_get(stage_light_list_t lightList, size_t index) {
@@ -249,6 +449,11 @@ stage_object_instance_get_object_id(stage_object_instance_t instance) {
     return instance->object_id;
 }
 
+stage_aabb_t
+stage_object_instance_get_bounds(stage_object_instance_t instance) {
+    return *reinterpret_cast<stage_aabb_t*>(&instance->bounds);
+}
+
 stage_object_t
 stage_object_get(stage_object_list_t objectList, size_t index) {
     return &objectList[index];
@@ -272,16 +477,23 @@ stage_object_get_buffer(stage_object_t object, size_t* sizeInBytes) {
     return object->data->data();
 }
 
+stage_aabb_t
+stage_object_get_bounds(stage_object_t object) {
+    return *reinterpret_cast<stage_aabb_t*>(&object->bounds);
+}
+
 stage_geometry_t
 stage_geometry_get(stage_geometry_list_t geometryList, size_t index) {
     return &geometryList[index];
 }
 
-uint32_t*
-stage_geometry_get_indices(stage_geometry_t geometry, size_t* count) {
-    auto& indices = geometry->indices;
-    *count = indices.size();
-    return indices.data();
+void*
+stage_geometry_get_indices(stage_geometry_t geometry, size_t* count, size_t* index_size) {
+    *count = geometry->numIndices();
+    *index_size = geometry->indexSize();
+    if (!geometry->indices16.empty())
+        return geometry->indices16.data();
+    return geometry->indices.data();
 }
 
 stage_vec3f_t*
@@ -316,6 +528,80 @@ stage_geometry_get_material_ids(stage_geometry_t geometry, size_t* count, size_t
     return reinterpret_cast<uint32_t*>(material_ids.data());
 }
 
+stage_aabb_t
+stage_geometry_get_bounds(stage_geometry_t geometry) {
+    return *reinterpret_cast<stage_aabb_t*>(&geometry->bounds);
+}
+
+uint16_t*
+stage_geometry_get_quantized_positions(stage_geometry_t geometry, size_t* count, size_t* stride) {
+    auto& positions = geometry->quantized_positions;
+    *count = positions.size();
+    *stride = positions.stride();
+    return reinterpret_cast<uint16_t*>(positions.data());
+}
+
+void
+stage_geometry_get_position_dequantization(stage_geometry_t geometry, stage_vec3f_t* offset, stage_vec3f_t* scale) {
+    *offset = *reinterpret_cast<stage_vec3f_t*>(&geometry->position_offset);
+    *scale = *reinterpret_cast<stage_vec3f_t*>(&geometry->position_scale);
+}
+
+int16_t*
+stage_geometry_get_octahedral_normals(stage_geometry_t geometry, size_t* count, size_t* stride) {
+    auto& normals = geometry->octahedral_normals;
+    *count = normals.size();
+    *stride = normals.stride();
+    return reinterpret_cast<int16_t*>(normals.data());
+}
+
+uint16_t*
+stage_geometry_get_half_uvs(stage_geometry_t geometry, size_t* count, size_t* stride) {
+    auto& uvs = geometry->half_uvs;
+    *count = uvs.size();
+    *stride = uvs.stride();
+    return reinterpret_cast<uint16_t*>(uvs.data());
+}
+
+stage_meshlet_t*
+stage_geometry_get_meshlets(stage_geometry_t geometry, size_t* count) {
+    auto& meshlets = geometry->meshlets;
+    *count = meshlets.size();
+    return reinterpret_cast<stage_meshlet_t*>(meshlets.data());
+}
+
+uint32_t*
+stage_geometry_get_meshlet_vertices(stage_geometry_t geometry, size_t* count) {
+    auto& vertices = geometry->meshlet_vertices;
+    *count = vertices.size();
+    return reinterpret_cast<uint32_t*>(vertices.data());
+}
+
+uint8_t*
+stage_geometry_get_meshlet_triangles(stage_geometry_t geometry, size_t* count) {
+    auto& triangles = geometry->meshlet_triangles;
+    *count = triangles.size() / 3;
+    return triangles.data();
+}
+
+stage_vec3f_t
+stage_geometry_decode_position(stage_geometry_t geometry, size_t index) {
+    stage_vec3f position = geometry->getPosition(index);
+    return *reinterpret_cast<stage_vec3f_t*>(&position);
+}
+
+stage_vec3f_t
+stage_geometry_decode_normal(stage_geometry_t geometry, size_t index) {
+    stage_vec3f normal = geometry->getNormal(index);
+    return *reinterpret_cast<stage_vec3f_t*>(&normal);
+}
+
+stage_vec2f_t
+stage_geometry_decode_uv(stage_geometry_t geometry, size_t index) {
+    stage_vec2f uv = geometry->getUV(index);
+    return *reinterpret_cast<stage_vec2f_t*>(&uv);
+}
+
 /* Scene API */
 stage_camera_t
 stage_scene_get_camera(stage_scene_t scene) {
@@ -361,4 +647,10 @@ stage_scene_get_textures(stage_scene_t scene, size_t* count) {
 float
 stage_scene_get_scale(stage_scene_t scene) {
     return scene->getSceneScale();
+}
+
+stage_aabb_t
+stage_scene_get_bounds(stage_scene_t scene) {
+    AABB bounds = scene->getSceneBounds();
+    return *reinterpret_cast<stage_aabb_t*>(&bounds);
 }
\ No newline at end of file
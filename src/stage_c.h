@@ -1,6 +1,7 @@
 #ifndef STAGE_H
 #define STAGE_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -48,6 +49,7 @@ typedef struct stage_object_instance* stage_object_instance_t;
 typedef struct stage_object_instance* stage_object_instance_list_t;
 typedef struct stage_scene* stage_scene_t;
 typedef struct stage_config* stage_config_t;
+typedef struct stage_load* stage_load_t;
 
 typedef enum {
     VertexLayout_Interleaved_VNT = 0x001,
@@ -56,8 +58,44 @@ typedef enum {
     VertexLayout_Block_VNT       = 0x008,
     VertexLayout_Block_VN        = 0x010,
     VertexLayout_Block_V         = 0x020,
+
+    // Flags that can be combined with any of the layouts above to store attributes in compressed form
+    VertexLayout_Compressed_N    = 0x100,   // Octahedral encoded normals, two int16_t snorm values
+    VertexLayout_Compressed_T    = 0x200,   // Half float UVs, two uint16_t
+    VertexLayout_Compressed_V    = 0x400,   // Positions as three uint16_t unorm values relative to the geometry's bounds
 } stage_vertex_layout_t;
 
+typedef enum {
+    IndexFormat_UInt32      = 0,
+    IndexFormat_Adaptive    = 1,
+} stage_index_format_t;
+
+typedef enum {
+    MipFilter_None      = 0,
+    MipFilter_Box       = 1,
+    MipFilter_Kaiser    = 2,
+} stage_mip_filter_t;
+
+typedef enum {
+    TextureCompression_None = 0,
+    TextureCompression_BC1  = 1,
+    TextureCompression_BC7  = 2,
+} stage_texture_compression_t;
+
+typedef enum {
+    TextureFormat_Uncompressed  = 0,
+    TextureFormat_BC1           = 1,
+    TextureFormat_BC4           = 2,
+    TextureFormat_BC5           = 3,
+    TextureFormat_BC6H          = 4,
+    TextureFormat_BC7           = 5,
+} stage_texture_format_t;
+
+typedef enum {
+    ObjParser_TinyObj   = 0,
+    ObjParser_Parallel  = 1,
+} stage_obj_parser_t;
+
 typedef enum {
     DistantLight = 0,
     InfiniteLight,
@@ -66,6 +104,52 @@ typedef enum {
     DiskLight,
 } stage_light_type_t;
 
+typedef enum {
+    LoadPhase_Parse     = 0,
+    LoadPhase_Normals   = 1,
+    LoadPhase_Geometry  = 2,
+    LoadPhase_Textures  = 3,
+    LoadPhase_Scale     = 4,
+    LoadPhase_Done      = 5,
+} stage_load_phase_t;
+
+/* A cluster of triangles, see stage_config_set_meshlets. Vertices index into stage_geometry_get_meshlet_vertices, triangles are three 
+ * bytes each in stage_geometry_get_meshlet_triangles that index into the meshlet's vertices. */
+typedef struct {
+    uint32_t vertex_offset;
+    uint32_t triangle_offset;
+    uint32_t vertex_count;
+    uint32_t triangle_count;
+    stage_vec3f_t center;
+    float radius;
+    stage_vec3f_t cone_axis;
+    float cone_cutoff;
+} stage_meshlet_t;
+
+/* An axis aligned bounding box, empty boxes have `lower` greater than `upper` */
+typedef struct {
+    stage_vec3f_t lower;
+    stage_vec3f_t upper;
+} stage_aabb_t;
+
+/* Streaming callbacks, see stage_config_set_sink. Unused callbacks may be NULL. */
+typedef struct {
+    void* user_data;
+    void (*on_geometry)(void* user_data, uint32_t object_id, stage_object_t object);
+    void (*on_texture)(void* user_data, uint32_t texture_id, stage_image_t texture);
+    void (*on_material)(void* user_data, uint32_t material_id, stage_openpbr_material_t material);
+    void (*on_light)(void* user_data, stage_light_t light);
+    void (*on_instance)(void* user_data, stage_object_instance_t instance);
+} stage_sink_t;
+
+/* Memory callbacks, see stage_config_set_allocator. `reallocate` may be NULL, it is then emulated with allocate and deallocate. */
+typedef struct {
+    void* user_data;
+    void* (*allocate)(void* user_data, size_t size, size_t alignment);
+    void* (*reallocate)(void* user_data, void* ptr, size_t old_size, size_t new_size, size_t alignment);
+    void (*deallocate)(void* user_data, void* ptr, size_t size, size_t alignment);
+} stage_allocator_t;
+
 /* API Functions */
 typedef unsigned int stage_error_t;
 #define STAGE_NO_ERROR  0x0000
@@ -77,12 +161,74 @@ stage_config_get_default();
 void
 stage_config_set_layout(stage_config_t config, stage_vertex_layout_t layout);
 
+void
+stage_config_set_obj_parser(stage_config_t config, stage_obj_parser_t parser);
+
+void
+stage_config_set_lazy_textures(stage_config_t config, bool lazy_textures);
+
+/* Generates a mip chain for every texture. LDR color channels are filtered in linear space, HDR textures as they are. */
+void
+stage_config_set_mip_filter(stage_config_t config, stage_mip_filter_t mip_filter);
+
+/* Block compresses color textures with the given format, opacity-only textures as BC4 and HDR textures as BC6H */
+void
+stage_config_set_texture_compression(stage_config_t config, stage_texture_compression_t texture_compression);
+
+void
+stage_config_set_optimize_vertex_cache(stage_config_t config, bool optimize_vertex_cache);
+
+void
+stage_config_set_index_format(stage_config_t config, stage_index_format_t index_format);
+
+/* Partitions every geometry into meshlets of at most `max_vertices` (up to 255) vertices and `max_triangles` triangles */
+void
+stage_config_set_meshlets(stage_config_t config, bool build_meshlets, size_t max_vertices, size_t max_triangles);
+
+void
+stage_config_set_use_asset_cache(stage_config_t config, bool use_asset_cache);
+
+void
+stage_config_set_snapshot_path(stage_config_t config, const char* snapshot_path);
+
+/* Streams loaded scenes to `sink` instead of keeping their objects and textures in the scene. Passing NULL disables streaming. 
+ * The data passed to a callback is only valid until the callback returns. */
+void
+stage_config_set_sink(stage_config_t config, const stage_sink_t* sink);
+
+/* Allocates vertex buffers and textures of loaded scenes through `allocator`. Passing NULL restores the default allocator.
+ * The callbacks are used until the last scene loaded with them is freed. */
+void
+stage_config_set_allocator(stage_config_t config, const stage_allocator_t* allocator);
+
 stage_scene_t
 stage_load(char *scene_file, stage_config_t config, stage_error_t* error);
 
 void
 stage_free(stage_scene_t scene);
 
+/* Asset Cache API */
+void
+stage_asset_cache_set_budget(size_t budget_in_bytes);
+
+void
+stage_asset_cache_clear();
+
+/* Asynchronous Loading API */
+stage_load_t
+stage_load_async(char *scene_file, stage_config_t config);
+
+/* Returns true once loading has finished. `phase` and `progress` are optional. */
+bool
+stage_load_poll(stage_load_t load, stage_load_phase_t* phase, float* progress);
+
+void
+stage_load_cancel(stage_load_t load);
+
+/* Blocks until loading has finished and releases `load`. Returns NULL if loading failed or was cancelled. */
+stage_scene_t
+stage_load_wait(stage_load_t load, stage_error_t* error);
+
 /* Camera API */
 stage_vec3f_t
 stage_camera_get_position(stage_camera_t camera);
@@ -118,6 +264,24 @@ stage_image_is_hdr(stage_image_t image);
 bool
 stage_image_is_valid(stage_image_t image);
 
+/* Mip levels are stored in one allocation starting with level 0, see stage_config_set_mip_filter */
+uint32_t
+stage_image_get_level_count(stage_image_t image);
+
+uint32_t
+stage_image_get_level_width(stage_image_t image, uint32_t level);
+
+uint32_t
+stage_image_get_level_height(stage_image_t image, uint32_t level);
+
+/* Byte offset of `level` from stage_image_get_data */
+size_t
+stage_image_get_level_offset(stage_image_t image, uint32_t level);
+
+/* Compressed images store the 4x4 blocks of every level in this format, see stage_config_set_texture_compression */
+stage_texture_format_t
+stage_image_get_format(stage_image_t image);
+
 /* Light API */
 stage_light_t
 stage_light_get(stage_light_list_t lightList, size_t index);
@@ -199,6 +363,10 @@ stage_object_instance_get_instance_to_world(stage_object_instance_t instance);
 uint32_t
 stage_object_instance_get_object_id(stage_object_instance_t instance);
 
+/* World space bounds of the instanced object */
+stage_aabb_t
+stage_object_instance_get_bounds(stage_object_instance_t instance);
+
 stage_object_t
 stage_object_get(stage_object_list_t objectList, size_t index);
 
@@ -211,11 +379,16 @@ stage_object_get_geometries(stage_object_t object, size_t* count);
 void*
 stage_object_get_buffer(stage_object_t object, size_t* sizeInBytes);
 
+/* Object space bounds of all geometries of the object */
+stage_aabb_t
+stage_object_get_bounds(stage_object_t object);
+
 stage_geometry_t
 stage_geometry_get(stage_geometry_list_t geometryList, size_t index);
 
-uint32_t*
-stage_geometry_get_indices(stage_geometry_t geometry, size_t* count);
+/* Returns `count` indices of `index_size` bytes each, which is 2 for geometries that were compacted with IndexFormat_Adaptive and 4 otherwise */
+void*
+stage_geometry_get_indices(stage_geometry_t geometry, size_t* count, size_t* index_size);
 
 stage_vec3f_t*
 stage_geometry_get_positions(stage_geometry_t geometry, size_t* count, size_t* stride);
@@ -229,6 +402,44 @@ stage_geometry_get_uvs(stage_geometry_t geometry, size_t* count, size_t* stride)
 uint32_t*
 stage_geometry_get_material_ids(stage_geometry_t geometry, size_t* count, size_t* stride);
 
+stage_aabb_t
+stage_geometry_get_bounds(stage_geometry_t geometry);
+
+/* Compressed attributes, only present in layouts with the matching VertexLayout_Compressed_* flag. Each element holds two or three values. */
+uint16_t*
+stage_geometry_get_quantized_positions(stage_geometry_t geometry, size_t* count, size_t* stride);
+
+/* Positions decode to `offset + scale * q` */
+void
+stage_geometry_get_position_dequantization(stage_geometry_t geometry, stage_vec3f_t* offset, stage_vec3f_t* scale);
+
+int16_t*
+stage_geometry_get_octahedral_normals(stage_geometry_t geometry, size_t* count, size_t* stride);
+
+uint16_t*
+stage_geometry_get_half_uvs(stage_geometry_t geometry, size_t* count, size_t* stride);
+
+/* Meshlets, only present if they were enabled with stage_config_set_meshlets */
+stage_meshlet_t*
+stage_geometry_get_meshlets(stage_geometry_t geometry, size_t* count);
+
+uint32_t*
+stage_geometry_get_meshlet_vertices(stage_geometry_t geometry, size_t* count);
+
+/* Returns `count` triangles, each made up of three bytes */
+uint8_t*
+stage_geometry_get_meshlet_triangles(stage_geometry_t geometry, size_t* count);
+
+/* Attribute access for any layout, compressed attributes are decoded */
+stage_vec3f_t
+stage_geometry_decode_position(stage_geometry_t geometry, size_t index);
+
+stage_vec3f_t
+stage_geometry_decode_normal(stage_geometry_t geometry, size_t index);
+
+stage_vec2f_t
+stage_geometry_decode_uv(stage_geometry_t geometry, size_t index);
+
 /* Scene API */
 stage_camera_t
 stage_scene_get_camera(stage_scene_t scene);
@@ -251,6 +462,10 @@ stage_scene_get_textures(stage_scene_t scene, size_t* count);
 float
 stage_scene_get_scale(stage_scene_t scene);
 
+/* World space bounds of all instances */
+stage_aabb_t
+stage_scene_get_bounds(stage_scene_t scene);
+
 #ifdef __cplusplus
 }
 #endif
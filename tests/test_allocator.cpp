@@ -0,0 +1,73 @@
+#include "test_common.h"
+
+TEST(Allocator, Buffer) {
+    auto allocator = std::make_shared<CountingAllocator>();
+    {
+        Buffer buf(allocator);
+        for (size_t size = 1; size <= 1024; size *= 2) {
+            buf.resize(size);
+            buf.data()[size - 1] = 1;
+        }
+        EXPECT_EQ(allocator->outstanding, buf.capacity());
+        buf.shrink_to_fit();
+        EXPECT_EQ(allocator->outstanding, buf.size());
+    }
+    EXPECT_GT(allocator->allocations, 0);
+    EXPECT_EQ(allocator->allocations, allocator->deallocations);
+    EXPECT_EQ(allocator->mismatches, 0);
+    EXPECT_EQ(allocator->outstanding, 0);
+}
+
+TEST(Allocator, Object) {
+    auto allocator = std::make_shared<CountingAllocator>();
+    {
+        Object obj(VertexLayout_Interleaved_VNT, 16, allocator);
+        obj.geometries.push_back(make_geometry(obj, 512, 512));
+        EXPECT_EQ(allocator->outstanding, obj.data->capacity());
+    }
+    EXPECT_EQ(allocator->mismatches, 0);
+    EXPECT_EQ(allocator->outstanding, 0);
+}
+
+TEST(Allocator, Alignment) {
+    // Vertex alignments are passed on to the allocator, rounded up to a power of two
+    auto allocator = std::make_shared<CountingAllocator>();
+    for (size_t alignment : { 4, 16, 48, 64, 256 }) {
+        Object obj(VertexLayout_Interleaved_VNT, alignment, allocator);
+        obj.geometries.push_back(make_geometry(obj, 100, 300));
+        ASSERT_NE(obj.data->data(), nullptr);
+        EXPECT_GE(obj.data->alignment(), alignment);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(obj.data->data()) % obj.data->alignment(), 0);
+    }
+    EXPECT_EQ(allocator->mismatches, 0);
+    EXPECT_EQ(allocator->outstanding, 0);
+}
+
+TEST(Allocator, Image) {
+    std::filesystem::path path = write_test_ppm("stage_test_allocator.ppm", 8, 4);
+    auto allocator = std::make_shared<CountingAllocator>();
+    {
+        Image eager(path.string(), false, false, allocator);
+        EXPECT_EQ(allocator->outstanding, eager.getSizeInBytes());
+
+        Image lazy(path.string(), false, true, allocator);
+        EXPECT_EQ(allocator->outstanding, eager.getSizeInBytes());
+        ASSERT_NE(lazy.getData(), nullptr);
+        EXPECT_EQ(allocator->outstanding, eager.getSizeInBytes() + lazy.getSizeInBytes());
+        EXPECT_EQ(std::memcmp(eager.getData(), lazy.getData(), eager.getSizeInBytes()), 0);
+
+        Image constant(stage_vec3f(1.f), allocator);
+        EXPECT_EQ(allocator->outstanding, eager.getSizeInBytes() + lazy.getSizeInBytes() + 4);
+
+        // Modifying shared pixels copies them into memory from the shared image's allocator
+        auto shared = std::make_shared<Image>(std::move(constant));
+        Image copy(shared);
+        copy.scale(stage_vec3f(0.5f));
+        EXPECT_EQ(allocator->outstanding, eager.getSizeInBytes() + lazy.getSizeInBytes() + 8);
+    }
+    EXPECT_EQ(allocator->outstanding, 0);
+    EXPECT_EQ(allocator->allocations, allocator->deallocations);
+    EXPECT_EQ(allocator->mismatches, 0);
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,128 @@
+#include "test_common.h"
+#include <backstage/asset_cache.h>
+#include <backstage/texture_loader.h>
+
+TEST(AssetCache, SharesImagesBetweenLoaders) {
+    AssetCache::get().clear();
+    std::filesystem::path path = write_test_ppm("stage_test_cache_shared.ppm", 4, 4);
+
+    std::vector<Image> first, second;
+    {
+        TextureLoader loader(first, false, true);
+        loader.load(path.string());
+        loader.finish(true);
+    }
+    {
+        TextureLoader loader(second, false, true);
+        loader.load(path.string());
+        loader.finish(true);
+    }
+
+    ASSERT_EQ(first.size(), 1);
+    ASSERT_EQ(second.size(), 1);
+    EXPECT_EQ(first[0].getData(), second[0].getData());
+    EXPECT_EQ(AssetCache::get().getSize(), first[0].getSizeInBytes());
+
+    AssetCache::get().clear();
+    std::filesystem::remove(path);
+}
+
+TEST(AssetCache, CopyOnWrite) {
+    auto shared = std::make_shared<Image>(stage_vec3f(1.f));
+    Image a(shared);
+    Image b(shared);
+
+    a.scale(stage_vec3f(0.5f));
+    EXPECT_NE(a.getData(), b.getData());
+    EXPECT_EQ(a.getData()[0], 128);
+    EXPECT_EQ(b.getData()[0], 255);
+    EXPECT_EQ(shared->getData()[0], 255);
+}
+
+TEST(AssetCache, EvictsLeastRecentlyUsed) {
+    AssetCache& cache = AssetCache::get();
+    cache.clear();
+    size_t budget = cache.getBudget();
+
+    std::vector<std::filesystem::path> paths;
+    for (int i = 0; i < 3; i++) {
+        paths.push_back(write_test_ppm("stage_test_cache_lru_" + std::to_string(i) + ".ppm", 4, 4));
+    }
+    auto image = std::make_shared<Image>(paths[0].string());
+    size_t size = image->getSizeInBytes();
+    cache.setBudget(2 * size);
+
+    cache.insertImage(paths[0].string(), false, false, MipFilter_None, image);
+    cache.insertImage(paths[1].string(), false, false, MipFilter_None, image);
+    EXPECT_NE(cache.findImage(paths[0].string(), false, false, MipFilter_None), nullptr);
+    cache.insertImage(paths[2].string(), false, false, MipFilter_None, image);
+
+    EXPECT_EQ(cache.getSize(), 2 * size);
+    EXPECT_NE(cache.findImage(paths[0].string(), false, false, MipFilter_None), nullptr);
+    EXPECT_EQ(cache.findImage(paths[1].string(), false, false, MipFilter_None), nullptr);
+    EXPECT_NE(cache.findImage(paths[2].string(), false, false, MipFilter_None), nullptr);
+    EXPECT_EQ(cache.findImage(paths[0].string(), true, false, MipFilter_None), nullptr);
+
+    cache.setBudget(budget);
+    cache.clear();
+    for (auto& path : paths) std::filesystem::remove(path);
+}
+
+TEST(AssetCache, SharesScenes) {
+    AssetCache::get().clear();
+    std::filesystem::path path = write_test_obj("stage_test_cache_scene.obj");
+
+    Config config;
+    config.use_asset_cache = true;
+    stage::Scene first(path.string(), config);
+    stage::Scene second(path.string(), config);
+    ASSERT_TRUE(first.isValid());
+    ASSERT_TRUE(second.isValid());
+    ASSERT_EQ(second.getObjects().size(), first.getObjects().size());
+    EXPECT_EQ(second.getObjects()[0].data.get(), first.getObjects()[0].data.get());
+    EXPECT_EQ(second.getInstances().size(), first.getInstances().size());
+    EXPECT_EQ(second.getMaterials().size(), first.getMaterials().size());
+
+    // A config that changes the loaded data does not hit the cached scene
+    Config other = config;
+    other.layout = VertexLayout_Interleaved_VN;
+    stage::Scene third(path.string(), other);
+    ASSERT_TRUE(third.isValid());
+    EXPECT_NE(third.getObjects()[0].data.get(), first.getObjects()[0].data.get());
+    EXPECT_NE(third.getObjects()[0].layout(), first.getObjects()[0].layout());
+
+    AssetCache::get().clear();
+    std::filesystem::remove(path);
+}
+
+TEST(AssetCache, EvictsScenes) {
+    AssetCache& cache = AssetCache::get();
+    cache.clear();
+    size_t budget = cache.getBudget();
+    std::filesystem::path first_path = write_test_obj("stage_test_cache_scene_0.obj");
+    std::filesystem::path second_path = write_test_obj("stage_test_cache_scene_1.obj");
+
+    Config config;
+    config.use_asset_cache = true;
+    stage::Scene first(first_path.string(), config);
+    ASSERT_TRUE(first.isValid());
+    size_t scene_size = cache.getSize();
+    ASSERT_GT(scene_size, 0);
+
+    // Only one of the two scenes fits, so loading the second one drops the first
+    cache.setBudget(scene_size + scene_size / 2);
+    stage::Scene second(second_path.string(), config);
+    ASSERT_TRUE(second.isValid());
+    EXPECT_EQ(cache.getSize(), scene_size);
+
+    stage::Scene reloaded(first_path.string(), config);
+    ASSERT_TRUE(reloaded.isValid());
+    EXPECT_NE(reloaded.getObjects()[0].data.get(), first.getObjects()[0].data.get());
+    // The evicted scene keeps its data alive
+    EXPECT_EQ(first.getObjects()[0].geometries[0].getPosition(2), reloaded.getObjects()[0].geometries[0].getPosition(2));
+
+    cache.setBudget(budget);
+    cache.clear();
+    std::filesystem::remove(first_path);
+    std::filesystem::remove(second_path);
+}
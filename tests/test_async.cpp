@@ -0,0 +1,32 @@
+#include "test_common.h"
+#include <backstage/scene.h>
+
+TEST(AsyncLoad, LoadScene) {
+    std::filesystem::path obj_path = write_test_obj("stage_test_async.obj");
+
+    auto load = stage::loadSceneAsync(obj_path.string(), Config());
+    auto scene = load->get();
+
+    ASSERT_TRUE(scene->isValid());
+    EXPECT_TRUE(load->isReady());
+    EXPECT_EQ(load->getPhase(), LoadPhase_Done);
+    EXPECT_EQ(load->getProgress(), 1.f);
+    EXPECT_EQ(scene->getObjects().size(), 1);
+
+    std::filesystem::remove(obj_path);
+}
+
+TEST(AsyncLoad, Cancel) {
+    std::filesystem::path obj_path = write_test_obj("stage_test_async_cancel.obj");
+
+    LoadProgress progress;
+    progress.cancel();
+    EXPECT_THROW(progress.report(LoadPhase_Parse, 0.f), LoadCancelled);
+
+    // The flag is set before loading starts, so the loader must observe it
+    auto scene = stage::backstage::createScene(obj_path.string(), Config(), &progress);
+    EXPECT_EQ(scene, nullptr);
+    EXPECT_NE(progress.getPhase(), LoadPhase_Done);
+
+    std::filesystem::remove(obj_path);
+}
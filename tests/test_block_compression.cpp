@@ -0,0 +1,382 @@
+#include "test_common.h"
+#include <random>
+#include <backstage/block_compression.h>
+#include <backstage/quantization.h>
+
+/* Reference decoders written from the format specifications, one 4x4 block at a time */
+
+struct BitReader {
+    const uint8_t* data;
+    uint32_t position { 0 };
+
+    uint32_t read(uint32_t bits) {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < bits; i++, position++) {
+            value |= uint32_t((data[position >> 3] >> (position & 7)) & 1) << i;
+        }
+        return value;
+    }
+};
+
+const int32_t bc_weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+void
+decode_bc1(const uint8_t* block, uint8_t texels[16][4]) {
+    uint16_t c0 = block[0] | (block[1] << 8);
+    uint16_t c1 = block[2] | (block[3] << 8);
+    int32_t palette[4][4];
+    for (int32_t i = 0; i < 2; i++) {
+        uint16_t c = i == 0 ? c0 : c1;
+        int32_t r = c >> 11, g = (c >> 5) & 63, b = c & 31;
+        palette[i][0] = (r << 3) | (r >> 2);
+        palette[i][1] = (g << 2) | (g >> 4);
+        palette[i][2] = (b << 3) | (b >> 2);
+        palette[i][3] = 255;
+    }
+    for (int32_t c = 0; c < 3; c++) {
+        if (c0 > c1) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = c0 > c1 ? 255 : 0;
+
+    uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (uint32_t(block[7]) << 24);
+    for (int32_t i = 0; i < 16; i++) {
+        for (int32_t c = 0; c < 4; c++) {
+            texels[i][c] = palette[(indices >> (2 * i)) & 3][c];
+        }
+    }
+}
+
+void
+decode_bc4(const uint8_t* block, uint8_t values[16]) {
+    int32_t r0 = block[0], r1 = block[1];
+    int32_t palette[8] = { r0, r1 };
+    for (int32_t i = 2; i < 8; i++) {
+        if (r0 > r1)
+            palette[i] = ((8 - i) * r0 + (i - 1) * r1) / 7;
+        else
+            palette[i] = i == 6 ? 0 : i == 7 ? 255 : ((6 - i) * r0 + (i - 1) * r1) / 5;
+    }
+    BitReader reader { block };
+    reader.position = 16;
+    for (int32_t i = 0; i < 16; i++) {
+        values[i] = palette[reader.read(3)];
+    }
+}
+
+/* Mode 6 only, returns false for other modes */
+bool
+decode_bc7(const uint8_t* block, uint8_t texels[16][4]) {
+    BitReader reader { block };
+    if (reader.read(7) != 0x40) return false;
+    int32_t endpoints[2][4];
+    for (int32_t c = 0; c < 4; c++) {
+        endpoints[0][c] = reader.read(7);
+        endpoints[1][c] = reader.read(7);
+    }
+    for (int32_t e = 0; e < 2; e++) {
+        uint32_t p = reader.read(1);
+        for (int32_t c = 0; c < 4; c++) {
+            endpoints[e][c] = (endpoints[e][c] << 1) | p;
+        }
+    }
+    for (int32_t i = 0; i < 16; i++) {
+        int32_t w = bc_weights4[reader.read(i == 0 ? 3 : 4)];
+        for (int32_t c = 0; c < 4; c++) {
+            texels[i][c] = ((64 - w) * endpoints[0][c] + w * endpoints[1][c] + 32) >> 6;
+        }
+    }
+    return true;
+}
+
+/* Unsigned mode 11 only, returns false for other modes */
+bool
+decode_bc6h(const uint8_t* block, float texels[16][3]) {
+    BitReader reader { block };
+    if (reader.read(5) != 0x03) return false;
+    int32_t endpoints[2][3];
+    for (int32_t e = 0; e < 2; e++) {
+        for (int32_t c = 0; c < 3; c++) {
+            int32_t q = reader.read(10);
+            endpoints[e][c] = q == 0 ? 0 : q == 1023 ? 0xffff : ((q << 16) + 0x8000) >> 10;
+        }
+    }
+    for (int32_t i = 0; i < 16; i++) {
+        int32_t w = bc_weights4[reader.read(i == 0 ? 3 : 4)];
+        for (int32_t c = 0; c < 3; c++) {
+            int32_t value = ((64 - w) * endpoints[0][c] + w * endpoints[1][c] + 32) >> 6;
+            texels[i][c] = halfToFloat(uint16_t((value * 31) >> 6));
+        }
+    }
+    return true;
+}
+
+/* Calls `fn` for every texel (x, y) with the block that contains it and its index in the block */
+template<typename F>
+void
+for_each_decoded_texel(const std::vector<uint8_t>& blocks, uint32_t width, uint32_t height, size_t block_size, F fn) {
+    uint32_t blocks_x = (width + 3) / 4;
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            fn(x, y, &blocks[((y / 4) * blocks_x + x / 4) * block_size], (y % 4) * 4 + x % 4);
+        }
+    }
+}
+
+/* RGBA ramps along the diagonal, all channels change together so that every block lies on a line in color space */
+std::vector<uint8_t>
+make_ramp(uint32_t width, uint32_t height, bool is_opaque = true) {
+    std::vector<uint8_t> texels(size_t(width) * height * 4);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            float t = float(x + y) / (width + height - 2);
+            uint8_t* texel = &texels[(size_t(y) * width + x) * 4];
+            texel[0] = uint8_t(t * 255.f);
+            texel[1] = uint8_t(255.f - t * 200.f);
+            texel[2] = uint8_t(64.f + t * 100.f);
+            texel[3] = is_opaque ? 255 : uint8_t(t * 255.f);
+        }
+    }
+    return texels;
+}
+
+std::vector<uint8_t>
+make_noise(uint32_t width, uint32_t height) {
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int32_t> value(0, 255);
+    std::vector<uint8_t> texels(size_t(width) * height * 4);
+    for (auto& texel : texels) {
+        texel = uint8_t(value(rng));
+    }
+    return texels;
+}
+
+/* Error of replacing every block of 4 channel texels by its mean, which any encoder should beat */
+double
+flat_block_rmse(const std::vector<uint8_t>& texels, uint32_t width, uint32_t height, int32_t channels) {
+    double squared_error = 0.0;
+    for (uint32_t by = 0; by < height; by += 4) {
+        for (uint32_t bx = 0; bx < width; bx += 4) {
+            for (int32_t c = 0; c < channels; c++) {
+                double sum = 0.0, sum_squared = 0.0;
+                int32_t count = 0;
+                for (uint32_t y = by; y < std::min(by + 4, height); y++) {
+                    for (uint32_t x = bx; x < std::min(bx + 4, width); x++) {
+                        double v = texels[(size_t(y) * width + x) * 4 + c];
+                        sum += v;
+                        sum_squared += v * v;
+                        count++;
+                    }
+                }
+                squared_error += sum_squared - sum * sum / count;
+            }
+        }
+    }
+    return std::sqrt(squared_error / (double(width) * height * channels));
+}
+
+/* Decodes BC1 or BC7 blocks and returns the RMSE over the first `channels` channels */
+double
+decoded_rmse(const std::vector<uint8_t>& texels, const std::vector<uint8_t>& blocks, uint32_t width, uint32_t height, TextureFormat format, int32_t channels) {
+    double squared_error = 0.0;
+    for_each_decoded_texel(blocks, width, height, blockSize(format), [&](uint32_t x, uint32_t y, const uint8_t* block, int32_t i) {
+        uint8_t decoded[16][4];
+        if (format == TextureFormat_BC1)
+            decode_bc1(block, decoded);
+        else
+            ASSERT_TRUE(decode_bc7(block, decoded));
+        for (int32_t c = 0; c < channels; c++) {
+            double error = decoded[i][c] - texels[(size_t(y) * width + x) * 4 + c];
+            squared_error += error * error;
+        }
+    });
+    return std::sqrt(squared_error / (double(width) * height * channels));
+}
+
+TEST(BlockCompression, Sizes) {
+    EXPECT_EQ(blockSize(TextureFormat_Uncompressed), 0);
+    EXPECT_EQ(blockSize(TextureFormat_BC1), 8);
+    EXPECT_EQ(blockSize(TextureFormat_BC4), 8);
+    EXPECT_EQ(blockSize(TextureFormat_BC5), 16);
+    EXPECT_EQ(blockSize(TextureFormat_BC6H), 16);
+    EXPECT_EQ(blockSize(TextureFormat_BC7), 16);
+
+    // Partial blocks count as full blocks
+    EXPECT_EQ(compressedSize(TextureFormat_BC1, 1, 1), 8);
+    EXPECT_EQ(compressedSize(TextureFormat_BC1, 5, 5), 32);
+    EXPECT_EQ(compressedSize(TextureFormat_BC7, 16, 8), 128);
+}
+
+TEST(BlockCompression, BC1) {
+    // 30 x 18 leaves partial blocks at the right and bottom edges
+    const uint32_t width = 30, height = 18;
+    std::vector<uint8_t> texels = make_ramp(width, height);
+    std::vector<uint8_t> blocks(compressedSize(TextureFormat_BC1, width, height));
+    compressBlocks(texels.data(), width, height, 4, TextureFormat_BC1, blocks.data());
+
+    int32_t max_error = 0;
+    for_each_decoded_texel(blocks, width, height, 8, [&](uint32_t x, uint32_t y, const uint8_t* block, int32_t i) {
+        uint8_t decoded[16][4];
+        decode_bc1(block, decoded);
+        for (int32_t c = 0; c < 4; c++) {
+            max_error = std::max(max_error, std::abs(decoded[i][c] - texels[(y * width + x) * 4 + c]));
+        }
+    });
+    EXPECT_LE(max_error, 8);
+
+    texels = make_noise(width, height);
+    for (size_t i = 3; i < texels.size(); i += 4) {
+        texels[i] = 255;
+    }
+    compressBlocks(texels.data(), width, height, 4, TextureFormat_BC1, blocks.data());
+    EXPECT_LT(decoded_rmse(texels, blocks, width, height, TextureFormat_BC1, 3), flat_block_rmse(texels, width, height, 3));
+}
+
+TEST(BlockCompression, BC1Transparency) {
+    const uint32_t width = 8, height = 8;
+    std::vector<uint8_t> texels = make_ramp(width, height);
+    for (size_t i = 0; i < size_t(width) * height; i++) {
+        texels[i * 4 + 3] = i % 3 == 0 ? 0 : 255;
+    }
+    // A fully transparent block
+    for (uint32_t y = 4; y < 8; y++) {
+        for (uint32_t x = 4; x < 8; x++) {
+            texels[(y * width + x) * 4 + 3] = 0;
+        }
+    }
+    std::vector<uint8_t> blocks(compressedSize(TextureFormat_BC1, width, height));
+    compressBlocks(texels.data(), width, height, 4, TextureFormat_BC1, blocks.data());
+
+    for_each_decoded_texel(blocks, width, height, 8, [&](uint32_t x, uint32_t y, const uint8_t* block, int32_t i) {
+        uint8_t decoded[16][4];
+        decode_bc1(block, decoded);
+        const uint8_t* texel = &texels[(y * width + x) * 4];
+        EXPECT_EQ(decoded[i][3], texel[3]);
+        if (texel[3] == 255) {
+            // Three color mode has one interpolated color only
+            for (int32_t c = 0; c < 3; c++) {
+                EXPECT_NEAR(decoded[i][c], texel[c], 24);
+            }
+        }
+    });
+}
+
+TEST(BlockCompression, BC4AndBC5) {
+    const uint32_t width = 12, height = 7;
+    std::vector<uint8_t> texels = make_ramp(width, height, false);
+    std::vector<uint8_t> bc4(compressedSize(TextureFormat_BC4, width, height));
+    std::vector<uint8_t> bc5(compressedSize(TextureFormat_BC5, width, height));
+    compressBlocks(texels.data(), width, height, 4, TextureFormat_BC4, bc4.data(), 3);
+    compressBlocks(texels.data(), width, height, 4, TextureFormat_BC5, bc5.data());
+
+    // The ramp spans at most 70 values per block, 10 per palette step
+    for_each_decoded_texel(bc4, width, height, 8, [&](uint32_t x, uint32_t y, const uint8_t* block, int32_t i) {
+        uint8_t decoded[16];
+        decode_bc4(block, decoded);
+        EXPECT_NEAR(decoded[i], texels[(y * width + x) * 4 + 3], 6);
+    });
+    for_each_decoded_texel(bc5, width, height, 16, [&](uint32_t x, uint32_t y, const uint8_t* block, int32_t i) {
+        for (int32_t c = 0; c < 2; c++) {
+            uint8_t decoded[16];
+            decode_bc4(block + 8 * c, decoded);
+            EXPECT_NEAR(decoded[i], texels[(y * width + x) * 4 + c], 6);
+        }
+    });
+
+    // Constant blocks are exact
+    std::vector<uint8_t> constant(16, 77);
+    uint8_t block[8];
+    uint8_t decoded[16];
+    compressBlocks(constant.data(), 4, 4, 1, TextureFormat_BC4, block);
+    decode_bc4(block, decoded);
+    for (uint8_t value : decoded) {
+        EXPECT_EQ(value, 77);
+    }
+}
+
+TEST(BlockCompression, BC7) {
+    const uint32_t width = 21, height = 10;
+    std::vector<uint8_t> blocks(compressedSize(TextureFormat_BC7, width, height));
+    for (bool is_opaque : { true, false }) {
+        std::vector<uint8_t> texels = make_ramp(width, height, is_opaque);
+        // Falling values make the first texel of every block end up on the far endpoint
+        std::reverse(texels.begin(), texels.end());
+        if (is_opaque) {
+            for (size_t i = 3; i < texels.size(); i += 4) {
+                texels[i] = 255;
+            }
+        }
+        compressBlocks(texels.data(), width, height, 4, TextureFormat_BC7, blocks.data());
+        EXPECT_LE(decoded_rmse(texels, blocks, width, height, TextureFormat_BC7, 4), 1.5);
+
+        // Opaque blocks stay exactly opaque
+        for_each_decoded_texel(blocks, width, height, 16, [&](uint32_t, uint32_t, const uint8_t* block, int32_t i) {
+            uint8_t decoded[16][4];
+            ASSERT_TRUE(decode_bc7(block, decoded));
+            if (is_opaque) {
+                EXPECT_EQ(decoded[i][3], 255);
+            }
+        });
+    }
+
+    std::vector<uint8_t> texels = make_noise(width, height);
+    compressBlocks(texels.data(), width, height, 4, TextureFormat_BC7, blocks.data());
+    EXPECT_LT(decoded_rmse(texels, blocks, width, height, TextureFormat_BC7, 4), flat_block_rmse(texels, width, height, 4));
+}
+
+TEST(BlockCompression, BC7Channels) {
+    // Gray images decode as opaque RGBA with equal color channels
+    std::vector<uint8_t> gray(25);
+    for (size_t i = 0; i < gray.size(); i++) {
+        gray[i] = uint8_t(i * 10);
+    }
+    std::vector<uint8_t> blocks(compressedSize(TextureFormat_BC7, 5, 5));
+    compressBlocks(gray.data(), 5, 5, 1, TextureFormat_BC7, blocks.data());
+    for_each_decoded_texel(blocks, 5, 5, 16, [&](uint32_t x, uint32_t y, const uint8_t* block, int32_t i) {
+        uint8_t decoded[16][4];
+        ASSERT_TRUE(decode_bc7(block, decoded));
+        EXPECT_NEAR(decoded[i][0], gray[y * 5 + x], 8);
+        EXPECT_EQ(decoded[i][0], decoded[i][1]);
+        EXPECT_EQ(decoded[i][0], decoded[i][2]);
+        EXPECT_EQ(decoded[i][3], 255);
+    });
+}
+TEST(BlockCompression, BC6H) {
+    const uint32_t width = 9, height = 6;
+    std::vector<float> texels(size_t(width) * height * 3);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            float* texel = &texels[(size_t(y) * width + x) * 3];
+            float t = float(x + y) / (width + height - 2);
+            texel[0] = 1.f + t * 3.f;
+            texel[1] = 40.f - t * 8.f;
+            texel[2] = 0.5f + t * 0.4f;
+        }
+    }
+    std::vector<uint8_t> blocks(compressedSize(TextureFormat_BC6H, width, height));
+    compressBlocksBC6H(texels.data(), width, height, 3, blocks.data());
+    for_each_decoded_texel(blocks, width, height, 16, [&](uint32_t x, uint32_t y, const uint8_t* block, int32_t i) {
+        float decoded[16][3];
+        ASSERT_TRUE(decode_bc6h(block, decoded));
+        for (int32_t c = 0; c < 3; c++) {
+            float expected = texels[(y * width + x) * 3 + c];
+            EXPECT_NEAR(decoded[i][c], expected, expected * 0.05f);
+        }
+    });
+
+    // Negative values and NaNs become zero, alpha is dropped
+    float special[4] = { -3.f, std::numeric_limits<float>::quiet_NaN(), 0.f, 2.f };
+    uint8_t block[16];
+    float decoded[16][3];
+    compressBlocksBC6H(special, 1, 1, 4, block);
+    ASSERT_TRUE(decode_bc6h(block, decoded));
+    EXPECT_EQ(decoded[0][0], 0.f);
+    EXPECT_EQ(decoded[0][1], 0.f);
+    EXPECT_EQ(decoded[0][2], 0.f);
+}
@@ -133,4 +133,86 @@ TEST(BufferView, StrideWrite) {
     for (int i = 0; i < 256; i++) {
         EXPECT_EQ(i, view[i]);
     }
-}
\ No newline at end of file
+}
+TEST(Buffer, WrapExternalMemory) {
+    auto data = std::make_shared<std::vector<uint8_t>>(make_data_array<uint8_t>(1024));
+    std::weak_ptr<std::vector<uint8_t>> observer = data;
+    {
+        Buffer buf(data->data(), data->size(), data);
+        data.reset();
+
+        EXPECT_FALSE(observer.expired());
+        EXPECT_EQ(buf.size(), 1024);
+        for (int i = 0; i < 1024; i++) {
+            EXPECT_EQ(buf.data()[i], uint8_t(i));
+        }
+        EXPECT_THROW(buf.resize(2048), std::runtime_error);
+    }
+    EXPECT_TRUE(observer.expired());
+}
+
+TEST(Buffer, GrowsGeometrically) {
+    Buffer buf;
+    size_t reallocations = 0;
+    size_t capacity = buf.capacity();
+    for (size_t size = 1; size <= 4096; size++) {
+        buf.resize(size);
+        buf.data()[size - 1] = uint8_t(size);
+        if (buf.capacity() != capacity) {
+            reallocations++;
+            capacity = buf.capacity();
+        }
+    }
+
+    EXPECT_EQ(buf.size(), 4096);
+    EXPECT_GE(buf.capacity(), buf.size());
+    EXPECT_LE(reallocations, 13);
+    for (size_t i = 0; i < 4096; i++) {
+        EXPECT_EQ(buf.data()[i], uint8_t(i + 1));
+    }
+}
+
+TEST(Buffer, ReserveAndShrink) {
+    std::vector<uint8_t> data = make_data_array<uint8_t>(256);
+    Buffer buf(data);
+
+    buf.reserve(1024);
+    EXPECT_EQ(buf.size(), 256);
+    EXPECT_EQ(buf.capacity(), 1024);
+    uint8_t* reserved = buf.data();
+    buf.resize(1024);
+    EXPECT_EQ(buf.data(), reserved);
+
+    buf.resize(128);
+    EXPECT_EQ(buf.capacity(), 1024);
+    buf.shrink_to_fit();
+    EXPECT_EQ(buf.capacity(), 128);
+    for (int i = 0; i < 128; i++) {
+        EXPECT_EQ(buf.data()[i], data[i]);
+    }
+}
+
+TEST(Buffer, AlignedStorage) {
+    for (size_t alignment : {4, 16, 64, 128, 256}) {
+        Buffer buf(Allocator::getDefault(), alignment);
+        EXPECT_GE(buf.alignment(), alignment);
+        for (size_t size : {1, 100, 5000}) {
+            buf.resize(size);
+            EXPECT_EQ((uintptr_t)buf.data() % alignment, 0);
+        }
+        buf.shrink_to_fit();
+        EXPECT_EQ((uintptr_t)buf.data() % alignment, 0);
+    }
+}
+
+TEST(BufferView, AlignedElementSize) {
+    EXPECT_EQ(sizeofAligned<stage_vec3f>(4), 12);
+    EXPECT_EQ(sizeofAligned<stage_vec3f>(16), 16);
+    EXPECT_EQ(sizeofAligned<stage_vec3f>(32), 32);
+    EXPECT_EQ(sizeofAligned<stage_vec2f>(16), 16);
+    EXPECT_EQ(sizeofAligned<uint32_t>(128), 128);
+
+    auto buffer = std::make_shared<Buffer>();
+    BufferView<stage_vec3f> view(buffer, 0, 10, 32, 32);
+    EXPECT_EQ(view.sizeInBytes(), 320);
+}
@@ -0,0 +1,211 @@
+#include "test_common.h"
+#include <set>
+#include <backstage/bvh.h>
+
+bool
+contains(const BVHNode& outer, const stage_vec3f& lower, const stage_vec3f& upper) {
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        if (lower[axis] < outer.lower[axis] || upper[axis] > outer.upper[axis])
+            return false;
+    }
+    return true;
+}
+
+void
+test_bvh(const BVH& bvh, const Object& obj) {
+    ASSERT_TRUE(bvh.isValid());
+
+    // Every node is reachable exactly once and every primitive is referenced by exactly one leaf
+    size_t num_triangles = 0;
+    for (auto& g : obj.geometries) {
+        num_triangles += g.numIndices() / 3;
+    }
+    std::vector<uint32_t> visited(bvh.nodes.size(), 0);
+    std::vector<uint32_t> referenced(bvh.primitives.size(), 0);
+    std::vector<uint32_t> stack { 0 };
+    while (!stack.empty()) {
+        uint32_t index = stack.back();
+        stack.pop_back();
+        ASSERT_LT(index, bvh.nodes.size());
+        visited[index]++;
+        const BVHNode& node = bvh.nodes[index];
+
+        if (node.isLeaf()) {
+            EXPECT_LE(node.offset + node.count, bvh.primitives.size());
+            for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                referenced[i]++;
+                const BVHPrimitive& p = bvh.primitives[i];
+                const Geometry& g = obj.geometries[p.geometry_id];
+                for (size_t k = 0; k < 3; k++) {
+                    stage_vec3f v = g.getPosition(g.getIndex(3 * p.primitive_id + k));
+                    EXPECT_TRUE(contains(node, v, v));
+                }
+            }
+            continue;
+        }
+        for (uint32_t child = node.offset; child < node.offset + 2; child++) {
+            ASSERT_LT(child, bvh.nodes.size());
+            EXPECT_TRUE(contains(node, bvh.nodes[child].lower, bvh.nodes[child].upper));
+            stack.push_back(child);
+        }
+    }
+    // Except for the padding node that aligns the sibling pairs
+    std::vector<uint32_t> expected_visits(bvh.nodes.size(), 1);
+    if (!bvh.nodes[0].isLeaf())
+        expected_visits[1] = 0;
+    EXPECT_EQ(visited, expected_visits);
+    EXPECT_EQ(referenced, std::vector<uint32_t>(bvh.primitives.size(), 1));
+    EXPECT_EQ(bvh.primitives.size(), num_triangles);
+    EXPECT_LE(bvh.nodes.size(), 2 * num_triangles);
+
+    std::set<std::pair<uint32_t, uint32_t>> primitives;
+    for (auto& p : bvh.primitives) {
+        primitives.insert({ p.geometry_id, p.primitive_id });
+    }
+    EXPECT_EQ(primitives.size(), num_triangles);
+}
+
+TEST(BVH, ObjectBVH) {
+    Object obj(VertexLayout_Interleaved_VN, 4);
+    obj.geometries.push_back(make_grid_geometry(obj, 128, true));
+    obj.geometries.push_back(make_grid_geometry(obj, 3));
+
+    BVHBuildOptions options;
+    test_bvh(buildObjectBVH(obj, options), obj);
+    options.num_bins = 4;
+    options.max_leaf_size = 1;
+    test_bvh(buildObjectBVH(obj, options), obj);
+    options.num_bins = 1000;
+    options.max_leaf_size = 64;
+    test_bvh(buildObjectBVH(obj, options), obj);
+}
+
+TEST(BVH, DegenerateCentroids) {
+    // All triangles share their centroid, so no SAH split exists and large leaves still have to be split
+    Object obj(VertexLayout_Interleaved_VN, 4);
+    std::vector<stage_vec3f> positions = make_data_array<stage_vec3f>(3, {0.f, 0.f, 0.f});
+    positions[1] = stage_vec3f(1.f, 0.f, 0.f);
+    positions[2] = stage_vec3f(0.f, 1.f, 0.f);
+    std::vector<uint32_t> indices;
+    for (size_t i = 0; i < 100; i++) {
+        indices.insert(indices.end(), { 0, 1, 2 });
+    }
+    obj.geometries.push_back(Geometry(obj, positions, {}, {}, make_data_array<uint32_t>(3, 0), indices));
+
+    BVHBuildOptions options;
+    options.max_leaf_size = 4;
+    BVH bvh = buildObjectBVH(obj, options);
+    test_bvh(bvh, obj);
+    for (auto& node : bvh.nodes) {
+        EXPECT_LE(node.count, options.max_leaf_size);
+    }
+}
+
+TEST(BVH, SAHCost) {
+    Object obj(VertexLayout_Interleaved_VN, 4);
+    obj.geometries.push_back(make_grid_geometry(obj, 64, true));
+
+    // A single leaf costs one intersection per triangle, any reasonable hierarchy is much cheaper
+    BVHBuildOptions options;
+    BVH bvh = buildObjectBVH(obj, options);
+    BVH leaf;
+    leaf.nodes.push_back(bvh.nodes[0]);
+    leaf.nodes[0].offset = 0;
+    leaf.nodes[0].count = uint32_t(bvh.primitives.size());
+    EXPECT_FLOAT_EQ(leaf.sahCost(), float(bvh.primitives.size()));
+    EXPECT_LT(bvh.sahCost(), 0.1f * leaf.sahCost());
+    EXPECT_EQ(BVH().sahCost(), 0.f);
+}
+
+stage_mat4f
+translation(float x) {
+    return stage_mat4f(stage_vec4f(1.f, 0.f, 0.f, 0.f), stage_vec4f(0.f, 1.f, 0.f, 0.f), stage_vec4f(0.f, 0.f, 1.f, 0.f), stage_vec4f(x, 0.f, 0.f, 1.f));
+}
+
+TEST(BVH, SceneBVH) {
+    std::vector<Object> objects;
+    objects.emplace_back(VertexLayout_Interleaved_VN, 4);
+    objects[0].geometries.push_back(make_grid_geometry(objects[0], 16));
+    objects.emplace_back(VertexLayout_Interleaved_VN, 4);
+
+    std::vector<ObjectInstance> instances;
+    for (size_t i = 0; i < 10; i++) {
+        instances.push_back({ translation(float(20 * i)), 0, AABB() });
+    }
+    // Instances of empty or missing objects are skipped
+    instances.push_back({ translation(0.f), 1, AABB() });
+    instances.push_back({ translation(0.f), 2, AABB() });
+
+    SceneBVH bvh = buildSceneBVH(objects, instances);
+    ASSERT_EQ(bvh.objects.size(), 2);
+    test_bvh(bvh.objects[0], objects[0]);
+    EXPECT_FALSE(bvh.objects[1].isValid());
+
+    ASSERT_TRUE(bvh.instances.isValid());
+    EXPECT_EQ(bvh.instances.primitives.size(), 10);
+    const BVHNode& root = bvh.instances.nodes[0];
+    EXPECT_EQ(root.lower, stage_vec3f(0.f, 0.f, 0.f));
+    EXPECT_EQ(root.upper, stage_vec3f(196.f, 16.f, 0.f));
+    for (auto& node : bvh.instances.nodes) {
+        if (!node.isLeaf()) continue;
+        for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+            uint32_t instance_id = bvh.instances.primitives[i].primitive_id;
+            ASSERT_LT(instance_id, 10);
+            stage_vec3f lower(20.f * instance_id, 0.f, 0.f);
+            EXPECT_TRUE(contains(node, lower, lower + stage_vec3f(16.f, 16.f, 0.f)));
+        }
+    }
+}
+
+TEST(BVH, InstanceBounds) {
+    std::vector<Object> objects;
+    objects.emplace_back(VertexLayout_Interleaved_VN, 4);
+    objects[0].geometries.push_back(make_grid_geometry(objects[0], 4));
+    std::vector<BVH> object_bvhs = { buildObjectBVH(objects[0]) };
+
+    // Bounds that are already known are used as they are, others are computed from the object's BVH
+    std::vector<ObjectInstance> instances;
+    instances.push_back({ translation(0.f), 0, AABB() });
+    instances.push_back({ translation(10.f), 0, AABB() });
+    instances[1].bounds.lower = stage_vec3f(-5.f);
+    instances[1].bounds.upper = stage_vec3f(20.f);
+
+    BVH bvh = buildInstanceBVH(instances, object_bvhs);
+    ASSERT_TRUE(bvh.isValid());
+    EXPECT_EQ(bvh.nodes[0].lower, stage_vec3f(-5.f));
+    EXPECT_EQ(bvh.nodes[0].upper, stage_vec3f(20.f));
+}
+
+TEST(BVH, DepthFirstOrder) {
+    // Large enough for subtrees to be built in parallel
+    Object obj(VertexLayout_Interleaved_VN, 4);
+    obj.geometries.push_back(make_grid_geometry(obj, 128, true));
+    BVH bvh = buildObjectBVH(obj);
+    test_bvh(bvh, obj);
+
+    // Sibling pairs start at even indices of a cache line aligned array
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(bvh.nodes.data()) % 64, 0);
+    EXPECT_EQ(sizeof(BVHNode), 32);
+
+    // Visiting the left child first, each inner node's children are the next unused pair after the padding node
+    uint32_t num_nodes = 2;
+    std::vector<uint32_t> stack { 0 };
+    while (!stack.empty()) {
+        const BVHNode& node = bvh.nodes[stack.back()];
+        stack.pop_back();
+        if (node.isLeaf()) continue;
+        ASSERT_EQ(node.offset, num_nodes);
+        stack.push_back(node.offset + 1);
+        stack.push_back(node.offset);
+        num_nodes += 2;
+    }
+    EXPECT_EQ(num_nodes, bvh.nodes.size());
+
+    // The layout does not depend on the order in which parallel subtrees were built
+    BVH other = buildObjectBVH(obj);
+    ASSERT_EQ(other.nodes.size(), bvh.nodes.size());
+    for (size_t i = 0; i < bvh.nodes.size(); i++) {
+        EXPECT_EQ(other.nodes[i].offset, bvh.nodes[i].offset);
+        EXPECT_EQ(other.nodes[i].count, bvh.nodes[i].count);
+    }
+}
@@ -1,5 +1,10 @@
 #include "test_common.h"
 
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <random>
+
 Geometry make_geometry(Object& obj, size_t size_vertices, size_t size_indices) {
     std::vector<stage_vec3f> vertices = make_data_array<stage_vec3f>(size_vertices, {0, 1, 2});
     std::vector<stage_vec3f> normals = make_data_array<stage_vec3f>(size_vertices, {3, 4, 5});
@@ -10,4 +15,53 @@ Geometry make_geometry(Object& obj, size_t size_vertices, size_t size_indices) {
 
     Geometry g(obj, vertices, normals, uvs, material_ids, indices);
     return g;
-}
\ No newline at end of file
+}
+
+Geometry make_grid_geometry(Object& obj, size_t n, bool shuffled) {
+    std::vector<stage_vec3f> positions;
+    std::vector<stage_vec3f> normals;
+    std::vector<uint32_t> material_ids;
+    for (size_t y = 0; y <= n; y++) {
+        for (size_t x = 0; x <= n; x++) {
+            positions.push_back(stage_vec3f(float(x), float(y), 0.f));
+            normals.push_back(stage_vec3f(0.f, 0.f, 1.f));
+            material_ids.push_back(uint32_t(x + y));
+        }
+    }
+
+    std::vector<std::array<uint32_t, 3>> triangles;
+    for (uint32_t y = 0; y < n; y++) {
+        for (uint32_t x = 0; x < n; x++) {
+            uint32_t i = y * uint32_t(n + 1) + x;
+            triangles.push_back({ i, i + 1, i + uint32_t(n) + 1 });
+            triangles.push_back({ i + 1, i + uint32_t(n) + 2, i + uint32_t(n) + 1 });
+        }
+    }
+    if (shuffled)
+        std::shuffle(triangles.begin(), triangles.end(), std::mt19937(42));
+    std::vector<uint32_t> indices;
+    for (auto& triangle : triangles) {
+        indices.insert(indices.end(), triangle.begin(), triangle.end());
+    }
+    return Geometry(obj, positions, normals, {}, material_ids, indices);
+}
+
+std::filesystem::path write_test_obj(std::string name) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::ofstream out(path);
+    out << "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+        << "vn 0 0 1\n"
+        << "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+        << "f 1/1/1 2/2/1 3/3/1 4/4/1\n";
+    return path;
+}
+
+std::filesystem::path write_test_ppm(std::string name, int width, int height) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::ofstream out(path, std::ios::binary);
+    out << "P6\n" << width << " " << height << "\n255\n";
+    for (int i = 0; i < width * height * 3; i++) {
+        out.put(char(i % 256));
+    }
+    return path;
+}
@@ -1,6 +1,11 @@
 #pragma once
+#include <atomic>
+#include <filesystem>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <numeric>
+#include <unordered_map>
 #include <gtest/gtest.h>
 #include <stage.h>
 
@@ -19,4 +24,52 @@ std::vector<T> make_data_array(size_t size, T value) {
     return data;
 }
 
+/*
+ * Tracks the number and size of outstanding allocations. Memory is aligned as requested, and releasing it with
+ * a different size or alignment than it was allocated with counts as a mismatch.
+ */
+struct CountingAllocator : public Allocator {
+    void* allocate(size_t size, size_t alignment) override {
+        void* ptr = ::operator new(size, std::align_val_t(alignment));
+        std::lock_guard<std::mutex> lock(mutex);
+        allocations++;
+        outstanding += size;
+        live[ptr] = { size, alignment };
+        return ptr;
+    }
+
+    void deallocate(void* ptr, size_t size, size_t alignment) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        deallocations++;
+        outstanding -= size;
+        auto it = live.find(ptr);
+        if (it == live.end()) {
+            mismatches++;
+            return;
+        }
+        if (it->second != std::make_pair(size, alignment))
+            mismatches++;
+        ::operator delete(ptr, std::align_val_t(it->second.second));
+        live.erase(it);
+    }
+
+    std::atomic<size_t> allocations { 0 };
+    std::atomic<size_t> deallocations { 0 };
+    std::atomic<size_t> mismatches { 0 };
+    std::atomic<int64_t> outstanding { 0 };
+
+private:
+    std::mutex mutex;
+    std::unordered_map<void*, std::pair<size_t, size_t>> live;
+};
+
 Geometry make_geometry(Object& obj, size_t size_vertices, size_t size_indices);
+
+/* A regular grid of `n` x `n` quads in the xy plane, the material ID of each vertex is x + y */
+Geometry make_grid_geometry(Object& obj, size_t n, bool shuffled = false);
+
+/* Writes a single quad OBJ file to the temporary directory */
+std::filesystem::path write_test_obj(std::string name);
+
+/* Writes a binary PPM image to the temporary directory */
+std::filesystem::path write_test_ppm(std::string name, int width, int height);
@@ -0,0 +1,281 @@
+#include "test_common.h"
+
+#include <thread>
+
+TEST(Image, LoadEager) {
+    std::filesystem::path path = write_test_ppm("stage_test_eager.ppm", 8, 4);
+    Image image(path.string());
+
+    EXPECT_TRUE(image.isValid());
+    EXPECT_TRUE(image.isLoaded());
+    EXPECT_EQ(image.getWidth(), 8);
+    EXPECT_EQ(image.getHeight(), 4);
+    EXPECT_EQ(image.getChannels(), 4);
+
+    std::filesystem::remove(path);
+}
+
+TEST(Image, LoadLazy) {
+    std::filesystem::path path = write_test_ppm("stage_test_lazy.ppm", 8, 4);
+    Image eager(path.string());
+    Image lazy(path.string(), false, true);
+
+    EXPECT_TRUE(lazy.isValid());
+    EXPECT_FALSE(lazy.isLoaded());
+    EXPECT_EQ(lazy.getWidth(), 8);
+    EXPECT_EQ(lazy.getHeight(), 4);
+    EXPECT_EQ(lazy.getChannels(), 4);
+
+    ASSERT_NE(lazy.getData(), nullptr);
+    EXPECT_TRUE(lazy.isLoaded());
+    for (int i = 0; i < 8 * 4 * 4; i++) {
+        EXPECT_EQ(lazy.getData()[i], eager.getData()[i]);
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST(Image, LoadLazyConcurrent) {
+    std::filesystem::path path = write_test_ppm("stage_test_lazy_concurrent.ppm", 64, 64);
+    Image lazy(path.string(), false, true);
+
+    std::vector<uint8_t*> results(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < results.size(); i++) {
+        threads.emplace_back([&, i]() { results[i] = lazy.getData(); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_NE(results[0], nullptr);
+    for (auto result : results) {
+        EXPECT_EQ(result, results[0]);
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST(Image, LoadLazyInvalid) {
+    Image lazy("stage_test_does_not_exist.png", false, true);
+
+    EXPECT_FALSE(lazy.isValid());
+    EXPECT_EQ(lazy.getData(), nullptr);
+}
+
+/* Wraps a copy of `pixels` in an image, 7x5 pixels leave a remainder after the blocks processed in parallel */
+template<typename T>
+Image
+make_test_image(const std::vector<T>& pixels, int32_t channels, int32_t width = 7, int32_t height = 5) {
+    auto owner = std::make_shared<std::vector<T>>(pixels);
+    return Image((uint8_t*)owner->data(), width, height, channels, std::is_same<T, float>::value, owner);
+}
+
+template<typename T>
+std::vector<T>
+make_test_pixels(int32_t channels, T scale) {
+    std::vector<T> pixels(7 * 5 * channels);
+    for (size_t i = 0; i < pixels.size(); i++) {
+        pixels[i] = T((i % 11) * scale);
+    }
+    return pixels;
+}
+
+TEST(Image, ScaleHDR) {
+    std::vector<float> pixels = make_test_pixels<float>(4, 0.75f);
+    Image image = make_test_image(pixels, 4);
+    image.scale(stage_vec3f(2.f, 0.5f, 10.f));
+
+    // Values above 1 are kept and alpha is untouched
+    const float* data = (const float*)image.getData();
+    stage_vec4f factors(2.f, 0.5f, 10.f, 1.f);
+    for (size_t i = 0; i < pixels.size(); i++) {
+        EXPECT_FLOAT_EQ(data[i], pixels[i] * factors[i % 4]);
+    }
+}
+
+TEST(Image, ScaleLDR) {
+    std::vector<uint8_t> pixels = make_test_pixels<uint8_t>(3, 23);
+    Image image = make_test_image(pixels, 3);
+    image.scale(stage_vec3f(0.5f, 2.f, 0.25f));
+
+    // Images without alpha scale all channels, results are rounded and clamped
+    const uint8_t* data = image.getData();
+    stage_vec3f factors(0.5f, 2.f, 0.25f);
+    for (size_t i = 0; i < pixels.size(); i++) {
+        EXPECT_EQ(data[i], uint8_t(std::min(pixels[i] * factors[i % 3] + 0.5f, 255.f)));
+    }
+}
+
+TEST(Image, MixColor) {
+    std::vector<uint8_t> pixels = make_test_pixels<uint8_t>(2, 25);
+    Image image = make_test_image(pixels, 2);
+    image.mix(stage_vec3f(1.f), stage_vec3f(0.5f));
+
+    // Gray images with alpha mix the first channel only
+    const uint8_t* data = image.getData();
+    for (size_t i = 0; i < pixels.size(); i++) {
+        uint8_t expected = i % 2 ? pixels[i] : uint8_t((pixels[i] / 255.f * 0.5f + 0.5f) * 255.f + 0.5f);
+        EXPECT_EQ(data[i], expected);
+    }
+}
+
+TEST(Image, ScaleAndMixImages) {
+    std::vector<float> pixels = make_test_pixels<float>(4, 0.5f);
+    std::vector<uint8_t> other_pixels = make_test_pixels<uint8_t>(4, 20);
+    Image other = make_test_image(other_pixels, 4);
+
+    // LDR images are read as values in [0, 1] when combined with HDR images
+    Image scaled = make_test_image(pixels, 4);
+    scaled.scale(other);
+    Image mixed = make_test_image(pixels, 4);
+    mixed.mix(other, stage_vec3f(0.25f));
+
+    const float* scaled_data = (const float*)scaled.getData();
+    const float* mixed_data = (const float*)mixed.getData();
+    for (size_t i = 0; i < pixels.size(); i++) {
+        bool is_alpha = i % 4 == 3;
+        float other_value = other_pixels[i] / 255.f;
+        EXPECT_NEAR(scaled_data[i], is_alpha ? pixels[i] : pixels[i] * other_value, 1e-5f);
+        EXPECT_NEAR(mixed_data[i], is_alpha ? pixels[i] : pixels[i] * 0.75f + other_value * 0.25f, 1e-5f);
+    }
+
+    // The other image and the wrapped pixels are left unchanged
+    EXPECT_EQ(std::memcmp(other.getData(), other_pixels.data(), other_pixels.size()), 0);
+}
+
+TEST(Image, MipChainLayout) {
+    std::vector<float> pixels = make_test_pixels<float>(4, 0.5f);
+    Image image = make_test_image(pixels, 4);
+    image.generateMips(MipFilter_Box);
+
+    // 7x5 -> 3x2 -> 1x1, all levels follow each other in one allocation
+    ASSERT_EQ(image.getLevelCount(), 3);
+    EXPECT_EQ(image.getLevelWidth(1), 3);
+    EXPECT_EQ(image.getLevelHeight(1), 2);
+    EXPECT_EQ(image.getLevelWidth(2), 1);
+    EXPECT_EQ(image.getLevelHeight(2), 1);
+    EXPECT_EQ(image.getLevelOffset(1), 7 * 5 * 4 * sizeof(float));
+    EXPECT_EQ(image.getLevelOffset(2), (7 * 5 + 3 * 2) * 4 * sizeof(float));
+    EXPECT_EQ(image.getSizeInBytes(), (7 * 5 + 3 * 2 + 1) * 4 * sizeof(float));
+    EXPECT_EQ(std::memcmp(image.getData(), pixels.data(), pixels.size() * sizeof(float)), 0);
+
+    // The box filter weights texels by their area, so every level keeps the mean of level 0
+    stage_vec4f mean(0.f);
+    for (size_t i = 0; i < pixels.size(); i++) {
+        mean[i % 4] += pixels[i] / (7 * 5);
+    }
+    const float* last = (const float*)(image.getData() + image.getLevelOffset(2));
+    for (int32_t c = 0; c < 4; c++) {
+        EXPECT_NEAR(last[c], mean[c], 1e-4f);
+    }
+
+    image.generateMips(MipFilter_None);
+    EXPECT_EQ(image.getLevelCount(), 1);
+    EXPECT_EQ(image.getSizeInBytes(), pixels.size() * sizeof(float));
+    EXPECT_EQ(std::memcmp(image.getData(), pixels.data(), pixels.size() * sizeof(float)), 0);
+}
+
+TEST(Image, MipGammaCorrect) {
+    // Black and white texels with alpha 0 and 1, color is averaged in linear space and alpha as it is
+    std::vector<uint8_t> pixels = { 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0 };
+    Image image = make_test_image(pixels, 4, 2, 2);
+    image.generateMips(MipFilter_Box);
+
+    ASSERT_EQ(image.getLevelCount(), 2);
+    const uint8_t* level = image.getData() + image.getLevelOffset(1);
+    EXPECT_EQ(level[0], 188);
+    EXPECT_EQ(level[1], 188);
+    EXPECT_EQ(level[2], 188);
+    EXPECT_EQ(level[3], 128);
+}
+
+TEST(Image, MipKaiserKeepsConstants) {
+    std::vector<uint8_t> ldr_pixels(16 * 9 * 4, 77);
+    std::vector<float> hdr_pixels(16 * 9 * 4, 2.5f);
+    Image ldr = make_test_image(ldr_pixels, 4, 16, 9);
+    Image hdr = make_test_image(hdr_pixels, 4, 16, 9);
+    ldr.generateMips(MipFilter_Kaiser);
+    hdr.generateMips(MipFilter_Kaiser);
+
+    ASSERT_EQ(ldr.getLevelCount(), 5);
+    const uint8_t* ldr_data = ldr.getData();
+    const float* hdr_data = (const float*)hdr.getData();
+    for (size_t i = 0; i < ldr.getSizeInBytes(); i++) {
+        EXPECT_EQ(ldr_data[i], 77);
+        EXPECT_NEAR(hdr_data[i], 2.5f, 1e-5f);
+    }
+}
+
+TEST(Image, MipLazyAndScale) {
+    std::filesystem::path path = write_test_ppm("stage_test_mips.ppm", 8, 4);
+    Image eager(path.string());
+    eager.generateMips(MipFilter_Box);
+
+    // Lazy images know their levels up front and generate them when they are decoded
+    Image lazy(path.string(), false, true);
+    lazy.generateMips(MipFilter_Box);
+    EXPECT_FALSE(lazy.isLoaded());
+    EXPECT_EQ(lazy.getLevelCount(), 4);
+    ASSERT_NE(lazy.getData(), nullptr);
+    EXPECT_EQ(std::memcmp(lazy.getData(), eager.getData(), eager.getSizeInBytes()), 0);
+
+    // Modifying level 0 generates the other levels again
+    Image expected(path.string());
+    expected.scale(stage_vec3f(0.5f));
+    expected.generateMips(MipFilter_Box);
+    eager.scale(stage_vec3f(0.5f));
+    EXPECT_EQ(std::memcmp(expected.getData(), eager.getData(), eager.getSizeInBytes()), 0);
+
+    std::filesystem::remove(path);
+}
+
+TEST(Image, CompressMipChain) {
+    std::vector<uint8_t> pixels = make_test_pixels<uint8_t>(4, 23);
+    Image image = make_test_image(pixels, 4);
+    image.generateMips(MipFilter_Box);
+    image.compress(TextureFormat_BC7);
+
+    // 7x5, 3x2 and 1x1 each take whole blocks
+    EXPECT_EQ(image.getFormat(), TextureFormat_BC7);
+    EXPECT_EQ(image.getLevelCount(), 3);
+    EXPECT_EQ(image.getLevelSizeInBytes(0), 4 * 16);
+    EXPECT_EQ(image.getLevelOffset(2), 5 * 16);
+    EXPECT_EQ(image.getSizeInBytes(), 6 * 16);
+    ASSERT_NE(image.getData(), nullptr);
+
+    // Compressed images keep their blocks, the format cannot be changed afterwards
+    std::vector<uint8_t> blocks(image.getData(), image.getData() + image.getSizeInBytes());
+    image.scale(stage_vec3f(0.5f));
+    image.generateMips(MipFilter_Kaiser);
+    image.compress(TextureFormat_BC1);
+    EXPECT_EQ(image.getFormat(), TextureFormat_BC7);
+    EXPECT_EQ(image.getMipFilter(), MipFilter_Box);
+    EXPECT_EQ(std::memcmp(image.getData(), blocks.data(), blocks.size()), 0);
+
+    // BC6H is for HDR images only
+    Image hdr = make_test_image(make_test_pixels<float>(3, 0.5f), 3);
+    hdr.compress(TextureFormat_BC7);
+    EXPECT_FALSE(hdr.isCompressed());
+    hdr.compress(TextureFormat_BC6H);
+    EXPECT_EQ(hdr.getSizeInBytes(), 4 * 16);
+}
+
+TEST(Image, CompressLazy) {
+    std::filesystem::path path = write_test_ppm("stage_test_compress.ppm", 8, 4);
+    Image eager(path.string());
+    eager.generateMips(MipFilter_Box);
+    eager.compress(TextureFormat_BC1);
+
+    // Lazy images are compressed after their mip levels were generated on decode
+    Image lazy(path.string(), false, true);
+    lazy.generateMips(MipFilter_Box);
+    lazy.compress(TextureFormat_BC1);
+    EXPECT_FALSE(lazy.isLoaded());
+    // Two blocks for 8x4 and one for each of 4x2, 2x1 and 1x1
+    EXPECT_EQ(lazy.getSizeInBytes(), 5 * 8);
+    ASSERT_NE(lazy.getData(), nullptr);
+    EXPECT_EQ(std::memcmp(lazy.getData(), eager.getData(), eager.getSizeInBytes()), 0);
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,104 @@
+#include "test_common.h"
+#include <random>
+#include <backstage/kernels.h>
+
+/* The tests use 37 vectors so that every SIMD width leaves a remainder for the scalar path */
+std::vector<stage_vec3f>
+make_random_vectors(size_t count) {
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> value(-10.f, 10.f);
+    std::vector<stage_vec3f> vectors(count);
+    for (auto& v : vectors) {
+        v = stage_vec3f(value(rng), value(rng), value(rng));
+    }
+    return vectors;
+}
+
+std::vector<SIMDLevel>
+supported_levels() {
+    std::vector<SIMDLevel> levels;
+    for (int level = SIMDLevel_Scalar; level <= supportedSIMDLevel(); level++) {
+        levels.push_back(SIMDLevel(level));
+    }
+    return levels;
+}
+
+void
+expect_near(const stage_vec3f& a, const stage_vec3f& b, float tolerance) {
+    EXPECT_NEAR(a.x, b.x, tolerance);
+    EXPECT_NEAR(a.y, b.y, tolerance);
+    EXPECT_NEAR(a.z, b.z, tolerance);
+}
+
+const stage_mat4f transform(stage_vec4f(2.f, 0.f, 0.f, 0.f), stage_vec4f(0.f, 0.f, -3.f, 0.f), stage_vec4f(0.f, 0.5f, 0.f, 0.f), stage_vec4f(1.f, 2.f, 3.f, 1.f));
+
+TEST(Kernels, TransformPositions) {
+    std::vector<stage_vec3f> positions = make_random_vectors(37);
+    for (VertexLayout layout : { VertexLayout_Interleaved_VN, VertexLayout_Block_VN }) {
+        for (SIMDLevel level : supported_levels()) {
+            setSIMDLevel(level);
+            Object obj(layout, 4);
+            Geometry g(obj, positions, positions, {}, make_data_array<uint32_t>(positions.size(), 0), {});
+
+            transformPositions(g.positions, transform);
+            for (size_t i = 0; i < positions.size(); i++) {
+                stage_vec3f expected(transform * stage_vec4f(positions[i], 1.f));
+                expect_near(g.positions[i], expected, 1e-5f);
+                // Neighbouring attributes are left untouched
+                EXPECT_EQ(g.normals[i], positions[i]);
+            }
+        }
+    }
+    setSIMDLevel(supportedSIMDLevel());
+}
+
+TEST(Kernels, TransformNormals) {
+    std::vector<stage_vec3f> normals = make_random_vectors(37);
+    normals[5] = stage_vec3f(0.f);
+
+    // A mirroring non-uniform scale, normals have to stay perpendicular to transformed tangents and keep their side
+    stage_mat4f mirror(stage_vec4f(-2.f, 0.f, 0.f, 0.f), stage_vec4f(0.f, 1.f, 0.f, 0.f), stage_vec4f(0.f, 0.f, 1.f, 0.f), stage_vec4f(5.f, 5.f, 5.f, 1.f));
+    for (SIMDLevel level : supported_levels()) {
+        setSIMDLevel(level);
+        Object obj(VertexLayout_Interleaved_VN, 4);
+        Geometry g(obj, normals, normals, {}, make_data_array<uint32_t>(normals.size(), 0), {});
+
+        transformNormals(g.normals, mirror);
+        for (size_t i = 0; i < normals.size(); i++) {
+            if (i == 5) {
+                EXPECT_EQ(g.normals[i], stage_vec3f(0.f));
+                continue;
+            }
+            expect_near(g.normals[i], normalize(stage_vec3f(-normals[i].x / 2.f, normals[i].y, normals[i].z)), 1e-5f);
+        }
+    }
+    setSIMDLevel(supportedSIMDLevel());
+}
+
+TEST(Kernels, NormalizeAndBounds) {
+    std::vector<stage_vec3f> vectors = make_random_vectors(37);
+    vectors[36] = stage_vec3f(0.f);
+    AABB expected;
+    for (auto& v : vectors) {
+        expected.extend(v);
+    }
+
+    for (SIMDLevel level : supported_levels()) {
+        setSIMDLevel(level);
+        Object obj(VertexLayout_Interleaved_VN, 4);
+        Geometry g(obj, vectors, vectors, {}, make_data_array<uint32_t>(vectors.size(), 0), {});
+
+        AABB bounds = computeBounds(g.positions);
+        EXPECT_EQ(bounds.lower, expected.lower);
+        EXPECT_EQ(bounds.upper, expected.upper);
+
+        normalizeVectors(g.normals);
+        for (size_t i = 0; i < 36; i++) {
+            expect_near(g.normals[i], normalize(vectors[i]), 1e-6f);
+        }
+        EXPECT_EQ(g.normals[36], stage_vec3f(0.f));
+    }
+    setSIMDLevel(supportedSIMDLevel());
+
+    EXPECT_TRUE(computeBounds(BufferView<stage_vec3f>()).isEmpty());
+}
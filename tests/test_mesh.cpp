@@ -51,34 +51,241 @@ test_layout(VertexLayout layout, size_t alignment) {
             EXPECT_EQ(g.material_ids[i], 8.f);
         }
     }
+
+    // Every element of every view starts at a multiple of the requested alignment
+    auto aligned = [alignment](auto& view) {
+        return (uintptr_t)view.data() % alignment == 0 && view.stride() % alignment == 0;
+    };
+    for (Geometry& g : obj.geometries) {
+        EXPECT_TRUE(aligned(g.positions));
+        if (g.normals.size() > 0) {
+            EXPECT_TRUE(aligned(g.normals));
+        }
+        if (g.uvs.size() > 0) {
+            EXPECT_TRUE(aligned(g.uvs));
+        }
+        EXPECT_TRUE(aligned(g.material_ids));
+    }
 }
 
 TEST(Object, LayoutInterleavedV) {
-    for (auto alignment : {4, 8, 16, 32, 128})
+    for (auto alignment : {4, 8, 16, 32, 64, 128})
         test_layout(VertexLayout_Interleaved_V, alignment);
 }
 
 TEST(Object, LayoutInterleavedVN) {
-    for (auto alignment : {4, 8, 16, 32, 128})
+    for (auto alignment : {4, 8, 16, 32, 64, 128})
         test_layout(VertexLayout_Interleaved_VN, alignment);
 }
 
 TEST(Object, LayoutInterleavedVNT) {
-    for (auto alignment : {4, 8, 16, 32, 128})
+    for (auto alignment : {4, 8, 16, 32, 64, 128})
         test_layout(VertexLayout_Interleaved_VNT, alignment);
 }
 
 TEST(Object, LayoutBlockV) {
-    for (auto alignment : {4, 8, 16, 32, 128})
+    for (auto alignment : {4, 8, 16, 32, 64, 128})
         test_layout(VertexLayout_Block_V, alignment);
 }
 
 TEST(Object, LayoutBlockVN) {
-    for (auto alignment : {4, 8, 16, 32, 128})
+    for (auto alignment : {4, 8, 16, 32, 64, 128})
         test_layout(VertexLayout_Block_VN, alignment);
 }
 
 TEST(Object, LayoutBlockVNT) {
-    for (auto alignment : {4, 8, 16, 32, 128})
+    for (auto alignment : {4, 8, 16, 32, 64, 128})
         test_layout(VertexLayout_Block_VNT, alignment);
-}
\ No newline at end of file
+}
+void
+test_builder(VertexLayout layout, size_t alignment) {
+    Object reference(layout, alignment);
+    reference.geometries.push_back(make_geometry(reference, 64, 96));
+    reference.geometries.push_back(make_geometry(reference, 32, 48));
+
+    // Both regions are reserved up front and filled afterwards, like the loaders do
+    Object obj(layout, alignment);
+    GeometryBuilder b0(obj, 64);
+    GeometryBuilder b1(obj, 32);
+    for (GeometryBuilder* builder : {&b0, &b1}) {
+        size_t num_vertices = builder == &b0 ? 64 : 32;
+        for (size_t i = 0; i < num_vertices; i++) {
+            builder->setPosition(i, stage_vec3f(0, 1, 2));
+            builder->setNormal(i, stage_vec3f(3, 4, 5));
+            builder->setUV(i, stage_vec2f(6, 7));
+            builder->setMaterialId(i, 8);
+        }
+        builder->indices() = make_data_array<uint32_t>(num_vertices * 3 / 2);
+    }
+    obj.geometries.push_back(b0.build());
+    obj.geometries.push_back(b1.build());
+
+    ASSERT_EQ(obj.data->size(), reference.data->size());
+    for (size_t i = 0; i < obj.geometries.size(); i++) {
+        Geometry& g = obj.geometries[i];
+        Geometry& r = reference.geometries[i];
+        EXPECT_EQ(g.indices, r.indices);
+        EXPECT_EQ(g.positions.offset(), r.positions.offset());
+        EXPECT_EQ(g.normals.offset(), r.normals.offset());
+        EXPECT_EQ(g.uvs.offset(), r.uvs.offset());
+        EXPECT_EQ(g.material_ids.offset(), r.material_ids.offset());
+        EXPECT_EQ(g.normals.size(), r.normals.size());
+        EXPECT_EQ(g.uvs.size(), r.uvs.size());
+        for (size_t v = 0; v < g.positions.size(); v++) {
+            EXPECT_EQ(g.positions[v], r.positions[v]);
+            if (v < g.normals.size()) {
+                EXPECT_EQ(g.normals[v], r.normals[v]);
+            }
+            if (v < g.uvs.size()) {
+                EXPECT_EQ(g.uvs[v], r.uvs[v]);
+            }
+            EXPECT_EQ(g.material_ids[v], r.material_ids[v]);
+        }
+    }
+}
+
+TEST(GeometryBuilder, MatchesGeometry) {
+    for (auto layout : {VertexLayout_Interleaved_V, VertexLayout_Interleaved_VN, VertexLayout_Interleaved_VNT, VertexLayout_Block_V, VertexLayout_Block_VN, VertexLayout_Block_VNT})
+        for (auto alignment : {4, 8, 16, 32, 64, 128})
+            test_builder(layout, alignment);
+}
+
+TEST(GeometryBuilder, WithoutUVs) {
+    Object obj(VertexLayout_Block_VNT, 16);
+    GeometryBuilder builder(obj, 16, false);
+    builder.setUV(0, stage_vec2f(1, 2));
+    Geometry g = builder.build();
+
+    EXPECT_EQ(g.positions.size(), 16);
+    EXPECT_EQ(g.uvs.size(), 0);
+    EXPECT_EQ(obj.data->size(), g.positions.sizeInBytes() + g.normals.sizeInBytes() + g.material_ids.sizeInBytes());
+}
+
+void
+test_compressed_layout(VertexLayout layout, size_t alignment) {
+    std::vector<stage_vec3f> positions, normals;
+    std::vector<stage_vec2f> uvs;
+    for (int i = 0; i < 256; i++) {
+        float t = i / 255.f;
+        positions.push_back(stage_vec3f(-10.f + 20.f * t, std::sin(7.f * t), 100.f * t * t));
+        normals.push_back(normalize(stage_vec3f(std::cos(13.f * t), std::sin(13.f * t), 2.f * t - 1.f)));
+        uvs.push_back(stage_vec2f(4.f * t - 1.f, 0.5f + t));
+    }
+    std::vector<uint32_t> material_ids(256, 3);
+
+    Object uncompressed(VertexLayout(layout & 0xff), alignment);
+    uncompressed.geometries.push_back(Geometry(uncompressed, positions, normals, uvs, material_ids, {}));
+    Object obj(layout, alignment);
+    obj.geometries.push_back(Geometry(obj, positions, normals, uvs, material_ids, {}));
+    GeometryBuilder builder(obj, 256);
+    for (size_t i = 0; i < 256; i++) {
+        builder.setPosition(i, positions[i]);
+        builder.setNormal(i, normals[i]);
+        builder.setUV(i, uvs[i]);
+        builder.setMaterialId(i, material_ids[i]);
+    }
+    obj.geometries.push_back(builder.build());
+
+    // The object holds two geometries, each one is smaller unless only absent attributes were compressed
+    bool has_normals = layout & (VertexLayout_Block_VN | VertexLayout_Block_VNT | VertexLayout_Interleaved_VN | VertexLayout_Interleaved_VNT);
+    EXPECT_LE(obj.data->size(), 2 * uncompressed.data->size());
+    if (alignment <= 4 && (has_normals || (layout & VertexLayout_Compressed_V))) {
+        EXPECT_LT(obj.data->size(), 2 * uncompressed.data->size());
+    }
+
+    for (Geometry& g : obj.geometries) {
+        EXPECT_EQ(g.positions.isValid(), !(layout & VertexLayout_Compressed_V));
+        EXPECT_EQ(g.normals.isValid(), has_normals && !(layout & VertexLayout_Compressed_N));
+        EXPECT_EQ(g.numVertices(), 256);
+        for (size_t i = 0; i < 256; i++) {
+            stage_vec3f p = g.getPosition(i);
+            EXPECT_NEAR(p.x, positions[i].x, 1e-3f);
+            EXPECT_NEAR(p.y, positions[i].y, 1e-3f);
+            EXPECT_NEAR(p.z, positions[i].z, 1e-3f);
+            if (g.numNormals() > 0) {
+                stage_vec3f n = g.getNormal(i);
+                EXPECT_NEAR(n.x, normals[i].x, 1e-3f);
+                EXPECT_NEAR(n.y, normals[i].y, 1e-3f);
+                EXPECT_NEAR(n.z, normals[i].z, 1e-3f);
+            }
+            if (g.numUVs() > 0) {
+                stage_vec2f uv = g.getUV(i);
+                EXPECT_NEAR(uv.x, uvs[i].x, 2e-3f);
+                EXPECT_NEAR(uv.y, uvs[i].y, 2e-3f);
+            }
+            EXPECT_EQ(g.material_ids[i], 3);
+        }
+    }
+}
+
+TEST(Object, LayoutCompressed) {
+    for (auto layout : {VertexLayout_Interleaved_V, VertexLayout_Interleaved_VN, VertexLayout_Interleaved_VNT, VertexLayout_Block_V, VertexLayout_Block_VN, VertexLayout_Block_VNT}) {
+        for (auto alignment : {4, 16}) {
+            test_compressed_layout(layout | VertexLayout_Compressed_N | VertexLayout_Compressed_T, alignment);
+            test_compressed_layout(layout | VertexLayout_Compressed_N | VertexLayout_Compressed_T | VertexLayout_Compressed_V, alignment);
+        }
+    }
+}
+
+TEST(Object, LayoutCompressedSize) {
+    Object uncompressed(VertexLayout_Interleaved_VNT, 4);
+    Object compressed(VertexLayout_Interleaved_VNT | VertexLayout_Compressed_N | VertexLayout_Compressed_T | VertexLayout_Compressed_V, 4);
+
+    // 12 + 12 + 8 + 4 bytes per vertex against 8 + 4 + 4 + 4
+    EXPECT_EQ(uncompressed.geometrySizeInBytes(100), 3600);
+    EXPECT_EQ(compressed.geometrySizeInBytes(100), 2000);
+}
+
+TEST(Geometry, CompactIndices) {
+    Object obj(VertexLayout_Interleaved_V, 4);
+    Geometry small = make_geometry(obj, 65536, 300);
+    small.indices.back() = 65535;
+    Geometry large = make_geometry(obj, 65537, 300);
+
+    small.compactIndices();
+    large.compactIndices();
+
+    EXPECT_EQ(small.indexSize(), sizeof(uint16_t));
+    EXPECT_TRUE(small.indices.empty());
+    ASSERT_EQ(small.numIndices(), 300);
+    for (size_t i = 0; i < 299; i++) {
+        EXPECT_EQ(small.getIndex(i), i);
+    }
+    EXPECT_EQ(small.getIndex(299), 65535);
+
+    EXPECT_EQ(large.indexSize(), sizeof(uint32_t));
+    EXPECT_TRUE(large.indices16.empty());
+    EXPECT_EQ(large.numIndices(), 300);
+}
+
+TEST(Geometry, Bounds) {
+    for (VertexLayout layout : { VertexLayout_Interleaved_VN, VertexLayout_Block_VN | VertexLayout_Compressed_V }) {
+        Object obj(layout, 4);
+        obj.geometries.push_back(make_grid_geometry(obj, 8));
+        obj.geometries.push_back(make_grid_geometry(obj, 3));
+        obj.updateBounds();
+
+        // Quantization keeps the corners of the bounds exact
+        EXPECT_EQ(obj.geometries[0].bounds.lower, stage_vec3f(0.f, 0.f, 0.f));
+        EXPECT_EQ(obj.geometries[0].bounds.upper, stage_vec3f(8.f, 8.f, 0.f));
+        EXPECT_EQ(obj.geometries[1].bounds.upper, stage_vec3f(3.f, 3.f, 0.f));
+        EXPECT_EQ(obj.bounds.lower, stage_vec3f(0.f, 0.f, 0.f));
+        EXPECT_EQ(obj.bounds.upper, stage_vec3f(8.f, 8.f, 0.f));
+    }
+
+    EXPECT_TRUE(Object(VertexLayout_Interleaved_V, 4).bounds.isEmpty());
+}
+
+TEST(AABB, Transform) {
+    AABB bounds;
+    bounds.extend(stage_vec3f(0.f, 0.f, 0.f));
+    bounds.extend(stage_vec3f(1.f, 2.f, 3.f));
+
+    // A rotation by 90 degrees around z followed by a translation
+    stage_mat4f m(stage_vec4f(0.f, 1.f, 0.f, 0.f), stage_vec4f(-1.f, 0.f, 0.f, 0.f), stage_vec4f(0.f, 0.f, 1.f, 0.f), stage_vec4f(10.f, 0.f, 0.f, 1.f));
+    AABB transformed = bounds.transform(m);
+    EXPECT_EQ(transformed.lower, stage_vec3f(8.f, 0.f, 0.f));
+    EXPECT_EQ(transformed.upper, stage_vec3f(10.f, 1.f, 3.f));
+
+    EXPECT_TRUE(AABB().transform(m).isEmpty());
+}
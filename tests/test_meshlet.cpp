@@ -0,0 +1,97 @@
+#include "test_common.h"
+#include <set>
+#include <backstage/meshlet.h>
+
+void
+test_meshlets(Geometry& g, size_t max_vertices, size_t max_triangles) {
+    MeshletData data = buildMeshlets(g, max_vertices, max_triangles);
+
+    size_t num_triangles = 0;
+    std::multiset<std::array<uint32_t, 3>> triangles, expected;
+    for (size_t i = 0; i < g.numIndices(); i += 3) {
+        expected.insert({ g.getIndex(i), g.getIndex(i + 1), g.getIndex(i + 2) });
+    }
+
+    for (const Meshlet& m : data.meshlets) {
+        EXPECT_GT(m.triangle_count, 0);
+        EXPECT_LE(m.vertex_count, max_vertices);
+        EXPECT_LE(m.triangle_count, max_triangles);
+        num_triangles += m.triangle_count;
+
+        for (size_t i = 0; i < m.vertex_count; i++) {
+            stage_vec3f d = g.getPosition(data.vertices[m.vertex_offset + i]) - m.center;
+            EXPECT_LE(std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z), m.radius * 1.0001f);
+        }
+        for (size_t t = 0; t < m.triangle_count; t++) {
+            const uint8_t* local = &data.triangles[3 * (m.triangle_offset + t)];
+            std::array<uint32_t, 3> triangle;
+            for (size_t k = 0; k < 3; k++) {
+                ASSERT_LT(local[k], m.vertex_count);
+                triangle[k] = data.vertices[m.vertex_offset + local[k]];
+            }
+            triangles.insert(triangle);
+        }
+    }
+    EXPECT_EQ(num_triangles, g.numIndices() / 3);
+    EXPECT_EQ(triangles, expected);
+}
+
+TEST(Meshlet, RespectsLimits) {
+    Object obj(VertexLayout_Interleaved_VN, 4);
+    Geometry g = make_grid_geometry(obj, 32, true);
+
+    test_meshlets(g, 64, 124);
+    test_meshlets(g, 16, 8);
+    test_meshlets(g, 255, 512);
+    test_meshlets(g, 3, 1);
+}
+
+TEST(Meshlet, BoundsAndCone) {
+    Object obj(VertexLayout_Interleaved_VN, 4);
+    Geometry g = make_grid_geometry(obj, 32);
+    MeshletData data = buildMeshlets(g, 64, 124);
+
+    ASSERT_GT(data.meshlets.size(), 1);
+    for (const Meshlet& m : data.meshlets) {
+        // A flat grid faces +z, so every cluster has a zero width cone
+        EXPECT_NEAR(m.cone_axis.z, 1.f, 1e-5f);
+        EXPECT_NEAR(m.cone_cutoff, 1.f, 1e-5f);
+        EXPECT_EQ(m.center.z, 0.f);
+    }
+}
+
+TEST(Meshlet, StoredInObjectBuffer) {
+    Object obj(VertexLayout_Block_VN | VertexLayout_Compressed_N, 16);
+    obj.geometries.push_back(make_grid_geometry(obj, 8));
+    obj.geometries.push_back(make_grid_geometry(obj, 20));
+    size_t vertex_size = obj.data->size();
+
+    std::vector<MeshletData> data;
+    for (auto& g : obj.geometries) {
+        data.push_back(buildMeshlets(g, 64, 124));
+        MeshletData copy = data.back();
+        storeMeshlets(obj, g, copy);
+    }
+
+    EXPECT_GT(obj.data->size(), vertex_size);
+    for (size_t i = 0; i < obj.geometries.size(); i++) {
+        Geometry& g = obj.geometries[i];
+        ASSERT_EQ(g.meshlets.size(), data[i].meshlets.size());
+        ASSERT_EQ(g.meshlet_vertices.size(), data[i].vertices.size());
+        ASSERT_EQ(g.meshlet_triangles.size(), data[i].triangles.size());
+        EXPECT_GE(g.meshlets.offset(), vertex_size);
+        EXPECT_EQ(g.meshlets.offset() % 16, 0);
+        EXPECT_EQ(g.meshlet_vertices.offset() % 16, 0);
+        EXPECT_EQ(g.meshlet_triangles.offset() % 16, 0);
+        for (size_t m = 0; m < g.meshlets.size(); m++) {
+            EXPECT_EQ(g.meshlets[m].vertex_offset, data[i].meshlets[m].vertex_offset);
+            EXPECT_EQ(g.meshlets[m].triangle_count, data[i].meshlets[m].triangle_count);
+        }
+        for (size_t v = 0; v < g.meshlet_vertices.size(); v++) {
+            EXPECT_EQ(g.meshlet_vertices[v], data[i].vertices[v]);
+        }
+        for (size_t t = 0; t < g.meshlet_triangles.size(); t++) {
+            EXPECT_EQ(g.meshlet_triangles[t], data[i].triangles[t]);
+        }
+    }
+}
@@ -0,0 +1,221 @@
+#include "test_common.h"
+#include <cmath>
+#include <fstream>
+#include <set>
+#include <tuple>
+#include <tiny_obj_loader.h>
+#include <backstage/obj_parser.h>
+
+using IndexKey = std::tuple<int, int, int>;
+
+struct TestFace {
+    std::vector<IndexKey> corners;
+    bool smooth;
+};
+
+/*
+ * Writes an OBJ file and returns the zero based indices that the corners of each face resolve to.
+ * The file is several MB large, so that it is parsed in multiple chunks.
+ * Faces are convex polygons with 3 to 6 corners that mix absolute and relative indices and all index formats.
+ * Material, smoothing group and object statements are sparse, so their state has to be carried across chunk boundaries.
+ */
+std::filesystem::path
+write_test_obj_chunks(std::string name, std::vector<TestFace>& faces) {
+    std::filesystem::path mtl_path = std::filesystem::temp_directory_path() / (name + ".mtl");
+    {
+        std::ofstream mtl(mtl_path);
+        mtl << "newmtl red\nKd 1 0 0\nnewmtl green\nKd 0 1 0\nnewmtl blue\nKd 0 0 1\n";
+    }
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::ofstream out(path);
+    out << "mtllib " << mtl_path.filename().string() << "\n";
+
+    const char* materials[] = { "red", "green", "blue", "missing" };
+    const char* smoothing[] = { "1", "off", "2" };
+    bool smooth = false;
+    int num_vertices = 0, num_normals = 0, num_texcoords = 0;
+    for (int polygon = 0; polygon < 16000; polygon++) {
+        if (polygon % 3000 == 1000)
+            out << "usemtl " << materials[(polygon / 3000) % 4] << "\n";
+        if (polygon % 4100 == 1500) {
+            out << "s " << smoothing[(polygon / 4100) % 3] << "\n";
+            smooth = (polygon / 4100) % 3 != 1;
+        }
+        if (polygon % 5700 == 2000)
+            out << ((polygon / 5700) % 2 ? "g group" : "o object") << polygon << "\n";
+
+        int n = 3 + polygon % 4;
+        int format = (polygon / 4) % 4;    // v, v/vt, v//vn, v/vt/vn
+        bool relative = polygon % 3 == 0;
+        for (int corner = 0; corner < n; corner++) {
+            float angle = 6.2831853f * corner / n;
+            out << "v " << polygon * 0.125f + std::cos(angle) << " " << std::sin(angle) << " " << polygon % 7 << "e-2\n";
+            out << "vt " << corner / float(n) << " " << 0.5f << "\n";
+        }
+        out << "vn 0 0 " << (polygon % 2 ? "1" : "-1") << "\n";
+        num_vertices += n;
+        num_texcoords += n;
+        num_normals += 1;
+
+        TestFace face { {}, smooth };
+        out << "f";
+        for (int corner = 0; corner < n; corner++) {
+            int vertex_index = num_vertices - n + corner, normal_index = -1, texcoord_index = -1;
+            out << " " << (relative ? corner - n : vertex_index + 1);
+            if (format == 1 || format == 3) {
+                texcoord_index = num_texcoords - n + corner;
+                out << "/" << (relative ? corner - n : texcoord_index + 1);
+            }
+            if (format == 2)
+                out << "/";
+            if (format == 2 || format == 3) {
+                normal_index = num_normals - 1;
+                out << "/" << (relative ? -1 : normal_index + 1);
+            }
+            face.corners.push_back(std::make_tuple(vertex_index, normal_index, texcoord_index));
+        }
+        out << "\n";
+        faces.push_back(face);
+    }
+    return path;
+}
+
+static void
+expect_near(const stage_vec3f& a, const stage_vec3f& b, float tolerance = 1e-6f) {
+    EXPECT_NEAR(a.x, b.x, tolerance);
+    EXPECT_NEAR(a.y, b.y, tolerance);
+    EXPECT_NEAR(a.z, b.z, tolerance);
+}
+
+TEST(ObjParser, MatchesTinyObj) {
+    std::vector<TestFace> faces;
+    std::filesystem::path path = write_test_obj_chunks("stage_test_obj_parser.obj", faces);
+    ASSERT_GT(std::filesystem::file_size(path), 3u << 20);
+    std::string mtl_search_path = (std::filesystem::temp_directory_path() / "").string();
+
+    std::vector<ObjShape> shapes;
+    tinyobj::attrib_t reference_attrib;
+    std::vector<tinyobj::shape_t> reference_shapes;
+    std::vector<tinyobj::material_t> materials, reference_materials;
+    std::string warning, error;
+    ASSERT_TRUE(parseObj(path.string(), mtl_search_path, shapes, materials, warning, error)) << error;
+    ASSERT_TRUE(tinyobj::LoadObj(&reference_attrib, &reference_shapes, &reference_materials, &warning, &error, path.string().c_str(), mtl_search_path.c_str())) << error;
+
+    ASSERT_EQ(materials.size(), reference_materials.size());
+    for (size_t i = 0; i < materials.size(); i++)
+        EXPECT_EQ(materials[i].name, reference_materials[i].name);
+
+    // Shapes are split at the same `o` and `g` statements
+    ASSERT_EQ(shapes.size(), reference_shapes.size());
+    ASSERT_EQ(shapes.size(), 4);
+    size_t face_id = 0;
+    for (size_t shape_id = 0; shape_id < shapes.size(); shape_id++) {
+        const ObjShape& shape = shapes[shape_id];
+        const auto& reference = reference_shapes[shape_id].mesh;
+        EXPECT_EQ(shape.name, reference_shapes[shape_id].name);
+        ASSERT_EQ(shape.indices.size(), reference.indices.size());
+        ASSERT_EQ(shape.normals.size(), shape.positions.size());
+        ASSERT_EQ(shape.uvs.size(), shape.positions.size());
+        ASSERT_EQ(shape.material_ids.size(), shape.positions.size());
+
+        // Polygons are fans around their first corner, tinyobj may split them along other diagonals but into as many triangles.
+        // Corners without a normal are only welded within a smoothing group.
+        size_t triangle = 0, expected_vertices = 0;
+        while (triangle < reference.material_ids.size()) {
+            ASSERT_LT(face_id, faces.size());
+            const TestFace& face = faces[face_id++];
+            size_t n = face.corners.size();
+            bool has_normals = std::get<1>(face.corners[0]) >= 0;
+            expected_vertices += has_normals || face.smooth ? n : 3 * (n - 2);
+
+            for (size_t k = 0; k + 2 < n; k++, triangle++) {
+                size_t corners[3] = { 0, k + 1, k + 2 };
+                for (size_t c = 0; c < 3; c++) {
+                    uint32_t vertex = shape.indices[3 * triangle + c];
+                    ASSERT_LT(vertex, shape.positions.size());
+                    auto [vertex_index, normal_index, texcoord_index] = face.corners[corners[c]];
+                    expect_near(shape.positions[vertex], make_vec3(&reference_attrib.vertices[3 * vertex_index]));
+                    // Polygons lie in a plane of constant z and wind counterclockwise
+                    expect_near(shape.normals[vertex], normal_index >= 0 ? make_vec3(&reference_attrib.normals[3 * normal_index]) : stage_vec3f(0.f, 0.f, 1.f));
+                    stage_vec2f uv = texcoord_index >= 0 ? make_vec2(&reference_attrib.texcoords[2 * texcoord_index]) : stage_vec2f(0.f);
+                    EXPECT_FLOAT_EQ(shape.uvs[vertex].x, uv.x);
+                    EXPECT_FLOAT_EQ(shape.uvs[vertex].y, uv.y);
+                    ASSERT_EQ(shape.material_ids[vertex], reference.material_ids[triangle]) << "triangle " << triangle;
+                }
+            }
+        }
+        EXPECT_EQ(shape.positions.size(), expected_vertices);
+    }
+    EXPECT_EQ(face_id, faces.size());
+
+    // The material state set in one chunk reaches the faces of the next one
+    std::set<int> material_ids;
+    for (const auto& shape : shapes)
+        material_ids.insert(shape.material_ids.begin(), shape.material_ids.end());
+    EXPECT_EQ(material_ids, std::set<int>({ -1, 0, 1, 2 }));
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(std::filesystem::temp_directory_path() / "stage_test_obj_parser.obj.mtl");
+}
+
+TEST(ObjParser, SmoothingGroupNormals) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "stage_test_obj_parser_smoothing.obj";
+    {
+        // Two triangles folded along their shared edge from vertex 2 to 3
+        std::ofstream out(path);
+        out << "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 1\nvt 0 0\nvt 1 0\n";
+        out << "o smooth\ns 1\nf 1 2 3\nf 2 4 3\n";
+        out << "o flat\ns off\nf 1 2 3\nf 2 4 3\n";
+        out << "o seam\ns 1\nf 1/1 2/1 3/1\nf 2/2 4/1 3/2\n";
+    }
+
+    std::vector<ObjShape> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warning, error;
+    ASSERT_TRUE(parseObj(path.string(), "", shapes, materials, warning, error)) << error;
+    ASSERT_EQ(shapes.size(), 3);
+
+    // Face normals are weighted by area
+    stage_vec3f first(0.f, 0.f, 1.f), second = stage_vec3f(-1.f, -1.f, 1.f) * stage_vec3f(1.f / std::sqrt(3.f));
+    stage_vec3f shared = stage_vec3f(-1.f, -1.f, 2.f) * stage_vec3f(1.f / std::sqrt(6.f));
+    auto normal_of = [](const ObjShape& shape, size_t triangle, size_t corner) { return shape.normals[shape.indices[3 * triangle + corner]]; };
+
+    const ObjShape& smooth = shapes[0];
+    EXPECT_EQ(smooth.positions.size(), 4);
+    expect_near(normal_of(smooth, 0, 0), first);
+    expect_near(normal_of(smooth, 0, 1), shared);
+    expect_near(normal_of(smooth, 1, 1), second);
+
+    const ObjShape& flat = shapes[1];
+    EXPECT_EQ(flat.positions.size(), 6);
+    for (size_t c = 0; c < 3; c++) {
+        expect_near(normal_of(flat, 0, c), first);
+        expect_near(normal_of(flat, 1, c), second);
+    }
+
+    // Differing uvs split the vertices of the shared edge, but not their normals
+    const ObjShape& seam = shapes[2];
+    EXPECT_EQ(seam.positions.size(), 6);
+    expect_near(normal_of(seam, 0, 1), shared);
+    expect_near(normal_of(seam, 1, 0), shared);
+    EXPECT_NE(seam.indices[1], seam.indices[3]);
+
+    std::filesystem::remove(path);
+}
+
+TEST(ObjParser, InvalidIndex) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "stage_test_obj_parser_invalid.obj";
+    {
+        std::ofstream out(path);
+        out << "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 -4\n";
+    }
+
+    std::vector<ObjShape> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warning, error;
+    EXPECT_FALSE(parseObj(path.string(), "", shapes, materials, warning, error));
+    EXPECT_FALSE(error.empty());
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,92 @@
+#include "test_common.h"
+#include <algorithm>
+#include <array>
+#include <set>
+#include <backstage/optimize.h>
+
+/* Triangles as sets of positions, which are invariant under reordering */
+std::multiset<std::array<float, 9>>
+triangle_set(const Geometry& g) {
+    std::multiset<std::array<float, 9>> triangles;
+    for (size_t i = 0; i < g.indices.size(); i += 3) {
+        std::array<stage_vec3f, 3> corners = { g.getPosition(g.indices[i]), g.getPosition(g.indices[i + 1]), g.getPosition(g.indices[i + 2]) };
+        // Rotate the smallest corner first, the winding order is preserved
+        size_t first = 0;
+        for (size_t k = 1; k < 3; k++) {
+            if (std::tie(corners[k].x, corners[k].y) < std::tie(corners[first].x, corners[first].y))
+                first = k;
+        }
+        std::array<float, 9> triangle;
+        for (size_t k = 0; k < 3; k++) {
+            stage_vec3f c = corners[(first + k) % 3];
+            triangle[3 * k] = c.x;
+            triangle[3 * k + 1] = c.y;
+            triangle[3 * k + 2] = c.z;
+        }
+        triangles.insert(triangle);
+    }
+    return triangles;
+}
+
+TEST(Optimize, CountCacheMisses) {
+    std::vector<uint32_t> indices = { 0, 1, 2, 2, 1, 3, 0, 1, 2 };
+    EXPECT_EQ(countCacheMisses(indices, 4, 16), 4);
+    // With a single entry only the repeated vertex hits
+    EXPECT_EQ(countCacheMisses(indices, 4, 1), 8);
+}
+
+TEST(Optimize, VertexFetchOrder) {
+    std::vector<uint32_t> indices = { 4, 2, 0, 2, 4, 5 };
+    std::vector<uint32_t> order = optimizeVertexFetch(indices, 6);
+
+    EXPECT_EQ(indices, std::vector<uint32_t>({ 0, 1, 2, 1, 0, 3 }));
+    EXPECT_EQ(order, std::vector<uint32_t>({ 4, 2, 0, 5, 1, 3 }));
+}
+
+TEST(Optimize, ReducesACMR) {
+    Object obj(VertexLayout_Interleaved_VN, 4);
+    Geometry g = make_grid_geometry(obj, 64, true);
+    auto before = triangle_set(g);
+
+    VertexCacheStats stats = optimizeGeometry(g);
+
+    EXPECT_EQ(stats.num_triangles, 2 * 64 * 64);
+    EXPECT_GT(stats.acmrBefore(), 2.f);
+    EXPECT_LT(stats.acmrAfter(), 0.8f);
+    EXPECT_EQ(stats.misses_after, countCacheMisses(g.indices, g.numVertices()));
+    EXPECT_EQ(triangle_set(g), before);
+
+    // Vertices are numbered in order of first use and keep all of their attributes
+    uint32_t next = 0;
+    for (uint32_t index : g.indices) {
+        EXPECT_LE(index, next);
+        next = std::max(next, index + 1);
+    }
+    for (size_t i = 0; i < g.numVertices(); i++) {
+        stage_vec3f p = g.getPosition(i);
+        EXPECT_EQ(g.material_ids[i], uint32_t(p.x + p.y));
+        EXPECT_EQ(g.getNormal(i), stage_vec3f(0.f, 0.f, 1.f));
+    }
+}
+
+TEST(Optimize, CompressedLayout) {
+    Object obj(VertexLayout_Block_VN | VertexLayout_Compressed_N | VertexLayout_Compressed_V, 4);
+    Geometry g = make_grid_geometry(obj, 16, true);
+    auto before = triangle_set(g);
+
+    VertexCacheStats stats = optimizeGeometry(g);
+
+    EXPECT_LT(stats.misses_after, stats.misses_before);
+    EXPECT_EQ(triangle_set(g), before);
+}
+
+TEST(Optimize, SkipsInvalidGeometry) {
+    Object obj(VertexLayout_Interleaved_V, 4);
+    Geometry g = make_geometry(obj, 8, 4);
+    std::vector<uint32_t> indices = g.indices;
+
+    VertexCacheStats stats = optimizeGeometry(g);
+
+    EXPECT_EQ(stats.num_triangles, 0);
+    EXPECT_EQ(g.indices, indices);
+}
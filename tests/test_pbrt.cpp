@@ -0,0 +1,54 @@
+#include "test_common.h"
+#include <cstring>
+#include <fstream>
+
+/* Two triangles, the first one with an image texture and the second one with the same texture node scaled */
+std::filesystem::path
+write_test_pbrt(std::string name, std::string texture_name, bool scaled_first) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::string base = "AttributeBegin\nMaterial \"matte\" \"texture Kd\" \"base\"\n"
+                       "Shape \"trianglemesh\" \"integer indices\" [0 1 2] \"point P\" [0 0 0 1 0 0 0 1 0]\nAttributeEnd\n";
+    std::string scaled = "AttributeBegin\nMaterial \"matte\" \"texture Kd\" \"scaled\"\n"
+                         "Shape \"trianglemesh\" \"integer indices\" [0 1 2] \"point P\" [0 0 1 1 0 1 0 1 1]\nAttributeEnd\n";
+    std::ofstream out(path);
+    out << "LookAt 0 0 5  0 0 0  0 1 0\nCamera \"perspective\"\nWorldBegin\n"
+        << "Texture \"base\" \"spectrum\" \"imagemap\" \"string filename\" \"" << texture_name << "\"\n"
+        << "Texture \"scaled\" \"spectrum\" \"scale\" \"texture tex1\" \"base\" \"rgb tex2\" [0.5 0.5 0.5]\n"
+        << (scaled_first ? scaled + base : base + scaled)
+        << "WorldEnd\n";
+    return path;
+}
+
+TEST(PBRT, ScaleKeepsSharedTexture) {
+    std::filesystem::path texture_path = write_test_ppm("stage_test_pbrt_base.ppm", 4, 4);
+    Image original(texture_path.string());
+    Image scaled(texture_path.string());
+    scaled.scale(stage_vec3f(0.5f));
+
+    // Either material may reach the shared texture node first
+    for (bool scaled_first : { false, true }) {
+        std::filesystem::path scene_path = write_test_pbrt("stage_test_pbrt_shared.pbrt", texture_path.filename().string(), scaled_first);
+        stage::Scene scene(scene_path.string(), Config());
+        ASSERT_TRUE(scene.isValid());
+
+        std::vector<int32_t> texture_ids;
+        for (auto& material : scene.getMaterials()) {
+            if (material.base_color_texid >= 0)
+                texture_ids.push_back(material.base_color_texid);
+        }
+        ASSERT_EQ(texture_ids.size(), 2);
+        ASSERT_NE(texture_ids[0], texture_ids[1]);
+
+        Image& first = scene.getTextures()[texture_ids[0]];
+        Image& second = scene.getTextures()[texture_ids[1]];
+        Image& base_texture = scaled_first ? second : first;
+        Image& scaled_texture = scaled_first ? first : second;
+        ASSERT_EQ(base_texture.getSizeInBytes(), original.getSizeInBytes());
+        EXPECT_EQ(std::memcmp(base_texture.getData(), original.getData(), original.getSizeInBytes()), 0);
+        EXPECT_EQ(std::memcmp(scaled_texture.getData(), scaled.getData(), scaled.getSizeInBytes()), 0);
+
+        std::filesystem::remove(scene_path);
+    }
+
+    std::filesystem::remove(texture_path);
+}
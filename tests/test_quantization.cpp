@@ -0,0 +1,59 @@
+#include "test_common.h"
+#include "backstage/quantization.h"
+
+using namespace stage::backstage;
+
+TEST(Quantization, HalfRoundTrip) {
+    for (float value : {0.f, -0.f, 1.f, -1.f, 0.5f, 65504.f, -2.f, 6.103515625e-05f, 5.9604645e-08f}) {
+        EXPECT_EQ(halfToFloat(floatToHalf(value)), value);
+    }
+    EXPECT_EQ(floatToHalf(1.f), 0x3c00);
+    EXPECT_EQ(floatToHalf(-2.f), 0xc000);
+    EXPECT_TRUE(std::isinf(halfToFloat(floatToHalf(1e6f))));
+    EXPECT_TRUE(std::isnan(halfToFloat(floatToHalf(std::nanf("")))));
+    EXPECT_EQ(halfToFloat(floatToHalf(1e-10f)), 0.f);
+
+    // Relative error of normal values is bounded by half an ulp
+    for (float value = -100.f; value < 100.f; value += 0.37f) {
+        EXPECT_NEAR(halfToFloat(floatToHalf(value)), value, std::abs(value) / 2048.f + 1e-7f);
+    }
+}
+
+TEST(Quantization, HalfRoundsToNearestEven) {
+    // 1 + 2^-11 lies halfway between 1 and the next half, ties go to the even mantissa
+    EXPECT_EQ(floatToHalf(1.f + std::ldexp(1.f, -11)), 0x3c00);
+    EXPECT_EQ(floatToHalf(1.f + 3.f * std::ldexp(1.f, -11)), 0x3c02);
+    EXPECT_EQ(floatToHalf(1.f + std::ldexp(1.f, -11) + std::ldexp(1.f, -20)), 0x3c01);
+}
+
+TEST(Quantization, OctahedralRoundTrip) {
+    for (int i = 0; i < 1000; i++) {
+        float z = 2.f * (i + 0.5f) / 1000.f - 1.f;
+        float phi = i * 2.39996323f;
+        float r = std::sqrt(1.f - z * z);
+        stage_vec3f n(r * std::cos(phi), r * std::sin(phi), z);
+        stage_vec3f decoded = decodeOctahedral(encodeOctahedral(n));
+        EXPECT_NEAR(decoded.x, n.x, 1e-4f);
+        EXPECT_NEAR(decoded.y, n.y, 1e-4f);
+        EXPECT_NEAR(decoded.z, n.z, 1e-4f);
+    }
+    for (stage_vec3f n : {stage_vec3f(1, 0, 0), stage_vec3f(0, -1, 0), stage_vec3f(0, 0, 1), stage_vec3f(0, 0, -1)}) {
+        EXPECT_EQ(decodeOctahedral(encodeOctahedral(n)), n);
+    }
+}
+
+TEST(Quantization, PositionRoundTrip) {
+    stage_vec3f lo(-5.f, 0.f, 2.f);
+    stage_vec3f hi(5.f, 1000.f, 2.f);
+    stage_vec3f scale = positionScale(lo, hi);
+
+    EXPECT_EQ(quantizePosition(lo, lo, scale), stage_vec3us(uint16_t(0), uint16_t(0), uint16_t(0)));
+    EXPECT_EQ(quantizePosition(hi, lo, scale), stage_vec3us(uint16_t(65535), uint16_t(65535), uint16_t(0)));
+    for (float t = 0.f; t <= 1.f; t += 0.01f) {
+        stage_vec3f p(lo.x + t * (hi.x - lo.x), lo.y + t * (hi.y - lo.y), 2.f);
+        stage_vec3f decoded = dequantizePosition(quantizePosition(p, lo, scale), lo, scale);
+        EXPECT_NEAR(decoded.x, p.x, scale.x);
+        EXPECT_NEAR(decoded.y, p.y, scale.y);
+        EXPECT_EQ(decoded.z, p.z);
+    }
+}
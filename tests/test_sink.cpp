@@ -0,0 +1,92 @@
+#include "test_common.h"
+#include <fstream>
+
+struct RecordingSink : public SceneSink {
+    void onGeometry(uint32_t object_id, Object& object) override {
+        object_ids.push_back(object_id);
+        num_geometries += object.geometries.size();
+        num_vertices += object.geometries[0].positions.size();
+    }
+    void onMaterial(uint32_t /*material_id*/, const OpenPBRMaterial& /*material*/) override { num_materials++; }
+    void onLight(const Light& /*light*/) override { num_lights++; }
+    void onInstance(const ObjectInstance& instance) override { instances.push_back(instance); }
+
+    std::vector<uint32_t> object_ids;
+    std::vector<ObjectInstance> instances;
+    size_t num_geometries { 0 };
+    size_t num_vertices { 0 };
+    size_t num_materials { 0 };
+    size_t num_lights { 0 };
+};
+
+TEST(SceneSink, StreamsObj) {
+    std::filesystem::path obj_path = write_test_obj("stage_test_sink.obj");
+
+    stage::Scene reference(obj_path.string(), Config());
+    ASSERT_TRUE(reference.isValid());
+
+    auto sink = std::make_shared<RecordingSink>();
+    Config config;
+    config.sink = sink;
+    stage::Scene streamed(obj_path.string(), config);
+    ASSERT_TRUE(streamed.isValid());
+
+    EXPECT_EQ(streamed.getObjects().size(), 0);
+    EXPECT_EQ(sink->num_geometries, reference.getObjects()[0].geometries.size());
+    EXPECT_EQ(sink->num_vertices, reference.getObjects()[0].geometries[0].positions.size());
+    EXPECT_EQ(sink->num_materials, reference.getMaterials().size());
+    EXPECT_EQ(sink->num_lights, reference.getLights().size());
+    ASSERT_EQ(sink->instances.size(), reference.getInstances().size());
+    for (size_t i = 0; i < sink->instances.size(); i++) {
+        EXPECT_EQ(sink->instances[i].object_id, sink->object_ids[0]);
+        EXPECT_EQ(sink->instances[i].bounds.lower, reference.getInstances()[i].bounds.lower);
+        EXPECT_EQ(sink->instances[i].bounds.upper, reference.getInstances()[i].bounds.upper);
+    }
+    EXPECT_FLOAT_EQ(streamed.getSceneScale(), reference.getSceneScale());
+    EXPECT_FLOAT_EQ(reference.getSceneScale(), 1.f);
+
+    std::filesystem::remove(obj_path);
+}
+
+/* Records how much allocator memory is alive whenever a geometry is delivered */
+struct MemorySink : public SceneSink {
+    void onGeometry(uint32_t /*object_id*/, Object& object) override {
+        outstanding.push_back(allocator->outstanding);
+        capacities.push_back(object.data->capacity());
+    }
+
+    std::shared_ptr<CountingAllocator> allocator;
+    std::vector<int64_t> outstanding;
+    std::vector<size_t> capacities;
+};
+
+TEST(SceneSink, ReleasesObjChunks) {
+    // Three quads in separate objects, each one becomes a geometry of its own
+    std::filesystem::path obj_path = std::filesystem::temp_directory_path() / "stage_test_sink_chunks.obj";
+    {
+        std::ofstream out(obj_path);
+        out << "vn 0 0 1\n";
+        for (int i = 0; i < 3; i++) {
+            out << "o quad" << i << "\n"
+                << "v " << i << " 0 0\nv " << i + 1 << " 0 0\nv " << i + 1 << " 1 0\nv " << i << " 1 0\n"
+                << "f -4//1 -3//1 -2//1 -1//1\n";
+        }
+    }
+
+    auto allocator = std::make_shared<CountingAllocator>();
+    auto sink = std::make_shared<MemorySink>();
+    sink->allocator = allocator;
+    Config config;
+    config.sink = sink;
+    config.allocator = allocator;
+    stage::Scene streamed(obj_path.string(), config);
+    ASSERT_TRUE(streamed.isValid());
+
+    // Only the buffer of the geometry that is being delivered may be alive
+    ASSERT_EQ(sink->outstanding.size(), 3);
+    for (size_t i = 0; i < sink->outstanding.size(); i++) {
+        EXPECT_EQ(sink->outstanding[i], int64_t(sink->capacities[i]));
+    }
+
+    std::filesystem::remove(obj_path);
+}
@@ -0,0 +1,62 @@
+#include "test_common.h"
+
+#include <cstring>
+#include <fstream>
+
+TEST(Snapshot, RoundTrip) {
+    std::filesystem::path obj_path = write_test_obj("stage_test_snapshot.obj");
+    std::filesystem::path snapshot_path = std::filesystem::temp_directory_path() / "stage_test_snapshot.stage";
+    std::filesystem::remove(snapshot_path);
+
+    Config config;
+    config.snapshot_path = snapshot_path.string();
+    stage::Scene source(obj_path.string(), config);
+    ASSERT_TRUE(source.isValid());
+    ASSERT_TRUE(std::filesystem::exists(snapshot_path));
+
+    stage::Scene snapshot(snapshot_path.string(), Config());
+    ASSERT_TRUE(snapshot.isValid());
+
+    EXPECT_EQ(snapshot.getSceneScale(), source.getSceneScale());
+    EXPECT_EQ(snapshot.getSceneBounds().lower, source.getSceneBounds().lower);
+    EXPECT_EQ(snapshot.getSceneBounds().upper, source.getSceneBounds().upper);
+    EXPECT_EQ(snapshot.getMaterials().size(), source.getMaterials().size());
+    EXPECT_EQ(snapshot.getInstances().size(), source.getInstances().size());
+    ASSERT_EQ(snapshot.getObjects().size(), source.getObjects().size());
+
+    for (size_t o = 0; o < source.getObjects().size(); ++o) {
+        Object& a = source.getObjects()[o];
+        Object& b = snapshot.getObjects()[o];
+        EXPECT_EQ(a.layout(), b.layout());
+        EXPECT_EQ(a.bounds.lower, b.bounds.lower);
+        EXPECT_EQ(a.bounds.upper, b.bounds.upper);
+        ASSERT_EQ(a.data->size(), b.data->size());
+        EXPECT_EQ(std::memcmp(a.data->data(), b.data->data(), a.data->size()), 0);
+        ASSERT_EQ(a.geometries.size(), b.geometries.size());
+
+        for (size_t g = 0; g < a.geometries.size(); ++g) {
+            EXPECT_EQ(a.geometries[g].indices, b.geometries[g].indices);
+            EXPECT_EQ(a.geometries[g].indices16, b.geometries[g].indices16);
+            EXPECT_EQ(a.geometries[g].positions.offset(), b.geometries[g].positions.offset());
+            EXPECT_EQ(a.geometries[g].positions.size(), b.geometries[g].positions.size());
+            EXPECT_EQ(a.geometries[g].normals.stride(), b.geometries[g].normals.stride());
+            EXPECT_EQ(a.geometries[g].uvs.size(), b.geometries[g].uvs.size());
+        }
+    }
+
+    std::filesystem::remove(obj_path);
+    std::filesystem::remove(snapshot_path);
+}
+
+TEST(Snapshot, RejectCorruptFile) {
+    std::filesystem::path snapshot_path = std::filesystem::temp_directory_path() / "stage_test_corrupt.stage";
+    {
+        std::ofstream out(snapshot_path, std::ios::binary);
+        out << "STAGESNP";
+    }
+
+    stage::Scene snapshot(snapshot_path.string(), Config());
+    EXPECT_FALSE(snapshot.isValid());
+
+    std::filesystem::remove(snapshot_path);
+}
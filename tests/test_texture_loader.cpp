@@ -0,0 +1,179 @@
+#include "test_common.h"
+#include <backstage/texture_loader.h>
+
+#include <cstring>
+#include <fstream>
+
+TEST(TextureLoader, DeterministicIndices) {
+    std::vector<std::filesystem::path> paths;
+    for (int i = 0; i < 16; i++) {
+        paths.push_back(write_test_ppm("stage_test_loader_" + std::to_string(i) + ".ppm", i + 1, 1));
+    }
+
+    std::vector<Image> textures;
+    TextureLoader loader(textures, false);
+    for (uint32_t i = 0; i < paths.size(); i++) {
+        EXPECT_EQ(loader.load(paths[i].string()), i);
+    }
+    loader.finish(true);
+
+    ASSERT_EQ(textures.size(), paths.size());
+    for (uint32_t i = 0; i < paths.size(); i++) {
+        EXPECT_EQ(textures[i].getWidth(), i + 1);
+        std::filesystem::remove(paths[i]);
+    }
+}
+
+TEST(TextureLoader, DropInvalid) {
+    std::filesystem::path path = write_test_ppm("stage_test_loader_valid.ppm", 2, 2);
+
+    std::vector<Image> textures;
+    TextureLoader loader(textures, false);
+    uint32_t invalid = loader.load("stage_test_does_not_exist.png");
+    uint32_t valid = loader.load(path.string());
+    uint32_t constant = loader.add(Image(stage_vec3f(1.f)));
+    std::vector<int32_t> remap = loader.finish(true);
+
+    ASSERT_EQ(textures.size(), 2);
+    EXPECT_EQ(remap[invalid], -1);
+    EXPECT_EQ(remap[valid], 0);
+    EXPECT_EQ(remap[constant], 1);
+    EXPECT_EQ(textures[0].getWidth(), 2);
+    EXPECT_EQ(textures[1].getWidth(), 1);
+
+    std::filesystem::remove(path);
+}
+
+TEST(TextureLoader, DeferredOperations) {
+    std::vector<Image> textures;
+    TextureLoader loader(textures, false);
+    uint32_t index = loader.add(Image(stage_vec3f(1.f)));
+
+    std::vector<int> order;
+    loader.defer([&](std::vector<Image>& t) { order.push_back(0); t[index].scale(stage_vec3f(0.5f)); });
+    loader.defer([&](std::vector<Image>& t) { order.push_back(1); EXPECT_EQ(&t, &textures); });
+    loader.finish(false);
+
+    ASSERT_EQ(order.size(), 2);
+    EXPECT_EQ(order[0], 0);
+    EXPECT_EQ(order[1], 1);
+    EXPECT_EQ(textures[index].getData()[0], 128);
+}
+
+TEST(TextureLoader, ShareFiles) {
+    std::filesystem::path path = write_test_ppm("stage_test_loader_shared.ppm", 4, 4);
+    std::filesystem::path alias = path.parent_path() / "." / path.filename();
+
+    std::vector<Image> textures;
+    TextureLoader loader(textures, false);
+    uint32_t a = loader.load(path.string());
+    uint32_t b = loader.load(alias.string());
+    uint32_t hdr = loader.load(path.string(), true);
+    loader.finish(true);
+
+    EXPECT_EQ(a, b);
+    EXPECT_NE(a, hdr);
+    EXPECT_EQ(textures.size(), 2);
+    EXPECT_EQ(loader.getSavedBytes(), 4 * 4 * 4);
+
+    std::filesystem::remove(path);
+}
+
+TEST(TextureLoader, ShareBlobs) {
+    std::filesystem::path path = write_test_ppm("stage_test_loader_blob.ppm", 4, 4);
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> blob((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::vector<uint8_t> blob_copy = blob;
+    std::vector<uint8_t> blob_other = blob;
+    blob_other.back() ^= 0xff;
+
+    std::vector<Image> textures;
+    TextureLoader loader(textures, false);
+    uint32_t a = loader.load(blob.data(), blob.size());
+    uint32_t b = loader.load(blob_copy.data(), blob_copy.size());
+    uint32_t c = loader.load(blob_other.data(), blob_other.size());
+    loader.finish(true);
+
+    EXPECT_EQ(a, b);
+    EXPECT_NE(a, c);
+    EXPECT_EQ(textures.size(), 2);
+
+    std::filesystem::remove(path);
+}
+
+TEST(TextureLoader, MakeUnique) {
+    std::filesystem::path path = write_test_ppm("stage_test_loader_unique.ppm", 4, 4);
+
+    std::vector<Image> textures;
+    TextureLoader loader(textures, false);
+    uint32_t shared = loader.load(path.string());
+    EXPECT_EQ(loader.load(path.string()), shared);
+
+    uint32_t unique = loader.makeUnique(shared);
+    EXPECT_NE(unique, shared);
+    // The new image is not registered, so it is not handed out again
+    EXPECT_EQ(loader.load(path.string()), shared);
+
+    // The last reference keeps its index but is no longer shared with later requests
+    uint32_t single = loader.load(std::string("stage_test_does_not_exist.png"));
+    EXPECT_EQ(loader.makeUnique(single), single);
+    EXPECT_NE(loader.load(std::string("stage_test_does_not_exist.png")), single);
+
+    loader.finish(false);
+    EXPECT_EQ(textures.size(), 4);
+
+    std::filesystem::remove(path);
+}
+
+TEST(TextureLoader, ReferenceClaimed) {
+    std::filesystem::path path = write_test_ppm("stage_test_loader_claimed.ppm", 4, 4);
+
+    std::vector<Image> textures;
+    TextureLoader loader(textures, false);
+
+    // The only user of an image may modify it in place, later users get the unmodified pixels
+    uint32_t file = loader.load(path.string());
+    EXPECT_EQ(loader.makeUnique(file), file);
+    uint32_t file_copy = loader.reference(file);
+    EXPECT_NE(file_copy, file);
+    loader.defer([=](std::vector<Image>& textures) { textures[file].scale(stage_vec3f(0.5f)); });
+
+    // Images that are referenced twice are copied before they are modified
+    uint32_t color = loader.add(Image(stage_vec3f(1.f, 0.5f, 0.f)));
+    EXPECT_EQ(loader.reference(color), color);
+    uint32_t color_unique = loader.makeUnique(color);
+    EXPECT_NE(color_unique, color);
+    loader.defer([=](std::vector<Image>& textures) { textures[color_unique].scale(stage_vec3f(0.5f)); });
+
+    loader.finish(false);
+    Image original(path.string());
+    Image scaled(path.string());
+    scaled.scale(stage_vec3f(0.5f));
+    EXPECT_EQ(std::memcmp(textures[file_copy].getData(), original.getData(), original.getSizeInBytes()), 0);
+    EXPECT_EQ(std::memcmp(textures[file].getData(), scaled.getData(), scaled.getSizeInBytes()), 0);
+    EXPECT_EQ(textures[color].getData()[0], 255);
+    EXPECT_EQ(textures[color_unique].getData()[0], 128);
+
+    std::filesystem::remove(path);
+}
+
+TEST(TextureLoader, GenerateMips) {
+    std::filesystem::path path = write_test_ppm("stage_test_loader_mips.ppm", 8, 2);
+
+    for (bool lazy : { false, true }) {
+        std::vector<Image> textures;
+        TextureLoader loader(textures, lazy, false, nullptr, MipFilter_Kaiser);
+        uint32_t file = loader.load(path.string());
+        uint32_t color = loader.add(Image(stage_vec3f(1.f)));
+        loader.finish(true);
+
+        EXPECT_EQ(textures[file].getMipFilter(), MipFilter_Kaiser);
+        EXPECT_EQ(textures[file].getLevelCount(), 4);
+        EXPECT_EQ(textures[file].isLoaded(), !lazy);
+        ASSERT_NE(textures[file].getData(), nullptr);
+        EXPECT_EQ(textures[file].getSizeInBytes(), (8 * 2 + 4 + 2 + 1) * 4);
+        EXPECT_EQ(textures[color].getLevelCount(), 1);
+    }
+
+    std::filesystem::remove(path);
+}
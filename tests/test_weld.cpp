@@ -0,0 +1,37 @@
+#include "test_common.h"
+#include <backstage/weld.h>
+
+TEST(VertexWelder, AssignsIndicesInOrder) {
+    VertexWelder<uint32_t> welder;
+
+    std::vector<uint32_t> keys = { 7, 3, 7, 9, 3, 1 };
+    std::vector<uint32_t> expected = { 0, 1, 0, 2, 1, 3 };
+    for (size_t i = 0; i < keys.size(); i++) {
+        EXPECT_EQ(welder.weld(keys[i]), expected[i]);
+    }
+    EXPECT_EQ(welder.size(), 4);
+}
+
+TEST(VertexWelder, ReportsInsertion) {
+    VertexWelder<stage_vec3i> welder;
+    bool inserted;
+
+    welder.weld(stage_vec3i(0, 1, 2), inserted);
+    EXPECT_TRUE(inserted);
+    welder.weld(stage_vec3i(0, 1, 3), inserted);
+    EXPECT_TRUE(inserted);
+    welder.weld(stage_vec3i(0, 1, 2), inserted);
+    EXPECT_FALSE(inserted);
+}
+
+TEST(VertexWelder, Grow) {
+    VertexWelder<uint64_t> welder;
+
+    for (uint64_t i = 0; i < 100000; i++) {
+        EXPECT_EQ(welder.weld(i << 32 | (i % 7)), i);
+    }
+    for (uint64_t i = 0; i < 100000; i++) {
+        EXPECT_EQ(welder.weld(i << 32 | (i % 7)), i);
+    }
+    EXPECT_EQ(welder.size(), 100000);
+}